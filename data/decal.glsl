@@ -0,0 +1,52 @@
+/*vertex shader*/
+#version 300 es
+in vec3 aPosition;
+in vec4 aDecal;
+in vec4 aDecalAxis;
+in vec4 aDecalAtlas;
+in vec4 aDecalColor;
+uniform mat4 uViewProjection;
+flat out vec4 decal;
+flat out vec4 axis;
+flat out vec4 atlas;
+flat out vec4 color;
+void main()
+{
+	vec2 rotated = vec2(aPosition.x * aDecalAxis.x - aPosition.z * aDecalAxis.y, aPosition.x * aDecalAxis.y + aPosition.z * aDecalAxis.x) * aDecal.w;
+	vec3 world = aDecal.xyz + vec3(rotated.x, aPosition.y * aDecalAxis.z, rotated.y);
+	decal = aDecal;
+	axis = aDecalAxis;
+	atlas = aDecalAtlas;
+	color = aDecalColor;
+	gl_Position = uViewProjection * vec4(world, 1.0);
+}
+
+/*fragment shader*/
+#version 300 es
+precision highp float;
+uniform sampler2D uDepth;
+uniform mediump sampler2D uDecalAtlas;
+uniform mat4 uInverseViewProjection;
+flat in vec4 decal;
+flat in vec4 axis;
+flat in vec4 atlas;
+flat in vec4 color;
+out vec4 oColor;
+
+void main()
+{
+	vec2 screen = gl_FragCoord.xy / vec2(textureSize(uDepth, 0));
+	float depth = texture(uDepth, screen).r;
+	vec4 world = uInverseViewProjection * vec4(vec3(screen, depth) * 2.0 - 1.0, 1.0);
+	vec3 offset = world.xyz / world.w - decal.xyz;
+	vec3 local = vec3(offset.x * axis.x + offset.z * axis.y, offset.y / axis.z, offset.z * axis.x - offset.x * axis.y);
+	local.xz /= decal.w;
+	if (any(greaterThan(abs(local), vec3(0.5))))
+		discard;
+
+	// Fade towards the top and bottom of the box so steep ground does not
+	// show a hard cut.
+	vec4 albedo = texture(uDecalAtlas, atlas.xy + (local.xz + 0.5) * atlas.zw) * color;
+	albedo.a *= 1.0 - smoothstep(0.35, 0.5, abs(local.y));
+	oColor = albedo;
+}
\ No newline at end of file
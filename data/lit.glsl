@@ -0,0 +1,94 @@
+/*vertex shader*/
+#version 300 es
+in vec3 aPosition;
+in vec3 aNormal;
+in vec4 aColor;
+in mat4 aModel;
+uniform mat4 uViewProjection;
+uniform mat4 uView;
+out vec3 worldPosition;
+out vec3 worldNormal;
+out float viewDepth;
+out vec4 color;
+void main()
+{
+vec4 world = aModel * vec4(aPosition, 1.0);
+worldPosition = world.xyz;
+worldNormal = mat3(aModel) * aNormal;
+viewDepth = -(uView * world).z;
+color = aColor;
+gl_Position = uViewProjection * world;
+}
+
+/*fragment shader*/
+#version 300 es
+precision mediump float;
+precision highp usampler2D;
+uniform highp usampler2D uClusterGrid;
+uniform highp usampler2D uClusterLights;
+uniform highp sampler2D uLightData;
+uniform highp sampler2DArray uShadowMap;
+uniform highp mat4 uShadowMatrices[4];
+uniform int uShadowCascadeCount;
+uniform float uShadowTexelSize;
+uniform ivec3 uClusterTiles;
+uniform vec4 uClusterScale;
+uniform sampler2D uFogOfWar;
+uniform vec4 uFogOfWarScale;
+in highp vec3 worldPosition;
+in vec3 worldNormal;
+in float viewDepth;
+in vec4 color;
+out vec4 oColor;
+
+float shadow(highp vec3 position)
+{
+	// Same lookup as terrain.glsl, so units and ground agree on shadow edges.
+	for (int i = 0; i < uShadowCascadeCount; i++)
+	{
+		highp vec3 coord = (uShadowMatrices[i] * vec4(position, 1.0)).xyz * 0.5 + 0.5;
+		if (all(greaterThan(coord.xy, vec2(uShadowTexelSize))) && all(lessThan(coord.xy, vec2(1.0 - uShadowTexelSize))))
+		{
+			float lit = 0.0;
+			for (int k = 0; k < 4; k++)
+			{
+				highp vec2 offset = (vec2(float(k & 1), float(k >> 1)) - 0.5) * uShadowTexelSize;
+				lit += step(coord.z, texture(uShadowMap, vec3(coord.xy + offset, float(i))).r);
+			}
+			return lit * 0.25;
+		}
+	}
+	return 1.0;
+}
+
+void main()
+{
+	ivec2 tile = ivec2(gl_FragCoord.xy * uClusterScale.xy);
+	int slice = clamp(int(log(viewDepth) * uClusterScale.z + uClusterScale.w), 0, uClusterTiles.z - 1);
+	uint cluster = texelFetch(uClusterGrid, ivec2(tile.y * uClusterTiles.x + tile.x, slice), 0).r;
+	int offset = int(cluster >> 8u);
+	int count = int(cluster & 255u);
+
+	vec3 normal = normalize(worldNormal);
+	vec3 lighting = vec3(0.15);
+	// The sun matches terrain.glsl. With no shadow map bound the cascade count
+	// stays 0 and units are fully lit.
+	float sun = max(dot(normal, normalize(vec3(0.4, 1.0, 0.3))), 0.0);
+	lighting += vec3(0.7 * sun * shadow(worldPosition));
+	for (int i = 0; i < count; i++)
+	{
+		int index = offset + i;
+		int light = int(texelFetch(uClusterLights, ivec2(index & 1023, index >> 10), 0).r);
+		vec4 positionRadius = texelFetch(uLightData, ivec2(0, light), 0);
+		vec3 radiance = texelFetch(uLightData, ivec2(1, light), 0).rgb;
+		vec3 toLight = positionRadius.xyz - worldPosition;
+		float distance = length(toLight);
+		float falloff = clamp(1.0 - distance / positionRadius.w, 0.0, 1.0);
+		lighting += radiance * falloff * falloff * max(dot(normal, toLight / max(distance, 0.0001)), 0.0);
+	}
+	// Units are hidden outside currently visible cells, not just darkened.
+	float fog = uFogOfWarScale.x > 0.0 ? texture(uFogOfWar, worldPosition.xz * uFogOfWarScale.xy + uFogOfWarScale.zw).r : 1.0;
+	if (fog < 0.75)
+		discard;
+	oColor = vec4(color.rgb * lighting, color.a);
+}
\ No newline at end of file
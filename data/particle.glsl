@@ -0,0 +1,30 @@
+/*vertex shader*/
+#version 300 es
+in vec3 aPosition;
+in vec4 aParticle;
+in vec4 aParticleColor;
+uniform mat4 uViewProjection;
+uniform vec3 uCameraRight;
+uniform vec3 uCameraUp;
+out vec2 uv;
+out vec4 color;
+void main()
+{
+vec3 world = aParticle.xyz + (uCameraRight * aPosition.x + uCameraUp * aPosition.y) * aParticle.w;
+uv = aPosition.xy + 0.5;
+color = aParticleColor;
+gl_Position = uViewProjection * vec4(world, 1.0);
+}
+
+/*fragment shader*/
+#version 300 es
+precision mediump float;
+uniform sampler2D uTexture;
+in vec2 uv;
+in vec4 color;
+out vec4 oColor;
+
+void main()
+{
+	oColor = texture(uTexture, uv) * color;
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+/*vertex shader*/
+#version 300 es
+in vec3 aPosition;
+in mat4 aModel;
+uniform mat4 uViewProjection;
+void main()
+{
+gl_Position = uViewProjection * aModel * vec4(aPosition, 1.0);
+}
+
+/*fragment shader*/
+#version 300 es
+precision mediump float;
+void main()
+{
+}
\ No newline at end of file
@@ -0,0 +1,150 @@
+/*vertex shader*/
+#version 300 es
+in vec3 aPosition;
+uniform mat4 uViewProjection;
+uniform vec3 uEye;
+uniform vec4 uPatch;
+uniform vec2 uMorph;
+uniform vec4 uHeightMapSize;
+uniform float uCellSize;
+uniform highp sampler2D uHeightMap;
+out vec2 worldUV;
+out vec2 worldPosition;
+out float worldHeight;
+
+// Float textures are not filterable on GLES 3.0, the height map is point
+// sampled and the four texels around a grid position blended here.
+float heightAt(vec2 texel)
+{
+	ivec2 last = ivec2(uHeightMapSize.xy) - 1;
+	vec2 base = floor(texel);
+	vec2 f = texel - base;
+	ivec2 i0 = clamp(ivec2(base), ivec2(0), last);
+	ivec2 i1 = clamp(ivec2(base) + 1, ivec2(0), last);
+	float h00 = texelFetch(uHeightMap, i0, 0).r;
+	float h10 = texelFetch(uHeightMap, ivec2(i1.x, i0.y), 0).r;
+	float h01 = texelFetch(uHeightMap, ivec2(i0.x, i1.y), 0).r;
+	float h11 = texelFetch(uHeightMap, i1, 0).r;
+	return mix(mix(h00, h10, f.x), mix(h01, h11, f.x), f.y);
+}
+
+float sampleHeight(vec2 world)
+{
+	return heightAt(world / uCellSize);
+}
+
+void main()
+{
+	vec2 world = uPatch.xy + aPosition.xz * uPatch.z;
+	float height = sampleHeight(world);
+	float morph = clamp((distance(uEye, vec3(world.x, height, world.y)) - uMorph.x) * uMorph.y, 0.0, 1.0);
+
+	// Odd grid vertices slide onto their even neighbour, which turns the grid
+	// into the next coarser one at morph = 1.
+	vec2 odd = fract(aPosition.xz * uPatch.w * 0.5) * 2.0 / uPatch.w;
+	world -= odd * uPatch.z * morph;
+	height = sampleHeight(world);
+
+	worldUV = (world / uCellSize + 0.5) * uHeightMapSize.zw;
+	worldPosition = world;
+	worldHeight = height;
+	gl_Position = uViewProjection * vec4(world.x, height, world.y, 1.0);
+}
+
+/*fragment shader*/
+#version 300 es
+precision mediump float;
+precision mediump sampler2DArray;
+uniform highp sampler2D uHeightMap;
+uniform highp sampler2DArray uShadowMap;
+uniform mat4 uShadowMatrices[4];
+uniform int uShadowCascadeCount;
+uniform float uShadowTexelSize;
+uniform sampler2DArray uSplatMap;
+uniform sampler2DArray uGroundLayers;
+uniform int uLayerCount;
+uniform float uGroundTiling;
+uniform highp vec4 uHeightMapSize;
+uniform highp float uCellSize;
+uniform sampler2D uFogOfWar;
+uniform vec4 uFogOfWarScale;
+uniform sampler2D uTracks;
+uniform vec4 uTracksScale;
+in vec2 worldUV;
+in highp vec2 worldPosition;
+in float worldHeight;
+out vec4 oColor;
+
+highp float heightAt(highp vec2 texel)
+{
+	ivec2 last = ivec2(uHeightMapSize.xy) - 1;
+	highp vec2 base = floor(texel);
+	highp vec2 f = texel - base;
+	ivec2 i0 = clamp(ivec2(base), ivec2(0), last);
+	ivec2 i1 = clamp(ivec2(base) + 1, ivec2(0), last);
+	highp float h00 = texelFetch(uHeightMap, i0, 0).r;
+	highp float h10 = texelFetch(uHeightMap, ivec2(i1.x, i0.y), 0).r;
+	highp float h01 = texelFetch(uHeightMap, ivec2(i0.x, i1.y), 0).r;
+	highp float h11 = texelFetch(uHeightMap, i1, 0).r;
+	return mix(mix(h00, h10, f.x), mix(h01, h11, f.x), f.y);
+}
+
+vec3 splat()
+{
+	// Gradients are taken up front since the layer loop branches per pixel.
+	vec2 groundUV = worldPosition * uGroundTiling;
+	vec2 ddx = dFdx(groundUV);
+	vec2 ddy = dFdy(groundUV);
+	vec3 albedo = vec3(0.0);
+	float total = 0.0;
+	for (int i = 0; i < uLayerCount; i += 4)
+	{
+		vec4 weights = texture(uSplatMap, vec3(worldUV, float(i / 4)));
+		for (int c = 0; c < 4 && i + c < uLayerCount; c++)
+		{
+			if (weights[c] > 0.004)
+			{
+				albedo += weights[c] * textureGrad(uGroundLayers, vec3(groundUV, float(i + c)), ddx, ddy).rgb;
+				total += weights[c];
+			}
+		}
+	}
+	return albedo / max(total, 0.001);
+}
+
+float shadow(vec3 position)
+{
+	// First cascade whose square contains the point, 2x2 PCF inside it.
+	for (int i = 0; i < uShadowCascadeCount; i++)
+	{
+		vec3 coord = (uShadowMatrices[i] * vec4(position, 1.0)).xyz * 0.5 + 0.5;
+		if (all(greaterThan(coord.xy, vec2(uShadowTexelSize))) && all(lessThan(coord.xy, vec2(1.0 - uShadowTexelSize))))
+		{
+			float lit = 0.0;
+			for (int k = 0; k < 4; k++)
+			{
+				vec2 offset = (vec2(float(k & 1), float(k >> 1)) - 0.5) * uShadowTexelSize;
+				lit += step(coord.z, texture(uShadowMap, vec3(coord.xy + offset, float(i))).r);
+			}
+			return lit * 0.25;
+		}
+	}
+	return 1.0;
+}
+
+void main()
+{
+	highp vec2 texel = worldPosition / uCellSize;
+	float left = heightAt(texel - vec2(1.0, 0.0));
+	float right = heightAt(texel + vec2(1.0, 0.0));
+	float down = heightAt(texel - vec2(0.0, 1.0));
+	float up = heightAt(texel + vec2(0.0, 1.0));
+	vec3 normal = normalize(vec3(left - right, 2.0 * uCellSize, down - up));
+	float light = max(dot(normal, normalize(vec3(0.4, 1.0, 0.3))), 0.0);
+	light *= shadow(vec3(worldPosition.x, worldHeight, worldPosition.y));
+	vec3 albedo = uLayerCount > 0 ? splat() : vec3(0.35, 0.55, 0.25);
+	if (uTracksScale.x > 0.0)
+		albedo *= 1.0 - 0.6 * texture(uTracks, worldPosition * uTracksScale.xy + uTracksScale.zw).r;
+	float fog = uFogOfWarScale.x > 0.0 ? texture(uFogOfWar, worldPosition * uFogOfWarScale.xy + uFogOfWarScale.zw).r : 1.0;
+	oColor = vec4(albedo * (0.3 + 0.7 * light) * (0.1 + 0.9 * fog), 1.0);
+}
\ No newline at end of file
@@ -2,12 +2,14 @@
 #version 300 es
 in vec3 aPosition;
 in vec4 aColor;
+in mat4 aModel;
+uniform mat4 uViewProjection;
 out vec4 color;
 void main()
 {
 vec4 posL = vec4(aPosition, 1.0);
 color = aColor;
-gl_Position = posL;
+gl_Position = uViewProjection * aModel * posL;
 }
 
 /*fragment shader*/
@@ -0,0 +1,28 @@
+/*vertex shader*/
+#version 430
+in vec3 aPosition;
+in vec4 aColor;
+in uint aDrawID;
+layout(std430, binding = 0) readonly buffer Transforms
+{
+	mat4 uModel[];
+};
+uniform mat4 uViewProjection;
+out vec4 color;
+void main()
+{
+vec4 posL = vec4(aPosition, 1.0);
+color = aColor;
+gl_Position = uViewProjection * uModel[aDrawID] * posL;
+}
+
+/*fragment shader*/
+#version 430
+precision mediump float;
+in vec4 color;
+out vec4 oColor;
+
+void main()
+{
+	oColor = vec4(1.0, 0.0, 0.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,797 @@
+#include "bvh.h"
+#include "simd.h"
+#include <math.h>
+#include <string.h>
+
+#define BVH_STACK_SIZE 64
+#define BVH_INSIDE 0x80000000
+#define BVH_MORTON_BITS 10
+#define BVH_RADIX_BITS 10
+#define BVH_EPSILON 1e-20f
+
+#define BVH_OUTSIDE 0
+#define BVH_INTERSECT 1
+#define BVH_CONTAINED 2
+
+typedef struct Bvh_Node
+{
+	Aabb bounds;
+	uint32 parent;
+	uint32 children[2];
+	uint32 userData;
+	uint32 height;
+} Bvh_Node;
+
+typedef struct Bvh_Morton
+{
+	uint32 code;
+	uint32 leaf;
+} Bvh_Morton;
+
+struct Bvh
+{
+	Bvh_Node* nodes;
+	uint32 nodeCount;
+	uint32 nodeCapacity;
+	uint32 freeList;
+	uint32 root;
+	uint32 leafCount;
+};
+
+typedef struct Bvh_FrustumPlanes
+{
+	float x[8];
+	float y[8];
+	float z[8];
+	float w[8];
+} Bvh_FrustumPlanes;
+
+#define Bvh_IsLeaf(node) ((node)->children[0] == BVH_NULL)
+
+static float Bvh_Min(float a, float b)
+{
+	return a < b ? a : b;
+}
+
+static float Bvh_Max(float a, float b)
+{
+	return a > b ? a : b;
+}
+
+static void Bvh_Union(const Aabb* a, const Aabb* b, Aabb* out)
+{
+	out->min.x = Bvh_Min(a->min.x, b->min.x);
+	out->min.y = Bvh_Min(a->min.y, b->min.y);
+	out->min.z = Bvh_Min(a->min.z, b->min.z);
+	out->max.x = Bvh_Max(a->max.x, b->max.x);
+	out->max.y = Bvh_Max(a->max.y, b->max.y);
+	out->max.z = Bvh_Max(a->max.z, b->max.z);
+}
+
+static float Bvh_Area(const Aabb* a)
+{
+	float dx = a->max.x - a->min.x;
+	float dy = a->max.y - a->min.y;
+	float dz = a->max.z - a->min.z;
+	return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+static int Bvh_Overlaps(const Aabb* a, const Aabb* b)
+{
+	return a->min.x <= b->max.x && a->max.x >= b->min.x &&
+		a->min.y <= b->max.y && a->max.y >= b->min.y &&
+		a->min.z <= b->max.z && a->max.z >= b->min.z;
+}
+
+static int Bvh_Contains(const Aabb* outer, const Aabb* inner)
+{
+	return outer->min.x <= inner->min.x && outer->max.x >= inner->max.x &&
+		outer->min.y <= inner->min.y && outer->max.y >= inner->max.y &&
+		outer->min.z <= inner->min.z && outer->max.z >= inner->max.z;
+}
+
+static uint32 Bvh_AllocateNode(Bvh* bvh)
+{
+	uint32 index;
+	if (bvh->freeList != BVH_NULL)
+	{
+		index = bvh->freeList;
+		bvh->freeList = bvh->nodes[index].parent;
+	}
+	else
+	{
+		if (bvh->nodeCount == bvh->nodeCapacity)
+		{
+			bvh->nodeCapacity *= 2;
+			bvh->nodes = (Bvh_Node*)realloc(bvh->nodes, sizeof(Bvh_Node) * bvh->nodeCapacity);
+		}
+		index = bvh->nodeCount++;
+	}
+
+	Bvh_Node* node = &bvh->nodes[index];
+	node->parent = BVH_NULL;
+	node->children[0] = BVH_NULL;
+	node->children[1] = BVH_NULL;
+	node->userData = BVH_NULL;
+	node->height = 0;
+	return index;
+}
+
+static void Bvh_FreeNode(Bvh* bvh, uint32 index)
+{
+	Bvh_Node* node = &bvh->nodes[index];
+	node->parent = bvh->freeList;
+	node->children[0] = BVH_NULL;
+	node->children[1] = BVH_NULL;
+	node->height = BVH_NULL;
+	bvh->freeList = index;
+}
+
+static void Bvh_Refit(Bvh* bvh, uint32 index)
+{
+	while (index != BVH_NULL)
+	{
+		Bvh_Node* node = &bvh->nodes[index];
+		const Bvh_Node* left = &bvh->nodes[node->children[0]];
+		const Bvh_Node* right = &bvh->nodes[node->children[1]];
+		Bvh_Union(&left->bounds, &right->bounds, &node->bounds);
+		node->height = 1 + (left->height > right->height ? left->height : right->height);
+		index = node->parent;
+	}
+}
+
+static uint32* Bvh_AcquireStack(const Bvh* bvh, uint32* local)
+{
+	uint32 needed = bvh->nodes[bvh->root].height + 2;
+	if (needed <= BVH_STACK_SIZE)
+		return local;
+	return (uint32*)malloc(sizeof(uint32) * needed);
+}
+
+static void Bvh_ReleaseStack(uint32* stack, uint32* local)
+{
+	if (stack != local)
+		free(stack);
+}
+
+Bvh* Bvh_Create()
+{
+	Bvh* bvh = (Bvh*)malloc(sizeof(Bvh));
+	bvh->nodeCapacity = 16;
+	bvh->nodes = (Bvh_Node*)malloc(sizeof(Bvh_Node) * bvh->nodeCapacity);
+	bvh->nodeCount = 0;
+	bvh->freeList = BVH_NULL;
+	bvh->root = BVH_NULL;
+	bvh->leafCount = 0;
+	return bvh;
+}
+
+void Bvh_Destroy(Bvh* bvh)
+{
+	free(bvh->nodes);
+	free(bvh);
+}
+
+static uint32 Bvh_ExpandBits(uint32 v)
+{
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+static uint32 Bvh_Quantize(float value, float min, float scale)
+{
+	float q = (value - min) * scale;
+	if (q <= 0.0f)
+		return 0;
+	if (q >= (float)((1 << BVH_MORTON_BITS) - 1))
+		return (1 << BVH_MORTON_BITS) - 1;
+	return (uint32)q;
+}
+
+static void Bvh_SortMorton(Bvh_Morton* keys, Bvh_Morton* scratch, uint32 count)
+{
+	uint32 histogram[1 << BVH_RADIX_BITS];
+	Bvh_Morton* source = keys;
+	Bvh_Morton* destination = scratch;
+	for (uint32 shift = 0; shift < 3 * BVH_MORTON_BITS; shift += BVH_RADIX_BITS)
+	{
+		memset(histogram, 0, sizeof(histogram));
+		for (uint32 i = 0; i < count; i++)
+		{
+			histogram[(source[i].code >> shift) & ((1 << BVH_RADIX_BITS) - 1)]++;
+		}
+		uint32 sum = 0;
+		for (uint32 i = 0; i < (1 << BVH_RADIX_BITS); i++)
+		{
+			uint32 c = histogram[i];
+			histogram[i] = sum;
+			sum += c;
+		}
+		for (uint32 i = 0; i < count; i++)
+		{
+			destination[histogram[(source[i].code >> shift) & ((1 << BVH_RADIX_BITS) - 1)]++] = source[i];
+		}
+		Bvh_Morton* swap = source;
+		source = destination;
+		destination = swap;
+	}
+	if (source != keys)
+		memcpy(keys, source, sizeof(Bvh_Morton) * count);
+}
+
+static uint32 Bvh_FindSplit(const Bvh_Morton* keys, uint32 first, uint32 last)
+{
+	uint32 firstCode = keys[first].code;
+	uint32 lastCode = keys[last].code;
+	if (firstCode == lastCode)
+		return (first + last) >> 1;
+
+	uint32 highest = 31;
+	uint32 diff = firstCode ^ lastCode;
+	while ((diff & (1u << highest)) == 0)
+		highest--;
+
+	// Binary search for the last key which still has the bit cleared.
+	uint32 mask = ~0u << highest;
+	uint32 prefix = firstCode & mask;
+	uint32 split = first;
+	uint32 step = last - first;
+	do
+	{
+		step = (step + 1) >> 1;
+		uint32 candidate = split + step;
+		if (candidate < last && (keys[candidate].code & mask) == prefix)
+			split = candidate;
+	} while (step > 1);
+	return split;
+}
+
+static uint32 Bvh_BuildRange(Bvh* bvh, const Bvh_Morton* keys, uint32 first, uint32 last)
+{
+	if (first == last)
+		return keys[first].leaf;
+
+	uint32 split = Bvh_FindSplit(keys, first, last);
+	uint32 left = Bvh_BuildRange(bvh, keys, first, split);
+	uint32 right = Bvh_BuildRange(bvh, keys, split + 1, last);
+
+	uint32 index = Bvh_AllocateNode(bvh);
+	Bvh_Node* node = &bvh->nodes[index];
+	Bvh_Node* leftNode = &bvh->nodes[left];
+	Bvh_Node* rightNode = &bvh->nodes[right];
+	node->children[0] = left;
+	node->children[1] = right;
+	leftNode->parent = index;
+	rightNode->parent = index;
+	Bvh_Union(&leftNode->bounds, &rightNode->bounds, &node->bounds);
+	node->height = 1 + (leftNode->height > rightNode->height ? leftNode->height : rightNode->height);
+	return index;
+}
+
+static void Bvh_BuildLeaves(Bvh* bvh, Bvh_Morton* keys, uint32 count)
+{
+	if (count == 0)
+	{
+		bvh->root = BVH_NULL;
+		return;
+	}
+
+	Aabb centroids;
+	for (uint32 i = 0; i < count; i++)
+	{
+		const Aabb* bounds = &bvh->nodes[keys[i].leaf].bounds;
+		float3 center;
+		center.x = (bounds->min.x + bounds->max.x) * 0.5f;
+		center.y = (bounds->min.y + bounds->max.y) * 0.5f;
+		center.z = (bounds->min.z + bounds->max.z) * 0.5f;
+		if (i == 0)
+		{
+			centroids.min = center;
+			centroids.max = center;
+		}
+		else
+		{
+			Aabb point;
+			point.min = center;
+			point.max = center;
+			Bvh_Union(&centroids, &point, &centroids);
+		}
+	}
+
+	float range = (float)((1 << BVH_MORTON_BITS) - 1);
+	float3 scale;
+	for (uint32 axis = 0; axis < 3; axis++)
+	{
+		float extent = centroids.max.data[axis] - centroids.min.data[axis];
+		scale.data[axis] = extent > 0.0f ? range / extent : 0.0f;
+	}
+
+	for (uint32 i = 0; i < count; i++)
+	{
+		const Aabb* bounds = &bvh->nodes[keys[i].leaf].bounds;
+		uint32 x = Bvh_Quantize((bounds->min.x + bounds->max.x) * 0.5f, centroids.min.x, scale.x);
+		uint32 y = Bvh_Quantize((bounds->min.y + bounds->max.y) * 0.5f, centroids.min.y, scale.y);
+		uint32 z = Bvh_Quantize((bounds->min.z + bounds->max.z) * 0.5f, centroids.min.z, scale.z);
+		keys[i].code = (Bvh_ExpandBits(x) << 2) | (Bvh_ExpandBits(y) << 1) | Bvh_ExpandBits(z);
+	}
+
+	Bvh_Morton* scratch = (Bvh_Morton*)malloc(sizeof(Bvh_Morton) * count);
+	Bvh_SortMorton(keys, scratch, count);
+	free(scratch);
+
+	bvh->root = Bvh_BuildRange(bvh, keys, 0, count - 1);
+	bvh->nodes[bvh->root].parent = BVH_NULL;
+}
+
+void Bvh_Build(Bvh* bvh, const Bvh_Item* items, uint32 count, uint32* proxies)
+{
+	bvh->nodeCount = 0;
+	bvh->freeList = BVH_NULL;
+	bvh->leafCount = count;
+	if (bvh->nodeCapacity < count * 2)
+	{
+		bvh->nodeCapacity = count * 2;
+		bvh->nodes = (Bvh_Node*)realloc(bvh->nodes, sizeof(Bvh_Node) * bvh->nodeCapacity);
+	}
+
+	Bvh_Morton* keys = (Bvh_Morton*)malloc(sizeof(Bvh_Morton) * (count > 0 ? count : 1));
+	for (uint32 i = 0; i < count; i++)
+	{
+		uint32 leaf = Bvh_AllocateNode(bvh);
+		bvh->nodes[leaf].bounds = items[i].bounds;
+		bvh->nodes[leaf].userData = items[i].userData;
+		keys[i].leaf = leaf;
+		if (proxies != NULL)
+			proxies[i] = leaf;
+	}
+	Bvh_BuildLeaves(bvh, keys, count);
+	free(keys);
+}
+
+void Bvh_Rebuild(Bvh* bvh)
+{
+	// Leaves keep their indices so proxies handed out stay valid, only the
+	// internal nodes are recycled.
+	Bvh_Morton* keys = (Bvh_Morton*)malloc(sizeof(Bvh_Morton) * (bvh->leafCount > 0 ? bvh->leafCount : 1));
+	uint32 count = 0;
+	for (uint32 i = 0; i < bvh->nodeCount; i++)
+	{
+		Bvh_Node* node = &bvh->nodes[i];
+		if (node->height == BVH_NULL)
+			continue;
+		if (Bvh_IsLeaf(node))
+			keys[count++].leaf = i;
+		else
+			Bvh_FreeNode(bvh, i);
+	}
+	ASSERT(count == bvh->leafCount);
+	Bvh_BuildLeaves(bvh, keys, count);
+	free(keys);
+}
+
+uint32 Bvh_Insert(Bvh* bvh, const Aabb* bounds, uint32 userData)
+{
+	uint32 leaf = Bvh_AllocateNode(bvh);
+	bvh->nodes[leaf].bounds = *bounds;
+	bvh->nodes[leaf].userData = userData;
+	bvh->leafCount++;
+
+	if (bvh->root == BVH_NULL)
+	{
+		bvh->root = leaf;
+		return leaf;
+	}
+
+	// Descend towards the sibling with the lowest surface area cost, counting
+	// the growth every ancestor has to pay on the way down.
+	uint32 index = bvh->root;
+	while (!Bvh_IsLeaf(&bvh->nodes[index]))
+	{
+		const Bvh_Node* node = &bvh->nodes[index];
+		Aabb combined;
+		Bvh_Union(&node->bounds, bounds, &combined);
+		float area = Bvh_Area(&node->bounds);
+		float combinedArea = Bvh_Area(&combined);
+		float cost = 2.0f * combinedArea;
+		float inheritance = 2.0f * (combinedArea - area);
+
+		float childCosts[2];
+		for (uint32 i = 0; i < 2; i++)
+		{
+			const Bvh_Node* child = &bvh->nodes[node->children[i]];
+			Bvh_Union(&child->bounds, bounds, &combined);
+			childCosts[i] = Bvh_Area(&combined) + inheritance;
+			if (!Bvh_IsLeaf(child))
+				childCosts[i] -= Bvh_Area(&child->bounds);
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1])
+			break;
+		index = node->children[childCosts[0] <= childCosts[1] ? 0 : 1];
+	}
+
+	uint32 sibling = index;
+	uint32 oldParent = bvh->nodes[sibling].parent;
+	uint32 newParent = Bvh_AllocateNode(bvh);
+	Bvh_Node* parent = &bvh->nodes[newParent];
+	parent->parent = oldParent;
+	parent->children[0] = sibling;
+	parent->children[1] = leaf;
+	bvh->nodes[sibling].parent = newParent;
+	bvh->nodes[leaf].parent = newParent;
+
+	if (oldParent == BVH_NULL)
+	{
+		bvh->root = newParent;
+	}
+	else
+	{
+		Bvh_Node* grandParent = &bvh->nodes[oldParent];
+		grandParent->children[grandParent->children[0] == sibling ? 0 : 1] = newParent;
+	}
+
+	Bvh_Refit(bvh, newParent);
+	return leaf;
+}
+
+void Bvh_Remove(Bvh* bvh, uint32 proxy)
+{
+	ASSERT(proxy < bvh->nodeCount && Bvh_IsLeaf(&bvh->nodes[proxy]));
+	bvh->leafCount--;
+
+	uint32 parent = bvh->nodes[proxy].parent;
+	Bvh_FreeNode(bvh, proxy);
+	if (parent == BVH_NULL)
+	{
+		bvh->root = BVH_NULL;
+		return;
+	}
+
+	Bvh_Node* parentNode = &bvh->nodes[parent];
+	uint32 sibling = parentNode->children[parentNode->children[0] == proxy ? 1 : 0];
+	uint32 grandParent = parentNode->parent;
+	bvh->nodes[sibling].parent = grandParent;
+	Bvh_FreeNode(bvh, parent);
+
+	if (grandParent == BVH_NULL)
+	{
+		bvh->root = sibling;
+	}
+	else
+	{
+		Bvh_Node* grandParentNode = &bvh->nodes[grandParent];
+		grandParentNode->children[grandParentNode->children[0] == parent ? 0 : 1] = sibling;
+		Bvh_Refit(bvh, grandParent);
+	}
+}
+
+uint32 Bvh_GetCount(const Bvh* bvh)
+{
+	return bvh->leafCount;
+}
+
+uint32 Bvh_GetHeight(const Bvh* bvh)
+{
+	return bvh->root == BVH_NULL ? 0 : bvh->nodes[bvh->root].height + 1;
+}
+
+uint32 Bvh_GetUserData(const Bvh* bvh, uint32 proxy)
+{
+	return bvh->nodes[proxy].userData;
+}
+
+void Bvh_GetBounds(const Bvh* bvh, uint32 proxy, Aabb* bounds)
+{
+	*bounds = bvh->nodes[proxy].bounds;
+}
+
+static void Bvh_SetupPlanes(const Frustum* frustum, Bvh_FrustumPlanes* planes)
+{
+	// Padding planes (0, 0, 0, 1) always contain the box.
+	for (uint32 i = 0; i < 8; i++)
+	{
+		if (i < FRUSTUM_PLANE_COUNTS)
+		{
+			planes->x[i] = frustum->planes[i].x;
+			planes->y[i] = frustum->planes[i].y;
+			planes->z[i] = frustum->planes[i].z;
+			planes->w[i] = frustum->planes[i].w;
+		}
+		else
+		{
+			planes->x[i] = 0.0f;
+			planes->y[i] = 0.0f;
+			planes->z[i] = 0.0f;
+			planes->w[i] = 1.0f;
+		}
+	}
+}
+
+static int Bvh_TestPlanes(const Bvh_FrustumPlanes* planes, const Aabb* bounds)
+{
+	float cx = (bounds->min.x + bounds->max.x) * 0.5f;
+	float cy = (bounds->min.y + bounds->max.y) * 0.5f;
+	float cz = (bounds->min.z + bounds->max.z) * 0.5f;
+	float ex = (bounds->max.x - bounds->min.x) * 0.5f;
+	float ey = (bounds->max.y - bounds->min.y) * 0.5f;
+	float ez = (bounds->max.z - bounds->min.z) * 0.5f;
+
+#ifdef SIMD_SSE
+	__m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 vcx = _mm_set1_ps(cx), vcy = _mm_set1_ps(cy), vcz = _mm_set1_ps(cz);
+	__m128 vex = _mm_set1_ps(ex), vey = _mm_set1_ps(ey), vez = _mm_set1_ps(ez);
+	__m128 zero = _mm_setzero_ps();
+	int outside = 0;
+	int inside = 0xff;
+	for (uint32 i = 0; i < 8; i += 4)
+	{
+		__m128 px = _mm_loadu_ps(planes->x + i);
+		__m128 py = _mm_loadu_ps(planes->y + i);
+		__m128 pz = _mm_loadu_ps(planes->z + i);
+		__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, vcx), _mm_mul_ps(py, vcy)), _mm_add_ps(_mm_mul_ps(pz, vcz), _mm_loadu_ps(planes->w + i)));
+		__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_and_ps(px, signMask), vex), _mm_mul_ps(_mm_and_ps(py, signMask), vey)), _mm_mul_ps(_mm_and_ps(pz, signMask), vez));
+		outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+		inside &= _mm_movemask_ps(_mm_cmpge_ps(_mm_sub_ps(distance, radius), zero)) << i | ~(0xf << i);
+	}
+	if (outside)
+		return BVH_OUTSIDE;
+	return (inside & 0xff) == 0xff ? BVH_CONTAINED : BVH_INTERSECT;
+#else
+	int result = BVH_CONTAINED;
+	for (uint32 i = 0; i < FRUSTUM_PLANE_COUNTS; i++)
+	{
+		float distance = planes->x[i] * cx + planes->y[i] * cy + planes->z[i] * cz + planes->w[i];
+		float radius = fabsf(planes->x[i]) * ex + fabsf(planes->y[i]) * ey + fabsf(planes->z[i]) * ez;
+		if (distance + radius < 0.0f)
+			return BVH_OUTSIDE;
+		if (distance - radius < 0.0f)
+			result = BVH_INTERSECT;
+	}
+	return result;
+#endif
+}
+
+uint32 Bvh_QueryFrustum(const Bvh* bvh, const Frustum* frustum, uint32* results, uint32 maxResults)
+{
+	if (bvh->root == BVH_NULL)
+		return 0;
+
+	Bvh_FrustumPlanes planes;
+	Bvh_SetupPlanes(frustum, &planes);
+
+	uint32 local[BVH_STACK_SIZE];
+	uint32* stack = Bvh_AcquireStack(bvh, local);
+	uint32 top = 0;
+	uint32 count = 0;
+	stack[top++] = bvh->root;
+	while (top > 0)
+	{
+		uint32 entry = stack[--top];
+		const Bvh_Node* node = &bvh->nodes[entry & ~BVH_INSIDE];
+
+		// Subtrees fully inside the frustum are collected without testing.
+		if ((entry & BVH_INSIDE) == 0)
+		{
+			int test = Bvh_TestPlanes(&planes, &node->bounds);
+			if (test == BVH_OUTSIDE)
+				continue;
+			if (test == BVH_CONTAINED)
+				entry |= BVH_INSIDE;
+		}
+
+		if (Bvh_IsLeaf(node))
+		{
+			if (count < maxResults)
+				results[count] = node->userData;
+			count++;
+		}
+		else
+		{
+			stack[top++] = node->children[0] | (entry & BVH_INSIDE);
+			stack[top++] = node->children[1] | (entry & BVH_INSIDE);
+		}
+	}
+	Bvh_ReleaseStack(stack, local);
+	return count;
+}
+
+uint32 Bvh_QueryAabb(const Bvh* bvh, const Aabb* bounds, uint32* results, uint32 maxResults)
+{
+	if (bvh->root == BVH_NULL)
+		return 0;
+
+	uint32 local[BVH_STACK_SIZE];
+	uint32* stack = Bvh_AcquireStack(bvh, local);
+	uint32 top = 0;
+	uint32 count = 0;
+	stack[top++] = bvh->root;
+	while (top > 0)
+	{
+		uint32 entry = stack[--top];
+		const Bvh_Node* node = &bvh->nodes[entry & ~BVH_INSIDE];
+		if ((entry & BVH_INSIDE) == 0)
+		{
+			if (!Bvh_Overlaps(&node->bounds, bounds))
+				continue;
+			if (Bvh_Contains(bounds, &node->bounds))
+				entry |= BVH_INSIDE;
+		}
+
+		if (Bvh_IsLeaf(node))
+		{
+			if (count < maxResults)
+				results[count] = node->userData;
+			count++;
+		}
+		else
+		{
+			stack[top++] = node->children[0] | (entry & BVH_INSIDE);
+			stack[top++] = node->children[1] | (entry & BVH_INSIDE);
+		}
+	}
+	Bvh_ReleaseStack(stack, local);
+	return count;
+}
+
+static float Bvh_Reciprocal(float value)
+{
+	if (value >= 0.0f && value < BVH_EPSILON)
+		value = BVH_EPSILON;
+	else if (value < 0.0f && value > -BVH_EPSILON)
+		value = -BVH_EPSILON;
+	return 1.0f / value;
+}
+
+static float Bvh_IntersectRay(const Aabb* bounds, const float3* origin, const float3* inverse, float maxDistance)
+{
+	float tmin = 0.0f;
+	float tmax = maxDistance;
+	for (uint32 axis = 0; axis < 3; axis++)
+	{
+		float t0 = (bounds->min.data[axis] - origin->data[axis]) * inverse->data[axis];
+		float t1 = (bounds->max.data[axis] - origin->data[axis]) * inverse->data[axis];
+		tmin = Bvh_Max(tmin, Bvh_Min(t0, t1));
+		tmax = Bvh_Min(tmax, Bvh_Max(t0, t1));
+	}
+	return tmin <= tmax ? tmin : -1.0f;
+}
+
+int Bvh_RayCast(const Bvh* bvh, const Bvh_Ray* ray, Bvh_Hit* hit)
+{
+	hit->userData = BVH_NULL;
+	hit->distance = ray->maxDistance;
+	if (bvh->root == BVH_NULL)
+		return 0;
+
+	float3 inverse;
+	inverse.x = Bvh_Reciprocal(ray->direction.x);
+	inverse.y = Bvh_Reciprocal(ray->direction.y);
+	inverse.z = Bvh_Reciprocal(ray->direction.z);
+
+	uint32 local[BVH_STACK_SIZE];
+	uint32* stack = Bvh_AcquireStack(bvh, local);
+	uint32 top = 0;
+	if (Bvh_IntersectRay(&bvh->nodes[bvh->root].bounds, &ray->origin, &inverse, hit->distance) >= 0.0f)
+		stack[top++] = bvh->root;
+
+	while (top > 0)
+	{
+		const Bvh_Node* node = &bvh->nodes[stack[--top]];
+		if (Bvh_IsLeaf(node))
+		{
+			float distance = Bvh_IntersectRay(&node->bounds, &ray->origin, &inverse, hit->distance);
+			if (distance >= 0.0f)
+			{
+				hit->userData = node->userData;
+				hit->distance = distance;
+			}
+			continue;
+		}
+
+		// Visit the nearer child first so the far one is usually culled.
+		float near0 = Bvh_IntersectRay(&bvh->nodes[node->children[0]].bounds, &ray->origin, &inverse, hit->distance);
+		float near1 = Bvh_IntersectRay(&bvh->nodes[node->children[1]].bounds, &ray->origin, &inverse, hit->distance);
+		uint32 first = near0 <= near1 ? 0 : 1;
+		float firstDistance = first == 0 ? near0 : near1;
+		float secondDistance = first == 0 ? near1 : near0;
+		if (secondDistance >= 0.0f)
+			stack[top++] = node->children[1 - first];
+		if (firstDistance >= 0.0f)
+			stack[top++] = node->children[first];
+	}
+	Bvh_ReleaseStack(stack, local);
+	return hit->userData != BVH_NULL;
+}
+
+uint32 Bvh_RayCast4(const Bvh* bvh, const Bvh_Ray* rays, Bvh_Hit* hits)
+{
+#ifdef SIMD_SSE
+	for (uint32 i = 0; i < 4; i++)
+	{
+		hits[i].userData = BVH_NULL;
+		hits[i].distance = rays[i].maxDistance;
+	}
+	if (bvh->root == BVH_NULL)
+		return 0;
+
+	float origins[3][4];
+	float inverses[3][4];
+	for (uint32 i = 0; i < 4; i++)
+	{
+		for (uint32 axis = 0; axis < 3; axis++)
+		{
+			origins[axis][i] = rays[i].origin.data[axis];
+			inverses[axis][i] = Bvh_Reciprocal(rays[i].direction.data[axis]);
+		}
+	}
+	__m128 ox = _mm_loadu_ps(origins[0]), oy = _mm_loadu_ps(origins[1]), oz = _mm_loadu_ps(origins[2]);
+	__m128 ix = _mm_loadu_ps(inverses[0]), iy = _mm_loadu_ps(inverses[1]), iz = _mm_loadu_ps(inverses[2]);
+	__m128 best = _mm_setr_ps(rays[0].maxDistance, rays[1].maxDistance, rays[2].maxDistance, rays[3].maxDistance);
+	__m128 zero = _mm_setzero_ps();
+
+	uint32 local[BVH_STACK_SIZE];
+	uint32* stack = Bvh_AcquireStack(bvh, local);
+	uint32 top = 0;
+	stack[top++] = bvh->root;
+	while (top > 0)
+	{
+		const Bvh_Node* node = &bvh->nodes[stack[--top]];
+		const Aabb* bounds = &node->bounds;
+
+		__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bounds->min.x), ox), ix);
+		__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bounds->max.x), ox), ix);
+		__m128 tmin = _mm_max_ps(zero, _mm_min_ps(t0, t1));
+		__m128 tmax = _mm_min_ps(best, _mm_max_ps(t0, t1));
+		t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bounds->min.y), oy), iy);
+		t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bounds->max.y), oy), iy);
+		tmin = _mm_max_ps(tmin, _mm_min_ps(t0, t1));
+		tmax = _mm_min_ps(tmax, _mm_max_ps(t0, t1));
+		t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bounds->min.z), oz), iz);
+		t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bounds->max.z), oz), iz);
+		tmin = _mm_max_ps(tmin, _mm_min_ps(t0, t1));
+		tmax = _mm_min_ps(tmax, _mm_max_ps(t0, t1));
+
+		__m128 hitMask = _mm_cmple_ps(tmin, tmax);
+		int mask = _mm_movemask_ps(hitMask);
+		if (mask == 0)
+			continue;
+
+		if (Bvh_IsLeaf(node))
+		{
+			best = _mm_or_ps(_mm_and_ps(hitMask, tmin), _mm_andnot_ps(hitMask, best));
+			for (uint32 i = 0; i < 4; i++)
+			{
+				if (mask & (1 << i))
+					hits[i].userData = node->userData;
+			}
+		}
+		else
+		{
+			stack[top++] = node->children[1];
+			stack[top++] = node->children[0];
+		}
+	}
+	Bvh_ReleaseStack(stack, local);
+
+	float distances[4];
+	_mm_storeu_ps(distances, best);
+	uint32 count = 0;
+	for (uint32 i = 0; i < 4; i++)
+	{
+		hits[i].distance = distances[i];
+		if (hits[i].userData != BVH_NULL)
+			count++;
+	}
+	return count;
+#else
+	uint32 count = 0;
+	for (uint32 i = 0; i < 4; i++)
+	{
+		count += Bvh_RayCast(bvh, &rays[i], &hits[i]);
+	}
+	return count;
+#endif
+}
\ No newline at end of file
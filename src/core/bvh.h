@@ -0,0 +1,55 @@
+#ifndef __BVH_H__
+#define __BVH_H__
+
+#include "config.h"
+#include "maths.h"
+#include "frustum.h"
+
+#define BVH_NULL 0xffffffff
+
+// Bounding volume hierarchy over static world bounds (doodads, buildings,
+// terrain patches). Bvh_Build sorts the items along a Morton curve for a
+// fast bulk build; Bvh_Insert picks the sibling with the lowest surface area
+// cost, so construction and destruction can be applied incrementally.
+// Queries write the stored user data into caller buffers and return the
+// total number of hits, which may exceed the buffer size.
+typedef struct Bvh Bvh;
+
+typedef struct Bvh_Item
+{
+	Aabb bounds;
+	uint32 userData;
+} Bvh_Item;
+
+typedef struct Bvh_Ray
+{
+	float3 origin;
+	float3 direction;
+	float maxDistance;
+} Bvh_Ray;
+
+typedef struct Bvh_Hit
+{
+	uint32 userData;
+	float distance;
+} Bvh_Hit;
+
+Bvh* Bvh_Create();
+void Bvh_Destroy(Bvh* bvh);
+
+void Bvh_Build(Bvh* bvh, const Bvh_Item* items, uint32 count, uint32* proxies);
+void Bvh_Rebuild(Bvh* bvh);
+uint32 Bvh_Insert(Bvh* bvh, const Aabb* bounds, uint32 userData);
+void Bvh_Remove(Bvh* bvh, uint32 proxy);
+
+uint32 Bvh_GetCount(const Bvh* bvh);
+uint32 Bvh_GetHeight(const Bvh* bvh);
+uint32 Bvh_GetUserData(const Bvh* bvh, uint32 proxy);
+void Bvh_GetBounds(const Bvh* bvh, uint32 proxy, Aabb* bounds);
+
+uint32 Bvh_QueryFrustum(const Bvh* bvh, const Frustum* frustum, uint32* results, uint32 maxResults);
+uint32 Bvh_QueryAabb(const Bvh* bvh, const Aabb* bounds, uint32* results, uint32 maxResults);
+int Bvh_RayCast(const Bvh* bvh, const Bvh_Ray* ray, Bvh_Hit* hit);
+uint32 Bvh_RayCast4(const Bvh* bvh, const Bvh_Ray* rays, Bvh_Hit* hits);
+
+#endif
\ No newline at end of file
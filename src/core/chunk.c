@@ -25,13 +25,27 @@ void Chunk_Draw(Chunk* chunk)
 	Shader* shader = Material_Get_Shader(chunk->material);
 	Shader_Use(shader);
 	Mesh_BindBuffer(chunk->mesh);
-	Shader_EnableVertexArray(shader);
 	Material_Apply(chunk->material);
 	Mesh_Draw(chunk->mesh);
 	Mesh_UnbindBuffer(chunk->mesh);
 }
 
+void Chunk_Record(Chunk* chunk, CommandList* list)
+{
+	GeometryPool_Range range;
+	Mesh_GetRange(chunk->mesh, &range);
+	CommandList_UseShader(list, Material_Get_Shader(chunk->material));
+	CommandList_BindPool(list, Mesh_GetPool(chunk->mesh));
+	CommandList_ApplyMaterial(list, chunk->material);
+	CommandList_DrawIndexed(list, &range, 1);
+}
+
 Material* Chunk_Get_Material(Chunk* chunk)
 {
 	return chunk->material;
+}
+
+Mesh* Chunk_Get_Mesh(Chunk* chunk)
+{
+	return chunk->mesh;
 }
\ No newline at end of file
@@ -5,12 +5,16 @@
 #include "maths.h"
 #include "mesh.h"
 #include "material.h"
+#include "command_list.h"
 
 typedef struct Chunk Chunk;
 
 Chunk* Chunk_Create(Mesh* mesh, Material* material);
 void Chunk_Destroy(Chunk* chunk);
 void Chunk_Draw(Chunk* chunk);
+// Records what Chunk_Draw does into a command list; safe on any thread.
+void Chunk_Record(Chunk* chunk, CommandList* list);
 Material* Chunk_Get_Material(Chunk* chunk);
+Mesh* Chunk_Get_Mesh(Chunk* chunk);
 
 #endif
\ No newline at end of file
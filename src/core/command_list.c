@@ -0,0 +1,352 @@
+#include "command_list.h"
+#include "timer.h"
+#include <string.h>
+#include <opengl/glad.h>
+
+#define COMMAND_LIST_ALIGNMENT 8
+
+typedef enum CommandList_Type
+{
+	COMMAND_USE_SHADER,
+	COMMAND_APPLY_MATERIAL,
+	COMMAND_SET_INT,
+	COMMAND_SET_FLOAT,
+	COMMAND_SET_FLOAT4,
+	COMMAND_SET_MATRIX4X4,
+	COMMAND_BIND_TEXTURE,
+	COMMAND_BIND_POOL,
+	COMMAND_DRAW_INDEXED
+} CommandList_Type;
+
+typedef struct CommandList_Header
+{
+	uint32 type;
+	uint32 size;
+} CommandList_Header;
+
+typedef struct CommandList_Object
+{
+	CommandList_Header header;
+	void* object;
+	uint32 unit;
+} CommandList_Object;
+
+typedef struct CommandList_Uniform
+{
+	CommandList_Header header;
+	int32 location;
+	int32 integer;
+	float values[4];
+} CommandList_Uniform;
+
+typedef struct CommandList_Matrices
+{
+	CommandList_Header header;
+	int32 location;
+	uint32 count;
+} CommandList_Matrices;
+
+typedef struct CommandList_Draw
+{
+	CommandList_Header header;
+	uint32 indexCount;
+	uint32 firstIndex;
+	int32 baseVertex;
+	uint32 instanceCount;
+} CommandList_Draw;
+
+typedef struct CommandList_Block
+{
+	struct CommandList_Block* next;
+	uint32 used;
+	uint32 capacity;
+} CommandList_Block;
+
+struct CommandList
+{
+	CommandList_Block* first;
+	CommandList_Block* current;
+	uint32 blockSize;
+	uint32 commandCount;
+	uint32 byteCount;
+};
+
+static uint8* CommandList_GetData(CommandList_Block* block)
+{
+	return (uint8*)block + ((sizeof(CommandList_Block) + COMMAND_LIST_ALIGNMENT - 1) & ~(COMMAND_LIST_ALIGNMENT - 1));
+}
+
+static CommandList_Block* CommandList_CreateBlock(uint32 capacity)
+{
+	uint32 header = (sizeof(CommandList_Block) + COMMAND_LIST_ALIGNMENT - 1) & ~(COMMAND_LIST_ALIGNMENT - 1);
+	CommandList_Block* block = (CommandList_Block*)malloc(header + capacity);
+	block->next = NULL;
+	block->used = 0;
+	block->capacity = capacity;
+	return block;
+}
+
+// Commands never straddle blocks; a command larger than the block size gets
+// a block of its own.
+static void* CommandList_Push(CommandList* list, uint32 type, uint32 size)
+{
+	size = (size + COMMAND_LIST_ALIGNMENT - 1) & ~(COMMAND_LIST_ALIGNMENT - 1);
+	CommandList_Block* block = list->current;
+	while (block->used + size > block->capacity)
+	{
+		if (block->next == NULL || block->next->capacity < size)
+		{
+			CommandList_Block* fresh = CommandList_CreateBlock(size > list->blockSize ? size : list->blockSize);
+			fresh->next = block->next;
+			block->next = fresh;
+		}
+		block = block->next;
+		block->used = 0;
+	}
+	list->current = block;
+
+	CommandList_Header* header = (CommandList_Header*)(CommandList_GetData(block) + block->used);
+	header->type = type;
+	header->size = size;
+	block->used += size;
+	list->commandCount++;
+	list->byteCount += size;
+	return header;
+}
+
+CommandList* CommandList_Create(uint32 blockSize)
+{
+	ASSERT(blockSize >= sizeof(CommandList_Matrices) + sizeof(matrix4x4));
+	CommandList* list = (CommandList*)malloc(sizeof(CommandList));
+	list->blockSize = blockSize;
+	list->first = CommandList_CreateBlock(blockSize);
+	list->current = list->first;
+	list->commandCount = 0;
+	list->byteCount = 0;
+	return list;
+}
+
+void CommandList_Destroy(CommandList* list)
+{
+	CommandList_Block* block = list->first;
+	while (block != NULL)
+	{
+		CommandList_Block* next = block->next;
+		free(block);
+		block = next;
+	}
+	free(list);
+}
+
+void CommandList_Reset(CommandList* list)
+{
+	list->first->used = 0;
+	list->current = list->first;
+	list->commandCount = 0;
+	list->byteCount = 0;
+}
+
+void CommandList_UseShader(CommandList* list, Shader* shader)
+{
+	CommandList_Object* command = (CommandList_Object*)CommandList_Push(list, COMMAND_USE_SHADER, sizeof(CommandList_Object));
+	command->object = shader;
+}
+
+void CommandList_ApplyMaterial(CommandList* list, Material* material)
+{
+	CommandList_Object* command = (CommandList_Object*)CommandList_Push(list, COMMAND_APPLY_MATERIAL, sizeof(CommandList_Object));
+	command->object = material;
+}
+
+void CommandList_SetInt(CommandList* list, int32 location, int32 value)
+{
+	if (location == -1)
+		return;
+	CommandList_Uniform* command = (CommandList_Uniform*)CommandList_Push(list, COMMAND_SET_INT, sizeof(CommandList_Uniform));
+	command->location = location;
+	command->integer = value;
+}
+
+void CommandList_SetFloat(CommandList* list, int32 location, float value)
+{
+	if (location == -1)
+		return;
+	CommandList_Uniform* command = (CommandList_Uniform*)CommandList_Push(list, COMMAND_SET_FLOAT, sizeof(CommandList_Uniform));
+	command->location = location;
+	command->values[0] = value;
+}
+
+void CommandList_SetFloat4(CommandList* list, int32 location, const float4* value)
+{
+	if (location == -1)
+		return;
+	CommandList_Uniform* command = (CommandList_Uniform*)CommandList_Push(list, COMMAND_SET_FLOAT4, sizeof(CommandList_Uniform));
+	command->location = location;
+	memcpy(command->values, value->data, sizeof(float4));
+}
+
+void CommandList_SetMatrix4x4(CommandList* list, int32 location, const matrix4x4* values, uint32 count)
+{
+	if (location == -1 || count == 0)
+		return;
+	CommandList_Matrices* command = (CommandList_Matrices*)CommandList_Push(list, COMMAND_SET_MATRIX4X4, sizeof(CommandList_Matrices) + sizeof(matrix4x4) * count);
+	command->location = location;
+	command->count = count;
+	memcpy(command + 1, values, sizeof(matrix4x4) * count);
+}
+
+void CommandList_BindTexture(CommandList* list, const Texture* texture, uint32 unit)
+{
+	CommandList_Object* command = (CommandList_Object*)CommandList_Push(list, COMMAND_BIND_TEXTURE, sizeof(CommandList_Object));
+	command->object = (void*)texture;
+	command->unit = unit;
+}
+
+void CommandList_BindPool(CommandList* list, const GeometryPool* pool)
+{
+	CommandList_Object* command = (CommandList_Object*)CommandList_Push(list, COMMAND_BIND_POOL, sizeof(CommandList_Object));
+	command->object = (void*)pool;
+}
+
+void CommandList_DrawIndexed(CommandList* list, const GeometryPool_Range* range, uint32 instanceCount)
+{
+	CommandList_Draw* command = (CommandList_Draw*)CommandList_Push(list, COMMAND_DRAW_INDEXED, sizeof(CommandList_Draw));
+	command->indexCount = range->indexCount;
+	command->firstIndex = range->firstIndex;
+	command->baseVertex = (int32)range->baseVertex;
+	command->instanceCount = instanceCount;
+}
+
+uint32 CommandList_GetCommandCount(const CommandList* list)
+{
+	return list->commandCount;
+}
+
+uint32 CommandList_GetSize(const CommandList* list)
+{
+	return list->byteCount;
+}
+
+void CommandList_Execute(CommandList* const* lists, uint32 count, CommandList_Stats* stats)
+{
+	CommandList_Stats local;
+	memset(&local, 0, sizeof(CommandList_Stats));
+	double start = Timer_GetMilliseconds();
+
+	// A material is applied again once anything may have overwritten its
+	// uniforms: a program switch or an explicit uniform command.
+	Shader* shader = NULL;
+	Material* material = NULL;
+	const GeometryPool* pool = NULL;
+	for (uint32 l = 0; l < count; l++)
+	{
+		const CommandList* list = lists[l];
+		uint32 remaining = list->commandCount;
+		local.commandCount += remaining;
+		local.byteCount += list->byteCount;
+		for (CommandList_Block* block = list->first; remaining > 0; block = block->next)
+		{
+			const uint8* data = CommandList_GetData(block);
+			uint32 offset = 0;
+			while (offset < block->used && remaining > 0)
+			{
+				const CommandList_Header* header = (const CommandList_Header*)(data + offset);
+				offset += header->size;
+				remaining--;
+				switch (header->type)
+				{
+				case COMMAND_USE_SHADER:
+				{
+					Shader* next = (Shader*)((const CommandList_Object*)header)->object;
+					if (next == shader)
+					{
+						local.skippedCount++;
+						break;
+					}
+					Shader_Use(next);
+					shader = next;
+					material = NULL;
+					break;
+				}
+				case COMMAND_APPLY_MATERIAL:
+				{
+					Material* next = (Material*)((const CommandList_Object*)header)->object;
+					if (next == material)
+					{
+						local.skippedCount++;
+						break;
+					}
+					Material_Apply(next);
+					material = next;
+					break;
+				}
+				case COMMAND_SET_INT:
+				{
+					const CommandList_Uniform* uniform = (const CommandList_Uniform*)header;
+					glUniform1i(uniform->location, uniform->integer);
+					material = NULL;
+					break;
+				}
+				case COMMAND_SET_FLOAT:
+				{
+					const CommandList_Uniform* uniform = (const CommandList_Uniform*)header;
+					glUniform1f(uniform->location, uniform->values[0]);
+					material = NULL;
+					break;
+				}
+				case COMMAND_SET_FLOAT4:
+				{
+					const CommandList_Uniform* uniform = (const CommandList_Uniform*)header;
+					glUniform4fv(uniform->location, 1, uniform->values);
+					material = NULL;
+					break;
+				}
+				case COMMAND_SET_MATRIX4X4:
+				{
+					const CommandList_Matrices* matrices = (const CommandList_Matrices*)header;
+					glUniformMatrix4fv(matrices->location, matrices->count, GL_FALSE, (const GLfloat*)(matrices + 1));
+					material = NULL;
+					break;
+				}
+				case COMMAND_BIND_TEXTURE:
+				{
+					const CommandList_Object* object = (const CommandList_Object*)header;
+					Texture_Bind((const Texture*)object->object, object->unit);
+					material = NULL;
+					break;
+				}
+				case COMMAND_BIND_POOL:
+				{
+					const GeometryPool* next = (const GeometryPool*)((const CommandList_Object*)header)->object;
+					if (next == pool)
+					{
+						local.skippedCount++;
+						break;
+					}
+					GeometryPool_Bind(next);
+					pool = next;
+					break;
+				}
+				case COMMAND_DRAW_INDEXED:
+				{
+					const CommandList_Draw* draw = (const CommandList_Draw*)header;
+					ASSERT(pool != NULL);
+					GeometryPool_Draw(pool, draw->indexCount, draw->firstIndex, draw->baseVertex, draw->instanceCount);
+					local.drawCallCount++;
+					break;
+				}
+				default:
+					ASSERT(0);
+					break;
+				}
+			}
+		}
+	}
+	if (pool != NULL)
+		GeometryPool_Unbind(pool);
+
+	local.listCount = count;
+	local.executeTime = Timer_GetMilliseconds() - start;
+	if (stats != NULL)
+		*stats = local;
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef __COMMAND_LIST_H__
+#define __COMMAND_LIST_H__
+
+#include "config.h"
+#include "maths.h"
+#include "shader.h"
+#include "material.h"
+#include "texture.h"
+#include "geometry_pool.h"
+
+// Deferred draw commands. Recording never touches GL: every command is
+// packed into the list's own linear blocks, so each worker thread can fill
+// its own list while the GL thread is busy. CommandList_Execute then replays
+// the given lists in array order on the GL thread, which keeps the frame
+// deterministic no matter which worker finished first, and drops binds
+// that would not change any state.
+//
+// Uniform locations are resolved while recording (Shader_GetLocation only
+// reads), and commands for missing uniforms are dropped right there. Data
+// passed by pointer is copied into the list. Objects referenced by a list
+// must stay alive, and geometry pools unchanged, until it was executed.
+typedef struct CommandList CommandList;
+
+typedef struct CommandList_Stats
+{
+	uint32 listCount;
+	uint32 commandCount;
+	uint32 skippedCount;
+	uint32 drawCallCount;
+	uint32 byteCount;
+	double executeTime;
+} CommandList_Stats;
+
+CommandList* CommandList_Create(uint32 blockSize);
+void CommandList_Destroy(CommandList* list);
+// Forgets the recorded commands but keeps the blocks for the next frame.
+void CommandList_Reset(CommandList* list);
+
+void CommandList_UseShader(CommandList* list, Shader* shader);
+void CommandList_ApplyMaterial(CommandList* list, Material* material);
+void CommandList_SetInt(CommandList* list, int32 location, int32 value);
+void CommandList_SetFloat(CommandList* list, int32 location, float value);
+void CommandList_SetFloat4(CommandList* list, int32 location, const float4* value);
+void CommandList_SetMatrix4x4(CommandList* list, int32 location, const matrix4x4* values, uint32 count);
+void CommandList_BindTexture(CommandList* list, const Texture* texture, uint32 unit);
+void CommandList_BindPool(CommandList* list, const GeometryPool* pool);
+void CommandList_DrawIndexed(CommandList* list, const GeometryPool_Range* range, uint32 instanceCount);
+
+uint32 CommandList_GetCommandCount(const CommandList* list);
+uint32 CommandList_GetSize(const CommandList* list);
+
+void CommandList_Execute(CommandList* const* lists, uint32 count, CommandList_Stats* stats);
+
+#endif
\ No newline at end of file
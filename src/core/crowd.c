@@ -0,0 +1,715 @@
+#include "crowd.h"
+#include "spatial_grid.h"
+#include "simd.h"
+#include "thread.h"
+#include "timer.h"
+#include <string.h>
+#include <math.h>
+
+#define CROWD_POSITION_X 0
+#define CROWD_POSITION_Z 1
+#define CROWD_VELOCITY_X 2
+#define CROWD_VELOCITY_Z 3
+#define CROWD_PREFERRED_X 4
+#define CROWD_PREFERRED_Z 5
+#define CROWD_NEW_VELOCITY_X 6
+#define CROWD_NEW_VELOCITY_Z 7
+#define CROWD_RADIUS 8
+#define CROWD_MAX_SPEED 9
+#define CROWD_STREAM_COUNT 10
+
+#define CROWD_EPSILON 0.00001f
+// Below this a range is not worth a job.
+#define CROWD_JOB_GRAIN 64
+
+// Velocities left of direction through point are allowed.
+typedef struct Crowd_Line
+{
+	float pointX;
+	float pointZ;
+	float directionX;
+	float directionZ;
+} Crowd_Line;
+
+struct Crowd
+{
+	Crowd_Desc desc;
+	uint32 count;
+	float* streams[CROWD_STREAM_COUNT];
+	// Stream index of every agent handle, a free handle links the free
+	// list through it.
+	uint32* indices;
+	uint32* agents;
+	uint32 freeAgent;
+	SpatialGrid* grid;
+	float inverseTimeHorizon;
+	float inverseTimeStep;
+	volatile int32 neighbourCount;
+	volatile int32 fallbackCount;
+	Crowd_Stats stats;
+};
+
+static float Crowd_Det(float ax, float az, float bx, float bz)
+{
+	return ax * bz - az * bx;
+}
+
+// Best velocity on line lineNo within speed radius and the lines before it;
+// towards (optX, optZ) as a direction when directionOpt is set, closest to
+// it otherwise.
+static int Crowd_Solve1(const Crowd_Line* lines, uint32 lineNo, float radius, float optX, float optZ, int directionOpt, float* resultX, float* resultZ)
+{
+	const Crowd_Line* line = &lines[lineNo];
+	float dotProduct = line->pointX * line->directionX + line->pointZ * line->directionZ;
+	float discriminant = dotProduct * dotProduct + radius * radius - (line->pointX * line->pointX + line->pointZ * line->pointZ);
+	if (discriminant < 0.0f)
+		return 0;
+
+	float sqrtDiscriminant = sqrtf(discriminant);
+	float tLeft = -dotProduct - sqrtDiscriminant;
+	float tRight = -dotProduct + sqrtDiscriminant;
+	for (uint32 i = 0; i < lineNo; i++)
+	{
+		float denominator = Crowd_Det(line->directionX, line->directionZ, lines[i].directionX, lines[i].directionZ);
+		float numerator = Crowd_Det(lines[i].directionX, lines[i].directionZ, line->pointX - lines[i].pointX, line->pointZ - lines[i].pointZ);
+		if (fabsf(denominator) <= CROWD_EPSILON)
+		{
+			if (numerator < 0.0f)
+				return 0;
+			continue;
+		}
+
+		float t = numerator / denominator;
+		if (denominator >= 0.0f)
+			tRight = t < tRight ? t : tRight;
+		else
+			tLeft = t > tLeft ? t : tLeft;
+	}
+	if (tLeft > tRight)
+		return 0;
+
+	float t;
+	if (directionOpt)
+	{
+		t = optX * line->directionX + optZ * line->directionZ > 0.0f ? tRight : tLeft;
+	}
+	else
+	{
+		t = line->directionX * (optX - line->pointX) + line->directionZ * (optZ - line->pointZ);
+		t = t < tLeft ? tLeft : (t > tRight ? tRight : t);
+	}
+	*resultX = line->pointX + t * line->directionX;
+	*resultZ = line->pointZ + t * line->directionZ;
+	return 1;
+}
+
+// Returns the first line that leaves no velocity, count when all hold.
+static uint32 Crowd_Solve2(const Crowd_Line* lines, uint32 count, float radius, float optX, float optZ, int directionOpt, float* resultX, float* resultZ)
+{
+	float lengthSq = optX * optX + optZ * optZ;
+	if (directionOpt)
+	{
+		*resultX = optX * radius;
+		*resultZ = optZ * radius;
+	}
+	else if (lengthSq > radius * radius)
+	{
+		float scale = radius / sqrtf(lengthSq);
+		*resultX = optX * scale;
+		*resultZ = optZ * scale;
+	}
+	else
+	{
+		*resultX = optX;
+		*resultZ = optZ;
+	}
+
+	for (uint32 i = 0; i < count; i++)
+	{
+		if (Crowd_Det(lines[i].directionX, lines[i].directionZ, lines[i].pointX - *resultX, lines[i].pointZ - *resultZ) > 0.0f)
+		{
+			float x = *resultX;
+			float z = *resultZ;
+			if (!Crowd_Solve1(lines, i, radius, optX, optZ, directionOpt, resultX, resultZ))
+			{
+				*resultX = x;
+				*resultZ = z;
+				return i;
+			}
+		}
+	}
+	return count;
+}
+
+// From line beginLine on, the velocity that minimises the largest
+// violation of any line.
+static void Crowd_Solve3(const Crowd_Line* lines, uint32 count, uint32 beginLine, float radius, float* resultX, float* resultZ)
+{
+	Crowd_Line projected[CROWD_MAX_NEIGHBOURS];
+	float distance = 0.0f;
+	for (uint32 i = beginLine; i < count; i++)
+	{
+		const Crowd_Line* line = &lines[i];
+		if (Crowd_Det(line->directionX, line->directionZ, line->pointX - *resultX, line->pointZ - *resultZ) <= distance)
+			continue;
+
+		uint32 projectedCount = 0;
+		for (uint32 j = 0; j < i; j++)
+		{
+			const Crowd_Line* other = &lines[j];
+			Crowd_Line* projection = &projected[projectedCount];
+			float determinant = Crowd_Det(line->directionX, line->directionZ, other->directionX, other->directionZ);
+			if (fabsf(determinant) <= CROWD_EPSILON)
+			{
+				if (line->directionX * other->directionX + line->directionZ * other->directionZ > 0.0f)
+					continue;
+				projection->pointX = 0.5f * (line->pointX + other->pointX);
+				projection->pointZ = 0.5f * (line->pointZ + other->pointZ);
+			}
+			else
+			{
+				float t = Crowd_Det(other->directionX, other->directionZ, line->pointX - other->pointX, line->pointZ - other->pointZ) / determinant;
+				projection->pointX = line->pointX + t * line->directionX;
+				projection->pointZ = line->pointZ + t * line->directionZ;
+			}
+			float directionX = other->directionX - line->directionX;
+			float directionZ = other->directionZ - line->directionZ;
+			float length = sqrtf(directionX * directionX + directionZ * directionZ);
+			projection->directionX = directionX / length;
+			projection->directionZ = directionZ / length;
+			projectedCount++;
+		}
+
+		float x = *resultX;
+		float z = *resultZ;
+		if (Crowd_Solve2(projected, projectedCount, radius, -line->directionZ, line->directionX, 1, resultX, resultZ) < projectedCount)
+		{
+			*resultX = x;
+			*resultZ = z;
+		}
+		distance = Crowd_Det(line->directionX, line->directionZ, line->pointX - *resultX, line->pointZ - *resultZ);
+	}
+}
+
+static uint32 Crowd_FindNeighbours(const Crowd* crowd, uint32 index, uint32* neighbours)
+{
+	uint32 ids[CROWD_MAX_NEIGHBOURS + 1];
+	float distances[CROWD_MAX_NEIGHBOURS + 1];
+	uint32 found = SpatialGrid_QueryNearest(crowd->grid, crowd->streams[CROWD_POSITION_X][index], crowd->streams[CROWD_POSITION_Z][index],
+		crowd->desc.neighbourDistance, crowd->desc.maxNeighbours + 1, ids, distances);
+	uint32 count = 0;
+	for (uint32 i = 0; i < found && count < crowd->desc.maxNeighbours; i++)
+	{
+		if (ids[i] != index)
+			neighbours[count++] = ids[i];
+	}
+	return count;
+}
+
+// The half-plane neighbour other leaves agent index, 0 when the two sit on
+// each other with the same velocity and no side is better.
+static int Crowd_BuildLine(const Crowd* crowd, uint32 index, uint32 other, Crowd_Line* line)
+{
+	float* const* streams = crowd->streams;
+	float relativeX = streams[CROWD_POSITION_X][other] - streams[CROWD_POSITION_X][index];
+	float relativeZ = streams[CROWD_POSITION_Z][other] - streams[CROWD_POSITION_Z][index];
+	float velocityX = streams[CROWD_VELOCITY_X][index];
+	float velocityZ = streams[CROWD_VELOCITY_Z][index];
+	float relativeVelocityX = velocityX - streams[CROWD_VELOCITY_X][other];
+	float relativeVelocityZ = velocityZ - streams[CROWD_VELOCITY_Z][other];
+	float distanceSq = relativeX * relativeX + relativeZ * relativeZ;
+	float combinedRadius = streams[CROWD_RADIUS][index] + streams[CROWD_RADIUS][other];
+	float combinedRadiusSq = combinedRadius * combinedRadius;
+	float uX, uZ;
+
+	if (distanceSq > combinedRadiusSq)
+	{
+		// Vector from the centre of the cut-off circle to the relative velocity.
+		float wX = relativeVelocityX - crowd->inverseTimeHorizon * relativeX;
+		float wZ = relativeVelocityZ - crowd->inverseTimeHorizon * relativeZ;
+		float wLengthSq = wX * wX + wZ * wZ;
+		float dotProduct = wX * relativeX + wZ * relativeZ;
+		if (dotProduct < 0.0f && dotProduct * dotProduct > combinedRadiusSq * wLengthSq)
+		{
+			float wLength = sqrtf(wLengthSq);
+			float unitX = wX / wLength;
+			float unitZ = wZ / wLength;
+			line->directionX = unitZ;
+			line->directionZ = -unitX;
+			uX = (combinedRadius * crowd->inverseTimeHorizon - wLength) * unitX;
+			uZ = (combinedRadius * crowd->inverseTimeHorizon - wLength) * unitZ;
+		}
+		else
+		{
+			float leg = sqrtf(distanceSq - combinedRadiusSq);
+			if (Crowd_Det(relativeX, relativeZ, wX, wZ) > 0.0f)
+			{
+				line->directionX = (relativeX * leg - relativeZ * combinedRadius) / distanceSq;
+				line->directionZ = (relativeX * combinedRadius + relativeZ * leg) / distanceSq;
+			}
+			else
+			{
+				line->directionX = -(relativeX * leg + relativeZ * combinedRadius) / distanceSq;
+				line->directionZ = -(-relativeX * combinedRadius + relativeZ * leg) / distanceSq;
+			}
+			float dotProduct2 = relativeVelocityX * line->directionX + relativeVelocityZ * line->directionZ;
+			uX = dotProduct2 * line->directionX - relativeVelocityX;
+			uZ = dotProduct2 * line->directionZ - relativeVelocityZ;
+		}
+	}
+	else
+	{
+		// Already overlapping: get apart within this step.
+		float wX = relativeVelocityX - crowd->inverseTimeStep * relativeX;
+		float wZ = relativeVelocityZ - crowd->inverseTimeStep * relativeZ;
+		float wLengthSq = wX * wX + wZ * wZ;
+		if (wLengthSq <= CROWD_EPSILON * CROWD_EPSILON)
+			return 0;
+		float wLength = sqrtf(wLengthSq);
+		float unitX = wX / wLength;
+		float unitZ = wZ / wLength;
+		line->directionX = unitZ;
+		line->directionZ = -unitX;
+		uX = (combinedRadius * crowd->inverseTimeStep - wLength) * unitX;
+		uZ = (combinedRadius * crowd->inverseTimeStep - wLength) * unitZ;
+	}
+
+	line->pointX = velocityX + 0.5f * uX;
+	line->pointZ = velocityZ + 0.5f * uZ;
+	return 1;
+}
+
+static void Crowd_SolveAgent(Crowd* crowd, uint32 index, uint32* neighbourCount, uint32* fallbackCount)
+{
+	float* const* streams = crowd->streams;
+	uint32 neighbours[CROWD_MAX_NEIGHBOURS];
+	// Zeroed so the solvers never see unset lines, even with no neighbours.
+	Crowd_Line lines[CROWD_MAX_NEIGHBOURS] = { { 0 } };
+	uint32 count = Crowd_FindNeighbours(crowd, index, neighbours);
+	uint32 lineCount = 0;
+	for (uint32 i = 0; i < count; i++)
+	{
+		lineCount += Crowd_BuildLine(crowd, index, neighbours[i], &lines[lineCount]);
+	}
+	*neighbourCount += count;
+
+	float radius = streams[CROWD_MAX_SPEED][index];
+	float x, z;
+	uint32 failed = Crowd_Solve2(lines, lineCount, radius, streams[CROWD_PREFERRED_X][index], streams[CROWD_PREFERRED_Z][index], 0, &x, &z);
+	if (failed < lineCount)
+	{
+		Crowd_Solve3(lines, lineCount, failed, radius, &x, &z);
+		(*fallbackCount)++;
+	}
+	streams[CROWD_NEW_VELOCITY_X][index] = x;
+	streams[CROWD_NEW_VELOCITY_Z][index] = z;
+}
+
+#if defined(SIMD_SSE)
+static __m128 Crowd_Select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static __m128 Crowd_Gather(const float* stream, const uint32* ids)
+{
+	return _mm_setr_ps(stream[ids[0]], stream[ids[1]], stream[ids[2]], stream[ids[3]]);
+}
+
+// Crowd_SolveAgent for agents first..first + 3, one per lane. Lanes with
+// fewer neighbours mask their missing lines out; a lane whose lines leave
+// no velocity stops and finishes alone with Crowd_Solve3.
+static void Crowd_SolveGroup(Crowd* crowd, uint32 first, uint32* neighbourCount, uint32* fallbackCount)
+{
+	float* const* streams = crowd->streams;
+	uint32 neighbours[4][CROWD_MAX_NEIGHBOURS];
+	uint32 counts[4];
+	uint32 maxCount = 0;
+	for (uint32 lane = 0; lane < 4; lane++)
+	{
+		counts[lane] = Crowd_FindNeighbours(crowd, first + lane, neighbours[lane]);
+		maxCount = counts[lane] > maxCount ? counts[lane] : maxCount;
+		*neighbourCount += counts[lane];
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 epsilon = _mm_set1_ps(CROWD_EPSILON);
+	const __m128 epsilonSq = _mm_set1_ps(CROWD_EPSILON * CROWD_EPSILON);
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 inverseTimeHorizon = _mm_set1_ps(crowd->inverseTimeHorizon);
+	const __m128 inverseTimeStep = _mm_set1_ps(crowd->inverseTimeStep);
+	__m128 positionX = _mm_loadu_ps(streams[CROWD_POSITION_X] + first);
+	__m128 positionZ = _mm_loadu_ps(streams[CROWD_POSITION_Z] + first);
+	__m128 velocityX = _mm_loadu_ps(streams[CROWD_VELOCITY_X] + first);
+	__m128 velocityZ = _mm_loadu_ps(streams[CROWD_VELOCITY_Z] + first);
+	__m128 radius = _mm_loadu_ps(streams[CROWD_RADIUS] + first);
+
+	__m128 pointX[CROWD_MAX_NEIGHBOURS];
+	__m128 pointZ[CROWD_MAX_NEIGHBOURS];
+	__m128 directionX[CROWD_MAX_NEIGHBOURS];
+	__m128 directionZ[CROWD_MAX_NEIGHBOURS];
+	__m128 valid[CROWD_MAX_NEIGHBOURS];
+	for (uint32 k = 0; k < maxCount; k++)
+	{
+		// Missing neighbours read the agent itself and are masked out.
+		uint32 ids[4];
+		for (uint32 lane = 0; lane < 4; lane++)
+		{
+			ids[lane] = k < counts[lane] ? neighbours[lane][k] : first + lane;
+		}
+		__m128 present = _mm_castsi128_ps(_mm_setr_epi32(k < counts[0] ? -1 : 0, k < counts[1] ? -1 : 0, k < counts[2] ? -1 : 0, k < counts[3] ? -1 : 0));
+
+		__m128 relativeX = _mm_sub_ps(Crowd_Gather(streams[CROWD_POSITION_X], ids), positionX);
+		__m128 relativeZ = _mm_sub_ps(Crowd_Gather(streams[CROWD_POSITION_Z], ids), positionZ);
+		__m128 relativeVelocityX = _mm_sub_ps(velocityX, Crowd_Gather(streams[CROWD_VELOCITY_X], ids));
+		__m128 relativeVelocityZ = _mm_sub_ps(velocityZ, Crowd_Gather(streams[CROWD_VELOCITY_Z], ids));
+		__m128 distanceSq = _mm_add_ps(_mm_mul_ps(relativeX, relativeX), _mm_mul_ps(relativeZ, relativeZ));
+		__m128 combinedRadius = _mm_add_ps(radius, Crowd_Gather(streams[CROWD_RADIUS], ids));
+		__m128 combinedRadiusSq = _mm_mul_ps(combinedRadius, combinedRadius);
+		__m128 separate = _mm_cmpgt_ps(distanceSq, combinedRadiusSq);
+
+		// Cut-off circle and legs of the velocity obstacle.
+		__m128 wX = _mm_sub_ps(relativeVelocityX, _mm_mul_ps(inverseTimeHorizon, relativeX));
+		__m128 wZ = _mm_sub_ps(relativeVelocityZ, _mm_mul_ps(inverseTimeHorizon, relativeZ));
+		__m128 wLengthSq = _mm_add_ps(_mm_mul_ps(wX, wX), _mm_mul_ps(wZ, wZ));
+		__m128 dotProduct = _mm_add_ps(_mm_mul_ps(wX, relativeX), _mm_mul_ps(wZ, relativeZ));
+		__m128 cutOff = _mm_and_ps(_mm_cmplt_ps(dotProduct, zero), _mm_cmpgt_ps(_mm_mul_ps(dotProduct, dotProduct), _mm_mul_ps(combinedRadiusSq, wLengthSq)));
+		__m128 wLength = _mm_sqrt_ps(wLengthSq);
+		__m128 unitX = _mm_div_ps(wX, wLength);
+		__m128 unitZ = _mm_div_ps(wZ, wLength);
+		__m128 scale = _mm_sub_ps(_mm_mul_ps(combinedRadius, inverseTimeHorizon), wLength);
+		__m128 cutOffUX = _mm_mul_ps(scale, unitX);
+		__m128 cutOffUZ = _mm_mul_ps(scale, unitZ);
+
+		__m128 leg = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(distanceSq, combinedRadiusSq), zero));
+		__m128 left = _mm_cmpgt_ps(_mm_sub_ps(_mm_mul_ps(relativeX, wZ), _mm_mul_ps(relativeZ, wX)), zero);
+		__m128 legX = Crowd_Select(left,
+			_mm_sub_ps(_mm_mul_ps(relativeX, leg), _mm_mul_ps(relativeZ, combinedRadius)),
+			_mm_xor_ps(_mm_add_ps(_mm_mul_ps(relativeX, leg), _mm_mul_ps(relativeZ, combinedRadius)), signMask));
+		__m128 legZ = Crowd_Select(left,
+			_mm_add_ps(_mm_mul_ps(relativeX, combinedRadius), _mm_mul_ps(relativeZ, leg)),
+			_mm_xor_ps(_mm_sub_ps(_mm_mul_ps(relativeZ, leg), _mm_mul_ps(relativeX, combinedRadius)), signMask));
+		legX = _mm_div_ps(legX, distanceSq);
+		legZ = _mm_div_ps(legZ, distanceSq);
+		__m128 dotProduct2 = _mm_add_ps(_mm_mul_ps(relativeVelocityX, legX), _mm_mul_ps(relativeVelocityZ, legZ));
+		__m128 legUX = _mm_sub_ps(_mm_mul_ps(dotProduct2, legX), relativeVelocityX);
+		__m128 legUZ = _mm_sub_ps(_mm_mul_ps(dotProduct2, legZ), relativeVelocityZ);
+
+		// Overlapping agents.
+		__m128 oX = _mm_sub_ps(relativeVelocityX, _mm_mul_ps(inverseTimeStep, relativeX));
+		__m128 oZ = _mm_sub_ps(relativeVelocityZ, _mm_mul_ps(inverseTimeStep, relativeZ));
+		__m128 oLengthSq = _mm_add_ps(_mm_mul_ps(oX, oX), _mm_mul_ps(oZ, oZ));
+		__m128 oLength = _mm_sqrt_ps(oLengthSq);
+		__m128 oUnitX = _mm_div_ps(oX, oLength);
+		__m128 oUnitZ = _mm_div_ps(oZ, oLength);
+		__m128 oScale = _mm_sub_ps(_mm_mul_ps(combinedRadius, inverseTimeStep), oLength);
+		present = _mm_and_ps(present, _mm_or_ps(separate, _mm_cmpgt_ps(oLengthSq, epsilonSq)));
+
+		__m128 lineX = Crowd_Select(separate, Crowd_Select(cutOff, unitZ, legX), oUnitZ);
+		__m128 lineZ = Crowd_Select(separate, Crowd_Select(cutOff, _mm_xor_ps(unitX, signMask), legZ), _mm_xor_ps(oUnitX, signMask));
+		__m128 uX = Crowd_Select(separate, Crowd_Select(cutOff, cutOffUX, legUX), _mm_mul_ps(oScale, oUnitX));
+		__m128 uZ = Crowd_Select(separate, Crowd_Select(cutOff, cutOffUZ, legUZ), _mm_mul_ps(oScale, oUnitZ));
+		directionX[k] = lineX;
+		directionZ[k] = lineZ;
+		pointX[k] = _mm_add_ps(velocityX, _mm_mul_ps(half, uX));
+		pointZ[k] = _mm_add_ps(velocityZ, _mm_mul_ps(half, uZ));
+		valid[k] = present;
+	}
+
+	// Crowd_Solve2 on all lanes; a lane takes part in a line's step only
+	// where the line is there and cuts off its current velocity.
+	__m128 maxSpeed = _mm_loadu_ps(streams[CROWD_MAX_SPEED] + first);
+	__m128 maxSpeedSq = _mm_mul_ps(maxSpeed, maxSpeed);
+	__m128 optX = _mm_loadu_ps(streams[CROWD_PREFERRED_X] + first);
+	__m128 optZ = _mm_loadu_ps(streams[CROWD_PREFERRED_Z] + first);
+	__m128 optLengthSq = _mm_add_ps(_mm_mul_ps(optX, optX), _mm_mul_ps(optZ, optZ));
+	__m128 clamp = _mm_cmpgt_ps(optLengthSq, maxSpeedSq);
+	__m128 optScale = _mm_div_ps(maxSpeed, _mm_sqrt_ps(_mm_max_ps(optLengthSq, epsilonSq)));
+	__m128 resultX = Crowd_Select(clamp, _mm_mul_ps(optX, optScale), optX);
+	__m128 resultZ = Crowd_Select(clamp, _mm_mul_ps(optZ, optScale), optZ);
+	__m128 failed = zero;
+	uint32 failedLines[4] = { 0, 0, 0, 0 };
+	for (uint32 i = 0; i < maxCount; i++)
+	{
+		__m128 violated = _mm_and_ps(_mm_andnot_ps(failed, valid[i]),
+			_mm_cmpgt_ps(_mm_sub_ps(_mm_mul_ps(directionX[i], _mm_sub_ps(pointZ[i], resultZ)), _mm_mul_ps(directionZ[i], _mm_sub_ps(pointX[i], resultX))), zero));
+		if (_mm_movemask_ps(violated) == 0)
+			continue;
+
+		__m128 dotProduct = _mm_add_ps(_mm_mul_ps(pointX[i], directionX[i]), _mm_mul_ps(pointZ[i], directionZ[i]));
+		__m128 discriminant = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(dotProduct, dotProduct), maxSpeedSq),
+			_mm_add_ps(_mm_mul_ps(pointX[i], pointX[i]), _mm_mul_ps(pointZ[i], pointZ[i])));
+		__m128 feasible = _mm_cmpge_ps(discriminant, zero);
+		__m128 sqrtDiscriminant = _mm_sqrt_ps(_mm_max_ps(discriminant, zero));
+		__m128 tLeft = _mm_sub_ps(_mm_sub_ps(zero, dotProduct), sqrtDiscriminant);
+		__m128 tRight = _mm_add_ps(_mm_sub_ps(zero, dotProduct), sqrtDiscriminant);
+		for (uint32 j = 0; j < i; j++)
+		{
+			__m128 denominator = _mm_sub_ps(_mm_mul_ps(directionX[i], directionZ[j]), _mm_mul_ps(directionZ[i], directionX[j]));
+			__m128 numerator = _mm_sub_ps(_mm_mul_ps(directionX[j], _mm_sub_ps(pointZ[i], pointZ[j])), _mm_mul_ps(directionZ[j], _mm_sub_ps(pointX[i], pointX[j])));
+			__m128 parallel = _mm_cmple_ps(_mm_andnot_ps(signMask, denominator), epsilon);
+			feasible = _mm_andnot_ps(_mm_and_ps(_mm_and_ps(valid[j], parallel), _mm_cmplt_ps(numerator, zero)), feasible);
+			__m128 crossing = _mm_andnot_ps(parallel, valid[j]);
+			__m128 t = _mm_div_ps(numerator, denominator);
+			__m128 right = _mm_cmpge_ps(denominator, zero);
+			tRight = Crowd_Select(_mm_and_ps(crossing, right), _mm_min_ps(t, tRight), tRight);
+			tLeft = Crowd_Select(_mm_andnot_ps(right, crossing), _mm_max_ps(t, tLeft), tLeft);
+		}
+		feasible = _mm_and_ps(feasible, _mm_cmple_ps(tLeft, tRight));
+
+		__m128 t = _mm_add_ps(_mm_mul_ps(directionX[i], _mm_sub_ps(optX, pointX[i])), _mm_mul_ps(directionZ[i], _mm_sub_ps(optZ, pointZ[i])));
+		t = _mm_min_ps(_mm_max_ps(t, tLeft), tRight);
+		__m128 update = _mm_and_ps(violated, feasible);
+		resultX = Crowd_Select(update, _mm_add_ps(pointX[i], _mm_mul_ps(t, directionX[i])), resultX);
+		resultZ = Crowd_Select(update, _mm_add_ps(pointZ[i], _mm_mul_ps(t, directionZ[i])), resultZ);
+		__m128 failing = _mm_andnot_ps(feasible, violated);
+		int failingMask = _mm_movemask_ps(failing);
+		for (uint32 lane = 0; lane < 4; lane++)
+		{
+			if (failingMask & (1 << lane))
+				failedLines[lane] = i;
+		}
+		failed = _mm_or_ps(failed, failing);
+	}
+
+	float x[4], z[4];
+	_mm_storeu_ps(x, resultX);
+	_mm_storeu_ps(z, resultZ);
+	int failedMask = _mm_movemask_ps(failed);
+	for (uint32 lane = 0; failedMask != 0 && lane < 4; lane++)
+	{
+		if ((failedMask & (1 << lane)) == 0)
+			continue;
+
+		// The lane's lines without the masked ones, as Crowd_SolveAgent has them.
+		Crowd_Line lines[CROWD_MAX_NEIGHBOURS];
+		uint32 lineCount = 0;
+		uint32 beginLine = 0;
+		for (uint32 k = 0; k < maxCount; k++)
+		{
+			if ((_mm_movemask_ps(valid[k]) & (1 << lane)) == 0)
+				continue;
+			if (k == failedLines[lane])
+				beginLine = lineCount;
+			Crowd_Line* line = &lines[lineCount++];
+			line->pointX = ((const float*)&pointX[k])[lane];
+			line->pointZ = ((const float*)&pointZ[k])[lane];
+			line->directionX = ((const float*)&directionX[k])[lane];
+			line->directionZ = ((const float*)&directionZ[k])[lane];
+		}
+		Crowd_Solve3(lines, lineCount, beginLine, streams[CROWD_MAX_SPEED][first + lane], &x[lane], &z[lane]);
+		(*fallbackCount)++;
+	}
+	_mm_storeu_ps(streams[CROWD_NEW_VELOCITY_X] + first, _mm_loadu_ps(x));
+	_mm_storeu_ps(streams[CROWD_NEW_VELOCITY_Z] + first, _mm_loadu_ps(z));
+}
+#endif
+
+static void Crowd_SolveRange(void* userData, uint32 begin, uint32 end)
+{
+	Crowd* crowd = (Crowd*)userData;
+	uint32 neighbourCount = 0;
+	uint32 fallbackCount = 0;
+	uint32 i = begin;
+#if defined(SIMD_SSE)
+	for (; i + 4 <= end; i += 4)
+	{
+		Crowd_SolveGroup(crowd, i, &neighbourCount, &fallbackCount);
+	}
+#endif
+	for (; i < end; i++)
+	{
+		Crowd_SolveAgent(crowd, i, &neighbourCount, &fallbackCount);
+	}
+	Atomic_Add(&crowd->neighbourCount, (int32)neighbourCount);
+	Atomic_Add(&crowd->fallbackCount, (int32)fallbackCount);
+}
+
+Crowd* Crowd_Create(const Crowd_Desc* crowd_desc)
+{
+	ASSERT(crowd_desc != NULL && crowd_desc->maxAgents > 0 && crowd_desc->cellSize > 0.0f);
+	ASSERT(crowd_desc->maxNeighbours <= CROWD_MAX_NEIGHBOURS);
+
+	Crowd* crowd = (Crowd*)malloc(sizeof(Crowd));
+	memset(crowd, 0, sizeof(Crowd));
+	crowd->desc = *crowd_desc;
+	if (crowd->desc.maxNeighbours == 0)
+		crowd->desc.maxNeighbours = 10;
+	if (crowd->desc.neighbourDistance <= 0.0f)
+		crowd->desc.neighbourDistance = crowd->desc.cellSize;
+	if (crowd->desc.timeHorizon <= 0.0f)
+		crowd->desc.timeHorizon = 2.0f;
+	crowd->inverseTimeHorizon = 1.0f / crowd->desc.timeHorizon;
+
+	uint32 maxAgents = crowd->desc.maxAgents;
+	crowd->streams[0] = (float*)malloc(sizeof(float) * CROWD_STREAM_COUNT * maxAgents);
+	for (uint32 s = 1; s < CROWD_STREAM_COUNT; s++)
+	{
+		crowd->streams[s] = crowd->streams[0] + s * maxAgents;
+	}
+	crowd->indices = (uint32*)malloc(sizeof(uint32) * maxAgents);
+	crowd->agents = (uint32*)malloc(sizeof(uint32) * maxAgents);
+	for (uint32 i = 0; i < maxAgents; i++)
+	{
+		crowd->indices[i] = i + 1 < maxAgents ? i + 1 : CROWD_INVALID;
+	}
+	crowd->freeAgent = 0;
+
+	SpatialGrid_Desc grid_desc;
+	grid_desc.originX = crowd->desc.originX;
+	grid_desc.originZ = crowd->desc.originZ;
+	grid_desc.cellSize = crowd->desc.cellSize;
+	grid_desc.columns = crowd->desc.columns;
+	grid_desc.rows = crowd->desc.rows;
+	grid_desc.maxItems = maxAgents;
+	crowd->grid = SpatialGrid_Create(&grid_desc);
+	return crowd;
+}
+
+void Crowd_Destroy(Crowd* crowd)
+{
+	SpatialGrid_Destroy(crowd->grid);
+	free(crowd->streams[0]);
+	free(crowd->indices);
+	free(crowd->agents);
+	free(crowd);
+}
+
+static uint32 Crowd_GetIndex(const Crowd* crowd, uint32 agent)
+{
+	ASSERT(agent < crowd->desc.maxAgents);
+	uint32 index = crowd->indices[agent];
+	ASSERT(index < crowd->count && crowd->agents[index] == agent);
+	return index;
+}
+
+uint32 Crowd_AddAgent(Crowd* crowd, const float2* position, float radius, float maxSpeed)
+{
+	uint32 agent = crowd->freeAgent;
+	if (agent == CROWD_INVALID)
+	{
+		LOG_W("Crowd: all %u agents are in use\n", crowd->desc.maxAgents);
+		return CROWD_INVALID;
+	}
+	crowd->freeAgent = crowd->indices[agent];
+
+	uint32 index = crowd->count++;
+	crowd->indices[agent] = index;
+	crowd->agents[index] = agent;
+	float** streams = crowd->streams;
+	streams[CROWD_POSITION_X][index] = position->x;
+	streams[CROWD_POSITION_Z][index] = position->y;
+	streams[CROWD_VELOCITY_X][index] = 0.0f;
+	streams[CROWD_VELOCITY_Z][index] = 0.0f;
+	streams[CROWD_PREFERRED_X][index] = 0.0f;
+	streams[CROWD_PREFERRED_Z][index] = 0.0f;
+	streams[CROWD_NEW_VELOCITY_X][index] = 0.0f;
+	streams[CROWD_NEW_VELOCITY_Z][index] = 0.0f;
+	streams[CROWD_RADIUS][index] = radius;
+	streams[CROWD_MAX_SPEED][index] = maxSpeed;
+	return agent;
+}
+
+void Crowd_RemoveAgent(Crowd* crowd, uint32 agent)
+{
+	uint32 index = Crowd_GetIndex(crowd, agent);
+	uint32 last = --crowd->count;
+	if (index != last)
+	{
+		for (uint32 s = 0; s < CROWD_STREAM_COUNT; s++)
+		{
+			crowd->streams[s][index] = crowd->streams[s][last];
+		}
+		crowd->agents[index] = crowd->agents[last];
+		crowd->indices[crowd->agents[index]] = index;
+	}
+	crowd->indices[agent] = crowd->freeAgent;
+	crowd->freeAgent = agent;
+}
+
+uint32 Crowd_GetAgentCount(const Crowd* crowd)
+{
+	return crowd->count;
+}
+
+void Crowd_SetPreferredVelocity(Crowd* crowd, uint32 agent, const float2* velocity)
+{
+	uint32 index = Crowd_GetIndex(crowd, agent);
+	crowd->streams[CROWD_PREFERRED_X][index] = velocity->x;
+	crowd->streams[CROWD_PREFERRED_Z][index] = velocity->y;
+}
+
+void Crowd_SetPosition(Crowd* crowd, uint32 agent, const float2* position)
+{
+	uint32 index = Crowd_GetIndex(crowd, agent);
+	crowd->streams[CROWD_POSITION_X][index] = position->x;
+	crowd->streams[CROWD_POSITION_Z][index] = position->y;
+}
+
+void Crowd_GetPosition(const Crowd* crowd, uint32 agent, float2* position)
+{
+	uint32 index = Crowd_GetIndex(crowd, agent);
+	position->x = crowd->streams[CROWD_POSITION_X][index];
+	position->y = crowd->streams[CROWD_POSITION_Z][index];
+}
+
+void Crowd_GetVelocity(const Crowd* crowd, uint32 agent, float2* velocity)
+{
+	uint32 index = Crowd_GetIndex(crowd, agent);
+	velocity->x = crowd->streams[CROWD_VELOCITY_X][index];
+	velocity->y = crowd->streams[CROWD_VELOCITY_Z][index];
+}
+
+void Crowd_Update(Crowd* crowd, JobSystem* jobs, float deltaTime)
+{
+	ASSERT(deltaTime > 0.0f);
+	double start = Timer_GetMilliseconds();
+	float** streams = crowd->streams;
+	uint32 count = crowd->count;
+
+	// Ids are stream indices, which removals reshuffle, so the grid is
+	// filled anew rather than kept up to date.
+	SpatialGrid_Clear(crowd->grid);
+	for (uint32 i = 0; i < count; i++)
+	{
+		SpatialGrid_Insert(crowd->grid, i, streams[CROWD_POSITION_X][i], streams[CROWD_POSITION_Z][i]);
+	}
+	double solveStart = Timer_GetMilliseconds();
+
+	crowd->inverseTimeStep = 1.0f / deltaTime;
+	Atomic_Store(&crowd->neighbourCount, 0);
+	Atomic_Store(&crowd->fallbackCount, 0);
+	if (jobs != NULL)
+		JobSystem_ParallelFor(jobs, count, CROWD_JOB_GRAIN, Crowd_SolveRange, crowd);
+	else
+		Crowd_SolveRange(crowd, 0, count);
+	double solveEnd = Timer_GetMilliseconds();
+
+	float* positionX = streams[CROWD_POSITION_X];
+	float* positionZ = streams[CROWD_POSITION_Z];
+	float* velocityX = streams[CROWD_VELOCITY_X];
+	float* velocityZ = streams[CROWD_VELOCITY_Z];
+	const float* newVelocityX = streams[CROWD_NEW_VELOCITY_X];
+	const float* newVelocityZ = streams[CROWD_NEW_VELOCITY_Z];
+	for (uint32 i = 0; i < count; i++)
+	{
+		velocityX[i] = newVelocityX[i];
+		velocityZ[i] = newVelocityZ[i];
+		positionX[i] += newVelocityX[i] * deltaTime;
+		positionZ[i] += newVelocityZ[i] * deltaTime;
+	}
+
+	Crowd_Stats* stats = &crowd->stats;
+	stats->agentCount = count;
+	stats->neighbourCount = (uint32)Atomic_Load(&crowd->neighbourCount);
+	stats->fallbackCount = (uint32)Atomic_Load(&crowd->fallbackCount);
+	stats->gridTime = solveStart - start;
+	stats->solveTime = solveEnd - solveStart;
+	stats->updateTime = Timer_GetMilliseconds() - start;
+}
+
+void Crowd_GetStats(const Crowd* crowd, Crowd_Stats* stats)
+{
+	*stats = crowd->stats;
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#ifndef __CROWD_H__
+#define __CROWD_H__
+
+#include "config.h"
+#include "maths.h"
+#include "job_system.h"
+
+#define CROWD_INVALID 0xFFFFFFFFu
+#define CROWD_MAX_NEIGHBOURS 16
+
+// Local avoidance for dense unit crowds with optimal reciprocal collision
+// avoidance (ORCA). Every tick each agent takes its nearest neighbours from
+// a spatial grid rebuilt from the current positions; every neighbour rules
+// out the half-plane of velocities that would collide with it within the
+// time horizon, assuming it does half of the avoiding. The new velocity is
+// the one closest to the preferred velocity (from the pathfinder) that
+// stays within all half-planes and the agent's speed; when the half-planes
+// leave nothing, the one that violates them least.
+//
+// Agent state is kept as structure-of-arrays streams in the XZ plane. The
+// SSE kernel builds the half-planes of four agents side by side and solves
+// the four linear programs together with masks, so the lanes only split
+// up in the rare case of no feasible velocity. Agents are solved in
+// parallel ranges on the job system; moving them is cheap and stays on
+// the calling thread.
+typedef struct Crowd Crowd;
+
+typedef struct Crowd_Desc
+{
+	uint32 maxAgents;
+	// Neighbour grid over the XZ plane; agents outside it still avoid each
+	// other, only slower to query.
+	float originX;
+	float originZ;
+	float cellSize;
+	uint32 columns;
+	uint32 rows;
+	// Nearest agents avoided, 10 when 0, at most CROWD_MAX_NEIGHBOURS.
+	uint32 maxNeighbours;
+	// Farthest centre to centre distance avoided, cellSize when 0.
+	float neighbourDistance;
+	// Seconds ahead collisions are avoided, 2 when 0.
+	float timeHorizon;
+} Crowd_Desc;
+
+// Of the last update, times in milliseconds.
+typedef struct Crowd_Stats
+{
+	uint32 agentCount;
+	uint32 neighbourCount;
+	// Agents without a velocity inside all their half-planes.
+	uint32 fallbackCount;
+	double gridTime;
+	double solveTime;
+	double updateTime;
+} Crowd_Stats;
+
+Crowd* Crowd_Create(const Crowd_Desc* crowd_desc);
+void Crowd_Destroy(Crowd* crowd);
+
+// Returns CROWD_INVALID when maxAgents are in the crowd already.
+uint32 Crowd_AddAgent(Crowd* crowd, const float2* position, float radius, float maxSpeed);
+void Crowd_RemoveAgent(Crowd* crowd, uint32 agent);
+uint32 Crowd_GetAgentCount(const Crowd* crowd);
+
+void Crowd_SetPreferredVelocity(Crowd* crowd, uint32 agent, const float2* velocity);
+// Places the agent without moving it there, its velocity is kept.
+void Crowd_SetPosition(Crowd* crowd, uint32 agent, const float2* position);
+void Crowd_GetPosition(const Crowd* crowd, uint32 agent, float2* position);
+void Crowd_GetVelocity(const Crowd* crowd, uint32 agent, float2* velocity);
+
+// Finds the new velocities on the job system (NULL for the calling thread)
+// and moves every agent by deltaTime; the calling thread must belong to it.
+void Crowd_Update(Crowd* crowd, JobSystem* jobs, float deltaTime);
+
+void Crowd_GetStats(const Crowd* crowd, Crowd_Stats* stats);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,451 @@
+#include "decals.h"
+#include "bvh.h"
+#include "frustum.h"
+#include "timer.h"
+#include "vertex.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <opengl/glad.h>
+#include <opengl/glad_ext.h>
+
+#define DECAL_DEFAULT_FADE_COUNT 64
+#define DECAL_LIFETIME_FADE 0.25f
+#define DECAL_HEIGHT_SLACK 8
+
+typedef struct DecalSystem_Slot
+{
+	float4 positionSize;
+	float4 axis;
+	float4 color;
+	uint32 frame;
+	uint32 sequence;
+	uint32 proxy;
+	float expiry;
+	float fadeTime;
+} DecalSystem_Slot;
+
+typedef struct DecalSystem_Instance
+{
+	float4 positionSize;
+	float4 axis;
+	float4 atlas;
+	float4 color;
+} DecalSystem_Instance;
+
+struct DecalSystem
+{
+	DecalSystem_Slot* slots;
+	uint32 capacity;
+	uint32 mask;
+	uint32 heightLimit;
+	uint32 nextSequence;
+	uint32 count;
+	uint32 fadeCount;
+	uint32 atlasColumns;
+	uint32 atlasRows;
+	float time;
+	Bvh* bvh;
+	uint32* visible;
+
+	uint32 trackWidth;
+	uint32 trackHeight;
+	float trackCellSize;
+	uint8* trackPixels;
+	uint32 trackDirtyMin;
+	uint32 trackDirtyMax;
+	Texture* trackTexture;
+
+	GLuint vao;
+	GLuint boIds[3];
+	DecalSystem_Stats stats;
+};
+
+static int DecalSystem_CompareRanks(const void* a, const void* b)
+{
+	uint32 x = *(const uint32*)a;
+	uint32 y = *(const uint32*)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void DecalSystem_Release(DecalSystem* system, DecalSystem_Slot* slot)
+{
+	Bvh_Remove(system->bvh, slot->proxy);
+	slot->proxy = BVH_NULL;
+	system->count--;
+}
+
+DecalSystem* DecalSystem_Create(uint32 capacity, uint32 atlasColumns, uint32 atlasRows)
+{
+	// Box corner i sits at bit 0 = x, bit 1 = y, bit 2 = z; faces wind
+	// counter-clockwise seen from outside.
+	static const float Corners[24] =
+	{
+		-0.5f, -0.5f, -0.5f, 0.5f, -0.5f, -0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f, -0.5f,
+		-0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f
+	};
+	static const uint16 Indices[36] =
+	{
+		0, 4, 6, 0, 6, 2, 1, 3, 7, 1, 7, 5, 0, 1, 5, 0, 5, 4,
+		2, 6, 7, 2, 7, 3, 0, 2, 3, 0, 3, 1, 4, 5, 7, 4, 7, 6
+	};
+
+	ASSERT(capacity > 0 && atlasColumns > 0 && atlasRows > 0);
+
+	DecalSystem* system = (DecalSystem*)malloc(sizeof(DecalSystem));
+	memset(system, 0, sizeof(DecalSystem));
+	system->capacity = 1;
+	while (system->capacity < capacity)
+	{
+		system->capacity <<= 1;
+	}
+	system->mask = system->capacity - 1;
+	system->heightLimit = DECAL_HEIGHT_SLACK;
+	for (uint32 c = system->capacity; c > 1; c >>= 1)
+	{
+		system->heightLimit += 2;
+	}
+	system->fadeCount = DECAL_DEFAULT_FADE_COUNT < system->capacity ? DECAL_DEFAULT_FADE_COUNT : system->capacity;
+	system->atlasColumns = atlasColumns;
+	system->atlasRows = atlasRows;
+	system->slots = (DecalSystem_Slot*)malloc(sizeof(DecalSystem_Slot) * system->capacity);
+	for (uint32 i = 0; i < system->capacity; i++)
+	{
+		system->slots[i].proxy = BVH_NULL;
+	}
+	system->visible = (uint32*)malloc(sizeof(uint32) * system->capacity);
+	system->bvh = Bvh_Create();
+
+	glGenVertexArrays(1, &system->vao);
+	glGenBuffers(3, system->boIds);
+	glBindVertexArray(system->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, system->boIds[0]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(Corners), Corners, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (const void*)0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, system->boIds[1]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Indices), Indices, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ARRAY_BUFFER, system->boIds[2]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(DecalSystem_Instance) * system->capacity, NULL, GL_STREAM_DRAW);
+	for (uint32 i = 0; i < 4; i++)
+	{
+		glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_DECAL + i);
+		glVertexAttribPointer(INSTANCE_ATTRIBUTE_DECAL + i, 4, GL_FLOAT, GL_FALSE, sizeof(DecalSystem_Instance), (const void*)(i * sizeof(float4)));
+		glVertexAttribDivisor(INSTANCE_ATTRIBUTE_DECAL + i, 1);
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	return system;
+}
+
+void DecalSystem_Destroy(DecalSystem* system)
+{
+	glDeleteVertexArrays(1, &system->vao);
+	glDeleteBuffers(3, system->boIds);
+	if (system->trackTexture != NULL)
+	{
+		Texture_Destroy(system->trackTexture);
+		free(system->trackPixels);
+	}
+	Bvh_Destroy(system->bvh);
+	free(system->visible);
+	free(system->slots);
+	free(system);
+}
+
+void DecalSystem_SetFadeCount(DecalSystem* system, uint32 fadeCount)
+{
+	system->fadeCount = fadeCount < system->capacity ? fadeCount : system->capacity;
+}
+
+uint32 DecalSystem_Add(DecalSystem* system, const Decal_Desc* decal_desc)
+{
+	uint32 sequence = system->nextSequence++;
+	DecalSystem_Slot* slot = &system->slots[sequence & system->mask];
+	if (slot->proxy != BVH_NULL)
+	{
+		DecalSystem_Release(system, slot);
+		system->stats.replacedCount++;
+	}
+
+	float c = cosf(decal_desc->angle);
+	float s = sinf(decal_desc->angle);
+	slot->positionSize.x = decal_desc->position.x;
+	slot->positionSize.y = decal_desc->position.y;
+	slot->positionSize.z = decal_desc->position.z;
+	slot->positionSize.w = decal_desc->size;
+	slot->axis.x = c;
+	slot->axis.y = s;
+	slot->axis.z = decal_desc->depth;
+	slot->axis.w = 0.0f;
+	slot->color = decal_desc->color;
+	slot->frame = decal_desc->frame < system->atlasColumns * system->atlasRows ? decal_desc->frame : 0;
+	slot->sequence = sequence;
+	slot->expiry = decal_desc->lifetime > 0.0f ? system->time + decal_desc->lifetime : 0.0f;
+	slot->fadeTime = decal_desc->lifetime * DECAL_LIFETIME_FADE;
+
+	Aabb bounds;
+	float extent = 0.5f * decal_desc->size * (fabsf(c) + fabsf(s));
+	bounds.min.x = decal_desc->position.x - extent;
+	bounds.min.y = decal_desc->position.y - 0.5f * decal_desc->depth;
+	bounds.min.z = decal_desc->position.z - extent;
+	bounds.max.x = decal_desc->position.x + extent;
+	bounds.max.y = decal_desc->position.y + 0.5f * decal_desc->depth;
+	bounds.max.z = decal_desc->position.z + extent;
+	slot->proxy = Bvh_Insert(system->bvh, &bounds, sequence & system->mask);
+	system->count++;
+	return sequence;
+}
+
+void DecalSystem_Remove(DecalSystem* system, uint32 decal)
+{
+	if (DecalSystem_IsAlive(system, decal))
+		DecalSystem_Release(system, &system->slots[decal & system->mask]);
+}
+
+int DecalSystem_IsAlive(const DecalSystem* system, uint32 decal)
+{
+	const DecalSystem_Slot* slot = &system->slots[decal & system->mask];
+	return decal != DECAL_INVALID && slot->proxy != BVH_NULL && slot->sequence == decal;
+}
+
+uint32 DecalSystem_GetCount(const DecalSystem* system)
+{
+	return system->count;
+}
+
+uint32 DecalSystem_GetCapacity(const DecalSystem* system)
+{
+	return system->capacity;
+}
+
+void DecalSystem_EnableTracks(DecalSystem* system, uint32 width, uint32 height, float cellSize)
+{
+	ASSERT(system->trackTexture == NULL && width > 0 && height > 0);
+
+	system->trackWidth = width;
+	system->trackHeight = height;
+	system->trackCellSize = cellSize;
+	system->trackPixels = (uint8*)calloc(width * height, sizeof(uint8));
+	system->trackDirtyMin = height;
+	system->trackDirtyMax = 0;
+
+	Texture_Desc desc =
+	{
+		TEXTURE_2D,
+		TEXTURE_R_8,
+		width,
+		height,
+		1,
+		1,
+		FILTER_LINEAR,
+		FILTER_LINEAR,
+		WRAP_CLAMP,
+		WRAP_CLAMP
+	};
+	system->trackTexture = Texture_Create(&desc);
+	Texture_SetData(system->trackTexture, 0, system->trackPixels);
+}
+
+void DecalSystem_StampTrack(DecalSystem* system, float x, float z, float radius, float strength)
+{
+	ASSERT(system->trackTexture != NULL);
+
+	// Cells are centred on multiples of the cell size, like height samples.
+	float inverseCell = 1.0f / system->trackCellSize;
+	float cx = x * inverseCell;
+	float cz = z * inverseCell;
+	float r = radius * inverseCell;
+	int32 x0 = (int32)ceilf(cx - r);
+	int32 x1 = (int32)floorf(cx + r);
+	int32 z0 = (int32)ceilf(cz - r);
+	int32 z1 = (int32)floorf(cz + r);
+	x0 = x0 > 0 ? x0 : 0;
+	z0 = z0 > 0 ? z0 : 0;
+	x1 = x1 < (int32)system->trackWidth - 1 ? x1 : (int32)system->trackWidth - 1;
+	z1 = z1 < (int32)system->trackHeight - 1 ? z1 : (int32)system->trackHeight - 1;
+	if (x0 > x1 || z0 > z1 || r <= 0.0f)
+		return;
+
+	float amount = 255.0f * strength;
+	float inverseRadius = 1.0f / r;
+	for (int32 zi = z0; zi <= z1; zi++)
+	{
+		uint8* row = system->trackPixels + zi * system->trackWidth;
+		float dz = (float)zi - cz;
+		for (int32 xi = x0; xi <= x1; xi++)
+		{
+			float dx = (float)xi - cx;
+			float falloff = 1.0f - sqrtf(dx * dx + dz * dz) * inverseRadius;
+			if (falloff <= 0.0f)
+				continue;
+			float value = row[xi] + amount * falloff;
+			row[xi] = (uint8)(value < 255.0f ? value : 255.0f);
+		}
+	}
+	system->trackDirtyMin = (uint32)z0 < system->trackDirtyMin ? (uint32)z0 : system->trackDirtyMin;
+	system->trackDirtyMax = (uint32)z1 > system->trackDirtyMax ? (uint32)z1 : system->trackDirtyMax;
+}
+
+void DecalSystem_BindTracks(const DecalSystem* system, Shader* shader, uint32 unit)
+{
+	Shader_Use(shader);
+	GLint location = Shader_GetLocation(shader, "uTracks");
+	if (location != -1)
+		glUniform1i(location, unit);
+	location = Shader_GetLocation(shader, "uTracksScale");
+	if (location != -1)
+	{
+		if (system->trackTexture == NULL)
+		{
+			glUniform4f(location, 0.0f, 0.0f, 0.0f, 0.0f);
+			return;
+		}
+		float scaleX = 1.0f / (system->trackCellSize * system->trackWidth);
+		float scaleY = 1.0f / (system->trackCellSize * system->trackHeight);
+		glUniform4f(location, scaleX, scaleY, 0.5f / system->trackWidth, 0.5f / system->trackHeight);
+	}
+	if (system->trackTexture != NULL)
+		Texture_Bind(system->trackTexture, unit);
+}
+
+void DecalSystem_Update(DecalSystem* system, float deltaTime)
+{
+	system->time += deltaTime;
+	system->stats.expiredCount = 0;
+	for (uint32 i = 0; i < system->capacity; i++)
+	{
+		DecalSystem_Slot* slot = &system->slots[i];
+		if (slot->proxy != BVH_NULL && slot->expiry > 0.0f && slot->expiry <= system->time)
+		{
+			DecalSystem_Release(system, slot);
+			system->stats.expiredCount++;
+		}
+	}
+
+	// Insertion never rotates, so a ring that keeps turning over slowly
+	// unbalances the tree; rebuild once it is clearly too deep.
+	if (system->count > 0 && Bvh_GetHeight(system->bvh) > system->heightLimit)
+		Bvh_Rebuild(system->bvh);
+
+	system->stats.trackUploadedRowCount = 0;
+	if (system->trackTexture != NULL && system->trackDirtyMin <= system->trackDirtyMax)
+	{
+		uint32 rows = system->trackDirtyMax - system->trackDirtyMin + 1;
+		Texture_SetSubData(system->trackTexture, 0, 0, system->trackDirtyMin, 0, system->trackWidth, rows, system->trackPixels + system->trackDirtyMin * system->trackWidth);
+		system->stats.trackUploadedRowCount = rows;
+		system->trackDirtyMin = system->trackHeight;
+		system->trackDirtyMax = 0;
+	}
+}
+
+void DecalSystem_Draw(DecalSystem* system, Material* material, const matrix4x4* viewProjection, const Texture* depth)
+{
+	DecalSystem_Stats* stats = &system->stats;
+	stats->visibleCount = 0;
+	stats->drawCallCount = 0;
+	matrix4x4 inverseViewProjection;
+	if (system->count == 0 || !Matrix4x4_Inverse(viewProjection, &inverseViewProjection))
+		return;
+
+	double start = Timer_GetMilliseconds();
+	Frustum frustum;
+	Frustum_FromMatrix(&frustum, viewProjection);
+	uint32 count = Bvh_QueryFrustum(system->bvh, &frustum, system->visible, system->capacity);
+	count = count < system->capacity ? count : system->capacity;
+
+	// Ranks count from the next slot to be replaced, so sorting them draws
+	// older decals first and newer ones on top.
+	for (uint32 i = 0; i < count; i++)
+	{
+		system->visible[i] = (system->visible[i] - system->nextSequence) & system->mask;
+	}
+	qsort(system->visible, count, sizeof(uint32), DecalSystem_CompareRanks);
+
+	glBindVertexArray(system->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, system->boIds[2]);
+	DecalSystem_Instance* instances = count > 0 ? (DecalSystem_Instance*)glMapBufferRange(GL_ARRAY_BUFFER, 0, count * sizeof(DecalSystem_Instance), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT) : NULL;
+	if (instances == NULL)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+		stats->cullTime = Timer_GetMilliseconds() - start;
+		return;
+	}
+	float frameWidth = 1.0f / system->atlasColumns;
+	float frameHeight = 1.0f / system->atlasRows;
+	float fadeScale = 1.0f / (system->fadeCount + 1);
+	for (uint32 i = 0; i < count; i++)
+	{
+		uint32 rank = system->visible[i];
+		const DecalSystem_Slot* slot = &system->slots[(system->nextSequence + rank) & system->mask];
+		DecalSystem_Instance* instance = &instances[i];
+		instance->positionSize = slot->positionSize;
+		instance->axis = slot->axis;
+		instance->atlas.x = (slot->frame % system->atlasColumns) * frameWidth;
+		instance->atlas.y = (slot->frame / system->atlasColumns) * frameHeight;
+		instance->atlas.z = frameWidth;
+		instance->atlas.w = frameHeight;
+		instance->color = slot->color;
+
+		// Decals the ring still takes before this one is replaced.
+		float alpha = 1.0f;
+		uint32 remaining = system->capacity - (system->nextSequence - slot->sequence);
+		if (remaining < system->fadeCount)
+			alpha = (remaining + 1) * fadeScale;
+		if (slot->expiry > 0.0f && slot->expiry - system->time < slot->fadeTime)
+			alpha *= (slot->expiry - system->time) / slot->fadeTime;
+		instance->color.w *= alpha;
+	}
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+	stats->visibleCount = count;
+	stats->cullTime = Timer_GetMilliseconds() - start;
+
+	Shader* shader = Material_Get_Shader(material);
+	Shader_Use(shader);
+	Material_Apply(material);
+	GLint location = Shader_GetLocation(shader, "uViewProjection");
+	if (location != -1)
+		glUniformMatrix4fv(location, 1, GL_FALSE, viewProjection->data);
+	location = Shader_GetLocation(shader, "uInverseViewProjection");
+	if (location != -1)
+		glUniformMatrix4fv(location, 1, GL_FALSE, inverseViewProjection.data);
+	location = Shader_GetLocation(shader, "uDepth");
+	if (location != -1)
+		glUniform1i(location, DECAL_DEPTH_UNIT);
+	Texture_Bind(depth, DECAL_DEPTH_UNIT);
+
+	// Back faces only, without depth test, so a camera inside a box still
+	// sees the decal; the shader clips against the scene depth itself.
+	GLboolean blend = glIsEnabled(GL_BLEND);
+	GLboolean cull = glIsEnabled(GL_CULL_FACE);
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glEnable(GL_CULL_FACE);
+	glCullFace(GL_FRONT);
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+
+	glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_SHORT, (const void*)0, count);
+	stats->drawCallCount = 1;
+
+	glDepthMask(GL_TRUE);
+	glCullFace(GL_BACK);
+	if (depthTest)
+		glEnable(GL_DEPTH_TEST);
+	if (!cull)
+		glDisable(GL_CULL_FACE);
+	if (!blend)
+		glDisable(GL_BLEND);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+void DecalSystem_GetStats(const DecalSystem* system, DecalSystem_Stats* stats)
+{
+	*stats = system->stats;
+	stats->decalCount = system->count;
+}
\ No newline at end of file
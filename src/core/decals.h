@@ -0,0 +1,73 @@
+#ifndef __DECALS_H__
+#define __DECALS_H__
+
+#include "config.h"
+#include "maths.h"
+#include "material.h"
+#include "shader.h"
+#include "texture.h"
+
+#define DECAL_INVALID 0xffffffff
+#define DECAL_DEPTH_UNIT 7
+
+// Ground marks (craters, scorch, blood) projected onto the scene. Decals
+// live in a fixed-capacity ring: once it is full every new decal replaces
+// the oldest one, and the fadeCount decals next in line fade out first so
+// nothing pops. Decals never move, so each one is a leaf of a Bvh and
+// DecalSystem_Draw only fills the frustum query result, oldest first, into
+// one instanced draw.
+//
+// Each instance is a box. The fragment shader rebuilds the world position
+// from uDepth, a copy of the scene depth (see Framebuffer_BlitDepth) since
+// the bound depth buffer cannot be sampled, and reads its frame of
+// uDecalAtlas, a texture of the material split into equal frames.
+//
+// Vehicle tracks are too many for the ring. DecalSystem_EnableTracks adds
+// an R8 layer over the terrain that DecalSystem_StampTrack darkens for
+// good; DecalSystem_Update uploads the changed rows and
+// DecalSystem_BindTracks sets uTracks and uTracksScale like FogOfWar_Bind.
+typedef struct DecalSystem DecalSystem;
+
+typedef struct Decal_Desc
+{
+	float3 position;
+	float size;
+	float depth;
+	float angle;
+	uint32 frame;
+	float4 color;
+	float lifetime;
+} Decal_Desc;
+
+typedef struct DecalSystem_Stats
+{
+	uint32 decalCount;
+	uint32 replacedCount;
+	uint32 expiredCount;
+	uint32 visibleCount;
+	uint32 drawCallCount;
+	uint32 trackUploadedRowCount;
+	double cullTime;
+} DecalSystem_Stats;
+
+// The capacity is rounded up to a power of two.
+DecalSystem* DecalSystem_Create(uint32 capacity, uint32 atlasColumns, uint32 atlasRows);
+void DecalSystem_Destroy(DecalSystem* system);
+
+void DecalSystem_SetFadeCount(DecalSystem* system, uint32 fadeCount);
+// A lifetime of zero keeps the decal until the ring replaces it.
+uint32 DecalSystem_Add(DecalSystem* system, const Decal_Desc* decal_desc);
+void DecalSystem_Remove(DecalSystem* system, uint32 decal);
+int DecalSystem_IsAlive(const DecalSystem* system, uint32 decal);
+uint32 DecalSystem_GetCount(const DecalSystem* system);
+uint32 DecalSystem_GetCapacity(const DecalSystem* system);
+
+void DecalSystem_EnableTracks(DecalSystem* system, uint32 width, uint32 height, float cellSize);
+void DecalSystem_StampTrack(DecalSystem* system, float x, float z, float radius, float strength);
+void DecalSystem_BindTracks(const DecalSystem* system, Shader* shader, uint32 unit);
+
+void DecalSystem_Update(DecalSystem* system, float deltaTime);
+void DecalSystem_Draw(DecalSystem* system, Material* material, const matrix4x4* viewProjection, const Texture* depth);
+void DecalSystem_GetStats(const DecalSystem* system, DecalSystem_Stats* stats);
+
+#endif
\ No newline at end of file
@@ -5,7 +5,8 @@ typedef enum Texture_Type
 {
 	TEXTURE_2D = 0x0000,
 	TEXTURE_3D = 0x0001,
-	TEXTURE_CUBE = 0x0002
+	TEXTURE_CUBE = 0x0002,
+	TEXTURE_2D_ARRAY = 0x0010
 } Texture_Type;
 
 typedef enum Texture_Format
@@ -13,7 +14,13 @@ typedef enum Texture_Format
 	TEXTURE_ALPHA_8 = 0x0003,
 	TEXTURE_LUMINANCE_ALPHA_88 = 0x0004,
 	TEXTURE_RGB_888 = 0x0005,
-	TEXTURE_RGBA_8888 = 0x0006
+	TEXTURE_RGBA_8888 = 0x0006,
+	TEXTURE_R_32F = 0x000d,
+	TEXTURE_DEPTH_32F = 0x000e,
+	TEXTURE_R_32UI = 0x0011,
+	TEXTURE_R_16UI = 0x0012,
+	TEXTURE_RGBA_32F = 0x0013,
+	TEXTURE_R_8 = 0x0014
 } Texture_Format;
 
 typedef enum Texture_Filter
@@ -21,7 +28,8 @@ typedef enum Texture_Filter
 	FILTER_POINT = 0x0007,
 	FILTER_LINEAR = 0x0008,
 	FILTER_BILINEAR = 0x0009,
-	FILTER_TRILLINEAR = 0x000a
+	FILTER_TRILLINEAR = 0x000a,
+	FILTER_POINT_MIPMAP = 0x000f
 } Texture_Filter;
 
 typedef enum Texture_Wrap
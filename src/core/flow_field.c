@@ -0,0 +1,637 @@
+#include "flow_field.h"
+#include "timer.h"
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+#define FLOW_FIELD_NO_DIRECTION 255
+// Width of the band of sectors run per round, in cost per sector edge
+// length: narrower means fewer sectors solved again, wider more of them
+// in parallel.
+#define FLOW_FIELD_BAND 0.5f
+
+typedef struct FlowField_HeapEntry
+{
+	float value;
+	uint32 cell;
+} FlowField_HeapEntry;
+
+typedef struct FlowField_Scratch
+{
+	FlowField_HeapEntry* heap;
+	uint8* tile;
+} FlowField_Scratch;
+
+struct FlowField_Field
+{
+	const FlowField* flow;
+	uint32 goalX;
+	uint32 goalZ;
+	uint32 version;
+	uint32 references;
+	uint32 lastUse;
+	int computed;
+	// Tiled by sector, see FlowField_Index.
+	float* distances;
+	uint8* directions;
+	// Per sector its top row, bottom row, left and right column as of the
+	// end of the last round.
+	float* edges;
+};
+
+struct FlowField
+{
+	uint32 width;
+	uint32 height;
+	float inverseCellSize;
+	uint32 sectorSize;
+	uint32 sectorShift;
+	uint32 sectorColumns;
+	uint32 sectorRows;
+	uint8* costs;
+	uint32 version;
+	uint32 useCount;
+	FlowField_Field* fields;
+	uint32 fieldCount;
+	// Per sector the lowest value published next to it since it last ran
+	// and the lowest of its own border values that dropped, FLT_MAX for
+	// none.
+	float* pending;
+	float* changed;
+	float band;
+	uint32* sectorList;
+	// One heap and cost tile per thread.
+	FlowField_Scratch* scratch;
+	uint32 scratchCount;
+	uint32 heapCapacity;
+	FlowField_Stats stats;
+};
+
+typedef struct FlowField_Round
+{
+	FlowField* flow;
+	FlowField_Field* field;
+	JobSystem* jobs;
+} FlowField_Round;
+
+static const int32 FlowField_StepX[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+static const int32 FlowField_StepZ[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+static const float FlowField_StepLength[8] = { 1.0f, 1.41421356f, 1.0f, 1.41421356f, 1.0f, 1.41421356f, 1.0f, 1.41421356f };
+
+static uint32 FlowField_Index(const FlowField* flow, uint32 x, uint32 z)
+{
+	uint32 mask = flow->sectorSize - 1;
+	uint32 sector = (z >> flow->sectorShift) * flow->sectorColumns + (x >> flow->sectorShift);
+	return (sector << (2 * flow->sectorShift)) + ((z & mask) << flow->sectorShift) + (x & mask);
+}
+
+// Diagonal steps may not cut a wall's corner.
+static int FlowField_CanStep(const FlowField* flow, uint32 x, uint32 z, uint32 direction)
+{
+	int32 nx = (int32)x + FlowField_StepX[direction];
+	int32 nz = (int32)z + FlowField_StepZ[direction];
+	if (nx < 0 || nz < 0 || nx >= (int32)flow->width || nz >= (int32)flow->height)
+		return 0;
+	if (flow->costs[nz * flow->width + nx] == FLOW_FIELD_IMPASSABLE)
+		return 0;
+	if ((direction & 1) == 0)
+		return 1;
+	return flow->costs[z * flow->width + nx] != FLOW_FIELD_IMPASSABLE && flow->costs[nz * flow->width + x] != FLOW_FIELD_IMPASSABLE;
+}
+
+static void FlowField_Push(FlowField_HeapEntry* heap, uint32* count, float value, uint32 cell)
+{
+	uint32 i = (*count)++;
+	while (i > 0)
+	{
+		uint32 parent = (i - 1) >> 1;
+		if (heap[parent].value <= value)
+			break;
+		heap[i] = heap[parent];
+		i = parent;
+	}
+	heap[i].value = value;
+	heap[i].cell = cell;
+}
+
+static FlowField_HeapEntry FlowField_Pop(FlowField_HeapEntry* heap, uint32* count)
+{
+	FlowField_HeapEntry top = heap[0];
+	FlowField_HeapEntry last = heap[--(*count)];
+	uint32 i = 0;
+	for (;;)
+	{
+		uint32 child = 2 * i + 1;
+		if (child >= *count)
+			break;
+		if (child + 1 < *count && heap[child + 1].value < heap[child].value)
+			child++;
+		if (heap[child].value >= last.value)
+			break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = last;
+	return top;
+}
+
+// What a neighbouring sector published for a cell on its border.
+static float FlowField_GetPublished(const FlowField* flow, const FlowField_Field* field, uint32 x, uint32 z)
+{
+	uint32 size = flow->sectorSize;
+	uint32 mask = size - 1;
+	uint32 sector = (z >> flow->sectorShift) * flow->sectorColumns + (x >> flow->sectorShift);
+	const float* edges = field->edges + sector * 4 * size;
+	uint32 lx = x & mask;
+	uint32 lz = z & mask;
+	if (lz == 0)
+		return edges[lx];
+	if (lz == mask)
+		return edges[size + lx];
+	if (lx == 0)
+		return edges[2 * size + lz];
+	return edges[3 * size + lz];
+}
+
+// Copies the sector's costs with a one cell border into the thread's tile,
+// cells outside the grid as walls, so steps need no bounds checks.
+static void FlowField_LoadTile(const FlowField* flow, uint32 x0, uint32 z0, uint8* tile)
+{
+	uint32 pitch = flow->sectorSize + 2;
+	for (uint32 row = 0; row < pitch; row++)
+	{
+		int32 z = (int32)z0 + (int32)row - 1;
+		uint8* line = tile + row * pitch;
+		if (z < 0 || z >= (int32)flow->height)
+		{
+			memset(line, FLOW_FIELD_IMPASSABLE, pitch);
+			continue;
+		}
+		const uint8* costs = flow->costs + z * flow->width;
+		line[0] = x0 > 0 ? costs[x0 - 1] : FLOW_FIELD_IMPASSABLE;
+		memcpy(line + 1, costs + x0, flow->sectorSize);
+		line[pitch - 1] = x0 + flow->sectorSize < flow->width ? costs[x0 + flow->sectorSize] : FLOW_FIELD_IMPASSABLE;
+	}
+}
+
+static int FlowField_CanStepTile(const uint8* tile, uint32 pitch, uint32 cell, uint32 direction)
+{
+	int32 dx = FlowField_StepX[direction];
+	int32 dz = FlowField_StepZ[direction] * (int32)pitch;
+	if (tile[cell + dx + dz] == FLOW_FIELD_IMPASSABLE)
+		return 0;
+	return (direction & 1) == 0 || (tile[cell + dx] != FLOW_FIELD_IMPASSABLE && tile[cell + dz] != FLOW_FIELD_IMPASSABLE);
+}
+
+static void FlowField_SolveSector(FlowField* flow, FlowField_Field* field, uint32 sector, FlowField_Scratch* scratch)
+{
+	uint32 size = flow->sectorSize;
+	uint32 mask = size - 1;
+	uint32 pitch = size + 2;
+	uint32 x0 = (sector % flow->sectorColumns) * size;
+	uint32 z0 = (sector / flow->sectorColumns) * size;
+	float* distances = field->distances + (sector << (2 * flow->sectorShift));
+	FlowField_HeapEntry* heap = scratch->heap;
+	uint8* tile = scratch->tile;
+	uint32 count = 0;
+	FlowField_LoadTile(flow, x0, z0, tile);
+
+	if (field->goalX - x0 < size && field->goalZ - z0 < size)
+	{
+		uint32 local = ((field->goalZ - z0) << flow->sectorShift) + (field->goalX - x0);
+		if (distances[local] == 0.0f)
+			FlowField_Push(heap, &count, 0.0f, local);
+	}
+
+	for (uint32 lz = 0; lz < size; lz++)
+	{
+		uint32 step = (lz == 0 || lz == mask) ? 1 : mask;
+		for (uint32 lx = 0; lx < size; lx += step)
+		{
+			uint32 cell = (lz + 1) * pitch + lx + 1;
+			uint8 cost = tile[cell];
+			if (cost == FLOW_FIELD_IMPASSABLE)
+				continue;
+			uint32 local = (lz << flow->sectorShift) + lx;
+			float best = distances[local];
+			for (uint32 d = 0; d < 8; d++)
+			{
+				uint32 nlx = lx + FlowField_StepX[d];
+				uint32 nlz = lz + FlowField_StepZ[d];
+				if (nlx < size && nlz < size)
+					continue;
+				if (!FlowField_CanStepTile(tile, pitch, cell, d))
+					continue;
+				float published = FlowField_GetPublished(flow, field, x0 + nlx, z0 + nlz);
+				float candidate = published + cost * FlowField_StepLength[d];
+				if (published != FLT_MAX && candidate < best)
+					best = candidate;
+			}
+			if (best < distances[local])
+			{
+				distances[local] = best;
+				FlowField_Push(heap, &count, best, local);
+			}
+		}
+	}
+
+	while (count > 0)
+	{
+		FlowField_HeapEntry entry = FlowField_Pop(heap, &count);
+		if (entry.value > distances[entry.cell])
+			continue;
+		uint32 lx = entry.cell & mask;
+		uint32 lz = entry.cell >> flow->sectorShift;
+		uint32 cell = (lz + 1) * pitch + lx + 1;
+		for (uint32 d = 0; d < 8; d++)
+		{
+			uint32 nlx = lx + FlowField_StepX[d];
+			uint32 nlz = lz + FlowField_StepZ[d];
+			if (nlx >= size || nlz >= size || !FlowField_CanStepTile(tile, pitch, cell, d))
+				continue;
+			uint32 neighbour = (nlz << flow->sectorShift) + nlx;
+			float candidate = entry.value + tile[(nlz + 1) * pitch + nlx + 1] * FlowField_StepLength[d];
+			if (candidate < distances[neighbour])
+			{
+				distances[neighbour] = candidate;
+				FlowField_Push(heap, &count, candidate, neighbour);
+			}
+		}
+	}
+}
+
+static void FlowField_SolveRange(void* userData, uint32 begin, uint32 end)
+{
+	FlowField_Round* round = (FlowField_Round*)userData;
+	FlowField* flow = round->flow;
+	uint32 thread = round->jobs != NULL ? JobSystem_GetThreadIndex(round->jobs) : 0;
+	FlowField_Scratch* scratch = &flow->scratch[thread];
+	for (uint32 i = begin; i < end; i++)
+	{
+		FlowField_SolveSector(flow, round->field, flow->sectorList[i], scratch);
+	}
+}
+
+static void FlowField_PublishRange(void* userData, uint32 begin, uint32 end)
+{
+	FlowField_Round* round = (FlowField_Round*)userData;
+	FlowField* flow = round->flow;
+	uint32 size = flow->sectorSize;
+	uint32 mask = size - 1;
+	for (uint32 i = begin; i < end; i++)
+	{
+		uint32 sector = flow->sectorList[i];
+		const float* distances = round->field->distances + (sector << (2 * flow->sectorShift));
+		float* edges = round->field->edges + sector * 4 * size;
+		float changed = FLT_MAX;
+		for (uint32 k = 0; k < size; k++)
+		{
+			float values[4];
+			values[0] = distances[k];
+			values[1] = distances[(mask << flow->sectorShift) + k];
+			values[2] = distances[k << flow->sectorShift];
+			values[3] = distances[(k << flow->sectorShift) + mask];
+			for (uint32 side = 0; side < 4; side++)
+			{
+				if (values[side] < edges[side * size + k])
+				{
+					edges[side * size + k] = values[side];
+					if (values[side] < changed)
+						changed = values[side];
+				}
+			}
+		}
+		flow->changed[sector] = changed;
+	}
+}
+
+static void FlowField_DirectRange(void* userData, uint32 begin, uint32 end)
+{
+	FlowField_Round* round = (FlowField_Round*)userData;
+	FlowField* flow = round->flow;
+	FlowField_Field* field = round->field;
+	uint32 size = flow->sectorSize;
+	for (uint32 sector = begin; sector < end; sector++)
+	{
+		uint32 x0 = (sector % flow->sectorColumns) * size;
+		uint32 z0 = (sector / flow->sectorColumns) * size;
+		uint32 base = sector << (2 * flow->sectorShift);
+		for (uint32 lz = 0; lz < size; lz++)
+		{
+			for (uint32 lx = 0; lx < size; lx++)
+			{
+				uint32 index = base + (lz << flow->sectorShift) + lx;
+				uint32 x = x0 + lx;
+				uint32 z = z0 + lz;
+				float best = field->distances[index];
+				uint8 direction = FLOW_FIELD_NO_DIRECTION;
+				if (best != FLT_MAX && best != 0.0f)
+				{
+					for (uint32 d = 0; d < 8; d++)
+					{
+						if (!FlowField_CanStep(flow, x, z, d))
+							continue;
+						float distance = field->distances[FlowField_Index(flow, x + FlowField_StepX[d], z + FlowField_StepZ[d])];
+						if (distance < best)
+						{
+							best = distance;
+							direction = (uint8)d;
+						}
+					}
+				}
+				field->directions[index] = direction;
+			}
+		}
+	}
+}
+
+static void FlowField_Run(JobSystem* jobs, uint32 count, Job_RangeFunction function, FlowField_Round* round)
+{
+	if (jobs != NULL)
+		JobSystem_ParallelFor(jobs, count, 1, function, round);
+	else
+		function(round, 0, count);
+}
+
+static void FlowField_Compute(FlowField* flow, FlowField_Field* field, JobSystem* jobs)
+{
+	double start = Timer_GetMilliseconds();
+	uint32 cellCount = flow->width * flow->height;
+	uint32 sectorCount = flow->sectorColumns * flow->sectorRows;
+	for (uint32 i = 0; i < cellCount; i++)
+	{
+		field->distances[i] = FLT_MAX;
+	}
+	for (uint32 i = 0; i < sectorCount * 4 * flow->sectorSize; i++)
+	{
+		field->edges[i] = FLT_MAX;
+	}
+	for (uint32 i = 0; i < sectorCount; i++)
+	{
+		flow->pending[i] = FLT_MAX;
+	}
+
+	flow->stats.roundCount = 0;
+	flow->stats.sectorSolveCount = 0;
+	if (flow->costs[field->goalZ * flow->width + field->goalX] != FLOW_FIELD_IMPASSABLE)
+	{
+		field->distances[FlowField_Index(flow, field->goalX, field->goalZ)] = 0.0f;
+		flow->pending[(field->goalZ >> flow->sectorShift) * flow->sectorColumns + (field->goalX >> flow->sectorShift)] = 0.0f;
+	}
+
+	FlowField_Round round;
+	round.flow = flow;
+	round.field = field;
+	round.jobs = jobs;
+	for (;;)
+	{
+		float lowest = FLT_MAX;
+		for (uint32 i = 0; i < sectorCount; i++)
+		{
+			if (flow->pending[i] < lowest)
+				lowest = flow->pending[i];
+		}
+		if (lowest == FLT_MAX)
+			break;
+
+		// Only sectors near the front of the wave run, the ones further out
+		// would mostly be solved again once it reaches them.
+		float limit = lowest + flow->band;
+		uint32 count = 0;
+		for (uint32 i = 0; i < sectorCount; i++)
+		{
+			if (flow->pending[i] <= limit)
+			{
+				flow->pending[i] = FLT_MAX;
+				flow->sectorList[count++] = i;
+			}
+		}
+
+		FlowField_Run(jobs, count, FlowField_SolveRange, &round);
+		FlowField_Run(jobs, count, FlowField_PublishRange, &round);
+		flow->stats.roundCount++;
+		flow->stats.sectorSolveCount += count;
+
+		for (uint32 i = 0; i < count; i++)
+		{
+			uint32 sector = flow->sectorList[i];
+			float changed = flow->changed[sector];
+			if (changed == FLT_MAX)
+				continue;
+			int32 sx = (int32)(sector % flow->sectorColumns);
+			int32 sz = (int32)(sector / flow->sectorColumns);
+			for (int32 z = sz - 1; z <= sz + 1; z++)
+			{
+				for (int32 x = sx - 1; x <= sx + 1; x++)
+				{
+					if (x < 0 || z < 0 || x >= (int32)flow->sectorColumns || z >= (int32)flow->sectorRows || (x == sx && z == sz))
+						continue;
+					float* pending = &flow->pending[z * flow->sectorColumns + x];
+					if (changed < *pending)
+						*pending = changed;
+				}
+			}
+		}
+	}
+
+	FlowField_Run(jobs, sectorCount, FlowField_DirectRange, &round);
+	field->computed = 1;
+	flow->stats.computeTime = Timer_GetMilliseconds() - start;
+}
+
+FlowField* FlowField_Create(const FlowField_Desc* flow_field_desc)
+{
+	ASSERT(flow_field_desc->cellSize > 0.0f);
+
+	FlowField* flow = (FlowField*)malloc(sizeof(FlowField));
+	memset(flow, 0, sizeof(FlowField));
+	flow->sectorSize = flow_field_desc->sectorSize > 0 ? flow_field_desc->sectorSize : 32;
+	ASSERT(flow->sectorSize >= 2 && (flow->sectorSize & (flow->sectorSize - 1)) == 0);
+	ASSERT(flow_field_desc->width % flow->sectorSize == 0 && flow_field_desc->height % flow->sectorSize == 0);
+	while ((1u << flow->sectorShift) < flow->sectorSize)
+	{
+		flow->sectorShift++;
+	}
+	flow->width = flow_field_desc->width;
+	flow->height = flow_field_desc->height;
+	flow->inverseCellSize = 1.0f / flow_field_desc->cellSize;
+	flow->sectorColumns = flow->width / flow->sectorSize;
+	flow->sectorRows = flow->height / flow->sectorSize;
+
+	uint32 cellCount = flow->width * flow->height;
+	flow->costs = (uint8*)malloc(cellCount);
+	if (flow_field_desc->costs != NULL)
+		memcpy(flow->costs, flow_field_desc->costs, cellCount);
+	else
+		memset(flow->costs, 1, cellCount);
+
+	uint32 sectorCount = flow->sectorColumns * flow->sectorRows;
+	flow->pending = (float*)malloc(sizeof(float) * sectorCount);
+	flow->changed = (float*)malloc(sizeof(float) * sectorCount);
+	flow->band = FLOW_FIELD_BAND * flow->sectorSize;
+	flow->sectorList = (uint32*)malloc(sizeof(uint32) * sectorCount);
+
+	// Every pop relaxes at most 8 cells and every cell is popped once with
+	// its final value, on top of one seed per cell and the goal.
+	flow->heapCapacity = 9 * flow->sectorSize * flow->sectorSize + 1;
+
+	flow->fieldCount = flow_field_desc->maxFields > 0 ? flow_field_desc->maxFields : 8;
+	flow->fields = (FlowField_Field*)malloc(sizeof(FlowField_Field) * flow->fieldCount);
+	memset(flow->fields, 0, sizeof(FlowField_Field) * flow->fieldCount);
+	for (uint32 i = 0; i < flow->fieldCount; i++)
+	{
+		flow->fields[i].flow = flow;
+	}
+	return flow;
+}
+
+void FlowField_Destroy(FlowField* flow)
+{
+	for (uint32 i = 0; i < flow->fieldCount; i++)
+	{
+		ASSERT(flow->fields[i].references == 0);
+		free(flow->fields[i].distances);
+		free(flow->fields[i].directions);
+		free(flow->fields[i].edges);
+	}
+	free(flow->fields);
+	for (uint32 i = 0; i < flow->scratchCount; i++)
+	{
+		free(flow->scratch[i].heap);
+		free(flow->scratch[i].tile);
+	}
+	free(flow->scratch);
+	free(flow->sectorList);
+	free(flow->changed);
+	free(flow->pending);
+	free(flow->costs);
+	free(flow);
+}
+
+void FlowField_SetCosts(FlowField* flow, uint32 x, uint32 z, uint32 width, uint32 height, const uint8* costs)
+{
+	ASSERT(x + width <= flow->width && z + height <= flow->height);
+	for (uint32 row = 0; row < height; row++)
+	{
+		memcpy(flow->costs + (z + row) * flow->width + x, costs + row * width, width);
+	}
+	flow->version++;
+}
+
+uint8 FlowField_GetCost(const FlowField* flow, uint32 x, uint32 z)
+{
+	ASSERT(x < flow->width && z < flow->height);
+	return flow->costs[z * flow->width + x];
+}
+
+FlowField_Field* FlowField_Request(FlowField* flow, JobSystem* jobs, float goalX, float goalZ)
+{
+	flow->stats.requestCount++;
+	int32 x = (int32)floorf(goalX * flow->inverseCellSize);
+	int32 z = (int32)floorf(goalZ * flow->inverseCellSize);
+	x = x < 0 ? 0 : (x >= (int32)flow->width ? (int32)flow->width - 1 : x);
+	z = z < 0 ? 0 : (z >= (int32)flow->height ? (int32)flow->height - 1 : z);
+
+	FlowField_Field* victim = NULL;
+	uint32 victimAge = 0;
+	for (uint32 i = 0; i < flow->fieldCount; i++)
+	{
+		FlowField_Field* field = &flow->fields[i];
+		if (field->computed && field->version == flow->version && field->goalX == (uint32)x && field->goalZ == (uint32)z)
+		{
+			flow->stats.hitCount++;
+			field->references++;
+			field->lastUse = ++flow->useCount;
+			return field;
+		}
+		if (field->references > 0)
+			continue;
+		// Empty and outdated fields go first, then the least recently used.
+		uint32 age = field->computed && field->version == flow->version ? field->lastUse : 0;
+		if (victim == NULL || age < victimAge)
+		{
+			victim = field;
+			victimAge = age;
+		}
+	}
+	if (victim == NULL)
+	{
+		LOG_W("FlowField: all %u fields are in use\n", flow->fieldCount);
+		return NULL;
+	}
+
+	uint32 threads = jobs != NULL ? JobSystem_GetThreadCount(jobs) : 1;
+	if (threads > flow->scratchCount)
+	{
+		uint32 tileSize = (flow->sectorSize + 2) * (flow->sectorSize + 2);
+		flow->scratch = (FlowField_Scratch*)realloc(flow->scratch, sizeof(FlowField_Scratch) * threads);
+		for (uint32 i = flow->scratchCount; i < threads; i++)
+		{
+			flow->scratch[i].heap = (FlowField_HeapEntry*)malloc(sizeof(FlowField_HeapEntry) * flow->heapCapacity);
+			flow->scratch[i].tile = (uint8*)malloc(tileSize);
+		}
+		flow->scratchCount = threads;
+	}
+	if (victim->distances == NULL)
+	{
+		uint32 cellCount = flow->width * flow->height;
+		victim->distances = (float*)malloc(sizeof(float) * cellCount);
+		victim->directions = (uint8*)malloc(cellCount);
+		victim->edges = (float*)malloc(sizeof(float) * flow->sectorColumns * flow->sectorRows * 4 * flow->sectorSize);
+	}
+
+	victim->goalX = (uint32)x;
+	victim->goalZ = (uint32)z;
+	victim->version = flow->version;
+	victim->computed = 0;
+	FlowField_Compute(flow, victim, jobs);
+	victim->references = 1;
+	victim->lastUse = ++flow->useCount;
+	return victim;
+}
+
+void FlowField_Release(FlowField* flow, FlowField_Field* field)
+{
+	ASSERT(field->flow == flow && field->references > 0);
+	field->references--;
+}
+
+static int FlowField_GetCell(const FlowField* flow, float x, float z, uint32* index)
+{
+	float fx = floorf(x * flow->inverseCellSize);
+	float fz = floorf(z * flow->inverseCellSize);
+	if (fx < 0.0f || fz < 0.0f || fx >= (float)flow->width || fz >= (float)flow->height)
+		return 0;
+	*index = FlowField_Index(flow, (uint32)fx, (uint32)fz);
+	return 1;
+}
+
+int FlowField_GetDirection(const FlowField_Field* field, float x, float z, float2* direction)
+{
+	static const float diagonal = 0.70710678f;
+	static const float directionX[8] = { 1.0f, diagonal, 0.0f, -diagonal, -1.0f, -diagonal, 0.0f, diagonal };
+	static const float directionZ[8] = { 0.0f, diagonal, 1.0f, diagonal, 0.0f, -diagonal, -1.0f, -diagonal };
+
+	uint32 index;
+	if (!FlowField_GetCell(field->flow, x, z, &index))
+		return 0;
+	uint8 d = field->directions[index];
+	if (d == FLOW_FIELD_NO_DIRECTION)
+		return 0;
+	direction->x = directionX[d];
+	direction->y = directionZ[d];
+	return 1;
+}
+
+float FlowField_GetDistance(const FlowField_Field* field, float x, float z)
+{
+	uint32 index;
+	if (!FlowField_GetCell(field->flow, x, z, &index))
+		return FLT_MAX;
+	return field->distances[index];
+}
+
+void FlowField_GetStats(const FlowField* flow, FlowField_Stats* stats)
+{
+	*stats = flow->stats;
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#ifndef __FLOW_FIELD_H__
+#define __FLOW_FIELD_H__
+
+#include "config.h"
+#include "maths.h"
+#include "job_system.h"
+
+#define FLOW_FIELD_IMPASSABLE 255
+
+// Flow-field pathfinder for group orders over a grid of movement costs
+// (1..254 per cell, FLOW_FIELD_IMPASSABLE for walls). A field holds the
+// cost to reach one goal from every cell, found by a Dijkstra wavefront,
+// and the direction of the cheapest neighbour, so any number of units
+// heading to that goal only look up a vector.
+//
+// Both fields are stored in square sectors, every sector one contiguous
+// tile. The wavefront runs sector by sector: a sector seeds its border
+// from the values its neighbours published last round and runs a local
+// Dijkstra, and a sector whose border got cheaper wakes up its neighbours.
+// Each round runs the woken sectors close to the front of the wave in
+// parallel on the job system; the result is the same as one global
+// Dijkstra.
+//
+// Fields are cached by goal cell. FlowField_Request returns a field that
+// stays valid until it is released, with no limit on readers; changing
+// costs only stops the cache from handing out older fields. Requests,
+// releases and cost changes belong to one thread.
+typedef struct FlowField FlowField;
+typedef struct FlowField_Field FlowField_Field;
+
+typedef struct FlowField_Desc
+{
+	// Cells; multiples of sectorSize.
+	uint32 width;
+	uint32 height;
+	float cellSize;
+	// Power of two, 32 when 0.
+	uint32 sectorSize;
+	// Fields kept for reuse, 8 when 0.
+	uint32 maxFields;
+	// Row-major, all 1 when NULL.
+	const uint8* costs;
+} FlowField_Desc;
+
+typedef struct FlowField_Stats
+{
+	uint32 requestCount;
+	uint32 hitCount;
+	// Of the last field computed.
+	uint32 roundCount;
+	uint32 sectorSolveCount;
+	double computeTime;
+} FlowField_Stats;
+
+FlowField* FlowField_Create(const FlowField_Desc* flow_field_desc);
+void FlowField_Destroy(FlowField* flow);
+
+void FlowField_SetCosts(FlowField* flow, uint32 x, uint32 z, uint32 width, uint32 height, const uint8* costs);
+uint8 FlowField_GetCost(const FlowField* flow, uint32 x, uint32 z);
+
+// The field towards the cell holding (goalX, goalZ), computed on the job
+// system (NULL for the calling thread) unless it is cached. Returns NULL
+// when every cached field is still held.
+FlowField_Field* FlowField_Request(FlowField* flow, JobSystem* jobs, float goalX, float goalZ);
+void FlowField_Release(FlowField* flow, FlowField_Field* field);
+
+// Unit direction to move in from (x, z); 0 at the goal, on unreachable
+// cells and outside the grid.
+int FlowField_GetDirection(const FlowField_Field* field, float x, float z, float2* direction);
+// Cost left to reach the goal, FLT_MAX when it cannot be reached.
+float FlowField_GetDistance(const FlowField_Field* field, float x, float z);
+
+void FlowField_GetStats(const FlowField* flow, FlowField_Stats* stats);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,396 @@
+#include "fog_of_war.h"
+#include "simd.h"
+#include "timer.h"
+#include <math.h>
+#include <string.h>
+#include <opengl/glad.h>
+
+#define FOG_OF_WAR_VISIBLE 255
+#define FOG_OF_WAR_EXPLORED 128
+
+typedef struct FogOfWar_Viewer
+{
+	int32 x;
+	int32 y;
+	uint32 radius;
+	uint32 nextFree;
+} FogOfWar_Viewer;
+
+struct FogOfWar
+{
+	uint32 width;
+	uint32 height;
+	float cellSize;
+	uint32 countStride;
+	uint32 wordStride;
+	uint16* counts;
+	uint32* visible;
+	uint32* explored;
+	uint8* pixels;
+	uint8* dirtyRows;
+	uint32 dirtyMin;
+	uint32 dirtyMax;
+	Texture* texture;
+
+	// Half widths of the circle rows, (2r + 1) entries per radius.
+	uint8* spans;
+	uint32 spanOffsets[FOG_OF_WAR_MAX_RADIUS + 1];
+
+	FogOfWar_Viewer* viewers;
+	uint32 viewerCount;
+	uint32 viewerCapacity;
+	uint32 firstFree;
+	uint32 stampCount;
+	FogOfWar_Stats stats;
+};
+
+static void FogOfWar_AddSpan(uint16* counts, uint32 x0, uint32 x1, int delta)
+{
+	uint32 x = x0;
+#ifdef SIMD_SSE
+	__m128i step = _mm_set1_epi16((short)delta);
+	for (; x + 8 <= x1; x += 8)
+	{
+		__m128i* cell = (__m128i*)(counts + x);
+		_mm_storeu_si128(cell, _mm_add_epi16(_mm_loadu_si128(cell), step));
+	}
+#endif
+	for (; x < x1; x++)
+	{
+		counts[x] = (uint16)(counts[x] + delta);
+	}
+}
+
+static void FogOfWar_Stamp(FogOfWar* fog, int32 cx, int32 cy, uint32 radius, int delta)
+{
+	const uint8* spans = fog->spans + fog->spanOffsets[radius];
+	int32 y0 = cy - (int32)radius > 0 ? cy - (int32)radius : 0;
+	int32 y1 = cy + (int32)radius < (int32)fog->height - 1 ? cy + (int32)radius : (int32)fog->height - 1;
+	for (int32 y = y0; y <= y1; y++)
+	{
+		int32 half = spans[y - cy + (int32)radius];
+		int32 x0 = cx - half > 0 ? cx - half : 0;
+		int32 x1 = cx + half < (int32)fog->width - 1 ? cx + half : (int32)fog->width - 1;
+		if (x0 > x1)
+			continue;
+		FogOfWar_AddSpan(fog->counts + y * fog->countStride, x0, x1 + 1, delta);
+		fog->dirtyRows[y] = 1;
+	}
+	if (y0 <= y1)
+	{
+		if (fog->dirtyMin > (uint32)y0)
+			fog->dirtyMin = y0;
+		if (fog->dirtyMax < (uint32)y1)
+			fog->dirtyMax = y1;
+	}
+	fog->stampCount++;
+}
+
+// Rebuilds the visible bits of a row from its counts, folds them into the
+// explored bits and returns whether either changed.
+static int FogOfWar_RebuildRow(FogOfWar* fog, uint32 y)
+{
+	const uint16* counts = fog->counts + y * fog->countStride;
+	uint32* visible = fog->visible + y * fog->wordStride;
+	uint32* explored = fog->explored + y * fog->wordStride;
+	uint32 changed = 0;
+	uint32 w = 0;
+#ifdef SIMD_SSE
+	__m128i zero = _mm_setzero_si128();
+	__m128i difference = zero;
+	for (; w + 4 <= fog->wordStride; w += 4)
+	{
+		uint32 words[4];
+		for (uint32 k = 0; k < 4; k++)
+		{
+			const __m128i* cells = (const __m128i*)(counts + (w + k) * 32);
+			__m128i low = _mm_packs_epi16(_mm_cmpeq_epi16(_mm_loadu_si128(cells), zero), _mm_cmpeq_epi16(_mm_loadu_si128(cells + 1), zero));
+			__m128i high = _mm_packs_epi16(_mm_cmpeq_epi16(_mm_loadu_si128(cells + 2), zero), _mm_cmpeq_epi16(_mm_loadu_si128(cells + 3), zero));
+			words[k] = ~((uint32)_mm_movemask_epi8(low) | ((uint32)_mm_movemask_epi8(high) << 16));
+		}
+		__m128i bits = _mm_loadu_si128((const __m128i*)words);
+		__m128i previous = _mm_loadu_si128((const __m128i*)(visible + w));
+		__m128i seen = _mm_loadu_si128((const __m128i*)(explored + w));
+		__m128i merged = _mm_or_si128(seen, bits);
+		difference = _mm_or_si128(difference, _mm_or_si128(_mm_xor_si128(previous, bits), _mm_xor_si128(seen, merged)));
+		_mm_storeu_si128((__m128i*)(visible + w), bits);
+		_mm_storeu_si128((__m128i*)(explored + w), merged);
+	}
+	changed = _mm_movemask_epi8(_mm_cmpeq_epi8(difference, zero)) != 0xffff;
+#endif
+	for (; w < fog->wordStride; w++)
+	{
+		uint32 bits = 0;
+		for (uint32 b = 0; b < 32; b++)
+		{
+			bits |= (uint32)(counts[w * 32 + b] != 0) << b;
+		}
+		changed |= (visible[w] ^ bits) | (explored[w] ^ (explored[w] | bits));
+		visible[w] = bits;
+		explored[w] |= bits;
+	}
+	return changed != 0;
+}
+
+static void FogOfWar_WriteRow(FogOfWar* fog, uint32 y)
+{
+	const uint32* visible = fog->visible + y * fog->wordStride;
+	const uint32* explored = fog->explored + y * fog->wordStride;
+	uint8* pixels = fog->pixels + y * fog->width;
+	uint32 x = 0;
+#ifdef SIMD_SSE
+	// Spreads 16 bits over 16 bytes: every byte tests its own bit.
+	const __m128i select = _mm_set_epi8((char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, (char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+	const __m128i exploredValue = _mm_set1_epi8((char)FOG_OF_WAR_EXPLORED);
+	for (; x + 16 <= fog->width; x += 16)
+	{
+		uint32 shift = x & 31;
+		__m128i v = _mm_cvtsi32_si128((visible[x >> 5] >> shift) & 0xffff);
+		__m128i e = _mm_cvtsi32_si128((explored[x >> 5] >> shift) & 0xffff);
+		v = _mm_unpacklo_epi8(v, v);
+		e = _mm_unpacklo_epi8(e, e);
+		v = _mm_unpacklo_epi16(v, v);
+		e = _mm_unpacklo_epi16(e, e);
+		v = _mm_unpacklo_epi32(v, v);
+		e = _mm_unpacklo_epi32(e, e);
+		v = _mm_cmpeq_epi8(_mm_and_si128(v, select), select);
+		e = _mm_cmpeq_epi8(_mm_and_si128(e, select), select);
+		_mm_storeu_si128((__m128i*)(pixels + x), _mm_or_si128(v, _mm_and_si128(e, exploredValue)));
+	}
+#endif
+	for (; x < fog->width; x++)
+	{
+		uint32 bit = 1u << (x & 31);
+		pixels[x] = (visible[x >> 5] & bit) ? FOG_OF_WAR_VISIBLE : ((explored[x >> 5] & bit) ? FOG_OF_WAR_EXPLORED : 0);
+	}
+}
+
+FogOfWar* FogOfWar_Create(uint32 width, uint32 height, float cellSize)
+{
+	ASSERT(width > 0 && height > 0);
+
+	FogOfWar* fog = (FogOfWar*)malloc(sizeof(FogOfWar));
+	fog->width = width;
+	fog->height = height;
+	fog->cellSize = cellSize;
+	fog->wordStride = (width + 127) / 128 * 4;
+	fog->countStride = fog->wordStride * 32;
+	fog->counts = (uint16*)calloc(fog->countStride * height, sizeof(uint16));
+	fog->visible = (uint32*)calloc(fog->wordStride * height, sizeof(uint32));
+	fog->explored = (uint32*)calloc(fog->wordStride * height, sizeof(uint32));
+	fog->pixels = (uint8*)calloc(width * height, sizeof(uint8));
+	fog->dirtyRows = (uint8*)calloc(height, sizeof(uint8));
+	fog->dirtyMin = height;
+	fog->dirtyMax = 0;
+
+	uint32 spanCount = 0;
+	for (uint32 r = 0; r <= FOG_OF_WAR_MAX_RADIUS; r++)
+	{
+		fog->spanOffsets[r] = spanCount;
+		spanCount += 2 * r + 1;
+	}
+	fog->spans = (uint8*)malloc(spanCount);
+	for (uint32 r = 0; r <= FOG_OF_WAR_MAX_RADIUS; r++)
+	{
+		float outer = (r + 0.5f) * (r + 0.5f);
+		for (int32 dy = -(int32)r; dy <= (int32)r; dy++)
+		{
+			fog->spans[fog->spanOffsets[r] + dy + r] = (uint8)sqrtf(outer - (float)(dy * dy));
+		}
+	}
+
+	fog->viewerCount = 0;
+	fog->viewerCapacity = 64;
+	fog->viewers = (FogOfWar_Viewer*)malloc(sizeof(FogOfWar_Viewer) * fog->viewerCapacity);
+	fog->firstFree = FOG_OF_WAR_INVALID;
+	fog->stampCount = 0;
+	memset(&fog->stats, 0, sizeof(FogOfWar_Stats));
+
+	Texture_Desc desc =
+	{
+		TEXTURE_2D,
+		TEXTURE_R_8,
+		width,
+		height,
+		1,
+		1,
+		FILTER_LINEAR,
+		FILTER_LINEAR,
+		WRAP_CLAMP,
+		WRAP_CLAMP
+	};
+	fog->texture = Texture_Create(&desc);
+	Texture_SetData(fog->texture, 0, fog->pixels);
+	return fog;
+}
+
+void FogOfWar_Destroy(FogOfWar* fog)
+{
+	Texture_Destroy(fog->texture);
+	free(fog->viewers);
+	free(fog->spans);
+	free(fog->dirtyRows);
+	free(fog->pixels);
+	free(fog->explored);
+	free(fog->visible);
+	free(fog->counts);
+	free(fog);
+}
+
+uint32 FogOfWar_AddViewer(FogOfWar* fog, int32 x, int32 y, uint32 radius)
+{
+	ASSERT(radius <= FOG_OF_WAR_MAX_RADIUS);
+
+	uint32 viewer = fog->firstFree;
+	if (viewer != FOG_OF_WAR_INVALID)
+	{
+		fog->firstFree = fog->viewers[viewer].nextFree;
+	}
+	else
+	{
+		if (fog->viewerCount == fog->viewerCapacity)
+		{
+			fog->viewerCapacity *= 2;
+			fog->viewers = (FogOfWar_Viewer*)realloc(fog->viewers, sizeof(FogOfWar_Viewer) * fog->viewerCapacity);
+		}
+		viewer = fog->viewerCount++;
+	}
+
+	FogOfWar_Viewer* entry = &fog->viewers[viewer];
+	entry->x = x;
+	entry->y = y;
+	entry->radius = radius;
+	entry->nextFree = FOG_OF_WAR_INVALID;
+	fog->stats.viewerCount++;
+	FogOfWar_Stamp(fog, x, y, radius, 1);
+	return viewer;
+}
+
+void FogOfWar_RemoveViewer(FogOfWar* fog, uint32 viewer)
+{
+	FogOfWar_Viewer* entry = &fog->viewers[viewer];
+	ASSERT(entry->radius != FOG_OF_WAR_INVALID);
+	FogOfWar_Stamp(fog, entry->x, entry->y, entry->radius, -1);
+	entry->radius = FOG_OF_WAR_INVALID;
+	entry->nextFree = fog->firstFree;
+	fog->firstFree = viewer;
+	fog->stats.viewerCount--;
+}
+
+void FogOfWar_MoveViewer(FogOfWar* fog, uint32 viewer, int32 x, int32 y)
+{
+	FogOfWar_Viewer* entry = &fog->viewers[viewer];
+	if (entry->x == x && entry->y == y)
+		return;
+	FogOfWar_Stamp(fog, entry->x, entry->y, entry->radius, -1);
+	FogOfWar_Stamp(fog, x, y, entry->radius, 1);
+	entry->x = x;
+	entry->y = y;
+}
+
+void FogOfWar_SetViewerRadius(FogOfWar* fog, uint32 viewer, uint32 radius)
+{
+	ASSERT(radius <= FOG_OF_WAR_MAX_RADIUS);
+
+	FogOfWar_Viewer* entry = &fog->viewers[viewer];
+	if (entry->radius == radius)
+		return;
+	FogOfWar_Stamp(fog, entry->x, entry->y, entry->radius, -1);
+	FogOfWar_Stamp(fog, entry->x, entry->y, radius, 1);
+	entry->radius = radius;
+}
+
+void FogOfWar_Update(FogOfWar* fog)
+{
+	FogOfWar_Stats* stats = &fog->stats;
+	double start = Timer_GetMilliseconds();
+	stats->dirtyRowCount = 0;
+	stats->uploadedRowCount = 0;
+
+	// Changed rows are uploaded in contiguous runs.
+	uint32 runStart = FOG_OF_WAR_INVALID;
+	for (uint32 y = fog->dirtyMin; y <= fog->dirtyMax + 1 && y <= fog->height; y++)
+	{
+		int changed = 0;
+		if (y < fog->height && fog->dirtyRows[y])
+		{
+			fog->dirtyRows[y] = 0;
+			stats->dirtyRowCount++;
+			changed = FogOfWar_RebuildRow(fog, y);
+			if (changed)
+				FogOfWar_WriteRow(fog, y);
+		}
+		if (changed && runStart == FOG_OF_WAR_INVALID)
+		{
+			runStart = y;
+		}
+		else if (!changed && runStart != FOG_OF_WAR_INVALID)
+		{
+			Texture_SetSubData(fog->texture, 0, 0, runStart, 0, fog->width, y - runStart, fog->pixels + runStart * fog->width);
+			stats->uploadedRowCount += y - runStart;
+			runStart = FOG_OF_WAR_INVALID;
+		}
+	}
+	fog->dirtyMin = fog->height;
+	fog->dirtyMax = 0;
+
+	stats->updateTime = Timer_GetMilliseconds() - start;
+	stats->stampCount = fog->stampCount;
+	fog->stampCount = 0;
+}
+
+void FogOfWar_Bind(const FogOfWar* fog, Shader* shader, uint32 unit)
+{
+	Shader_Use(shader);
+	GLint location = Shader_GetLocation(shader, "uFogOfWar");
+	if (location != -1)
+		glUniform1i(location, unit);
+	location = Shader_GetLocation(shader, "uFogOfWarScale");
+	if (location != -1)
+	{
+		float scaleX = 1.0f / (fog->cellSize * fog->width);
+		float scaleY = 1.0f / (fog->cellSize * fog->height);
+		glUniform4f(location, scaleX, scaleY, 0.5f / fog->width, 0.5f / fog->height);
+	}
+	Texture_Bind(fog->texture, unit);
+}
+
+int FogOfWar_IsVisible(const FogOfWar* fog, int32 x, int32 y)
+{
+	if (x < 0 || y < 0 || x >= (int32)fog->width || y >= (int32)fog->height)
+		return 0;
+	return (fog->visible[y * fog->wordStride + (x >> 5)] >> (x & 31)) & 1;
+}
+
+int FogOfWar_IsExplored(const FogOfWar* fog, int32 x, int32 y)
+{
+	if (x < 0 || y < 0 || x >= (int32)fog->width || y >= (int32)fog->height)
+		return 0;
+	return (fog->explored[y * fog->wordStride + (x >> 5)] >> (x & 31)) & 1;
+}
+
+const uint32* FogOfWar_GetVisibleRow(const FogOfWar* fog, uint32 y)
+{
+	ASSERT(y < fog->height);
+	return fog->visible + y * fog->wordStride;
+}
+
+uint32 FogOfWar_GetWidth(const FogOfWar* fog)
+{
+	return fog->width;
+}
+
+uint32 FogOfWar_GetHeight(const FogOfWar* fog)
+{
+	return fog->height;
+}
+
+Texture* FogOfWar_GetTexture(const FogOfWar* fog)
+{
+	return fog->texture;
+}
+
+void FogOfWar_GetStats(const FogOfWar* fog, FogOfWar_Stats* stats)
+{
+	*stats = fog->stats;
+}
\ No newline at end of file
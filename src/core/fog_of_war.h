@@ -0,0 +1,50 @@
+#ifndef __FOG_OF_WAR_H__
+#define __FOG_OF_WAR_H__
+
+#include "config.h"
+#include "shader.h"
+#include "texture.h"
+
+#define FOG_OF_WAR_MAX_RADIUS 64
+#define FOG_OF_WAR_INVALID 0xffffffff
+
+// Visibility grid of one player. Every cell counts the viewers that see it,
+// so moving a viewer only removes its old circle stamp and adds the new one.
+// FogOfWar_Update turns the rows touched since the last update into visible
+// and explored bitsets and uploads the rows that changed into an R8 texture:
+// 255 visible, 128 explored, 0 never seen.
+//
+// Cell (x, y) is centred on world (x * cellSize, y * cellSize), like a
+// terrain height sample. FogOfWar_Bind sets uFogOfWar and uFogOfWarScale on a
+// shader; shaders treat a zero scale as no fog of war.
+typedef struct FogOfWar FogOfWar;
+
+typedef struct FogOfWar_Stats
+{
+	uint32 viewerCount;
+	uint32 stampCount;
+	uint32 dirtyRowCount;
+	uint32 uploadedRowCount;
+	double updateTime;
+} FogOfWar_Stats;
+
+FogOfWar* FogOfWar_Create(uint32 width, uint32 height, float cellSize);
+void FogOfWar_Destroy(FogOfWar* fog);
+
+uint32 FogOfWar_AddViewer(FogOfWar* fog, int32 x, int32 y, uint32 radius);
+void FogOfWar_RemoveViewer(FogOfWar* fog, uint32 viewer);
+void FogOfWar_MoveViewer(FogOfWar* fog, uint32 viewer, int32 x, int32 y);
+void FogOfWar_SetViewerRadius(FogOfWar* fog, uint32 viewer, uint32 radius);
+
+void FogOfWar_Update(FogOfWar* fog);
+void FogOfWar_Bind(const FogOfWar* fog, Shader* shader, uint32 unit);
+
+int FogOfWar_IsVisible(const FogOfWar* fog, int32 x, int32 y);
+int FogOfWar_IsExplored(const FogOfWar* fog, int32 x, int32 y);
+const uint32* FogOfWar_GetVisibleRow(const FogOfWar* fog, uint32 y);
+uint32 FogOfWar_GetWidth(const FogOfWar* fog);
+uint32 FogOfWar_GetHeight(const FogOfWar* fog);
+Texture* FogOfWar_GetTexture(const FogOfWar* fog);
+void FogOfWar_GetStats(const FogOfWar* fog, FogOfWar_Stats* stats);
+
+#endif
\ No newline at end of file
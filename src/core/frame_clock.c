@@ -0,0 +1,89 @@
+#include "frame_clock.h"
+#include <string.h>
+
+struct FrameClock
+{
+	FrameClock_Desc desc;
+	double tickLength;
+	double previous;
+	double accumulator;
+	int started;
+	uint32 tick;
+	FrameClock_Stats stats;
+};
+
+FrameClock* FrameClock_Create(const FrameClock_Desc* frame_clock_desc)
+{
+	ASSERT(frame_clock_desc != NULL && frame_clock_desc->tickRate > 0.0 && frame_clock_desc->maxTicksPerFrame > 0);
+
+	FrameClock* clock = (FrameClock*)malloc(sizeof(FrameClock));
+	memset(clock, 0, sizeof(FrameClock));
+	clock->desc = *frame_clock_desc;
+	clock->tickLength = 1000.0 / frame_clock_desc->tickRate;
+	if (clock->desc.maxFrameTime <= 0.0)
+		clock->desc.maxFrameTime = clock->tickLength * clock->desc.maxTicksPerFrame;
+	return clock;
+}
+
+void FrameClock_Destroy(FrameClock* clock)
+{
+	free(clock);
+}
+
+uint32 FrameClock_Advance(FrameClock* clock, double now)
+{
+	clock->stats.frameCount++;
+	if (!clock->started)
+	{
+		clock->started = 1;
+		clock->previous = now;
+		return 0;
+	}
+
+	double elapsed = now - clock->previous;
+	clock->previous = now;
+	if (elapsed < 0.0)
+		elapsed = 0.0;
+	if (elapsed > clock->desc.maxFrameTime)
+	{
+		clock->stats.clampedFrameCount++;
+		clock->stats.droppedTime += elapsed - clock->desc.maxFrameTime;
+		elapsed = clock->desc.maxFrameTime;
+	}
+
+	clock->accumulator += elapsed;
+	uint32 ticks = (uint32)(clock->accumulator / clock->tickLength);
+	if (ticks > clock->desc.maxTicksPerFrame)
+	{
+		uint32 dropped = ticks - clock->desc.maxTicksPerFrame;
+		clock->stats.droppedTickCount += dropped;
+		clock->stats.droppedTime += dropped * clock->tickLength;
+		clock->accumulator -= dropped * clock->tickLength;
+		ticks = clock->desc.maxTicksPerFrame;
+	}
+	clock->accumulator -= ticks * clock->tickLength;
+
+	clock->tick += ticks;
+	clock->stats.tickCount += ticks;
+	return ticks;
+}
+
+float FrameClock_GetAlpha(const FrameClock* clock)
+{
+	return (float)(clock->accumulator / clock->tickLength);
+}
+
+float FrameClock_GetTickTime(const FrameClock* clock)
+{
+	return (float)(clock->tickLength / 1000.0);
+}
+
+uint32 FrameClock_GetTick(const FrameClock* clock)
+{
+	return clock->tick;
+}
+
+void FrameClock_GetStats(const FrameClock* clock, FrameClock_Stats* stats)
+{
+	*stats = clock->stats;
+}
\ No newline at end of file
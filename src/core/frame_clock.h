@@ -0,0 +1,49 @@
+#ifndef __FRAME_CLOCK_H__
+#define __FRAME_CLOCK_H__
+
+#include "config.h"
+
+// Fixed-timestep scheduler. The simulation advances in whole ticks of
+// 1 / tickRate seconds while frames are drawn as fast as the display allows;
+// FrameClock_Advance turns the wall time that passed since the last frame
+// into the number of ticks to run now, and FrameClock_GetAlpha tells how far
+// the frame lies between the last two ticks so transforms can be
+// interpolated.
+//
+// A frame that took longer than maxFrameTime (a breakpoint, a window drag)
+// only counts as maxFrameTime, and no frame runs more than
+// maxTicksPerFrame ticks. Whatever is left over is dropped instead of
+// carried, so a simulation that cannot keep up slows down rather than
+// spiralling into ever longer catch-up frames. Ticks themselves are never
+// skipped, which keeps lockstep peers in agreement.
+typedef struct FrameClock FrameClock;
+
+typedef struct FrameClock_Desc
+{
+	double tickRate;
+	uint32 maxTicksPerFrame;
+	double maxFrameTime;
+} FrameClock_Desc;
+
+typedef struct FrameClock_Stats
+{
+	uint32 frameCount;
+	uint32 tickCount;
+	uint32 clampedFrameCount;
+	uint32 droppedTickCount;
+	double droppedTime;
+} FrameClock_Stats;
+
+FrameClock* FrameClock_Create(const FrameClock_Desc* frame_clock_desc);
+void FrameClock_Destroy(FrameClock* clock);
+
+// Takes the current time in milliseconds and returns how many ticks to
+// simulate before drawing. The first call only starts the clock.
+uint32 FrameClock_Advance(FrameClock* clock, double now);
+float FrameClock_GetAlpha(const FrameClock* clock);
+// Tick length in seconds.
+float FrameClock_GetTickTime(const FrameClock* clock);
+uint32 FrameClock_GetTick(const FrameClock* clock);
+void FrameClock_GetStats(const FrameClock* clock, FrameClock_Stats* stats);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "framebuffer.h"
+#include <opengl/glad.h>
+
+struct Framebuffer
+{
+	GLuint id;
+	GLuint colorMask;
+};
+
+static void Framebuffer_Attach(GLenum attachment, const Texture* texture, uint32 layer)
+{
+	if (texture == NULL)
+	{
+		glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, 0, 0);
+	}
+	else if (Texture_GetTarget(texture) == GL_TEXTURE_2D)
+	{
+		glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, Texture_GetHandle(texture), 0);
+	}
+	else
+	{
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, attachment, Texture_GetHandle(texture), 0, layer);
+	}
+}
+
+static void Framebuffer_UpdateDrawBuffers(const Framebuffer* framebuffer)
+{
+	GLenum buffers[FRAMEBUFFER_MAX_COLORS];
+	GLsizei count = 0;
+	for (uint32 i = 0; i < FRAMEBUFFER_MAX_COLORS; i++)
+	{
+		buffers[i] = (framebuffer->colorMask & (1 << i)) ? GL_COLOR_ATTACHMENT0 + i : GL_NONE;
+		if (framebuffer->colorMask & (1 << i))
+			count = i + 1;
+	}
+
+	if (count == 0)
+	{
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	}
+	else
+	{
+		glDrawBuffers(count, buffers);
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+	}
+}
+
+Framebuffer* Framebuffer_Create()
+{
+	Framebuffer* framebuffer = (Framebuffer*)malloc(sizeof(Framebuffer));
+	glGenFramebuffers(1, &framebuffer->id);
+	framebuffer->colorMask = 0;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->id);
+	Framebuffer_UpdateDrawBuffers(framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	return framebuffer;
+}
+
+void Framebuffer_Destroy(Framebuffer* framebuffer)
+{
+	glDeleteFramebuffers(1, &framebuffer->id);
+	free(framebuffer);
+}
+
+void Framebuffer_AttachDepth(Framebuffer* framebuffer, const Texture* texture, uint32 layer)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->id);
+	Framebuffer_Attach(GL_DEPTH_ATTACHMENT, texture, layer);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Framebuffer_AttachColor(Framebuffer* framebuffer, uint32 index, const Texture* texture, uint32 layer)
+{
+	ASSERT(index < FRAMEBUFFER_MAX_COLORS);
+	if (texture != NULL)
+		framebuffer->colorMask |= 1 << index;
+	else
+		framebuffer->colorMask &= ~(1 << index);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->id);
+	Framebuffer_Attach(GL_COLOR_ATTACHMENT0 + index, texture, layer);
+	Framebuffer_UpdateDrawBuffers(framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+int Framebuffer_IsComplete(const Framebuffer* framebuffer)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->id);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		LOG_E("Framebuffer is incomplete: 0x%x\n", status);
+		return 0;
+	}
+	return 1;
+}
+
+void Framebuffer_Bind(const Framebuffer* framebuffer)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->id);
+}
+
+void Framebuffer_Unbind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Framebuffer_BlitColor(const Framebuffer* source, const Framebuffer* destination, uint32 width, uint32 height)
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, source->id);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, destination != NULL ? destination->id : 0);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+void Framebuffer_BlitDepth(const Framebuffer* source, const Framebuffer* destination, uint32 width, uint32 height)
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, source->id);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, destination->id);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef __FRAMEBUFFER_H__
+#define __FRAMEBUFFER_H__
+
+#include "config.h"
+#include "texture.h"
+
+#define FRAMEBUFFER_MAX_COLORS 4
+
+// Render target made of texture attachments. Layered textures (2D arrays)
+// attach one layer at a time. A framebuffer without color attachments is a
+// depth-only target.
+typedef struct Framebuffer Framebuffer;
+
+Framebuffer* Framebuffer_Create();
+void Framebuffer_Destroy(Framebuffer* framebuffer);
+
+void Framebuffer_AttachDepth(Framebuffer* framebuffer, const Texture* texture, uint32 layer);
+void Framebuffer_AttachColor(Framebuffer* framebuffer, uint32 index, const Texture* texture, uint32 layer);
+int Framebuffer_IsComplete(const Framebuffer* framebuffer);
+
+void Framebuffer_Bind(const Framebuffer* framebuffer);
+void Framebuffer_Unbind();
+// A NULL destination is the window.
+void Framebuffer_BlitColor(const Framebuffer* source, const Framebuffer* destination, uint32 width, uint32 height);
+void Framebuffer_BlitDepth(const Framebuffer* source, const Framebuffer* destination, uint32 width, uint32 height);
+
+#endif
\ No newline at end of file
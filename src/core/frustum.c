@@ -0,0 +1,54 @@
+#include "frustum.h"
+#include <math.h>
+
+static void Frustum_SetPlane(float4* plane, const matrix4x4* m, int row, float sign)
+{
+	plane->x = m->data[3] + sign * m->data[row];
+	plane->y = m->data[7] + sign * m->data[4 + row];
+	plane->z = m->data[11] + sign * m->data[8 + row];
+	plane->w = m->data[15] + sign * m->data[12 + row];
+
+	float length = sqrtf(plane->x * plane->x + plane->y * plane->y + plane->z * plane->z);
+	if (length > 0.0f)
+	{
+		plane->x /= length;
+		plane->y /= length;
+		plane->z /= length;
+		plane->w /= length;
+	}
+}
+
+void Frustum_FromMatrix(Frustum* frustum, const matrix4x4* viewProjection)
+{
+	Frustum_SetPlane(&frustum->planes[0], viewProjection, 0, 1.0f);
+	Frustum_SetPlane(&frustum->planes[1], viewProjection, 0, -1.0f);
+	Frustum_SetPlane(&frustum->planes[2], viewProjection, 1, 1.0f);
+	Frustum_SetPlane(&frustum->planes[3], viewProjection, 1, -1.0f);
+	Frustum_SetPlane(&frustum->planes[4], viewProjection, 2, 1.0f);
+	Frustum_SetPlane(&frustum->planes[5], viewProjection, 2, -1.0f);
+}
+
+int Frustum_TestSphere(const Frustum* frustum, const float3* center, float radius)
+{
+	for (int i = 0; i < FRUSTUM_PLANE_COUNTS; i++)
+	{
+		const float4* plane = &frustum->planes[i];
+		if (plane->x * center->x + plane->y * center->y + plane->z * center->z + plane->w < -radius)
+			return 0;
+	}
+	return 1;
+}
+
+int Frustum_TestAabb(const Frustum* frustum, const Aabb* aabb)
+{
+	for (int i = 0; i < FRUSTUM_PLANE_COUNTS; i++)
+	{
+		const float4* plane = &frustum->planes[i];
+		float x = plane->x >= 0.0f ? aabb->max.x : aabb->min.x;
+		float y = plane->y >= 0.0f ? aabb->max.y : aabb->min.y;
+		float z = plane->z >= 0.0f ? aabb->max.z : aabb->min.z;
+		if (plane->x * x + plane->y * y + plane->z * z + plane->w < 0.0f)
+			return 0;
+	}
+	return 1;
+}
\ No newline at end of file
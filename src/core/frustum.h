@@ -0,0 +1,19 @@
+#ifndef __FRUSTUM_H__
+#define __FRUSTUM_H__
+
+#include "config.h"
+#include "maths.h"
+
+#define FRUSTUM_PLANE_COUNTS 6
+
+// Planes are stored as (normal, distance) pointing inside the frustum.
+typedef struct Frustum
+{
+	float4 planes[FRUSTUM_PLANE_COUNTS];
+} Frustum;
+
+void Frustum_FromMatrix(Frustum* frustum, const matrix4x4* viewProjection);
+int Frustum_TestSphere(const Frustum* frustum, const float3* center, float radius);
+int Frustum_TestAabb(const Frustum* frustum, const Aabb* aabb);
+
+#endif
\ No newline at end of file
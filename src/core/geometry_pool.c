@@ -0,0 +1,228 @@
+#include "geometry_pool.h"
+#include "shader.h"
+#include "tlsf.h"
+#include <opengl/glad.h>
+
+#define GEOMETRY_POOL_VERTICES 0
+#define GEOMETRY_POOL_INDICES 1
+
+#define SHARED_VERTEX_CAPACITY (1 << 16)
+#define SHARED_INDEX_CAPACITY (3 << 16)
+
+struct GeometryPool
+{
+	GLuint vao;
+	GLuint boIds[2];
+	Tlsf* allocators[2];
+};
+
+typedef struct GeometryPool_Copy
+{
+	GLuint stride;
+} GeometryPool_Copy;
+
+static const GLuint GeometryPool_Strides[2] = { sizeof(Vertex), sizeof(GLushort) };
+
+static GeometryPool* SharedPool = NULL;
+
+static GLuint GeometryPool_CreateBuffer(GLsizeiptr size)
+{
+	GLuint id;
+	glGenBuffers(1, &id);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, id);
+	glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	return id;
+}
+
+static void GeometryPool_SetupVertexArray(GeometryPool* pool)
+{
+	glBindVertexArray(pool->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, pool->boIds[GEOMETRY_POOL_VERTICES]);
+	Shader_EnableVertexLayout(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool->boIds[GEOMETRY_POOL_INDICES]);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+static void GeometryPool_CopyRange(void* userData, uint32 from, uint32 to, uint32 size)
+{
+	const GeometryPool_Copy* copy = (const GeometryPool_Copy*)userData;
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, from * copy->stride, to * copy->stride, size * copy->stride);
+}
+
+static void GeometryPool_Relocate(GeometryPool* pool, uint32 which, uint32 capacity, int defragment)
+{
+	Tlsf* allocator = pool->allocators[which];
+	GeometryPool_Copy copy;
+	copy.stride = GeometryPool_Strides[which];
+
+	GLuint source = pool->boIds[which];
+	GLuint destination = GeometryPool_CreateBuffer(capacity * copy.stride);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, source);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, destination);
+	if (defragment)
+	{
+		Tlsf_Defragment(allocator, GeometryPool_CopyRange, &copy);
+	}
+	else
+	{
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, Tlsf_GetCapacity(allocator) * copy.stride);
+		Tlsf_Grow(allocator, capacity);
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	glDeleteBuffers(1, &source);
+	pool->boIds[which] = destination;
+	GeometryPool_SetupVertexArray(pool);
+}
+
+static uint32 GeometryPool_Reserve(GeometryPool* pool, uint32 which, uint32 size)
+{
+	Tlsf* allocator = pool->allocators[which];
+	uint32 block = Tlsf_Allocate(allocator, size);
+	if (block != TLSF_INVALID)
+		return block;
+
+	uint32 capacity = Tlsf_GetCapacity(allocator);
+	uint32 used = Tlsf_GetUsedSize(allocator);
+	if (used + size <= capacity)
+	{
+		GeometryPool_Relocate(pool, which, capacity, 1);
+		block = Tlsf_Allocate(allocator, size);
+		if (block != TLSF_INVALID)
+			return block;
+	}
+
+	uint32 grown = capacity * 2;
+	if (grown < used + size)
+		grown = used + size;
+	LOG_I("Growing geometry pool %s buffer to %u elements\n", which == GEOMETRY_POOL_VERTICES ? "vertex" : "index", grown);
+	GeometryPool_Relocate(pool, which, grown, 0);
+	return Tlsf_Allocate(allocator, size);
+}
+
+GeometryPool* GeometryPool_Create(uint32 vertexCapacity, uint32 indexCapacity)
+{
+	GeometryPool* pool = (GeometryPool*)malloc(sizeof(GeometryPool));
+	pool->allocators[GEOMETRY_POOL_VERTICES] = Tlsf_Create(vertexCapacity);
+	pool->allocators[GEOMETRY_POOL_INDICES] = Tlsf_Create(indexCapacity);
+	pool->boIds[GEOMETRY_POOL_VERTICES] = GeometryPool_CreateBuffer(vertexCapacity * sizeof(Vertex));
+	pool->boIds[GEOMETRY_POOL_INDICES] = GeometryPool_CreateBuffer(indexCapacity * sizeof(GLushort));
+	glGenVertexArrays(1, &pool->vao);
+	GeometryPool_SetupVertexArray(pool);
+	return pool;
+}
+
+void GeometryPool_Destroy(GeometryPool* pool)
+{
+	glDeleteVertexArrays(1, &pool->vao);
+	glDeleteBuffers(2, pool->boIds);
+	Tlsf_Destroy(pool->allocators[GEOMETRY_POOL_VERTICES]);
+	Tlsf_Destroy(pool->allocators[GEOMETRY_POOL_INDICES]);
+	free(pool);
+}
+
+GeometryPool* GeometryPool_GetShared()
+{
+	if (SharedPool == NULL)
+	{
+		SharedPool = GeometryPool_Create(SHARED_VERTEX_CAPACITY, SHARED_INDEX_CAPACITY);
+	}
+	return SharedPool;
+}
+
+void GeometryPool_DestroyShared()
+{
+	if (SharedPool != NULL)
+	{
+		GeometryPool_Destroy(SharedPool);
+		SharedPool = NULL;
+	}
+}
+
+Result GeometryPool_Allocate(GeometryPool* pool, const Vertex* vertices, uint32 vertexCount, const uint16* indices, uint32 indexCount, GeometryPool_Allocation* allocation)
+{
+	ASSERT(allocation != NULL);
+
+	allocation->vertexBlock = GeometryPool_Reserve(pool, GEOMETRY_POOL_VERTICES, vertexCount);
+	allocation->indexBlock = GeometryPool_Reserve(pool, GEOMETRY_POOL_INDICES, indexCount);
+	if (allocation->vertexBlock == TLSF_INVALID || allocation->indexBlock == TLSF_INVALID)
+	{
+		LOG_E("Out of geometry pool memory\n");
+		GeometryPool_Free(pool, allocation);
+		return Result_FAILURE;
+	}
+
+	GeometryPool_Range range;
+	GeometryPool_GetRange(pool, allocation, &range);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, pool->boIds[GEOMETRY_POOL_VERTICES]);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, range.baseVertex * sizeof(Vertex), vertexCount * sizeof(Vertex), vertices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, pool->boIds[GEOMETRY_POOL_INDICES]);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, range.firstIndex * sizeof(GLushort), indexCount * sizeof(GLushort), indices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	return Result_SUCCESS;
+}
+
+void GeometryPool_Free(GeometryPool* pool, GeometryPool_Allocation* allocation)
+{
+	Tlsf_Free(pool->allocators[GEOMETRY_POOL_VERTICES], allocation->vertexBlock);
+	Tlsf_Free(pool->allocators[GEOMETRY_POOL_INDICES], allocation->indexBlock);
+	allocation->vertexBlock = TLSF_INVALID;
+	allocation->indexBlock = TLSF_INVALID;
+}
+
+void GeometryPool_GetRange(const GeometryPool* pool, const GeometryPool_Allocation* allocation, GeometryPool_Range* range)
+{
+	const Tlsf* vertexAllocator = pool->allocators[GEOMETRY_POOL_VERTICES];
+	const Tlsf* indexAllocator = pool->allocators[GEOMETRY_POOL_INDICES];
+	range->baseVertex = Tlsf_GetOffset(vertexAllocator, allocation->vertexBlock);
+	range->vertexCount = Tlsf_GetSize(vertexAllocator, allocation->vertexBlock);
+	range->firstIndex = Tlsf_GetOffset(indexAllocator, allocation->indexBlock);
+	range->indexCount = Tlsf_GetSize(indexAllocator, allocation->indexBlock);
+}
+
+void GeometryPool_Defragment(GeometryPool* pool)
+{
+	for (uint32 i = 0; i < 2; i++)
+	{
+		GeometryPool_Relocate(pool, i, Tlsf_GetCapacity(pool->allocators[i]), 1);
+	}
+}
+
+void GeometryPool_Bind(const GeometryPool* pool)
+{
+	glBindVertexArray(pool->vao);
+}
+
+void GeometryPool_Unbind(const GeometryPool* pool)
+{
+	glBindVertexArray(0);
+}
+
+void GeometryPool_Draw(const GeometryPool* pool, uint32 indexCount, uint32 firstIndex, uint32 baseVertex, uint32 instanceCount)
+{
+	const void* indices = (const void*)(firstIndex * sizeof(GLushort));
+	if (GLAD_GL_VERSION_3_2 || baseVertex == 0)
+	{
+		if (instanceCount == 1)
+			glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, indices, baseVertex);
+		else
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, indices, instanceCount, baseVertex);
+		return;
+	}
+
+	// Without base vertex draws, move the attributes to the range instead and
+	// put them back afterwards. Slower, but only hit on old contexts.
+	glBindBuffer(GL_ARRAY_BUFFER, pool->boIds[GEOMETRY_POOL_VERTICES]);
+	Shader_EnableVertexLayout(baseVertex);
+	if (instanceCount == 1)
+		glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, indices);
+	else
+		glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, indices, instanceCount);
+	Shader_EnableVertexLayout(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef __GEOMETRY_POOL_H__
+#define __GEOMETRY_POOL_H__
+
+#include "config.h"
+#include "vertex.h"
+
+// A pair of large vertex/index buffers shared by many meshes. Every mesh
+// sub-allocates a vertex range and an index range, indices stay relative to
+// the mesh and are drawn with a base vertex, so all meshes of a pool share
+// one vertex array object.
+typedef struct GeometryPool GeometryPool;
+
+typedef struct GeometryPool_Allocation
+{
+	uint32 vertexBlock;
+	uint32 indexBlock;
+} GeometryPool_Allocation;
+
+typedef struct GeometryPool_Range
+{
+	uint32 baseVertex;
+	uint32 vertexCount;
+	uint32 firstIndex;
+	uint32 indexCount;
+} GeometryPool_Range;
+
+GeometryPool* GeometryPool_Create(uint32 vertexCapacity, uint32 indexCapacity);
+void GeometryPool_Destroy(GeometryPool* pool);
+
+GeometryPool* GeometryPool_GetShared();
+void GeometryPool_DestroyShared();
+
+Result GeometryPool_Allocate(GeometryPool* pool, const Vertex* vertices, uint32 vertexCount, const uint16* indices, uint32 indexCount, GeometryPool_Allocation* allocation);
+void GeometryPool_Free(GeometryPool* pool, GeometryPool_Allocation* allocation);
+void GeometryPool_GetRange(const GeometryPool* pool, const GeometryPool_Allocation* allocation, GeometryPool_Range* range);
+void GeometryPool_Defragment(GeometryPool* pool);
+
+void GeometryPool_Bind(const GeometryPool* pool);
+void GeometryPool_Unbind(const GeometryPool* pool);
+// Draws from the bound pool. Base vertex draws need OpenGL 3.2, older
+// contexts fall back to re-pointing the vertex layout for each draw.
+void GeometryPool_Draw(const GeometryPool* pool, uint32 indexCount, uint32 firstIndex, uint32 baseVertex, uint32 instanceCount);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,328 @@
+#include "gpu_cull.h"
+#include "frustum.h"
+#include "shader.h"
+#include <opengl/glad_ext.h>
+
+#define GPU_CULL_INSTANCES 0
+#define GPU_CULL_VISIBLE 1
+#define GPU_CULL_TRANSFORMS 2
+
+#define GPU_CULL_GROUP_SIZE 64
+#define GPU_CULL_HIZ_GROUP_SIZE 8
+
+static const char* GpuCull_CullSource =
+	"#version 430\n"
+	"layout(local_size_x = 64) in;\n"
+	"struct Instance { vec4 sphere; uint command; uint padding0; uint padding1; uint padding2; };\n"
+	"struct DrawCommand { uint count; uint instanceCount; uint firstIndex; int baseVertex; uint baseInstance; };\n"
+	"layout(std430, binding = 0) readonly buffer Transforms { mat4 transforms[]; };\n"
+	"layout(std430, binding = 1) readonly buffer Instances { Instance instances[]; };\n"
+	"layout(std430, binding = 2) buffer Commands { DrawCommand commands[]; };\n"
+	"layout(std430, binding = 3) writeonly buffer Visible { uint visible[]; };\n"
+	"layout(std430, binding = 4) writeonly buffer VisibleTransforms { mat4 visibleTransforms[]; };\n"
+	"uniform mat4 uViewProjection;\n"
+	"uniform vec4 uPlanes[6];\n"
+	"uniform uint uInstanceCount;\n"
+	"uniform int uUseHiZ;\n"
+	"uniform vec2 uHiZSize;\n"
+	"uniform float uHiZLevels;\n"
+	"uniform sampler2D uHiZ;\n"
+	"bool FrustumTest(vec3 center, float radius)\n"
+	"{\n"
+	"	for (int i = 0; i < 6; i++)\n"
+	"	{\n"
+	"		if (dot(uPlanes[i].xyz, center) + uPlanes[i].w < -radius)\n"
+	"			return false;\n"
+	"	}\n"
+	"	return true;\n"
+	"}\n"
+	"bool HiZTest(vec3 center, float radius)\n"
+	"{\n"
+	"	vec2 screenMin = vec2(1.0);\n"
+	"	vec2 screenMax = vec2(0.0);\n"
+	"	float depthMin = 1.0;\n"
+	"	for (int i = 0; i < 8; i++)\n"
+	"	{\n"
+	"		vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);\n"
+	"		vec4 clip = uViewProjection * vec4(corner, 1.0);\n"
+	"		if (clip.w <= 0.0)\n"
+	"			return true;\n"
+	"		vec3 ndc = clip.xyz / clip.w;\n"
+	"		screenMin = min(screenMin, ndc.xy * 0.5 + 0.5);\n"
+	"		screenMax = max(screenMax, ndc.xy * 0.5 + 0.5);\n"
+	"		depthMin = min(depthMin, ndc.z * 0.5 + 0.5);\n"
+	"	}\n"
+	"	screenMin = clamp(screenMin, 0.0, 1.0);\n"
+	"	screenMax = clamp(screenMax, 0.0, 1.0);\n"
+	"	vec2 size = (screenMax - screenMin) * uHiZSize;\n"
+	"	float level = clamp(ceil(log2(max(max(size.x, size.y), 1.0))), 0.0, uHiZLevels - 1.0);\n"
+	"	float depth = max(max(textureLod(uHiZ, screenMin, level).r, textureLod(uHiZ, vec2(screenMax.x, screenMin.y), level).r),\n"
+	"		max(textureLod(uHiZ, vec2(screenMin.x, screenMax.y), level).r, textureLod(uHiZ, screenMax, level).r));\n"
+	"	return depthMin <= depth;\n"
+	"}\n"
+	"void main()\n"
+	"{\n"
+	"	uint index = gl_GlobalInvocationID.x;\n"
+	"	if (index >= uInstanceCount)\n"
+	"		return;\n"
+	"	Instance instance = instances[index];\n"
+	"	mat4 model = transforms[index];\n"
+	"	vec3 center = (model * vec4(instance.sphere.xyz, 1.0)).xyz;\n"
+	"	float scale = max(length(model[0].xyz), max(length(model[1].xyz), length(model[2].xyz)));\n"
+	"	float radius = instance.sphere.w * scale;\n"
+	"	if (!FrustumTest(center, radius))\n"
+	"		return;\n"
+	"	if (uUseHiZ != 0 && !HiZTest(center, radius))\n"
+	"		return;\n"
+	"	uint slot = commands[instance.command].baseInstance + atomicAdd(commands[instance.command].instanceCount, 1u);\n"
+	"	visible[slot] = index;\n"
+	"	visibleTransforms[slot] = model;\n"
+	"}\n";
+
+static const char* GpuCull_HiZSource =
+	"#version 430\n"
+	"layout(local_size_x = 8, local_size_y = 8) in;\n"
+	"layout(r32f, binding = 0) writeonly uniform image2D uDestination;\n"
+	"uniform sampler2D uSource;\n"
+	"uniform int uSourceLevel;\n"
+	"uniform ivec2 uSourceSize;\n"
+	"uniform int uReduce;\n"
+	"void main()\n"
+	"{\n"
+	"	ivec2 position = ivec2(gl_GlobalInvocationID.xy);\n"
+	"	if (any(greaterThanEqual(position, imageSize(uDestination))))\n"
+	"		return;\n"
+	"	float depth;\n"
+	"	if (uReduce == 0)\n"
+	"	{\n"
+	"		depth = texelFetch(uSource, position, 0).r;\n"
+	"	}\n"
+	"	else\n"
+	"	{\n"
+	"		ivec2 source = position * 2;\n"
+	"		ivec2 last = uSourceSize - 1;\n"
+	// An odd source dimension leaves a row or column the 2x2 footprint
+	// never reaches, so take a third one there (3x2, 2x3 or 3x3).
+	"		ivec2 extent = ivec2(2) + (uSourceSize & 1);\n"
+	"		depth = 0.0;\n"
+	"		for (int y = 0; y < extent.y; y++)\n"
+	"			for (int x = 0; x < extent.x; x++)\n"
+	"				depth = max(depth, texelFetch(uSource, min(source + ivec2(x, y), last), uSourceLevel).r);\n"
+	"	}\n"
+	"	imageStore(uDestination, position, vec4(depth));\n"
+	"}\n";
+
+struct GpuCull
+{
+	Shader* cullShader;
+	Shader* hizShader;
+	Texture* hiz;
+	uint32 hizLevels;
+	int useHiZ;
+	uint32 maxInstances;
+	GLuint boIds[3];
+};
+
+static void GpuCull_SetInt(Shader* shader, const char* name, GLint value)
+{
+	GLint location = Shader_GetLocation(shader, name);
+	if (location != -1)
+	{
+		glUniform1i(location, value);
+	}
+}
+
+int GpuCull_IsSupported()
+{
+	return GLAD_GL_VERSION_4_3;
+}
+
+GpuCull* GpuCull_Create(uint32 maxInstances)
+{
+	if (!GpuCull_IsSupported())
+	{
+		LOG_E("GPU culling requires OpenGL 4.3\n");
+		return NULL;
+	}
+
+	Shader* cullShader = Shader_CompileCompute(GpuCull_CullSource);
+	Shader* hizShader = Shader_CompileCompute(GpuCull_HiZSource);
+	if (cullShader == NULL || hizShader == NULL)
+	{
+		if (cullShader != NULL)
+			Shader_Destroy(cullShader);
+		if (hizShader != NULL)
+			Shader_Destroy(hizShader);
+		return NULL;
+	}
+
+	GpuCull* cull = (GpuCull*)malloc(sizeof(GpuCull));
+	cull->cullShader = cullShader;
+	cull->hizShader = hizShader;
+	cull->hiz = NULL;
+	cull->hizLevels = 0;
+	cull->useHiZ = 0;
+	cull->maxInstances = maxInstances;
+
+	glGenBuffers(3, cull->boIds);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, cull->boIds[GPU_CULL_INSTANCES]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GpuCull_Instance) * maxInstances, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, cull->boIds[GPU_CULL_VISIBLE]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint) * maxInstances, NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, cull->boIds[GPU_CULL_TRANSFORMS]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(matrix4x4) * maxInstances, NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	return cull;
+}
+
+void GpuCull_Destroy(GpuCull* cull)
+{
+	if (cull->hiz != NULL)
+		Texture_Destroy(cull->hiz);
+	glDeleteBuffers(3, cull->boIds);
+	Shader_Destroy(cull->cullShader);
+	Shader_Destroy(cull->hizShader);
+	free(cull);
+}
+
+void GpuCull_BuildHiZ(GpuCull* cull, const Texture* depth)
+{
+	uint32 width = Texture_GetWidth(depth);
+	uint32 height = Texture_GetHeight(depth);
+
+	if (cull->hiz == NULL || Texture_GetWidth(cull->hiz) != width || Texture_GetHeight(cull->hiz) != height)
+	{
+		if (cull->hiz != NULL)
+			Texture_Destroy(cull->hiz);
+
+		uint32 levels = 1;
+		while ((width >> levels) > 0 || (height >> levels) > 0)
+		{
+			levels++;
+		}
+
+		Texture_Desc desc =
+		{
+			TEXTURE_2D,
+			TEXTURE_R_32F,
+			width,
+			height,
+			1,
+			levels,
+			FILTER_POINT_MIPMAP,
+			FILTER_POINT,
+			WRAP_CLAMP,
+			WRAP_CLAMP
+		};
+		cull->hiz = Texture_Create(&desc);
+		cull->hizLevels = levels;
+		for (uint32 level = 0; level < levels; level++)
+		{
+			Texture_SetData(cull->hiz, level, NULL);
+		}
+	}
+
+	Shader_Use(cull->hizShader);
+	GpuCull_SetInt(cull->hizShader, "uSource", 0);
+	GLint sourceSize = Shader_GetLocation(cull->hizShader, "uSourceSize");
+
+	for (uint32 level = 0; level < cull->hizLevels; level++)
+	{
+		uint32 levelWidth = width >> level > 0 ? width >> level : 1;
+		uint32 levelHeight = height >> level > 0 ? height >> level : 1;
+		if (level == 0)
+		{
+			Texture_Bind(depth, 0);
+			GpuCull_SetInt(cull->hizShader, "uReduce", 0);
+			GpuCull_SetInt(cull->hizShader, "uSourceLevel", 0);
+			if (sourceSize != -1)
+				glUniform2i(sourceSize, width, height);
+		}
+		else
+		{
+			uint32 sourceWidth = width >> (level - 1) > 0 ? width >> (level - 1) : 1;
+			uint32 sourceHeight = height >> (level - 1) > 0 ? height >> (level - 1) : 1;
+			Texture_Bind(cull->hiz, 0);
+			GpuCull_SetInt(cull->hizShader, "uReduce", 1);
+			GpuCull_SetInt(cull->hizShader, "uSourceLevel", level - 1);
+			if (sourceSize != -1)
+				glUniform2i(sourceSize, sourceWidth, sourceHeight);
+		}
+
+		glBindImageTexture(0, Texture_GetHandle(cull->hiz), level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute((levelWidth + GPU_CULL_HIZ_GROUP_SIZE - 1) / GPU_CULL_HIZ_GROUP_SIZE, (levelHeight + GPU_CULL_HIZ_GROUP_SIZE - 1) / GPU_CULL_HIZ_GROUP_SIZE, 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	cull->useHiZ = 1;
+}
+
+void GpuCull_ClearHiZ(GpuCull* cull)
+{
+	cull->useHiZ = 0;
+}
+
+void GpuCull_Dispatch(GpuCull* cull, const matrix4x4* viewProjection, const GpuCull_Instance* instances, uint32 instanceCount, uint32 transformBuffer, uint32 commandBuffer)
+{
+	ASSERT(instanceCount <= cull->maxInstances);
+	if (instanceCount == 0)
+		return;
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, cull->boIds[GPU_CULL_INSTANCES]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GpuCull_Instance) * cull->maxInstances, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GpuCull_Instance) * instanceCount, instances);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	Frustum frustum;
+	Frustum_FromMatrix(&frustum, viewProjection);
+
+	Shader* shader = cull->cullShader;
+	Shader_Use(shader);
+
+	GLint location = Shader_GetLocation(shader, "uViewProjection");
+	if (location != -1)
+		glUniformMatrix4fv(location, 1, GL_FALSE, viewProjection->data);
+	location = Shader_GetLocation(shader, "uPlanes[0]");
+	if (location != -1)
+		glUniform4fv(location, FRUSTUM_PLANE_COUNTS, frustum.planes[0].data);
+	location = Shader_GetLocation(shader, "uInstanceCount");
+	if (location != -1)
+		glUniform1ui(location, instanceCount);
+
+	int useHiZ = cull->useHiZ && cull->hiz != NULL;
+	GpuCull_SetInt(shader, "uUseHiZ", useHiZ);
+	if (useHiZ)
+	{
+		Texture_Bind(cull->hiz, 0);
+		GpuCull_SetInt(shader, "uHiZ", 0);
+		location = Shader_GetLocation(shader, "uHiZSize");
+		if (location != -1)
+			glUniform2f(location, (float)Texture_GetWidth(cull->hiz), (float)Texture_GetHeight(cull->hiz));
+		location = Shader_GetLocation(shader, "uHiZLevels");
+		if (location != -1)
+			glUniform1f(location, (float)cull->hizLevels);
+	}
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, transformBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, cull->boIds[GPU_CULL_INSTANCES]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, cull->boIds[GPU_CULL_VISIBLE]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, cull->boIds[GPU_CULL_TRANSFORMS]);
+	glDispatchCompute((instanceCount + GPU_CULL_GROUP_SIZE - 1) / GPU_CULL_GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+	if (useHiZ)
+		glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+uint32 GpuCull_GetVisibleBuffer(const GpuCull* cull)
+{
+	return cull->boIds[GPU_CULL_VISIBLE];
+}
+
+uint32 GpuCull_GetVisibleTransformBuffer(const GpuCull* cull)
+{
+	return cull->boIds[GPU_CULL_TRANSFORMS];
+}
\ No newline at end of file
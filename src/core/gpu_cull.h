@@ -0,0 +1,35 @@
+#ifndef __GPU_CULL_H__
+#define __GPU_CULL_H__
+
+#include "config.h"
+#include "maths.h"
+#include "texture.h"
+
+// Compute-shader instance culling. Every instance is tested against the view
+// frustum and, once a depth pyramid has been built, against the Hi-Z buffer.
+// Survivors are compacted into the visible buffer and counted straight into
+// the instanceCount of their indirect draw command. The visible buffer holds
+// their original index; their transforms are compacted alongside, so aModel
+// shaders read the visible transform buffer with the same instance offsets.
+typedef struct GpuCull GpuCull;
+
+typedef struct GpuCull_Instance
+{
+	float4 sphere;
+	uint32 command;
+	uint32 padding[3];
+} GpuCull_Instance;
+
+int GpuCull_IsSupported();
+
+GpuCull* GpuCull_Create(uint32 maxInstances);
+void GpuCull_Destroy(GpuCull* cull);
+
+void GpuCull_BuildHiZ(GpuCull* cull, const Texture* depth);
+void GpuCull_ClearHiZ(GpuCull* cull);
+
+void GpuCull_Dispatch(GpuCull* cull, const matrix4x4* viewProjection, const GpuCull_Instance* instances, uint32 instanceCount, uint32 transformBuffer, uint32 commandBuffer);
+uint32 GpuCull_GetVisibleBuffer(const GpuCull* cull);
+uint32 GpuCull_GetVisibleTransformBuffer(const GpuCull* cull);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,319 @@
+#include "gpu_particles.h"
+#include "shader.h"
+#include "vertex.h"
+#include <opengl/glad_ext.h>
+#include <string.h>
+
+#define GPU_PARTICLES_QUAD 2
+
+typedef struct GpuParticles_Vertex
+{
+	float4 positionSize;
+	float4 color;
+	float4 velocityAge;
+	float life;
+} GpuParticles_Vertex;
+
+static const char* GpuParticles_UpdateSource =
+	"#version 300 es\n"
+	"in vec4 aParticle;\n"
+	"in vec4 aParticleColor;\n"
+	"in vec4 aParticleVelocity;\n"
+	"in float aParticleLife;\n"
+	"uniform float uDeltaTime;\n"
+	"uniform vec3 uAcceleration;\n"
+	"uniform float uDrag;\n"
+	"uniform int uSpawnFirst;\n"
+	"uniform int uSpawnCount;\n"
+	"uniform int uCapacity;\n"
+	"uniform int uSeed;\n"
+	"uniform vec3 uPosition;\n"
+	"uniform vec3 uPositionVariance;\n"
+	"uniform vec3 uVelocity;\n"
+	"uniform vec3 uVelocityVariance;\n"
+	"uniform vec2 uLifetime;\n"
+	"uniform vec2 uSize;\n"
+	"uniform vec4 uStartColor;\n"
+	"uniform vec4 uEndColor;\n"
+	"out vec4 vParticle;\n"
+	"out vec4 vParticleColor;\n"
+	"out vec4 vParticleVelocity;\n"
+	"out float vParticleLife;\n"
+	"float Random(inout uint state)\n"
+	"{\n"
+	"	state ^= state >> 16; state *= 0x7feb352du;\n"
+	"	state ^= state >> 15; state *= 0x846ca68bu;\n"
+	"	state ^= state >> 16;\n"
+	"	return float(state & 0xffffffu) * (2.0 / 16777215.0) - 1.0;\n"
+	"}\n"
+	"void main()\n"
+	"{\n"
+	"	vec3 position = aParticle.xyz;\n"
+	"	vec3 velocity = aParticleVelocity.xyz;\n"
+	"	float age = aParticleVelocity.w;\n"
+	"	float life = aParticleLife;\n"
+	"	if ((gl_VertexID - uSpawnFirst + uCapacity) % uCapacity < uSpawnCount)\n"
+	"	{\n"
+	"		uint state = uint(gl_VertexID) * 0x9e3779b9u ^ uint(uSeed);\n"
+	"		position = uPosition + uPositionVariance * vec3(Random(state), Random(state), Random(state));\n"
+	"		velocity = uVelocity + uVelocityVariance * vec3(Random(state), Random(state), Random(state));\n"
+	"		life = max(uLifetime.x + uLifetime.y * Random(state), 0.001);\n"
+	"		age = 0.0;\n"
+	"	}\n"
+	"	if (age < life)\n"
+	"	{\n"
+	"		velocity = (velocity + uAcceleration * uDeltaTime) * max(1.0 - uDrag * uDeltaTime, 0.0);\n"
+	"		position += velocity * uDeltaTime;\n"
+	"		age += uDeltaTime;\n"
+	"	}\n"
+	"	float t = min(age / life, 1.0);\n"
+	"	bool alive = age < life;\n"
+	"	vParticle = vec4(position, alive ? mix(uSize.x, uSize.y, t) : 0.0);\n"
+	"	vParticleColor = alive ? mix(uStartColor, uEndColor, t) : vec4(0.0);\n"
+	"	vParticleVelocity = vec4(velocity, age);\n"
+	"	vParticleLife = life;\n"
+	"	gl_Position = vec4(0.0);\n"
+	"}\n"
+	"/*fragment shader*/\n"
+	"#version 300 es\n"
+	"precision mediump float;\n"
+	"out vec4 oColor;\n"
+	"void main()\n"
+	"{\n"
+	"	oColor = vec4(0.0);\n"
+	"}\n";
+
+static const char* GpuParticles_Varyings[] = { "vParticle", "vParticleColor", "vParticleVelocity", "vParticleLife" };
+
+struct GpuParticles
+{
+	ParticleEmitter_Desc desc;
+	uint32 capacity;
+	uint32 current;
+	uint32 spawnCursor;
+	uint32 pendingSpawns;
+	float spawnAccumulator;
+	uint32 seed;
+	Shader* updateShader;
+	GLuint boIds[3];
+	GLuint updateVaos[2];
+	GLuint drawVaos[2];
+};
+
+static void GpuParticles_SetupAttributes(GLuint buffer, GLuint divisor)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_PARTICLE);
+	glVertexAttribPointer(INSTANCE_ATTRIBUTE_PARTICLE, 4, GL_FLOAT, GL_FALSE, sizeof(GpuParticles_Vertex), (const void*)0);
+	glVertexAttribDivisor(INSTANCE_ATTRIBUTE_PARTICLE, divisor);
+	glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_PARTICLE_COLOR);
+	glVertexAttribPointer(INSTANCE_ATTRIBUTE_PARTICLE_COLOR, 4, GL_FLOAT, GL_FALSE, sizeof(GpuParticles_Vertex), (const void*)sizeof(float4));
+	glVertexAttribDivisor(INSTANCE_ATTRIBUTE_PARTICLE_COLOR, divisor);
+	if (divisor == 0)
+	{
+		glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_PARTICLE_VELOCITY);
+		glVertexAttribPointer(INSTANCE_ATTRIBUTE_PARTICLE_VELOCITY, 4, GL_FLOAT, GL_FALSE, sizeof(GpuParticles_Vertex), (const void*)(2 * sizeof(float4)));
+		glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_PARTICLE_LIFE);
+		glVertexAttribPointer(INSTANCE_ATTRIBUTE_PARTICLE_LIFE, 1, GL_FLOAT, GL_FALSE, sizeof(GpuParticles_Vertex), (const void*)(3 * sizeof(float4)));
+	}
+}
+
+static void GpuParticles_SetFloat(Shader* shader, const char* name, const float* value, uint32 componentCount)
+{
+	GLint location = Shader_GetLocation(shader, name);
+	if (location == -1)
+		return;
+	switch (componentCount)
+	{
+	case 1:
+		glUniform1fv(location, 1, value);
+		break;
+	case 2:
+		glUniform2fv(location, 1, value);
+		break;
+	case 3:
+		glUniform3fv(location, 1, value);
+		break;
+	default:
+		glUniform4fv(location, 1, value);
+		break;
+	}
+}
+
+static void GpuParticles_SetInt(Shader* shader, const char* name, GLint value)
+{
+	GLint location = Shader_GetLocation(shader, name);
+	if (location != -1)
+	{
+		glUniform1i(location, value);
+	}
+}
+
+int GpuParticles_IsSupported()
+{
+	return GLAD_GL_VERSION_3_3;
+}
+
+GpuParticles* GpuParticles_Create(const ParticleEmitter_Desc* emitter_desc, uint32 capacity)
+{
+	static const float Corners[8] = { -0.5f, -0.5f, 0.5f, -0.5f, -0.5f, 0.5f, 0.5f, 0.5f };
+
+	ASSERT(capacity > 0);
+	if (!GpuParticles_IsSupported())
+	{
+		LOG_E("GPU particles require instanced arrays\n");
+		return NULL;
+	}
+
+	Shader* updateShader = Shader_CompileFeedback(GpuParticles_UpdateSource, GpuParticles_Varyings, 4);
+	if (updateShader == NULL)
+		return NULL;
+
+	GpuParticles* particles = (GpuParticles*)malloc(sizeof(GpuParticles));
+	particles->desc = *emitter_desc;
+	particles->capacity = capacity;
+	particles->current = 0;
+	particles->spawnCursor = 0;
+	particles->pendingSpawns = 0;
+	particles->spawnAccumulator = 0.0f;
+	particles->seed = 0x2545f491u;
+	particles->updateShader = updateShader;
+
+	// A zeroed particle has age == life, i.e. it is dead until spawned.
+	GpuParticles_Vertex* vertices = (GpuParticles_Vertex*)calloc(capacity, sizeof(GpuParticles_Vertex));
+	glGenBuffers(3, particles->boIds);
+	for (uint32 i = 0; i < 2; i++)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, particles->boIds[i]);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GpuParticles_Vertex) * capacity, vertices, GL_DYNAMIC_COPY);
+	}
+	free(vertices);
+	glBindBuffer(GL_ARRAY_BUFFER, particles->boIds[GPU_PARTICLES_QUAD]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(Corners), Corners, GL_STATIC_DRAW);
+
+	glGenVertexArrays(2, particles->updateVaos);
+	glGenVertexArrays(2, particles->drawVaos);
+	for (uint32 i = 0; i < 2; i++)
+	{
+		glBindVertexArray(particles->updateVaos[i]);
+		GpuParticles_SetupAttributes(particles->boIds[i], 0);
+
+		glBindVertexArray(particles->drawVaos[i]);
+		glBindBuffer(GL_ARRAY_BUFFER, particles->boIds[GPU_PARTICLES_QUAD]);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (const void*)0);
+		GpuParticles_SetupAttributes(particles->boIds[i], 1);
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return particles;
+}
+
+void GpuParticles_Destroy(GpuParticles* particles)
+{
+	glDeleteVertexArrays(2, particles->updateVaos);
+	glDeleteVertexArrays(2, particles->drawVaos);
+	glDeleteBuffers(3, particles->boIds);
+	Shader_Destroy(particles->updateShader);
+	free(particles);
+}
+
+void GpuParticles_SetPosition(GpuParticles* particles, const float3* position)
+{
+	particles->desc.position = *position;
+}
+
+void GpuParticles_SetRate(GpuParticles* particles, float rate)
+{
+	particles->desc.rate = rate;
+}
+
+const ParticleEmitter_Desc* GpuParticles_GetDesc(const GpuParticles* particles)
+{
+	return &particles->desc;
+}
+
+uint32 GpuParticles_GetCapacity(const GpuParticles* particles)
+{
+	return particles->capacity;
+}
+
+uint32 GpuParticles_Spawn(GpuParticles* particles, uint32 count)
+{
+	uint32 available = particles->capacity - particles->pendingSpawns;
+	count = count < available ? count : available;
+	particles->pendingSpawns += count;
+	return count;
+}
+
+void GpuParticles_Update(GpuParticles* particles, float deltaTime)
+{
+	const ParticleEmitter_Desc* desc = &particles->desc;
+	particles->spawnAccumulator += desc->rate * deltaTime;
+	uint32 emitted = (uint32)particles->spawnAccumulator;
+	particles->spawnAccumulator -= (float)emitted;
+	GpuParticles_Spawn(particles, emitted);
+
+	Shader* shader = particles->updateShader;
+	Shader_Use(shader);
+	float lifetime[2] = { desc->lifetime, desc->lifetimeVariance };
+	float size[2] = { desc->startSize, desc->endSize };
+	GpuParticles_SetFloat(shader, "uDeltaTime", &deltaTime, 1);
+	GpuParticles_SetFloat(shader, "uAcceleration", desc->acceleration.data, 3);
+	GpuParticles_SetFloat(shader, "uDrag", &desc->drag, 1);
+	GpuParticles_SetFloat(shader, "uPosition", desc->position.data, 3);
+	GpuParticles_SetFloat(shader, "uPositionVariance", desc->positionVariance.data, 3);
+	GpuParticles_SetFloat(shader, "uVelocity", desc->velocity.data, 3);
+	GpuParticles_SetFloat(shader, "uVelocityVariance", desc->velocityVariance.data, 3);
+	GpuParticles_SetFloat(shader, "uLifetime", lifetime, 2);
+	GpuParticles_SetFloat(shader, "uSize", size, 2);
+	GpuParticles_SetFloat(shader, "uStartColor", desc->startColor.data, 4);
+	GpuParticles_SetFloat(shader, "uEndColor", desc->endColor.data, 4);
+	GpuParticles_SetInt(shader, "uSpawnFirst", particles->spawnCursor);
+	GpuParticles_SetInt(shader, "uSpawnCount", particles->pendingSpawns);
+	GpuParticles_SetInt(shader, "uCapacity", particles->capacity);
+	GpuParticles_SetInt(shader, "uSeed", (GLint)particles->seed);
+
+	uint32 next = particles->current ^ 1;
+	glEnable(GL_RASTERIZER_DISCARD);
+	glBindVertexArray(particles->updateVaos[particles->current]);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, particles->boIds[next]);
+	glBeginTransformFeedback(GL_POINTS);
+	glDrawArrays(GL_POINTS, 0, particles->capacity);
+	glEndTransformFeedback();
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+	glBindVertexArray(0);
+	glDisable(GL_RASTERIZER_DISCARD);
+
+	particles->current = next;
+	particles->spawnCursor = (particles->spawnCursor + particles->pendingSpawns) % particles->capacity;
+	particles->pendingSpawns = 0;
+	particles->seed = particles->seed * 1664525u + 1013904223u;
+}
+
+void GpuParticles_Draw(GpuParticles* particles, Material* material, const matrix4x4* viewProjection, const float3* cameraRight, const float3* cameraUp)
+{
+	GLboolean blend = glIsEnabled(GL_BLEND);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthMask(GL_FALSE);
+
+	Shader* shader = Material_Get_Shader(material);
+	Shader_Use(shader);
+	Material_Apply(material);
+	GLint location = Shader_GetLocation(shader, "uViewProjection");
+	if (location != -1)
+		glUniformMatrix4fv(location, 1, GL_FALSE, viewProjection->data);
+	GpuParticles_SetFloat(shader, "uCameraRight", cameraRight->data, 3);
+	GpuParticles_SetFloat(shader, "uCameraUp", cameraUp->data, 3);
+
+	// Dead particles have zero size and collapse to degenerate quads.
+	glBindVertexArray(particles->drawVaos[particles->current]);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, particles->capacity);
+	glBindVertexArray(0);
+
+	glDepthMask(GL_TRUE);
+	if (!blend)
+		glDisable(GL_BLEND);
+}
\ No newline at end of file
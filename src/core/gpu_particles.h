@@ -0,0 +1,34 @@
+#ifndef __GPU_PARTICLES_H__
+#define __GPU_PARTICLES_H__
+
+#include "config.h"
+#include "maths.h"
+#include "material.h"
+#include "particles.h"
+
+// GPU particle backend. Particles live in two vertex buffers and a transform
+// feedback pass ping-pongs between them every update, so the CPU never
+// reads them back. Spawning walks a ring over the pool: each update the
+// next rate * dt slots are respawned by the shader, the oldest particles
+// first. Size the pool for rate * lifetime particles.
+//
+// Effects are described by the same ParticleEmitter_Desc as the CPU path
+// and drawn with the same particle material, so an effect can move between
+// the two by swapping its emitter.
+typedef struct GpuParticles GpuParticles;
+
+int GpuParticles_IsSupported();
+
+GpuParticles* GpuParticles_Create(const ParticleEmitter_Desc* emitter_desc, uint32 capacity);
+void GpuParticles_Destroy(GpuParticles* particles);
+
+void GpuParticles_SetPosition(GpuParticles* particles, const float3* position);
+void GpuParticles_SetRate(GpuParticles* particles, float rate);
+const ParticleEmitter_Desc* GpuParticles_GetDesc(const GpuParticles* particles);
+uint32 GpuParticles_GetCapacity(const GpuParticles* particles);
+
+uint32 GpuParticles_Spawn(GpuParticles* particles, uint32 count);
+void GpuParticles_Update(GpuParticles* particles, float deltaTime);
+void GpuParticles_Draw(GpuParticles* particles, Material* material, const matrix4x4* viewProjection, const float3* cameraRight, const float3* cameraUp);
+
+#endif
\ No newline at end of file
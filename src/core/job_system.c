@@ -0,0 +1,536 @@
+#include "job_system.h"
+#include "thread.h"
+#include <string.h>
+
+#define JOB_MAX_CONTINUATIONS 8
+#define JOB_SYSTEM_SPIN_COUNT 64
+#define JOB_SYSTEM_YIELD_COUNT 256
+
+// Deque indices only grow and wrap around; sizes are taken as the signed
+// distance so the wrap is harmless.
+#define JOB_DEQUE_DISTANCE(from, to) ((int32)((uint32)(to) - (uint32)(from)))
+#define JOB_DEQUE_NEXT(index, amount) ((int32)((uint32)(index) + (uint32)(amount)))
+
+struct Job
+{
+	Job_Function function;
+	void* userData;
+	Job* parent;
+	volatile int32 unfinished;
+	volatile int32 pendingDependencies;
+	uint32 continuationCount;
+	int mainThread;
+	Job* continuations[JOB_MAX_CONTINUATIONS];
+	Job_RangeFunction range;
+	uint32 begin;
+	uint32 end;
+	uint32 grain;
+};
+
+// bottom is written by the owner only, top is raced for by thieves; they
+// live on separate cache lines.
+typedef struct JobSystem_Deque
+{
+	volatile int32 bottom;
+	uint8 padding0[60];
+	volatile int32 top;
+	uint8 padding1[60];
+	Job** jobs;
+	uint32 capacity;
+	uint32 mask;
+} JobSystem_Deque;
+
+typedef struct JobSystem_ThreadData
+{
+	JobSystem_Deque deque;
+	JobSystem* system;
+	Thread* thread;
+	uint32 index;
+	Job* jobs;
+	uint32 nextJob;
+	uint32 random;
+	JobSystem_Stats stats;
+	uint8 padding[64];
+} JobSystem_ThreadData;
+
+struct JobSystem
+{
+	uint32 threadCount;
+	uint32 jobsPerThread;
+	JobSystem_ThreadData* threads;
+	volatile int32 running;
+	volatile int32 sleeping;
+	Mutex* sleepMutex;
+	Condition* sleepCondition;
+	Mutex* mainMutex;
+	Job** mainJobs;
+	uint32 mainFirst;
+	uint32 mainCount;
+	volatile int32 mainPending;
+};
+
+// Index + 1 of the calling thread in the system, 0 for foreign threads.
+static THREAD_LOCAL uint32 JobSystem_threadIndex = 0;
+
+static JobSystem_ThreadData* JobSystem_GetThreadData(JobSystem* system)
+{
+	ASSERT(JobSystem_threadIndex > 0 && JobSystem_threadIndex <= system->threadCount);
+	return &system->threads[JobSystem_threadIndex - 1];
+}
+
+static int JobSystem_Push(JobSystem_Deque* deque, Job* job)
+{
+	int32 bottom = Atomic_Load(&deque->bottom);
+	int32 top = Atomic_Load(&deque->top);
+	if (JOB_DEQUE_DISTANCE(top, bottom) >= (int32)deque->capacity)
+		return 0;
+
+	deque->jobs[(uint32)bottom & deque->mask] = job;
+	Atomic_Store(&deque->bottom, JOB_DEQUE_NEXT(bottom, 1));
+	return 1;
+}
+
+static Job* JobSystem_Pop(JobSystem_Deque* deque)
+{
+	// Claim the bottom entry first, then look whether a thief got there too.
+	int32 bottom = JOB_DEQUE_NEXT(Atomic_Load(&deque->bottom), -1);
+	Atomic_Exchange(&deque->bottom, bottom);
+	int32 top = Atomic_Load(&deque->top);
+	int32 size = JOB_DEQUE_DISTANCE(top, bottom);
+	if (size < 0)
+	{
+		Atomic_Store(&deque->bottom, top);
+		return NULL;
+	}
+
+	Job* job = deque->jobs[(uint32)bottom & deque->mask];
+	if (size > 0)
+		return job;
+
+	// Last entry: race the thieves for it through top.
+	if (Atomic_CompareExchange(&deque->top, top, JOB_DEQUE_NEXT(top, 1)) != top)
+		job = NULL;
+	Atomic_Store(&deque->bottom, JOB_DEQUE_NEXT(top, 1));
+	return job;
+}
+
+static Job* JobSystem_Steal(JobSystem_Deque* deque)
+{
+	int32 top = Atomic_Load(&deque->top);
+	int32 bottom = Atomic_Load(&deque->bottom);
+	if (JOB_DEQUE_DISTANCE(top, bottom) <= 0)
+		return NULL;
+
+	Job* job = deque->jobs[(uint32)top & deque->mask];
+	if (Atomic_CompareExchange(&deque->top, top, JOB_DEQUE_NEXT(top, 1)) != top)
+		return NULL;
+	return job;
+}
+
+static int JobSystem_HasWork(JobSystem* system)
+{
+	for (uint32 i = 0; i < system->threadCount; i++)
+	{
+		JobSystem_Deque* deque = &system->threads[i].deque;
+		if (JOB_DEQUE_DISTANCE(Atomic_Load(&deque->top), Atomic_Load(&deque->bottom)) > 0)
+			return 1;
+	}
+	return 0;
+}
+
+static Job* JobSystem_PopMainThread(JobSystem* system)
+{
+	if (Atomic_Load(&system->mainPending) == 0)
+		return NULL;
+
+	Job* job = NULL;
+	Mutex_Lock(system->mainMutex);
+	if (system->mainCount > 0)
+	{
+		job = system->mainJobs[system->mainFirst];
+		system->mainFirst = (system->mainFirst + 1) & (system->jobsPerThread - 1);
+		system->mainCount--;
+		Atomic_Add(&system->mainPending, -1);
+	}
+	Mutex_Unlock(system->mainMutex);
+	return job;
+}
+
+static Job* JobSystem_GetJob(JobSystem* system, JobSystem_ThreadData* data)
+{
+	Job* job = NULL;
+	if (data->index == 0)
+	{
+		job = JobSystem_PopMainThread(system);
+		if (job != NULL)
+			return job;
+	}
+
+	job = JobSystem_Pop(&data->deque);
+	if (job != NULL || system->threadCount == 1)
+		return job;
+
+	// xorshift picks where to start looking, so thieves spread out.
+	data->random ^= data->random << 13;
+	data->random ^= data->random >> 17;
+	data->random ^= data->random << 5;
+	uint32 victim = data->random % system->threadCount;
+	for (uint32 i = 0; i < system->threadCount; i++, victim = (victim + 1) % system->threadCount)
+	{
+		if (victim == data->index)
+			continue;
+		data->stats.stealAttemptCount++;
+		job = JobSystem_Steal(&system->threads[victim].deque);
+		if (job != NULL)
+		{
+			data->stats.stolenCount++;
+			return job;
+		}
+	}
+	return NULL;
+}
+
+static void JobSystem_Execute(JobSystem* system, JobSystem_ThreadData* data, Job* job);
+
+static void JobSystem_Submit(JobSystem* system, Job* job)
+{
+	if (job->mainThread)
+	{
+		Mutex_Lock(system->mainMutex);
+		ASSERT(system->mainCount < system->jobsPerThread);
+		system->mainJobs[(system->mainFirst + system->mainCount) & (system->jobsPerThread - 1)] = job;
+		system->mainCount++;
+		Atomic_Add(&system->mainPending, 1);
+		Mutex_Unlock(system->mainMutex);
+		return;
+	}
+
+	JobSystem_ThreadData* data = JobSystem_GetThreadData(system);
+	if (!JobSystem_Push(&data->deque, job))
+	{
+		data->stats.inlineCount++;
+		JobSystem_Execute(system, data, job);
+		return;
+	}
+	if (Atomic_Load(&system->sleeping) > 0)
+	{
+		Mutex_Lock(system->sleepMutex);
+		Condition_Signal(system->sleepCondition);
+		Mutex_Unlock(system->sleepMutex);
+	}
+}
+
+static void JobSystem_Release(JobSystem* system, Job* job)
+{
+	if (Atomic_Add(&job->pendingDependencies, -1) == 0)
+		JobSystem_Submit(system, job);
+}
+
+static void JobSystem_Finish(JobSystem* system, Job* job)
+{
+	// Once unfinished drops to zero the job belongs to its waiter, so
+	// everything needed afterwards is read before.
+	Job* parent = job->parent;
+	uint32 continuationCount = job->continuationCount;
+	Job* continuations[JOB_MAX_CONTINUATIONS];
+	for (uint32 i = 0; i < continuationCount; i++)
+	{
+		continuations[i] = job->continuations[i];
+	}
+	if (Atomic_Add(&job->unfinished, -1) != 0)
+		return;
+
+	for (uint32 i = 0; i < continuationCount; i++)
+	{
+		JobSystem_Release(system, continuations[i]);
+	}
+	if (parent != NULL)
+		JobSystem_Finish(system, parent);
+}
+
+static void JobSystem_Execute(JobSystem* system, JobSystem_ThreadData* data, Job* job)
+{
+	job->function(system, job, job->userData);
+	data->stats.executedCount++;
+	JobSystem_Finish(system, job);
+}
+
+static void JobSystem_WorkerMain(void* userData)
+{
+	JobSystem_ThreadData* data = (JobSystem_ThreadData*)userData;
+	JobSystem* system = data->system;
+	JobSystem_threadIndex = data->index + 1;
+
+	// Spin briefly, then yield, then sleep until a push wakes us.
+	uint32 idle = 0;
+	while (Atomic_Load(&system->running))
+	{
+		Job* job = JobSystem_GetJob(system, data);
+		if (job != NULL)
+		{
+			JobSystem_Execute(system, data, job);
+			idle = 0;
+			continue;
+		}
+
+		idle++;
+		if (idle < JOB_SYSTEM_SPIN_COUNT)
+		{
+			Thread_Pause();
+			continue;
+		}
+		if (idle < JOB_SYSTEM_YIELD_COUNT)
+		{
+			Thread_Yield();
+			continue;
+		}
+
+		Mutex_Lock(system->sleepMutex);
+		Atomic_Add(&system->sleeping, 1);
+		while (Atomic_Load(&system->running) && !JobSystem_HasWork(system))
+		{
+			data->stats.sleepCount++;
+			Condition_Wait(system->sleepCondition, system->sleepMutex);
+		}
+		Atomic_Add(&system->sleeping, -1);
+		Mutex_Unlock(system->sleepMutex);
+		idle = 0;
+	}
+}
+
+JobSystem* JobSystem_Create(const JobSystem_Desc* job_system_desc)
+{
+	ASSERT(job_system_desc != NULL && JobSystem_threadIndex == 0);
+
+	JobSystem* system = (JobSystem*)malloc(sizeof(JobSystem));
+	memset(system, 0, sizeof(JobSystem));
+	uint32 workerCount = job_system_desc->workerCount;
+	if (workerCount == 0)
+		workerCount = Thread_GetProcessorCount() - 1;
+	system->threadCount = workerCount + 1;
+	system->jobsPerThread = 64;
+	while (system->jobsPerThread < job_system_desc->jobsPerThread)
+	{
+		system->jobsPerThread <<= 1;
+	}
+	system->running = 1;
+	system->sleepMutex = Mutex_Create();
+	system->sleepCondition = Condition_Create();
+	system->mainMutex = Mutex_Create();
+	system->mainJobs = (Job**)malloc(sizeof(Job*) * system->jobsPerThread);
+
+	system->threads = (JobSystem_ThreadData*)malloc(sizeof(JobSystem_ThreadData) * system->threadCount);
+	memset(system->threads, 0, sizeof(JobSystem_ThreadData) * system->threadCount);
+	for (uint32 i = 0; i < system->threadCount; i++)
+	{
+		JobSystem_ThreadData* data = &system->threads[i];
+		data->system = system;
+		data->index = i;
+		data->random = 0x9E3779B9u * (i + 1);
+		data->deque.capacity = system->jobsPerThread;
+		data->deque.mask = system->jobsPerThread - 1;
+		data->deque.jobs = (Job**)malloc(sizeof(Job*) * system->jobsPerThread);
+		data->jobs = (Job*)malloc(sizeof(Job) * system->jobsPerThread);
+		memset(data->jobs, 0, sizeof(Job) * system->jobsPerThread);
+	}
+
+	JobSystem_threadIndex = 1;
+	for (uint32 i = 1; i < system->threadCount; i++)
+	{
+		// A worker that failed to start leaves an empty deque behind, which
+		// costs the thieves a glance and nothing else.
+		system->threads[i].thread = Thread_Create(JobSystem_WorkerMain, &system->threads[i]);
+		if (system->threads[i].thread == NULL)
+			LOG_W("Job system runs without worker %u\n", i);
+	}
+	return system;
+}
+
+void JobSystem_Destroy(JobSystem* system)
+{
+	ASSERT(JobSystem_threadIndex == 1);
+
+	Mutex_Lock(system->sleepMutex);
+	Atomic_Store(&system->running, 0);
+	Condition_Broadcast(system->sleepCondition);
+	Mutex_Unlock(system->sleepMutex);
+	for (uint32 i = 1; i < system->threadCount; i++)
+	{
+		if (system->threads[i].thread != NULL)
+			Thread_Join(system->threads[i].thread);
+	}
+	JobSystem_threadIndex = 0;
+
+	for (uint32 i = 0; i < system->threadCount; i++)
+	{
+		free(system->threads[i].deque.jobs);
+		free(system->threads[i].jobs);
+	}
+	free(system->threads);
+	free(system->mainJobs);
+	Mutex_Destroy(system->mainMutex);
+	Condition_Destroy(system->sleepCondition);
+	Mutex_Destroy(system->sleepMutex);
+	free(system);
+}
+
+uint32 JobSystem_GetThreadCount(const JobSystem* system)
+{
+	return system->threadCount;
+}
+
+uint32 JobSystem_GetThreadIndex(const JobSystem* system)
+{
+	ASSERT(JobSystem_threadIndex > 0 && JobSystem_threadIndex <= system->threadCount);
+	return JobSystem_threadIndex - 1;
+}
+
+Job* JobSystem_CreateJob(JobSystem* system, Job_Function function, void* userData)
+{
+	JobSystem_ThreadData* data = JobSystem_GetThreadData(system);
+	Job* job = &data->jobs[data->nextJob++ & (system->jobsPerThread - 1)];
+	// Still in flight: this thread has more than jobsPerThread jobs going.
+	ASSERT(Atomic_Load(&job->unfinished) == 0);
+
+	job->function = function;
+	job->userData = userData;
+	job->parent = NULL;
+	job->continuationCount = 0;
+	job->mainThread = 0;
+	job->range = NULL;
+	Atomic_Store(&job->pendingDependencies, 1);
+	Atomic_Store(&job->unfinished, 1);
+	return job;
+}
+
+Job* JobSystem_CreateChild(JobSystem* system, Job* parent, Job_Function function, void* userData)
+{
+	ASSERT(parent != NULL && Atomic_Load(&parent->unfinished) > 0);
+	Atomic_Add(&parent->unfinished, 1);
+	Job* job = JobSystem_CreateJob(system, function, userData);
+	job->parent = parent;
+	return job;
+}
+
+static void JobSystem_ParallelForJob(JobSystem* system, Job* job, void* userData)
+{
+	uint32 begin = job->begin;
+	uint32 end = job->end;
+	while (end - begin > job->grain)
+	{
+		uint32 middle = begin + (end - begin) / 2;
+		Job* child = JobSystem_CreateChild(system, job, JobSystem_ParallelForJob, userData);
+		child->range = job->range;
+		child->begin = middle;
+		child->end = end;
+		child->grain = job->grain;
+		JobSystem_Run(system, child);
+		end = middle;
+	}
+	if (end > begin)
+		job->range(userData, begin, end);
+}
+
+Job* JobSystem_CreateParallelFor(JobSystem* system, uint32 count, uint32 minGrain, Job_RangeFunction function, void* userData)
+{
+	ASSERT(function != NULL);
+	uint32 grain = count;
+	if (system->threadCount > 1)
+		grain = count / (system->threadCount * 4);
+	if (grain < minGrain)
+		grain = minGrain;
+	if (grain == 0)
+		grain = 1;
+
+	Job* job = JobSystem_CreateJob(system, JobSystem_ParallelForJob, userData);
+	job->range = function;
+	job->begin = 0;
+	job->end = count;
+	job->grain = grain;
+	return job;
+}
+
+void Job_AddDependency(Job* job, Job* dependency)
+{
+	ASSERT(dependency->continuationCount < JOB_MAX_CONTINUATIONS);
+	dependency->continuations[dependency->continuationCount++] = job;
+	Atomic_Add(&job->pendingDependencies, 1);
+}
+
+void Job_SetMainThread(Job* job)
+{
+	job->mainThread = 1;
+}
+
+void JobSystem_Run(JobSystem* system, Job* job)
+{
+	JobSystem_Release(system, job);
+}
+
+void JobSystem_Wait(JobSystem* system, Job* job)
+{
+	JobSystem_ThreadData* data = JobSystem_GetThreadData(system);
+	uint32 idle = 0;
+	while (Atomic_Load(&job->unfinished) > 0)
+	{
+		Job* next = JobSystem_GetJob(system, data);
+		if (next != NULL)
+		{
+			JobSystem_Execute(system, data, next);
+			idle = 0;
+		}
+		else if (++idle < JOB_SYSTEM_SPIN_COUNT)
+		{
+			Thread_Pause();
+		}
+		else
+		{
+			Thread_Yield();
+		}
+	}
+}
+
+int Job_IsFinished(const Job* job)
+{
+	return Atomic_Load(&job->unfinished) == 0;
+}
+
+void JobSystem_ParallelFor(JobSystem* system, uint32 count, uint32 minGrain, Job_RangeFunction function, void* userData)
+{
+	Job* job = JobSystem_CreateParallelFor(system, count, minGrain, function, userData);
+	JobSystem_Run(system, job);
+	JobSystem_Wait(system, job);
+}
+
+void JobSystem_RunMainThreadJobs(JobSystem* system)
+{
+	JobSystem_ThreadData* data = JobSystem_GetThreadData(system);
+	ASSERT(data->index == 0);
+	Job* job;
+	while ((job = JobSystem_PopMainThread(system)) != NULL)
+	{
+		JobSystem_Execute(system, data, job);
+	}
+}
+
+void JobSystem_GetStats(const JobSystem* system, JobSystem_Stats* stats)
+{
+	memset(stats, 0, sizeof(JobSystem_Stats));
+	for (uint32 i = 0; i < system->threadCount; i++)
+	{
+		const JobSystem_Stats* local = &system->threads[i].stats;
+		stats->executedCount += local->executedCount;
+		stats->stolenCount += local->stolenCount;
+		stats->stealAttemptCount += local->stealAttemptCount;
+		stats->inlineCount += local->inlineCount;
+		stats->sleepCount += local->sleepCount;
+	}
+}
+
+void JobSystem_ResetStats(JobSystem* system)
+{
+	for (uint32 i = 0; i < system->threadCount; i++)
+	{
+		memset(&system->threads[i].stats, 0, sizeof(JobSystem_Stats));
+	}
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#ifndef __JOB_SYSTEM_H__
+#define __JOB_SYSTEM_H__
+
+#include "config.h"
+
+// Work-stealing job scheduler. Thread 0 is the thread that created the
+// system, the others are workers; every thread owns a fixed-size
+// Chase-Lev deque it pushes to and pops from at the bottom (newest first,
+// cache-warm), while idle threads steal from the top of random victims.
+// Only threads of the system may create, run or wait for jobs.
+//
+// A job finishes when its function returned and all its children
+// finished, so a job can fan out and its creator waits on the job alone.
+// Job_AddDependency holds a job back until another one finished; both must
+// be unsubmitted when the edge is added. Jobs flagged with
+// Job_SetMainThread never leave thread 0 (GL work), they run inside
+// JobSystem_Wait or JobSystem_RunMainThreadJobs there.
+//
+// Waiting never blocks: the waiting thread executes other jobs until its
+// job finished, which gives the same throughput as switching fibers without
+// their platform code, as long as jobs do not wait on work that can only
+// run on a thread further down the same stack.
+//
+// Job memory comes from a per-thread ring of desc.jobsPerThread entries
+// that is reused without freeing, so a thread must not have more jobs in
+// flight than that. A job stays valid until it finished and is reused once
+// the ring wrapped around. When a deque is full the job runs right away.
+typedef struct JobSystem JobSystem;
+typedef struct Job Job;
+
+typedef void (*Job_Function)(JobSystem* system, Job* job, void* userData);
+typedef void (*Job_RangeFunction)(void* userData, uint32 begin, uint32 end);
+
+typedef struct JobSystem_Desc
+{
+	// 0 uses one worker per processor besides the calling thread.
+	uint32 workerCount;
+	uint32 jobsPerThread;
+} JobSystem_Desc;
+
+typedef struct JobSystem_Stats
+{
+	uint32 executedCount;
+	uint32 stolenCount;
+	uint32 stealAttemptCount;
+	uint32 inlineCount;
+	uint32 sleepCount;
+} JobSystem_Stats;
+
+JobSystem* JobSystem_Create(const JobSystem_Desc* job_system_desc);
+void JobSystem_Destroy(JobSystem* system);
+uint32 JobSystem_GetThreadCount(const JobSystem* system);
+// Index of the calling thread, 0 for the thread that created the system.
+uint32 JobSystem_GetThreadIndex(const JobSystem* system);
+
+Job* JobSystem_CreateJob(JobSystem* system, Job_Function function, void* userData);
+// The parent must not have finished yet, which holds whenever the child is
+// created from inside the parent's function.
+Job* JobSystem_CreateChild(JobSystem* system, Job* parent, Job_Function function, void* userData);
+// Splits [0, count) into ranges of at least minGrain indices. The grain
+// adapts to the thread count so that every thread gets several ranges to
+// balance with; ranges are split in halves lazily, so thieves take the
+// biggest pieces first.
+Job* JobSystem_CreateParallelFor(JobSystem* system, uint32 count, uint32 minGrain, Job_RangeFunction function, void* userData);
+void Job_AddDependency(Job* job, Job* dependency);
+void Job_SetMainThread(Job* job);
+
+void JobSystem_Run(JobSystem* system, Job* job);
+void JobSystem_Wait(JobSystem* system, Job* job);
+int Job_IsFinished(const Job* job);
+// Runs, waits for and returns; the common case for data-parallel loops.
+void JobSystem_ParallelFor(JobSystem* system, uint32 count, uint32 minGrain, Job_RangeFunction function, void* userData);
+// Thread 0 only: runs the main-thread jobs that are ready.
+void JobSystem_RunMainThreadJobs(JobSystem* system);
+
+// Sums the per-thread counters; only exact while no job is running.
+void JobSystem_GetStats(const JobSystem* system, JobSystem_Stats* stats);
+void JobSystem_ResetStats(JobSystem* system);
+
+#endif
\ No newline at end of file
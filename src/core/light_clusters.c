@@ -0,0 +1,417 @@
+#include "light_clusters.h"
+#include "texture.h"
+#include "simd.h"
+#include "timer.h"
+#include <opengl/glad.h>
+#include <math.h>
+#include <string.h>
+
+#define LIGHT_CLUSTERS_INDEX_WIDTH 1024
+#define LIGHT_CLUSTERS_COUNT_BITS 8
+#define LIGHT_CLUSTERS_JOB_GRAIN 64
+
+typedef struct LightClusters_Bounds
+{
+	uint16 minX, maxX;
+	uint16 minY, maxY;
+	uint16 minZ, maxZ;
+	uint32 visible;
+} LightClusters_Bounds;
+
+struct LightClusters
+{
+	LightClusters_Desc desc;
+	LightClusters_Camera camera;
+	uint32 clusterCount;
+	float sliceScale;
+	float sliceBias;
+
+	float* planesX[2];
+	float* planesY[2];
+	uint32 planeCountX;
+	uint32 planeCountY;
+
+	const PointLight* lights;
+	uint32 lightCount;
+	LightClusters_Bounds* bounds;
+
+	uint16* clusterLights;
+	uint8* clusterCounts;
+	uint32* sliceOverflows;
+
+	uint32* grid;
+	uint16* indices;
+	uint32 indexCount;
+	float4* lightData;
+
+	Texture* gridTexture;
+	Texture* indexTexture;
+	Texture* lightTexture;
+
+	double beginTime;
+	LightClusters_Stats stats;
+};
+
+static const uint32 LightClusters_BitCounts[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+static Texture* LightClusters_CreateTexture(Texture_Format format, uint32 width, uint32 height)
+{
+	Texture_Desc desc =
+	{
+		TEXTURE_2D,
+		format,
+		width,
+		height,
+		1,
+		1,
+		FILTER_POINT,
+		FILTER_POINT,
+		WRAP_CLAMP,
+		WRAP_CLAMP
+	};
+	Texture* texture = Texture_Create(&desc);
+	Texture_SetData(texture, 0, NULL);
+	return texture;
+}
+
+static float* LightClusters_AllocatePlanes(uint32 count)
+{
+	float* planes = (float*)malloc(sizeof(float) * count);
+	memset(planes, 0, sizeof(float) * count);
+	return planes;
+}
+
+LightClusters* LightClusters_Create(const LightClusters_Desc* light_clusters_desc)
+{
+	ASSERT(light_clusters_desc->maxLightsPerCluster < (1 << LIGHT_CLUSTERS_COUNT_BITS));
+	ASSERT(light_clusters_desc->maxLights <= 0xffff);
+
+	LightClusters* clusters = (LightClusters*)malloc(sizeof(LightClusters));
+	memset(clusters, 0, sizeof(LightClusters));
+	clusters->desc = *light_clusters_desc;
+	clusters->clusterCount = light_clusters_desc->tilesX * light_clusters_desc->tilesY * light_clusters_desc->slices;
+
+	// Internal tile boundaries only, padded with (0, 0) planes which never
+	// count as left or right of a light.
+	clusters->planeCountX = (light_clusters_desc->tilesX - 1 + 3) & ~3u;
+	clusters->planeCountY = (light_clusters_desc->tilesY - 1 + 3) & ~3u;
+	for (uint32 i = 0; i < 2; i++)
+	{
+		clusters->planesX[i] = LightClusters_AllocatePlanes(clusters->planeCountX);
+		clusters->planesY[i] = LightClusters_AllocatePlanes(clusters->planeCountY);
+	}
+
+	clusters->bounds = (LightClusters_Bounds*)malloc(sizeof(LightClusters_Bounds) * light_clusters_desc->maxLights);
+	clusters->clusterLights = (uint16*)malloc(sizeof(uint16) * clusters->clusterCount * light_clusters_desc->maxLightsPerCluster);
+	clusters->clusterCounts = (uint8*)malloc(clusters->clusterCount);
+	clusters->sliceOverflows = (uint32*)malloc(sizeof(uint32) * light_clusters_desc->slices);
+	clusters->grid = (uint32*)malloc(sizeof(uint32) * clusters->clusterCount);
+
+	uint32 indexCapacity = clusters->clusterCount * light_clusters_desc->maxLightsPerCluster;
+	uint32 indexRows = (indexCapacity + LIGHT_CLUSTERS_INDEX_WIDTH - 1) / LIGHT_CLUSTERS_INDEX_WIDTH;
+	clusters->indices = (uint16*)malloc(sizeof(uint16) * indexRows * LIGHT_CLUSTERS_INDEX_WIDTH);
+	clusters->lightData = (float4*)malloc(sizeof(float4) * 2 * light_clusters_desc->maxLights);
+
+	clusters->gridTexture = LightClusters_CreateTexture(TEXTURE_R_32UI, light_clusters_desc->tilesX * light_clusters_desc->tilesY, light_clusters_desc->slices);
+	clusters->indexTexture = LightClusters_CreateTexture(TEXTURE_R_16UI, LIGHT_CLUSTERS_INDEX_WIDTH, indexRows);
+	clusters->lightTexture = LightClusters_CreateTexture(TEXTURE_RGBA_32F, 2, light_clusters_desc->maxLights);
+	return clusters;
+}
+
+void LightClusters_Destroy(LightClusters* clusters)
+{
+	Texture_Destroy(clusters->gridTexture);
+	Texture_Destroy(clusters->indexTexture);
+	Texture_Destroy(clusters->lightTexture);
+	for (uint32 i = 0; i < 2; i++)
+	{
+		free(clusters->planesX[i]);
+		free(clusters->planesY[i]);
+	}
+	free(clusters->bounds);
+	free(clusters->clusterLights);
+	free(clusters->clusterCounts);
+	free(clusters->sliceOverflows);
+	free(clusters->grid);
+	free(clusters->indices);
+	free(clusters->lightData);
+	free(clusters);
+}
+
+static void LightClusters_SetupPlanes(float** planes, uint32 tiles, float tangent)
+{
+	// Boundary k through the eye, at ndc b: x + b * tangent * z = 0, with
+	// positive distances on the side of larger ndc.
+	for (uint32 k = 1; k < tiles; k++)
+	{
+		float b = -1.0f + 2.0f * k / tiles;
+		float slope = b * tangent;
+		float inverseLength = 1.0f / sqrtf(1.0f + slope * slope);
+		planes[0][k - 1] = inverseLength;
+		planes[1][k - 1] = slope * inverseLength;
+	}
+}
+
+void LightClusters_Begin(LightClusters* clusters, const LightClusters_Camera* camera, const PointLight* lights, uint32 lightCount)
+{
+	clusters->beginTime = Timer_GetMilliseconds();
+	if (lightCount > clusters->desc.maxLights)
+	{
+		LOG_W("Too many point lights, dropping %u\n", lightCount - clusters->desc.maxLights);
+		lightCount = clusters->desc.maxLights;
+	}
+
+	clusters->camera = *camera;
+	clusters->lights = lights;
+	clusters->lightCount = lightCount;
+
+	float tangentY = tanf(camera->fovY * 0.5f);
+	LightClusters_SetupPlanes(clusters->planesX, clusters->desc.tilesX, tangentY * camera->aspect);
+	LightClusters_SetupPlanes(clusters->planesY, clusters->desc.tilesY, tangentY);
+
+	float logRange = logf(camera->farPlane / camera->nearPlane);
+	clusters->sliceScale = clusters->desc.slices / logRange;
+	clusters->sliceBias = -logf(camera->nearPlane) * clusters->sliceScale;
+}
+
+static void LightClusters_CountSides(const float* const* planes, uint32 planeCount, float a, float z, float radius, uint32* right, uint32* left)
+{
+	uint32 countRight = 0;
+	uint32 countLeft = 0;
+#ifdef SIMD_SSE
+	__m128 va = _mm_set1_ps(a);
+	__m128 vz = _mm_set1_ps(z);
+	__m128 vr = _mm_set1_ps(radius);
+	__m128 vnr = _mm_set1_ps(-radius);
+	for (uint32 k = 0; k < planeCount; k += 4)
+	{
+		__m128 distance = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(planes[0] + k), va), _mm_mul_ps(_mm_loadu_ps(planes[1] + k), vz));
+		countRight += LightClusters_BitCounts[_mm_movemask_ps(_mm_cmpgt_ps(distance, vr))];
+		countLeft += LightClusters_BitCounts[_mm_movemask_ps(_mm_cmplt_ps(distance, vnr))];
+	}
+#else
+	for (uint32 k = 0; k < planeCount; k++)
+	{
+		float distance = planes[0][k] * a + planes[1][k] * z;
+		countRight += distance > radius;
+		countLeft += distance < -radius;
+	}
+#endif
+	*right = countRight;
+	*left = countLeft;
+}
+
+static uint32 LightClusters_GetSlice(const LightClusters* clusters, float depth)
+{
+	if (depth <= clusters->camera.nearPlane)
+		return 0;
+	float slice = logf(depth) * clusters->sliceScale + clusters->sliceBias;
+	if (slice >= (float)(clusters->desc.slices - 1))
+		return clusters->desc.slices - 1;
+	return slice > 0.0f ? (uint32)slice : 0;
+}
+
+void LightClusters_PrepareLights(LightClusters* clusters, uint32 first, uint32 count)
+{
+	const matrix4x4* view = &clusters->camera.view;
+	uint32 tilesX = clusters->desc.tilesX;
+	uint32 tilesY = clusters->desc.tilesY;
+	for (uint32 i = first; i < first + count && i < clusters->lightCount; i++)
+	{
+		const PointLight* light = &clusters->lights[i];
+		LightClusters_Bounds* bounds = &clusters->bounds[i];
+		float4 position;
+		Matrix4x4_TransformPoint(view, &light->position, &position);
+		float depth = -position.z;
+		float radius = light->radius;
+
+		float4* data = &clusters->lightData[i * 2];
+		data[0].x = light->position.x;
+		data[0].y = light->position.y;
+		data[0].z = light->position.z;
+		data[0].w = radius;
+		data[1].x = light->color.r * light->intensity;
+		data[1].y = light->color.g * light->intensity;
+		data[1].z = light->color.b * light->intensity;
+		data[1].w = 0.0f;
+
+		bounds->visible = depth + radius >= clusters->camera.nearPlane && depth - radius <= clusters->camera.farPlane;
+		if (!bounds->visible)
+			continue;
+
+		bounds->minZ = (uint16)LightClusters_GetSlice(clusters, depth - radius);
+		bounds->maxZ = (uint16)LightClusters_GetSlice(clusters, depth + radius);
+		if (depth <= radius)
+		{
+			// The sphere reaches behind the eye, where the tile planes flip.
+			bounds->minX = 0;
+			bounds->maxX = (uint16)(tilesX - 1);
+			bounds->minY = 0;
+			bounds->maxY = (uint16)(tilesY - 1);
+			continue;
+		}
+
+		uint32 right, left;
+		LightClusters_CountSides((const float* const*)clusters->planesX, clusters->planeCountX, position.x, position.z, radius, &right, &left);
+		bounds->minX = (uint16)right;
+		bounds->maxX = (uint16)(tilesX - 1 - left);
+		LightClusters_CountSides((const float* const*)clusters->planesY, clusters->planeCountY, position.y, position.z, radius, &right, &left);
+		bounds->minY = (uint16)right;
+		bounds->maxY = (uint16)(tilesY - 1 - left);
+		bounds->visible = bounds->minX <= bounds->maxX && bounds->minY <= bounds->maxY;
+	}
+}
+
+void LightClusters_BinSlices(LightClusters* clusters, uint32 firstSlice, uint32 sliceCount)
+{
+	uint32 tilesX = clusters->desc.tilesX;
+	uint32 tilesY = clusters->desc.tilesY;
+	uint32 maxPerCluster = clusters->desc.maxLightsPerCluster;
+	uint32 lastSlice = firstSlice + sliceCount < clusters->desc.slices ? firstSlice + sliceCount : clusters->desc.slices;
+	if (firstSlice >= lastSlice)
+		return;
+
+	memset(clusters->clusterCounts + firstSlice * tilesX * tilesY, 0, (lastSlice - firstSlice) * tilesX * tilesY);
+	for (uint32 slice = firstSlice; slice < lastSlice; slice++)
+	{
+		uint32 overflow = 0;
+		for (uint32 i = 0; i < clusters->lightCount; i++)
+		{
+			const LightClusters_Bounds* bounds = &clusters->bounds[i];
+			if (!bounds->visible || slice < bounds->minZ || slice > bounds->maxZ)
+				continue;
+
+			for (uint32 y = bounds->minY; y <= bounds->maxY; y++)
+			{
+				uint32 cluster = (slice * tilesY + y) * tilesX + bounds->minX;
+				for (uint32 x = bounds->minX; x <= bounds->maxX; x++, cluster++)
+				{
+					uint8* count = &clusters->clusterCounts[cluster];
+					if (*count < maxPerCluster)
+						clusters->clusterLights[cluster * maxPerCluster + (*count)++] = (uint16)i;
+					else
+						overflow++;
+				}
+			}
+		}
+		clusters->sliceOverflows[slice] = overflow;
+	}
+}
+
+void LightClusters_Finish(LightClusters* clusters)
+{
+	uint32 maxPerCluster = clusters->desc.maxLightsPerCluster;
+	uint32 offset = 0;
+	uint32 occupied = 0;
+	uint32 largest = 0;
+	for (uint32 cluster = 0; cluster < clusters->clusterCount; cluster++)
+	{
+		uint32 count = clusters->clusterCounts[cluster];
+		clusters->grid[cluster] = (offset << LIGHT_CLUSTERS_COUNT_BITS) | count;
+		memcpy(clusters->indices + offset, clusters->clusterLights + cluster * maxPerCluster, sizeof(uint16) * count);
+		offset += count;
+		occupied += count > 0;
+		largest = count > largest ? count : largest;
+	}
+	clusters->indexCount = offset;
+
+	uint32 overflow = 0;
+	for (uint32 slice = 0; slice < clusters->desc.slices; slice++)
+	{
+		overflow += clusters->sliceOverflows[slice];
+	}
+	if (overflow > 0)
+	{
+		LOG_W("%u light assignments did not fit into their clusters\n", overflow);
+	}
+
+	LightClusters_Stats* stats = &clusters->stats;
+	stats->binTime = Timer_GetMilliseconds() - clusters->beginTime;
+	stats->lightCount = clusters->lightCount;
+	stats->indexCount = offset;
+	stats->occupiedClusters = occupied;
+	stats->overflowCount = overflow;
+	stats->averageLightsPerCluster = occupied > 0 ? (float)offset / occupied : 0.0f;
+	stats->maxLightsPerCluster = largest;
+
+	// Only the rows in use are uploaded; the tail of the last one is padding.
+	uint32 rows = (offset + LIGHT_CLUSTERS_INDEX_WIDTH - 1) / LIGHT_CLUSTERS_INDEX_WIDTH;
+	memset(clusters->indices + offset, 0, sizeof(uint16) * (rows * LIGHT_CLUSTERS_INDEX_WIDTH - offset));
+	Texture_SetData(clusters->gridTexture, 0, clusters->grid);
+	if (rows > 0)
+		Texture_SetSubData(clusters->indexTexture, 0, 0, 0, 0, LIGHT_CLUSTERS_INDEX_WIDTH, rows, clusters->indices);
+	if (clusters->lightCount > 0)
+		Texture_SetSubData(clusters->lightTexture, 0, 0, 0, 0, 2, clusters->lightCount, clusters->lightData);
+}
+
+void LightClusters_Build(LightClusters* clusters, const LightClusters_Camera* camera, const PointLight* lights, uint32 lightCount)
+{
+	LightClusters_Begin(clusters, camera, lights, lightCount);
+	LightClusters_PrepareLights(clusters, 0, clusters->lightCount);
+	LightClusters_BinSlices(clusters, 0, clusters->desc.slices);
+	LightClusters_Finish(clusters);
+}
+
+static void LightClusters_PrepareRange(void* userData, uint32 begin, uint32 end)
+{
+	LightClusters_PrepareLights((LightClusters*)userData, begin, end - begin);
+}
+
+static void LightClusters_BinRange(void* userData, uint32 begin, uint32 end)
+{
+	LightClusters_BinSlices((LightClusters*)userData, begin, end - begin);
+}
+
+void LightClusters_BuildJobs(LightClusters* clusters, JobSystem* jobs, const LightClusters_Camera* camera, const PointLight* lights, uint32 lightCount)
+{
+	if (jobs == NULL)
+	{
+		LightClusters_Build(clusters, camera, lights, lightCount);
+		return;
+	}
+
+	LightClusters_Begin(clusters, camera, lights, lightCount);
+	JobSystem_ParallelFor(jobs, clusters->lightCount, LIGHT_CLUSTERS_JOB_GRAIN, LightClusters_PrepareRange, clusters);
+	JobSystem_ParallelFor(jobs, clusters->desc.slices, 1, LightClusters_BinRange, clusters);
+	LightClusters_Finish(clusters);
+}
+
+void LightClusters_Bind(const LightClusters* clusters, Shader* shader, uint32 firstUnit)
+{
+	Shader_Use(shader);
+	GLint location = Shader_GetLocation(shader, "uClusterGrid");
+	if (location != -1)
+		glUniform1i(location, firstUnit);
+	location = Shader_GetLocation(shader, "uClusterLights");
+	if (location != -1)
+		glUniform1i(location, firstUnit + 1);
+	location = Shader_GetLocation(shader, "uLightData");
+	if (location != -1)
+		glUniform1i(location, firstUnit + 2);
+	location = Shader_GetLocation(shader, "uClusterTiles");
+	if (location != -1)
+		glUniform3i(location, clusters->desc.tilesX, clusters->desc.tilesY, clusters->desc.slices);
+	location = Shader_GetLocation(shader, "uClusterScale");
+	if (location != -1)
+	{
+		glUniform4f(location, (float)clusters->desc.tilesX / clusters->camera.width, (float)clusters->desc.tilesY / clusters->camera.height,
+			clusters->sliceScale, clusters->sliceBias);
+	}
+	location = Shader_GetLocation(shader, "uView");
+	if (location != -1)
+		glUniformMatrix4fv(location, 1, GL_FALSE, clusters->camera.view.data);
+
+	Texture_Bind(clusters->gridTexture, firstUnit);
+	Texture_Bind(clusters->indexTexture, firstUnit + 1);
+	Texture_Bind(clusters->lightTexture, firstUnit + 2);
+}
+
+uint32 LightClusters_GetLightCount(const LightClusters* clusters)
+{
+	return clusters->lightCount;
+}
+
+void LightClusters_GetStats(const LightClusters* clusters, LightClusters_Stats* stats)
+{
+	*stats = clusters->stats;
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#ifndef __LIGHT_CLUSTERS_H__
+#define __LIGHT_CLUSTERS_H__
+
+#include "config.h"
+#include "maths.h"
+#include "shader.h"
+#include "job_system.h"
+
+// Clustered forward lighting. Point lights are binned into a froxel grid of
+// screen tiles and exponential depth slices every frame; fragments look up
+// their cluster and loop over its lights only. The cluster table, light
+// index list and light data are uploaded to integer and float textures read
+// with texelFetch, which GLSL ES 3.00 supports where buffer textures are not.
+//
+// LightClusters_Build does a whole frame. The steps in between are split so
+// worker threads can run PrepareLights over disjoint light ranges, then
+// BinSlices over disjoint slice ranges; LightClusters_BuildJobs does that on
+// a job system.
+typedef struct LightClusters LightClusters;
+
+typedef struct PointLight
+{
+	float3 position;
+	float radius;
+	float3 color;
+	float intensity;
+} PointLight;
+
+typedef struct LightClusters_Desc
+{
+	uint32 tilesX;
+	uint32 tilesY;
+	uint32 slices;
+	uint32 maxLights;
+	uint32 maxLightsPerCluster;
+} LightClusters_Desc;
+
+typedef struct LightClusters_Camera
+{
+	matrix4x4 view;
+	float fovY;
+	float aspect;
+	float nearPlane;
+	float farPlane;
+	uint32 width;
+	uint32 height;
+} LightClusters_Camera;
+
+typedef struct LightClusters_Stats
+{
+	double binTime;
+	uint32 lightCount;
+	uint32 indexCount;
+	uint32 occupiedClusters;
+	uint32 overflowCount;
+	float averageLightsPerCluster;
+	uint32 maxLightsPerCluster;
+} LightClusters_Stats;
+
+LightClusters* LightClusters_Create(const LightClusters_Desc* light_clusters_desc);
+void LightClusters_Destroy(LightClusters* clusters);
+
+void LightClusters_Build(LightClusters* clusters, const LightClusters_Camera* camera, const PointLight* lights, uint32 lightCount);
+// Finish uploads the textures, so the calling thread must own the GL context
+// as well as belong to the jobs (NULL for Build).
+void LightClusters_BuildJobs(LightClusters* clusters, JobSystem* jobs, const LightClusters_Camera* camera, const PointLight* lights, uint32 lightCount);
+
+void LightClusters_Begin(LightClusters* clusters, const LightClusters_Camera* camera, const PointLight* lights, uint32 lightCount);
+void LightClusters_PrepareLights(LightClusters* clusters, uint32 first, uint32 count);
+void LightClusters_BinSlices(LightClusters* clusters, uint32 firstSlice, uint32 sliceCount);
+void LightClusters_Finish(LightClusters* clusters);
+
+void LightClusters_Bind(const LightClusters* clusters, Shader* shader, uint32 firstUnit);
+uint32 LightClusters_GetLightCount(const LightClusters* clusters);
+void LightClusters_GetStats(const LightClusters* clusters, LightClusters_Stats* stats);
+
+#endif
\ No newline at end of file
@@ -91,6 +91,18 @@ void Material_Apply(Material* material)
 			glUniformMatrix4fv(location, 1, GL_FALSE, (GLfloat*)matrix4x4value.data);
 		}
 	);
+
+	Texture* texturevalue;
+	GLint unit = 0;
+	kh_foreach(material->textures, name, texturevalue,
+		GLint location = Shader_GetLocation(shader, name);
+		if (location != -1)
+		{
+			Texture_Bind(texturevalue, unit);
+			glUniform1i(location, unit);
+			unit++;
+		}
+	);
 }
 
 Result Material_Get_Float(const Material* material, const char* name, float* value)
@@ -186,7 +198,7 @@ Result Material_Set_Float(Material* material, const char* name, float* value)
 		{
 			int ret;
 			k = kh_put(float, material->floats, name, &ret);
-			if (ret != 0)
+			if (ret < 0)
 				return Result_FAILURE;
 		}
 		kh_value(material->floats, k) = *value;
@@ -204,7 +216,7 @@ Result Material_Set_Float3(Material* material, const char* name, float3* value)
 		{
 			int ret;
 			k = kh_put(float3, material->float3s, name, &ret);
-			if (ret != 0)
+			if (ret < 0)
 				return Result_FAILURE;
 		}
 		kh_value(material->float3s, k) = *value;
@@ -222,7 +234,7 @@ Result Material_Set_Float4(Material* material, const char* name, float4* value)
 		{
 			int ret;
 			k = kh_put(float4, material->float4s, name, &ret);
-			if (ret != 0)
+			if (ret < 0)
 				return Result_FAILURE;
 		}
 		kh_value(material->float4s, k) = *value;
@@ -240,7 +252,7 @@ Result Material_Set_Matrix3x3(Material* material, const char* name, matrix3x3* v
 		{
 			int ret;
 			k = kh_put(matrix3x3, material->matrix3x3s, name, &ret);
-			if (ret != 0)
+			if (ret < 0)
 				return Result_FAILURE;
 		}
 		kh_value(material->matrix3x3s, k) = *value;
@@ -258,7 +270,7 @@ Result Material_Set_Matrix4x4(Material* material, const char* name, matrix4x4* v
 		{
 			int ret;
 			k = kh_put(matrix4x4, material->matrix4x4s, name, &ret);
-			if (ret != 0)
+			if (ret < 0)
 				return Result_FAILURE;
 		}
 		kh_value(material->matrix4x4s, k) = *value;
@@ -276,7 +288,7 @@ Result Material_Set_Texture(const Material* material, const char* name, Texture*
 		{
 			int ret;
 			k = kh_put(Texture, material->textures, name, &ret);
-			if (ret != 0)
+			if (ret < 0)
 				return Result_FAILURE;
 		}
 		kh_value(material->textures, k) = *value;
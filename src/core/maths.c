@@ -0,0 +1,217 @@
+#include "maths.h"
+#include <math.h>
+#include <string.h>
+
+void Matrix4x4_Identity(matrix4x4* out)
+{
+	memset(out, 0, sizeof(matrix4x4));
+	out->a1 = out->b2 = out->c3 = out->d4 = 1.0f;
+}
+
+void Matrix4x4_Multiply(const matrix4x4* a, const matrix4x4* b, matrix4x4* out)
+{
+	matrix4x4 result;
+	for (int column = 0; column < 4; column++)
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			result.data2D[column][row] =
+				a->data2D[0][row] * b->data2D[column][0] +
+				a->data2D[1][row] * b->data2D[column][1] +
+				a->data2D[2][row] * b->data2D[column][2] +
+				a->data2D[3][row] * b->data2D[column][3];
+		}
+	}
+	*out = result;
+}
+
+void Matrix4x4_TransformPoint(const matrix4x4* m, const float3* point, float4* out)
+{
+	float4 result;
+	for (int row = 0; row < 4; row++)
+	{
+		result.data[row] = m->data2D[0][row] * point->x + m->data2D[1][row] * point->y + m->data2D[2][row] * point->z + m->data2D[3][row];
+	}
+	*out = result;
+}
+
+// Cofactor expansion over 2x2 sub-determinants. Returns 0 and leaves out
+// untouched when the matrix is singular.
+int Matrix4x4_Inverse(const matrix4x4* m, matrix4x4* out)
+{
+	const float* a = m->data;
+	float s0 = a[0] * a[5] - a[4] * a[1];
+	float s1 = a[0] * a[6] - a[4] * a[2];
+	float s2 = a[0] * a[7] - a[4] * a[3];
+	float s3 = a[1] * a[6] - a[5] * a[2];
+	float s4 = a[1] * a[7] - a[5] * a[3];
+	float s5 = a[2] * a[7] - a[6] * a[3];
+	float c5 = a[10] * a[15] - a[14] * a[11];
+	float c4 = a[9] * a[15] - a[13] * a[11];
+	float c3 = a[9] * a[14] - a[13] * a[10];
+	float c2 = a[8] * a[15] - a[12] * a[11];
+	float c1 = a[8] * a[14] - a[12] * a[10];
+	float c0 = a[8] * a[13] - a[12] * a[9];
+	float determinant = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+	if (determinant == 0.0f)
+		return 0;
+
+	float scale = 1.0f / determinant;
+	matrix4x4 result;
+	float* r = result.data;
+	r[0] = (a[5] * c5 - a[6] * c4 + a[7] * c3) * scale;
+	r[1] = (-a[1] * c5 + a[2] * c4 - a[3] * c3) * scale;
+	r[2] = (a[13] * s5 - a[14] * s4 + a[15] * s3) * scale;
+	r[3] = (-a[9] * s5 + a[10] * s4 - a[11] * s3) * scale;
+	r[4] = (-a[4] * c5 + a[6] * c2 - a[7] * c1) * scale;
+	r[5] = (a[0] * c5 - a[2] * c2 + a[3] * c1) * scale;
+	r[6] = (-a[12] * s5 + a[14] * s2 - a[15] * s1) * scale;
+	r[7] = (a[8] * s5 - a[10] * s2 + a[11] * s1) * scale;
+	r[8] = (a[4] * c4 - a[5] * c2 + a[7] * c0) * scale;
+	r[9] = (-a[0] * c4 + a[1] * c2 - a[3] * c0) * scale;
+	r[10] = (a[12] * s4 - a[13] * s2 + a[15] * s0) * scale;
+	r[11] = (-a[8] * s4 + a[9] * s2 - a[11] * s0) * scale;
+	r[12] = (-a[4] * c3 + a[5] * c1 - a[6] * c0) * scale;
+	r[13] = (a[0] * c3 - a[1] * c1 + a[2] * c0) * scale;
+	r[14] = (-a[12] * s3 + a[13] * s1 - a[14] * s0) * scale;
+	r[15] = (a[8] * s3 - a[9] * s1 + a[10] * s0) * scale;
+	*out = result;
+	return 1;
+}
+
+// Quaternion (x, y, z, w) of a rotation matrix given by its unit columns.
+static void Matrix4x4_GetRotation(const float3 axes[3], float4* out)
+{
+	// r(row, column) of the rotation
+#define R(row, column) axes[column].data[row]
+	float trace = R(0, 0) + R(1, 1) + R(2, 2);
+	if (trace > 0.0f)
+	{
+		float s = sqrtf(trace + 1.0f) * 2.0f;
+		out->w = 0.25f * s;
+		out->x = (R(2, 1) - R(1, 2)) / s;
+		out->y = (R(0, 2) - R(2, 0)) / s;
+		out->z = (R(1, 0) - R(0, 1)) / s;
+	}
+	else if (R(0, 0) > R(1, 1) && R(0, 0) > R(2, 2))
+	{
+		float s = sqrtf(1.0f + R(0, 0) - R(1, 1) - R(2, 2)) * 2.0f;
+		out->w = (R(2, 1) - R(1, 2)) / s;
+		out->x = 0.25f * s;
+		out->y = (R(0, 1) + R(1, 0)) / s;
+		out->z = (R(0, 2) + R(2, 0)) / s;
+	}
+	else if (R(1, 1) > R(2, 2))
+	{
+		float s = sqrtf(1.0f + R(1, 1) - R(0, 0) - R(2, 2)) * 2.0f;
+		out->w = (R(0, 2) - R(2, 0)) / s;
+		out->x = (R(0, 1) + R(1, 0)) / s;
+		out->y = 0.25f * s;
+		out->z = (R(1, 2) + R(2, 1)) / s;
+	}
+	else
+	{
+		float s = sqrtf(1.0f + R(2, 2) - R(0, 0) - R(1, 1)) * 2.0f;
+		out->w = (R(1, 0) - R(0, 1)) / s;
+		out->x = (R(0, 2) + R(2, 0)) / s;
+		out->y = (R(1, 2) + R(2, 1)) / s;
+		out->z = 0.25f * s;
+	}
+#undef R
+}
+
+// Splits an affine transform into translation, per-axis scale and the unit
+// axes left after taking the scale out; a mirroring transform gets a
+// negative x scale so the axes stay a rotation.
+static void Matrix4x4_Decompose(const matrix4x4* m, float3* translation, float3* scale, float3 axes[3])
+{
+	for (int column = 0; column < 3; column++)
+	{
+		const float* c = m->data2D[column];
+		scale->data[column] = sqrtf(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+		float inverse = scale->data[column] > 0.0f ? 1.0f / scale->data[column] : 0.0f;
+		axes[column].x = c[0] * inverse;
+		axes[column].y = c[1] * inverse;
+		axes[column].z = c[2] * inverse;
+		translation->data[column] = m->data2D[3][column];
+	}
+	float determinant =
+		axes[0].x * (axes[1].y * axes[2].z - axes[1].z * axes[2].y) -
+		axes[1].x * (axes[0].y * axes[2].z - axes[0].z * axes[2].y) +
+		axes[2].x * (axes[0].y * axes[1].z - axes[0].z * axes[1].y);
+	if (determinant < 0.0f)
+	{
+		scale->x = -scale->x;
+		axes[0].x = -axes[0].x;
+		axes[0].y = -axes[0].y;
+		axes[0].z = -axes[0].z;
+	}
+}
+
+// Translation and scale are blended linearly, rotation along the shorter
+// arc at constant speed. Nearly equal rotations, the common case between
+// two simulation ticks, use a normalised lerp where the arc's sine would
+// lose precision. Both transforms must be affine.
+void Matrix4x4_Interpolate(const matrix4x4* a, const matrix4x4* b, float t, matrix4x4* out)
+{
+	float3 translationA, translationB, scaleA, scaleB, axesA[3], axesB[3];
+	float4 rotationA, rotationB;
+	Matrix4x4_Decompose(a, &translationA, &scaleA, axesA);
+	Matrix4x4_Decompose(b, &translationB, &scaleB, axesB);
+	Matrix4x4_GetRotation(axesA, &rotationA);
+	Matrix4x4_GetRotation(axesB, &rotationB);
+
+	float cosine = rotationA.x * rotationB.x + rotationA.y * rotationB.y + rotationA.z * rotationB.z + rotationA.w * rotationB.w;
+	float sign = 1.0f;
+	if (cosine < 0.0f)
+	{
+		cosine = -cosine;
+		sign = -1.0f;
+	}
+	float weightA = 1.0f - t;
+	float weightB = t;
+	if (cosine < 0.9995f)
+	{
+		float angle = acosf(cosine);
+		float inverseSine = 1.0f / sinf(angle);
+		weightA = sinf((1.0f - t) * angle) * inverseSine;
+		weightB = sinf(t * angle) * inverseSine;
+	}
+	weightB *= sign;
+
+	float4 q;
+	for (int i = 0; i < 4; i++)
+	{
+		q.data[i] = rotationA.data[i] * weightA + rotationB.data[i] * weightB;
+	}
+	float length = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+	for (int i = 0; i < 4; i++)
+	{
+		q.data[i] /= length;
+	}
+
+	float3 scale;
+	for (int i = 0; i < 3; i++)
+	{
+		scale.data[i] = scaleA.data[i] + (scaleB.data[i] - scaleA.data[i]) * t;
+	}
+
+	float* r = out->data;
+	r[0] = (1.0f - 2.0f * (q.y * q.y + q.z * q.z)) * scale.x;
+	r[1] = 2.0f * (q.x * q.y + q.z * q.w) * scale.x;
+	r[2] = 2.0f * (q.x * q.z - q.y * q.w) * scale.x;
+	r[3] = 0.0f;
+	r[4] = 2.0f * (q.x * q.y - q.z * q.w) * scale.y;
+	r[5] = (1.0f - 2.0f * (q.x * q.x + q.z * q.z)) * scale.y;
+	r[6] = 2.0f * (q.y * q.z + q.x * q.w) * scale.y;
+	r[7] = 0.0f;
+	r[8] = 2.0f * (q.x * q.z + q.y * q.w) * scale.z;
+	r[9] = 2.0f * (q.y * q.z - q.x * q.w) * scale.z;
+	r[10] = (1.0f - 2.0f * (q.x * q.x + q.y * q.y)) * scale.z;
+	r[11] = 0.0f;
+	for (int i = 0; i < 3; i++)
+	{
+		r[12 + i] = translationA.data[i] + (translationB.data[i] - translationA.data[i]) * t;
+	}
+	r[15] = 1.0f;
+}
\ No newline at end of file
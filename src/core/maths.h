@@ -61,4 +61,16 @@ typedef union matrix4x4
 	float data[16];
 } matrix4x4;
 
+typedef struct Aabb
+{
+	float3 min;
+	float3 max;
+} Aabb;
+
+void Matrix4x4_Identity(matrix4x4* out);
+void Matrix4x4_Multiply(const matrix4x4* a, const matrix4x4* b, matrix4x4* out);
+void Matrix4x4_TransformPoint(const matrix4x4* m, const float3* point, float4* out);
+int Matrix4x4_Inverse(const matrix4x4* m, matrix4x4* out);
+void Matrix4x4_Interpolate(const matrix4x4* a, const matrix4x4* b, float t, matrix4x4* out);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,428 @@
+#ifndef __FIXED_H__
+#define __FIXED_H__
+
+#include "lwTypes.h"
+#include <math.h>
+
+// Fixed-point numbers for the lockstep simulation. Everything here is
+// integer arithmetic, so the same inputs give the same bits with any
+// compiler, optimisation level or instruction set; floats only come in
+// when loading data and go out at the render boundary. Overflow wraps,
+// relying on two's complement and arithmetic right shifts, which MSVC,
+// GCC and Clang all provide. Products round to nearest, quotients truncate
+// towards zero; dividing by zero gives the largest value of the sign.
+//
+// fix16 (Q16.16) is the everyday type for positions, speeds and angles;
+// fix32 (Q32.32) is for accumulators and long distances. Square roots are
+// exact to the last bit, sines come from a quarter-wave table with linear
+// interpolation and atan2 from a polynomial, both within a few units of
+// the last place of fix16.
+
+namespace lwge
+{
+	namespace core
+	{
+		class fix16
+		{
+		public:
+			//! Zero
+			fix16() : raw(0) {}
+			//! From an integer, wraps beyond +-32767
+			explicit fix16(s32 n) : raw((s32)((u32)n << 16)) {}
+
+			static fix16 fromRaw(s32 r) { fix16 f; f.raw = r; return f; }
+			//! Rounded to nearest; only for loading data, never for results of the simulation.
+			static fix16 fromFloat(f32 f) { return fromRaw((s32)floor((f64)f * 65536.0 + 0.5)); }
+			static fix16 pi() { return fromRaw(205887); }
+			static fix16 halfPi() { return fromRaw(102944); }
+			static fix16 twoPi() { return fromRaw(411775); }
+			static fix16 maxValue() { return fromRaw(0x7FFFFFFF); }
+			static fix16 minValue() { return fromRaw((s32)0x80000000); }
+
+			f32 toFloat() const { return (f32)raw * (1.0f / 65536.0f); }
+			//! Rounded towards minus infinity
+			s32 toInt() const { return raw >> 16; }
+
+			// operators
+			fix16	operator-	() const					{ return fromRaw((s32)(0u - (u32)raw)); }
+
+			fix16	operator+	(const fix16 other) const	{ return fromRaw((s32)((u32)raw + (u32)other.raw)); }
+			fix16	operator-	(const fix16 other) const	{ return fromRaw((s32)((u32)raw - (u32)other.raw)); }
+			fix16	operator*	(const fix16 other) const	{ return fromRaw((s32)(((s64)raw * other.raw + 0x8000) >> 16)); }
+			fix16	operator/	(const fix16 other) const
+			{
+				if (other.raw == 0)
+					return raw >= 0 ? maxValue() : minValue();
+				return fromRaw((s32)((s64)raw * 65536 / other.raw));
+			}
+
+			fix16	operator*	(const s32 n) const			{ return fromRaw((s32)((u32)raw * (u32)n)); }
+			fix16	operator/	(const s32 n) const			{ return n != 0 ? fromRaw((s32)((s64)raw / n)) : (raw >= 0 ? maxValue() : minValue()); }
+
+			fix16&	operator+=	(const fix16 other)			{ return *this = *this + other; }
+			fix16&	operator-=	(const fix16 other)			{ return *this = *this - other; }
+			fix16&	operator*=	(const fix16 other)			{ return *this = *this * other; }
+			fix16&	operator/=	(const fix16 other)			{ return *this = *this / other; }
+			fix16&	operator*=	(const s32 n)				{ return *this = *this * n; }
+			fix16&	operator/=	(const s32 n)				{ return *this = *this / n; }
+
+			bool	operator==	(const fix16 other) const	{ return raw == other.raw; }
+			bool	operator!=	(const fix16 other) const	{ return raw != other.raw; }
+			bool	operator<	(const fix16 other) const	{ return raw < other.raw; }
+			bool	operator<=	(const fix16 other) const	{ return raw <= other.raw; }
+			bool	operator>	(const fix16 other) const	{ return raw > other.raw; }
+			bool	operator>=	(const fix16 other) const	{ return raw >= other.raw; }
+
+			//! 16.16 two's complement bits
+			s32 raw;
+		};
+
+		class fix32
+		{
+		public:
+			//! Zero
+			fix32() : raw(0) {}
+			//! From an integer, wraps beyond +-2^31 - 1
+			explicit fix32(s32 n) : raw((s64)n * 0x100000000LL) {}
+			//! Widening, exact
+			explicit fix32(fix16 f) : raw((s64)f.raw * 65536) {}
+
+			static fix32 fromRaw(s64 r) { fix32 f; f.raw = r; return f; }
+			//! Rounded to nearest; only for loading data, never for results of the simulation.
+			static fix32 fromFloat(f64 f) { return fromRaw((s64)floor(f * 4294967296.0 + 0.5)); }
+			static fix32 maxValue() { return fromRaw(0x7FFFFFFFFFFFFFFFLL); }
+			static fix32 minValue() { return fromRaw((s64)0x8000000000000000ULL); }
+
+			f64 toDouble() const { return (f64)raw * (1.0 / 4294967296.0); }
+			f32 toFloat() const { return (f32)toDouble(); }
+			//! Rounded to nearest, wraps beyond the range of fix16
+			fix16 toFix16() const { return fix16::fromRaw((s32)((raw + 0x8000) >> 16)); }
+
+			// operators
+			fix32	operator-	() const					{ return fromRaw((s64)(0u - (u64)raw)); }
+
+			fix32	operator+	(const fix32 other) const	{ return fromRaw((s64)((u64)raw + (u64)other.raw)); }
+			fix32	operator-	(const fix32 other) const	{ return fromRaw((s64)((u64)raw - (u64)other.raw)); }
+			fix32	operator*	(const fix32 other) const;
+			fix32	operator/	(const fix32 other) const;
+
+			fix32	operator*	(const s32 n) const			{ return fromRaw((s64)((u64)raw * (u64)(s64)n)); }
+			fix32	operator/	(const s32 n) const			{ return n != 0 ? fromRaw(raw / n) : (raw >= 0 ? maxValue() : minValue()); }
+
+			fix32&	operator+=	(const fix32 other)			{ return *this = *this + other; }
+			fix32&	operator-=	(const fix32 other)			{ return *this = *this - other; }
+			fix32&	operator*=	(const fix32 other)			{ return *this = *this * other; }
+			fix32&	operator/=	(const fix32 other)			{ return *this = *this / other; }
+			fix32&	operator*=	(const s32 n)				{ return *this = *this * n; }
+			fix32&	operator/=	(const s32 n)				{ return *this = *this / n; }
+
+			bool	operator==	(const fix32 other) const	{ return raw == other.raw; }
+			bool	operator!=	(const fix32 other) const	{ return raw != other.raw; }
+			bool	operator<	(const fix32 other) const	{ return raw < other.raw; }
+			bool	operator<=	(const fix32 other) const	{ return raw <= other.raw; }
+			bool	operator>	(const fix32 other) const	{ return raw > other.raw; }
+			bool	operator>=	(const fix32 other) const	{ return raw >= other.raw; }
+
+			//! 32.32 two's complement bits
+			s64 raw;
+		};
+
+		//! Number of significant bits
+		inline u32 fixedBitLength(u64 value)
+		{
+			u32 length = 0;
+			if (value >> 32) { length += 32; value >>= 32; }
+			if (value >> 16) { length += 16; value >>= 16; }
+			if (value >> 8) { length += 8; value >>= 8; }
+			if (value >> 4) { length += 4; value >>= 4; }
+			if (value >> 2) { length += 2; value >>= 2; }
+			if (value >> 1) { length += 1; value >>= 1; }
+			return length + (u32)value;
+		}
+
+		// The full 128 bit product, shifted down with rounding; no compiler
+		// independent 128 bit type exists, so it is put together from four
+		// 32 bit products.
+		inline fix32 fix32::operator*(const fix32 other) const
+		{
+			u64 a = (u64)raw;
+			u64 b = (u64)other.raw;
+			u64 aLow = a & 0xFFFFFFFFu, aHigh = a >> 32;
+			u64 bLow = b & 0xFFFFFFFFu, bHigh = b >> 32;
+			u64 lowLow = aLow * bLow;
+			u64 lowHigh = aLow * bHigh;
+			u64 highLow = aHigh * bLow;
+			u64 middle = (lowLow >> 32) + (lowHigh & 0xFFFFFFFFu) + (highLow & 0xFFFFFFFFu);
+			u64 low = (middle << 32) | (lowLow & 0xFFFFFFFFu);
+			u64 high = aHigh * bHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32);
+			// Signed operands take the other one off the upper half.
+			if (raw < 0)
+				high -= b;
+			if (other.raw < 0)
+				high -= a;
+			u64 rounded = low + 0x80000000u;
+			if (rounded < low)
+				high++;
+			return fromRaw((s64)((high << 32) | (rounded >> 32)));
+		}
+
+		// Long division of the magnitudes: the fraction bits the dividend has
+		// room for in one hardware division, the rest one bit at a time.
+		inline fix32 fix32::operator/(const fix32 other) const
+		{
+			if (other.raw == 0)
+				return raw >= 0 ? maxValue() : minValue();
+			u64 a = raw < 0 ? 0u - (u64)raw : (u64)raw;
+			u64 b = other.raw < 0 ? 0u - (u64)other.raw : (u64)other.raw;
+			u32 shift = 64 - fixedBitLength(a);
+			shift = shift < 32 ? shift : 32;
+			u64 quotient = (a << shift) / b;
+			u64 remainder = (a << shift) % b;
+			for (u32 i = shift; i < 32; i++)
+			{
+				bool carry = (remainder >> 63) != 0;
+				remainder <<= 1;
+				quotient <<= 1;
+				if (carry || remainder >= b)
+				{
+					remainder -= b;
+					quotient |= 1;
+				}
+			}
+			return fromRaw((raw < 0) != (other.raw < 0) ? (s64)(0u - quotient) : (s64)quotient);
+		}
+
+		//! ceil(sqrt(i + 1) * 16), so a seed from it is never below the root.
+		inline const u16* fixedSqrtTable()
+		{
+			static const u16 table[256] =
+			{
+				16, 23, 28, 32, 36, 40, 43, 46, 48, 51, 54, 56, 58, 60, 62, 64,
+				66, 68, 70, 72, 74, 76, 77, 79, 80, 82, 84, 85, 87, 88, 90, 91,
+				92, 94, 95, 96, 98, 99, 100, 102, 103, 104, 105, 107, 108, 109, 110, 111,
+				112, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 127, 128,
+				129, 130, 131, 132, 133, 134, 135, 136, 137, 138, 139, 140, 141, 142, 143, 144,
+				144, 145, 146, 147, 148, 149, 150, 151, 151, 152, 153, 154, 155, 156, 156, 157,
+				158, 159, 160, 160, 161, 162, 163, 164, 164, 165, 166, 167, 168, 168, 169, 170,
+				171, 171, 172, 173, 174, 174, 175, 176, 176, 177, 178, 179, 179, 180, 181, 182,
+				182, 183, 184, 184, 185, 186, 186, 187, 188, 188, 189, 190, 190, 191, 192, 192,
+				193, 194, 194, 195, 196, 196, 197, 198, 198, 199, 200, 200, 201, 202, 202, 203,
+				204, 204, 205, 205, 206, 207, 207, 208, 208, 209, 210, 210, 211, 212, 212, 213,
+				213, 214, 215, 215, 216, 216, 217, 218, 218, 219, 219, 220, 220, 221, 222, 222,
+				223, 223, 224, 224, 225, 226, 226, 227, 227, 228, 228, 229, 230, 230, 231, 231,
+				232, 232, 233, 233, 234, 235, 235, 236, 236, 237, 237, 238, 238, 239, 239, 240,
+				240, 241, 242, 242, 243, 243, 244, 244, 245, 245, 246, 246, 247, 247, 248, 248,
+				249, 249, 250, 250, 251, 251, 252, 252, 253, 253, 254, 254, 255, 255, 256, 256
+			};
+			return table;
+		}
+
+		//! Square root of value * 4^extraPairs rounded to nearest.
+		/** Seeded from the top bits of the radicand through the table, two
+		Newton steps from above and a last integer correction make it exact,
+		whatever the steps left over. Zero pairs that do not fit into 64 bits
+		follow digit by digit, one root bit each. */
+		inline u64 fixedSqrtBits(u64 value, u32 extraPairs)
+		{
+			if (value == 0)
+				return 0;
+			u32 length = fixedBitLength(value);
+			u32 pairs = length + 2 * extraPairs <= 64 ? extraPairs : (64 - length) / 2;
+			u64 x = value << (2 * pairs);
+
+			length = fixedBitLength(x);
+			u32 shift = length > 8 ? (length - 7) & ~1u : 0;
+			u64 root = (((u64)fixedSqrtTable()[x >> shift] << (shift / 2)) + 15) >> 4;
+			root = (root + x / root) >> 1;
+			root = (root + x / root) >> 1;
+			while (root > 0xFFFFFFFFu || root * root > x)
+				root--;
+			u64 remainder = x - root * root;
+
+			for (; pairs < extraPairs; pairs++)
+			{
+				remainder <<= 2;
+				root <<= 1;
+				u64 test = (root << 1) | 1;
+				if (remainder >= test)
+				{
+					remainder -= test;
+					root |= 1;
+				}
+			}
+			// remainder is value - root^2, past root the root is nearer to root + 1.
+			return remainder > root ? root + 1 : root;
+		}
+
+		//! 0 for negative values
+		inline fix16 fixedSqrt(fix16 f)
+		{
+			return f.raw > 0 ? fix16::fromRaw((s32)fixedSqrtBits((u64)f.raw, 8)) : fix16();
+		}
+
+		//! 0 for negative values
+		inline fix32 fixedSqrt(fix32 f)
+		{
+			return f.raw > 0 ? fix32::fromRaw((s64)fixedSqrtBits((u64)f.raw, 16)) : fix32();
+		}
+
+		inline fix16 fixedAbs(fix16 f)
+		{
+			return f.raw < 0 ? -f : f;
+		}
+
+		inline fix32 fixedAbs(fix32 f)
+		{
+			return f.raw < 0 ? -f : f;
+		}
+
+		inline fix16 fixedMin(fix16 a, fix16 b)
+		{
+			return a < b ? a : b;
+		}
+
+		inline fix16 fixedMax(fix16 a, fix16 b)
+		{
+			return a > b ? a : b;
+		}
+
+		inline fix16 fixedClamp(fix16 value, fix16 low, fix16 high)
+		{
+			return value < low ? low : (value > high ? high : value);
+		}
+
+		//! sin(i * pi / 1024) for the first quarter wave in Q2.30, literal so that no libm is involved.
+		inline const s32* fixedSineTable()
+		{
+			static const s32 table[513] =
+			{
+				0, 3294193, 6588356, 9882456, 13176464, 16470347, 19764076, 23057618,
+				26350943, 29644021, 32936819, 36229307, 39521455, 42813230, 46104602, 49395541,
+				52686014, 55975992, 59265442, 62554335, 65842639, 69130324, 72417357, 75703709,
+				78989349, 82274245, 85558366, 88841683, 92124163, 95405776, 98686491, 101966277,
+				105245103, 108522939, 111799753, 115075515, 118350194, 121623759, 124896179, 128167423,
+				131437462, 134706263, 137973796, 141240030, 144504935, 147768480, 151030634, 154291367,
+				157550647, 160808445, 164064728, 167319468, 170572633, 173824192, 177074115, 180322371,
+				183568930, 186813762, 190056834, 193298119, 196537583, 199775198, 203010932, 206244756,
+				209476638, 212706549, 215934457, 219160334, 222384147, 225605867, 228825464, 232042906,
+				235258165, 238471210, 241682010, 244890535, 248096755, 251300640, 254502159, 257701283,
+				260897982, 264092224, 267283981, 270473223, 273659918, 276844038, 280025552, 283204430,
+				286380643, 289554160, 292724951, 295892988, 299058239, 302220676, 305380268, 308536985,
+				311690799, 314841679, 317989595, 321134518, 324276419, 327415267, 330551034, 333683689,
+				336813204, 339939549, 343062693, 346182609, 349299266, 352412636, 355522689, 358629395,
+				361732726, 364832652, 367929144, 371022173, 374111709, 377197725, 380280190, 383359076,
+				386434353, 389505993, 392573967, 395638246, 398698801, 401755603, 404808624, 407857835,
+				410903207, 413944711, 416982319, 420016002, 423045732, 426071480, 429093217, 432110916,
+				435124548, 438134084, 441139496, 444140756, 447137835, 450130706, 453119340, 456103710,
+				459083786, 462059541, 465030947, 467997976, 470960600, 473918791, 476872522, 479821764,
+				482766489, 485706671, 488642281, 491573292, 494499676, 497421405, 500338453, 503250791,
+				506158392, 509061229, 511959275, 514852502, 517740883, 520624391, 523502998, 526376678,
+				529245404, 532109148, 534967884, 537821584, 540670223, 543513772, 546352205, 549185496,
+				552013618, 554836544, 557654248, 560466703, 563273883, 566075761, 568872310, 571663506,
+				574449320, 577229728, 580004702, 582774218, 585538248, 588296766, 591049748, 593797166,
+				596538995, 599275210, 602005783, 604730691, 607449906, 610163404, 612871159, 615573145,
+				618269338, 620959711, 623644239, 626322897, 628995660, 631662503, 634323400, 636978327,
+				639627258, 642270169, 644907034, 647537830, 650162530, 652781111, 655393548, 657999816,
+				660599890, 663193747, 665781362, 668362709, 670937767, 673506508, 676068911, 678624950,
+				681174602, 683717842, 686254647, 688784993, 691308855, 693826211, 696337036, 698841307,
+				701339000, 703830092, 706314559, 708792378, 711263525, 713727978, 716185713, 718636707,
+				721080937, 723518380, 725949013, 728372813, 730789757, 733199822, 735602987, 737999228,
+				740388522, 742770848, 745146182, 747514503, 749875788, 752230015, 754577161, 756917205,
+				759250125, 761575898, 763894504, 766205919, 768510122, 770807092, 773096806, 775379244,
+				777654384, 779922204, 782182683, 784435800, 786681534, 788919863, 791150767, 793374223,
+				795590213, 797798714, 799999706, 802193167, 804379079, 806557419, 808728167, 810891304,
+				813046808, 815194659, 817334838, 819467323, 821592095, 823709135, 825818421, 827919934,
+				830013654, 832099562, 834177638, 836247863, 838310216, 840364679, 842411232, 844449856,
+				846480531, 848503239, 850517961, 852524677, 854523370, 856514019, 858496606, 860471112,
+				862437520, 864395810, 866345964, 868287963, 870221790, 872147426, 874064853, 875974054,
+				877875009, 879767701, 881652112, 883528225, 885396022, 887255485, 889106597, 890949341,
+				892783698, 894609652, 896427186, 898236282, 900036924, 901829095, 903612776, 905387953,
+				907154608, 908912725, 910662286, 912403276, 914135678, 915859476, 917574653, 919281194,
+				920979082, 922668302, 924348837, 926020672, 927683790, 929338177, 930983817, 932620694,
+				934248793, 935868098, 937478595, 939080267, 940673101, 942257081, 943832191, 945398418,
+				946955747, 948504163, 950043650, 951574196, 953095785, 954608403, 956112036, 957606670,
+				959092290, 960568883, 962036435, 963494932, 964944360, 966384706, 967815955, 969238095,
+				970651112, 972054994, 973449725, 974835295, 976211688, 977578894, 978936898, 980285688,
+				981625251, 982955574, 984276646, 985588453, 986890984, 988184225, 989468165, 990742793,
+				992008094, 993264059, 994510675, 995747930, 996975812, 998194311, 999403415, 1000603111,
+				1001793390, 1002974239, 1004145648, 1005307605, 1006460100, 1007603122, 1008736660, 1009860704,
+				1010975242, 1012080264, 1013175761, 1014261721, 1015338134, 1016404991, 1017462281, 1018509994,
+				1019548121, 1020576651, 1021595575, 1022604883, 1023604567, 1024594615, 1025575020, 1026545772,
+				1027506862, 1028458280, 1029400018, 1030332067, 1031254418, 1032167062, 1033069992, 1033963197,
+				1034846671, 1035720404, 1036584389, 1037438617, 1038283080, 1039117770, 1039942680, 1040757802,
+				1041563127, 1042358649, 1043144360, 1043920252, 1044686319, 1045442553, 1046188946, 1046925492,
+				1047652185, 1048369016, 1049075980, 1049773069, 1050460278, 1051137599, 1051805027, 1052462555,
+				1053110176, 1053747885, 1054375676, 1054993543, 1055601479, 1056199480, 1056787540, 1057365653,
+				1057933813, 1058492016, 1059040255, 1059578527, 1060106826, 1060625146, 1061133483, 1061631833,
+				1062120190, 1062598550, 1063066909, 1063525261, 1063973603, 1064411931, 1064840240, 1065258526,
+				1065666786, 1066065015, 1066453210, 1066831367, 1067199483, 1067557554, 1067905576, 1068243547,
+				1068571464, 1068889322, 1069197120, 1069494854, 1069782521, 1070060120, 1070327646, 1070585099,
+				1070832474, 1071069770, 1071296985, 1071514117, 1071721163, 1071918122, 1072104991, 1072281769,
+				1072448455, 1072605046, 1072751542, 1072887940, 1073014240, 1073130440, 1073236540, 1073332538,
+				1073418433, 1073494225, 1073559913, 1073615496, 1073660973, 1073696345, 1073721611, 1073736771,
+				1073741824
+			};
+			return table;
+		}
+
+		//! Sine of a position in 1/512ths of the quarter wave with 16 fraction bits, Q2.30.
+		inline s64 fixedQuarterSine(u32 position)
+		{
+			const s32* table = fixedSineTable();
+			u32 index = position >> 16;
+			if (index >= 512)
+				return table[512];
+			s64 step = table[index + 1] - table[index];
+			return table[index] + ((step * (position & 0xFFFFu)) >> 16);
+		}
+
+		//! Any angle in radians
+		inline fix16 fixedSin(fix16 angle)
+		{
+			// 2048 table steps per turn with 16 fraction bits; only the bits
+			// within one turn are kept, so the product may wrap.
+			u32 phase = (u32)(((u64)(s64)angle.raw * 21361415u) >> 16) & 0x7FFFFFFu;
+			u32 quadrant = phase >> 25;
+			u32 position = phase & 0x1FFFFFFu;
+			s64 value = fixedQuarterSine((quadrant & 1) != 0 ? 0x2000000u - position : position);
+			s32 result = (s32)((value + (1 << 13)) >> 14);
+			return fix16::fromRaw(quadrant >= 2 ? -result : result);
+		}
+
+		//! Any angle in radians
+		inline fix16 fixedCos(fix16 angle)
+		{
+			return fixedSin(angle + fix16::halfPi());
+		}
+
+		//! Angle of (x, y) from the x axis in [-pi, pi], 0 for the null vector.
+		/** atan on [0, 1] is the polynomial of Abramowitz and Stegun 4.4.47
+		(error below 1e-5) evaluated in Q2.30, the octant picks the rest. */
+		inline fix16 fixedAtan2(fix16 y, fix16 x)
+		{
+			u64 ax = x.raw < 0 ? 0u - (u64)(s64)x.raw : (u64)x.raw;
+			u64 ay = y.raw < 0 ? 0u - (u64)(s64)y.raw : (u64)y.raw;
+			if (ax == 0 && ay == 0)
+				return fix16();
+
+			bool steep = ay > ax;
+			s64 z = (s64)(steep ? (ax << 30) / ay : (ay << 30) / ax);
+			s64 z2 = (z * z) >> 30;
+			s64 p = 22371518;
+			p = ((p * z2) >> 30) - 91410863;
+			p = ((p * z2) >> 30) + 193424926;
+			p = ((p * z2) >> 30) - 354656388;
+			p = ((p * z2) >> 30) + 1073597943;
+			s64 angle = (p * z) >> 30;
+			if (steep)
+				angle = 1686629713LL - angle;
+			if (x.raw < 0)
+				angle = 3373259426LL - angle;
+			s32 result = (s32)((angle + (1 << 13)) >> 14);
+			return fix16::fromRaw(y.raw < 0 ? -result : result);
+		}
+
+	} // end namespace core
+} // end namespace lwge
+
+#endif
\ No newline at end of file
@@ -0,0 +1,94 @@
+#ifndef __FIXED2_H__
+#define __FIXED2_H__
+
+#include "fixed.h"
+#include "float2.h"
+
+namespace lwge
+{
+	namespace core
+	{
+		//! 2d vector of fix16 for the simulation, the deterministic counterpart of float2.
+		class fixed2
+		{
+		public:
+			//! Default constructor (null vector)
+			fixed2() {}
+			//! Constructor with two different values
+			fixed2(fix16 nx, fix16 ny) : x(nx), y(ny) {}
+
+			//! Rounded to nearest; only for loading data.
+			static fixed2 fromFloat(const float2& v) { return fixed2(fix16::fromFloat(v.x), fix16::fromFloat(v.y)); }
+			//! For the render boundary.
+			float2 toFloat() const { return float2(x.toFloat(), y.toFloat()); }
+
+			// operators
+			fixed2	operator-	() const					{ return fixed2(-x, -y); }
+
+			fixed2	operator+	(const fixed2& other) const	{ return fixed2(x + other.x, y + other.y); }
+			fixed2	operator-	(const fixed2& other) const	{ return fixed2(x - other.x, y - other.y); }
+			fixed2	operator*	(const fix16 v) const		{ return fixed2(x * v, y * v); }
+			fixed2	operator/	(const fix16 v) const		{ return fixed2(x / v, y / v); }
+
+			fixed2& operator+=	(const fixed2& other)		{ x += other.x; y += other.y; return *this; }
+			fixed2& operator-=	(const fixed2& other)		{ x -= other.x; y -= other.y; return *this; }
+			fixed2& operator*=	(const fix16 v)				{ x *= v; y *= v; return *this; }
+			fixed2& operator/=	(const fix16 v)				{ x /= v; y /= v; return *this; }
+
+			bool	operator==	(const fixed2& other) const	{ return x == other.x && y == other.y; }
+			bool	operator!=	(const fixed2& other) const	{ return !(*this == other); }
+
+			// functions
+
+			fixed2& set(fix16 nx, fix16 ny) { x = nx; y = ny; return *this; }
+
+			//! Gets the length of the vector.
+			/** Squares are summed in 64 bits, so any vector has its length. */
+			fix16 getLength() const
+			{
+				u64 sum = (u64)((s64)x.raw * x.raw) + (u64)((s64)y.raw * y.raw);
+				return fix16::fromRaw((s32)fixedSqrtBits(sum, 0));
+			}
+
+			//! Get the squared length of this vector
+			/** Wraps once the length passes 181. */
+			fix16 getLengthSQ() const { return dotProduct(*this); }
+
+			//! Get the dot product of this vector with another.
+			/** Rounded once from the exact sum. */
+			fix16 dotProduct(const fixed2& other) const
+			{
+				s64 sum = (s64)x.raw * other.x.raw + (s64)y.raw * other.y.raw;
+				return fix16::fromRaw((s32)((sum + 0x8000) >> 16));
+			}
+
+			//! Gets distance from another point.
+			fix16 getDistanceFrom(const fixed2& other) const
+			{
+				return fixed2(x - other.x, y - other.y).getLength();
+			}
+
+			//! Normalize the vector.
+			/** The null vector is left untouched.
+			\return Reference to this vector, after normalization. */
+			fixed2& normalize()
+			{
+				fix16 length = getLength();
+				if (length.raw == 0)
+					return *this;
+				x /= length;
+				y /= length;
+				return *this;
+			}
+
+			//! x coordinate of vector.
+			fix16 x;
+
+			//! y coordinate of vector.
+			fix16 y;
+		};
+
+	} // end namespace core
+} // end namespace lwge
+
+#endif
\ No newline at end of file
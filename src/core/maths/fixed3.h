@@ -0,0 +1,109 @@
+#ifndef __FIXED3_H__
+#define __FIXED3_H__
+
+#include "fixed.h"
+#include "float3.h"
+
+namespace lwge
+{
+	namespace core
+	{
+		//! 3d vector of fix16 for the simulation, the deterministic counterpart of float3.
+		class fixed3
+		{
+		public:
+			//! Default constructor (null vector)
+			fixed3() {}
+			//! Constructor with three different values
+			fixed3(fix16 nx, fix16 ny, fix16 nz) : x(nx), y(ny), z(nz) {}
+
+			//! Rounded to nearest; only for loading data.
+			static fixed3 fromFloat(const float3& v) { return fixed3(fix16::fromFloat(v.x), fix16::fromFloat(v.y), fix16::fromFloat(v.z)); }
+			//! For the render boundary.
+			float3 toFloat() const { return float3(x.toFloat(), y.toFloat(), z.toFloat()); }
+
+			// operators
+			fixed3	operator-	() const					{ return fixed3(-x, -y, -z); }
+
+			fixed3	operator+	(const fixed3& other) const	{ return fixed3(x + other.x, y + other.y, z + other.z); }
+			fixed3	operator-	(const fixed3& other) const	{ return fixed3(x - other.x, y - other.y, z - other.z); }
+			fixed3	operator*	(const fix16 v) const		{ return fixed3(x * v, y * v, z * v); }
+			fixed3	operator/	(const fix16 v) const		{ return fixed3(x / v, y / v, z / v); }
+
+			fixed3& operator+=	(const fixed3& other)		{ x += other.x; y += other.y; z += other.z; return *this; }
+			fixed3& operator-=	(const fixed3& other)		{ x -= other.x; y -= other.y; z -= other.z; return *this; }
+			fixed3& operator*=	(const fix16 v)				{ x *= v; y *= v; z *= v; return *this; }
+			fixed3& operator/=	(const fix16 v)				{ x /= v; y /= v; z /= v; return *this; }
+
+			bool	operator==	(const fixed3& other) const	{ return x == other.x && y == other.y && z == other.z; }
+			bool	operator!=	(const fixed3& other) const	{ return !(*this == other); }
+
+			// functions
+
+			fixed3& set(fix16 nx, fix16 ny, fix16 nz) { x = nx; y = ny; z = nz; return *this; }
+
+			//! Get length of the vector.
+			/** Squares are summed in 64 bits, so any vector has its length. */
+			fix16 getLength() const
+			{
+				u64 sum = (u64)((s64)x.raw * x.raw) + (u64)((s64)y.raw * y.raw) + (u64)((s64)z.raw * z.raw);
+				return fix16::fromRaw((s32)fixedSqrtBits(sum, 0));
+			}
+
+			//! Get squared length of the vector.
+			/** Wraps once the length passes 181. */
+			fix16 getLengthSQ() const { return dotProduct(*this); }
+
+			//! Get the dot product with another vector.
+			/** Rounded once from the exact sum. */
+			fix16 dotProduct(const fixed3& other) const
+			{
+				s64 sum = (s64)x.raw * other.x.raw + (s64)y.raw * other.y.raw + (s64)z.raw * other.z.raw;
+				return fix16::fromRaw((s32)((sum + 0x8000) >> 16));
+			}
+
+			//! Get distance from another point.
+			fix16 getDistanceFrom(const fixed3& other) const
+			{
+				return fixed3(x - other.x, y - other.y, z - other.z).getLength();
+			}
+
+			//! Calculates the cross product with another vector.
+			/** Every component is rounded once from the exact difference. */
+			fixed3 crossProduct(const fixed3& p) const
+			{
+				return fixed3(
+					fix16::fromRaw((s32)(((s64)y.raw * p.z.raw - (s64)z.raw * p.y.raw + 0x8000) >> 16)),
+					fix16::fromRaw((s32)(((s64)z.raw * p.x.raw - (s64)x.raw * p.z.raw + 0x8000) >> 16)),
+					fix16::fromRaw((s32)(((s64)x.raw * p.y.raw - (s64)y.raw * p.x.raw + 0x8000) >> 16)));
+			}
+
+			//! Normalizes the vector.
+			/** In case of the 0 vector the result is still 0, otherwise
+			the length of the vector will be 1.
+			\return Reference to this vector after normalization. */
+			fixed3& normalize()
+			{
+				fix16 length = getLength();
+				if (length.raw == 0)
+					return *this;
+				x /= length;
+				y /= length;
+				z /= length;
+				return *this;
+			}
+
+			//! x coordinate of the vector
+			fix16 x;
+
+			//! y coordinate of the vector
+			fix16 y;
+
+			//! z coordinate of the vector
+			fix16 z;
+		};
+
+	} // end namespace core
+} // end namespace lwge
+
+#endif
\ No newline at end of file
@@ -0,0 +1,120 @@
+#ifndef __FIXED_QUATERNION_H__
+#define __FIXED_QUATERNION_H__
+
+#include "fixed3.h"
+#include "matrix4.h"
+
+namespace lwge
+{
+	namespace core
+	{
+		//! Rotation quaternion of fix16 for the simulation.
+		/** Products drift off unit length by a few units of the last place;
+		normalize after a run of them. */
+		class fixedQuaternion
+		{
+		public:
+			//! Default Constructor (identity)
+			fixedQuaternion() : w(1) {}
+			//! Constructor
+			fixedQuaternion(fix16 nx, fix16 ny, fix16 nz, fix16 nw) : x(nx), y(ny), z(nz), w(nw) {}
+
+			//! Rotation by angle (radians) around axis, which must be unit length.
+			static fixedQuaternion fromAngleAxis(fix16 angle, const fixed3& axis)
+			{
+				fix16 half = fix16::fromRaw(angle.raw >> 1);
+				fix16 s = fixedSin(half);
+				return fixedQuaternion(axis.x * s, axis.y * s, axis.z * s, fixedCos(half));
+			}
+
+			//! Multiplication operator, applies other first.
+			fixedQuaternion operator*(const fixedQuaternion& other) const
+			{
+				return fixedQuaternion(
+					w * other.x + x * other.w + y * other.z - z * other.y,
+					w * other.y + y * other.w + z * other.x - x * other.z,
+					w * other.z + z * other.w + x * other.y - y * other.x,
+					w * other.w - x * other.x - y * other.y - z * other.z);
+			}
+
+			//! Rotates a vector.
+			fixed3 operator*(const fixed3& v) const
+			{
+				// v + 2w (q x v) + 2 q x (q x v)
+				fixed3 q(x, y, z);
+				fixed3 t = q.crossProduct(v) * fix16(2);
+				return v + t * w + q.crossProduct(t);
+			}
+
+			bool operator==(const fixedQuaternion& other) const { return x == other.x && y == other.y && z == other.z && w == other.w; }
+			bool operator!=(const fixedQuaternion& other) const { return !(*this == other); }
+
+			//! Calculates the dot product
+			fix16 dotProduct(const fixedQuaternion& other) const
+			{
+				s64 sum = (s64)x.raw * other.x.raw + (s64)y.raw * other.y.raw + (s64)z.raw * other.z.raw + (s64)w.raw * other.w.raw;
+				return fix16::fromRaw((s32)((sum + 0x8000) >> 16));
+			}
+
+			//! Normalizes the quaternion
+			fixedQuaternion& normalize()
+			{
+				u64 sum = (u64)((s64)x.raw * x.raw) + (u64)((s64)y.raw * y.raw) + (u64)((s64)z.raw * z.raw) + (u64)((s64)w.raw * w.raw);
+				fix16 length = fix16::fromRaw((s32)fixedSqrtBits(sum, 0));
+				if (length.raw == 0)
+					return *this;
+				x /= length;
+				y /= length;
+				z /= length;
+				w /= length;
+				return *this;
+			}
+
+			//! Inverts this quaternion, which must be unit length.
+			fixedQuaternion& makeInverse()
+			{
+				x = -x;
+				y = -y;
+				z = -z;
+				return *this;
+			}
+
+			//! Creates a matrix from this quaternion for the render boundary.
+			/** Same layout as quaternion::getMatrix. */
+			void getMatrix(matrix4& dest, const fixed3& translation) const
+			{
+				f32 X = x.toFloat(), Y = y.toFloat(), Z = z.toFloat(), W = w.toFloat();
+				dest[0] = 1.0f - 2.0f*Y*Y - 2.0f*Z*Z;
+				dest[1] = 2.0f*X*Y + 2.0f*Z*W;
+				dest[2] = 2.0f*X*Z - 2.0f*Y*W;
+				dest[3] = 0.0f;
+
+				dest[4] = 2.0f*X*Y - 2.0f*Z*W;
+				dest[5] = 1.0f - 2.0f*X*X - 2.0f*Z*Z;
+				dest[6] = 2.0f*Z*Y + 2.0f*X*W;
+				dest[7] = 0.0f;
+
+				dest[8] = 2.0f*X*Z + 2.0f*Y*W;
+				dest[9] = 2.0f*Z*Y - 2.0f*X*W;
+				dest[10] = 1.0f - 2.0f*X*X - 2.0f*Y*Y;
+				dest[11] = 0.0f;
+
+				dest[12] = translation.x.toFloat();
+				dest[13] = translation.y.toFloat();
+				dest[14] = translation.z.toFloat();
+				dest[15] = 1.0f;
+
+				dest.setDefinitelyIdentityMatrix(false);
+			}
+
+			//! Quaternion elements.
+			fix16 x; // vectorial (imaginary) part
+			fix16 y;
+			fix16 z;
+			fix16 w; // real part
+		};
+
+	} // end namespace core
+} // end namespace lwge
+
+#endif
\ No newline at end of file
@@ -1,61 +1,134 @@
 #include "mesh.h"
 #include <opengl/glad.h>
 #include <stdlib.h>
+#include <math.h>
 
 struct Mesh
 {
-	GLuint boIds[2];
+	GeometryPool* pool;
+	GeometryPool_Allocation allocation;
 	GLuint indexCount;
 	GLuint materialIndex;
+	Aabb bounds;
+	float4 sphere;
 };
 
+static void Mesh_ComputeBounds(Mesh* mesh, const Mesh_Data* mesh_data)
+{
+	Aabb* bounds = &mesh->bounds;
+	if (mesh_data->vertexCount == 0)
+	{
+		bounds->min.x = bounds->min.y = bounds->min.z = 0.0f;
+		bounds->max = bounds->min;
+	}
+	else
+	{
+		bounds->min = bounds->max = mesh_data->vertices[0].position;
+	}
+
+	for (uint32 i = 1; i < mesh_data->vertexCount; i++)
+	{
+		const float3* p = &mesh_data->vertices[i].position;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (p->data[axis] < bounds->min.data[axis])
+				bounds->min.data[axis] = p->data[axis];
+			if (p->data[axis] > bounds->max.data[axis])
+				bounds->max.data[axis] = p->data[axis];
+		}
+	}
+
+	float4* sphere = &mesh->sphere;
+	sphere->x = (bounds->min.x + bounds->max.x) * 0.5f;
+	sphere->y = (bounds->min.y + bounds->max.y) * 0.5f;
+	sphere->z = (bounds->min.z + bounds->max.z) * 0.5f;
+	float radiusSq = 0.0f;
+	for (uint32 i = 0; i < mesh_data->vertexCount; i++)
+	{
+		const float3* p = &mesh_data->vertices[i].position;
+		float dx = p->x - sphere->x;
+		float dy = p->y - sphere->y;
+		float dz = p->z - sphere->z;
+		float distanceSq = dx * dx + dy * dy + dz * dz;
+		if (distanceSq > radiusSq)
+			radiusSq = distanceSq;
+	}
+	sphere->w = sqrtf(radiusSq);
+}
+
 Mesh* Mesh_Create(const Mesh_Data* mesh_data)
 {
+	return Mesh_CreateInPool(GeometryPool_GetShared(), mesh_data);
+}
+
+Mesh* Mesh_CreateInPool(GeometryPool* pool, const Mesh_Data* mesh_data)
+{
+	ASSERT(pool != NULL && mesh_data != NULL);
+
 	GLushort* indices = (GLushort*)malloc(sizeof(GLushort) * mesh_data->indexCount);
 	for (int i = 0; i < mesh_data->indexCount; i++)
 	{
+		ASSERT(mesh_data->indices[i] <= 0xffff);
 		indices[i] = (GLushort)mesh_data->indices[i];
 	}
 
 	Mesh* mesh = (Mesh*)malloc(sizeof(Mesh));
+	mesh->pool = pool;
 
-	glGenBuffers(2, mesh->boIds);
-
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->boIds[0]);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->boIds[1]);
-	
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * mesh_data->vertexCount, mesh_data->vertices, GL_STATIC_DRAW);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * mesh_data->indexCount, indices, GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	Result result = GeometryPool_Allocate(pool, mesh_data->vertices, mesh_data->vertexCount, indices, mesh_data->indexCount, &mesh->allocation);
+	free(indices);
+	if (result != Result_SUCCESS)
+	{
+		free(mesh);
+		return NULL;
+	}
 
 	mesh->indexCount = mesh_data->indexCount;
-
-	free(indices);
+	Mesh_ComputeBounds(mesh, mesh_data);
 
 	return mesh;
 }
 
 void Mesh_Destroy(Mesh* mesh)
 {
-	glDeleteBuffers(2, mesh->boIds);
+	GeometryPool_Free(mesh->pool, &mesh->allocation);
 	free(mesh);
 }
 
 void Mesh_BindBuffer(const Mesh* mesh)
 {
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->boIds[0]);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->boIds[1]);
+	GeometryPool_Bind(mesh->pool);
 }
 
 void Mesh_UnbindBuffer(const Mesh* mesh)
 {
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	GeometryPool_Unbind(mesh->pool);
 }
 
 void Mesh_Draw(const Mesh* mesh)
 {
-	glDrawElements(GL_TRIANGLES, mesh->indexCount, GL_UNSIGNED_SHORT, 0);
+	GeometryPool_Range range;
+	GeometryPool_GetRange(mesh->pool, &mesh->allocation, &range);
+	GeometryPool_Draw(mesh->pool, mesh->indexCount, range.firstIndex, range.baseVertex, 1);
+}
+
+GeometryPool* Mesh_GetPool(const Mesh* mesh)
+{
+	return mesh->pool;
+}
+
+void Mesh_GetRange(const Mesh* mesh, GeometryPool_Range* range)
+{
+	GeometryPool_GetRange(mesh->pool, &mesh->allocation, range);
+	range->indexCount = mesh->indexCount;
+}
+
+void Mesh_GetBounds(const Mesh* mesh, Aabb* bounds)
+{
+	*bounds = mesh->bounds;
+}
+
+void Mesh_GetBoundingSphere(const Mesh* mesh, float4* sphere)
+{
+	*sphere = mesh->sphere;
 }
\ No newline at end of file
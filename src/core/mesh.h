@@ -2,7 +2,9 @@
 #define __MESH_H__
 
 #include "config.h"
+#include "maths.h"
 #include "vertex.h"
+#include "geometry_pool.h"
 
 typedef struct Mesh_Data
 {
@@ -15,10 +17,16 @@ typedef struct Mesh_Data
 typedef struct Mesh Mesh;
 
 Mesh* Mesh_Create(const Mesh_Data* mesh_data);
+Mesh* Mesh_CreateInPool(GeometryPool* pool, const Mesh_Data* mesh_data);
 void Mesh_Destroy(Mesh* mesh);
 
 void Mesh_BindBuffer(const Mesh* Mesh);
 void Mesh_UnbindBuffer(const Mesh* mesh);
 void Mesh_Draw(const Mesh* mesh);
 
+GeometryPool* Mesh_GetPool(const Mesh* mesh);
+void Mesh_GetRange(const Mesh* mesh, GeometryPool_Range* range);
+void Mesh_GetBounds(const Mesh* mesh, Aabb* bounds);
+void Mesh_GetBoundingSphere(const Mesh* mesh, float4* sphere);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,833 @@
+#include "occlusion.h"
+#include "simd.h"
+#include "timer.h"
+#include <math.h>
+#include <string.h>
+
+#define OCCLUSION_BAND_HEIGHT 16
+#define OCCLUSION_NEAR 0.0001f
+#define OCCLUSION_MAX_RESOLUTION 64
+#define OCCLUSION_MAX_EDGES 9
+#define OCCLUSION_MAX_PLANES 4
+#define OCCLUDER_NO_NEIGHBOUR 0xffffffff
+
+// Cell states used while voxelizing a mesh in Occluder_Generate. After the
+// flood fill, cells still EMPTY are the ones enclosed by the surface.
+#define OCCLUDER_CELL_EMPTY 0
+#define OCCLUDER_CELL_SURFACE 1
+#define OCCLUDER_CELL_OUTSIDE 2
+#define OCCLUDER_CELL_INSIDE 3
+
+struct Occluder
+{
+	float3* positions;
+	uint32 vertexCount;
+	uint32* indices;
+	uint32 indexCount;
+	// Per triangle edge, the far vertex of the triangle across it, or
+	// OCCLUDER_NO_NEIGHBOUR on an open edge.
+	uint32* adjacency;
+};
+
+typedef struct Occluder_Edge
+{
+	uint32 v0;
+	uint32 v1;
+	uint32 index;
+} Occluder_Edge;
+
+typedef struct Occluder_Weld
+{
+	float3 position;
+	uint32 vertex;
+} Occluder_Weld;
+
+// A triangle set up for rasterization. A pixel is written only when every
+// edge function (a, b, c) is non-negative at its centre, and gets the
+// largest of the depth planes (dzdx, dzdy, z0).
+typedef struct Occlusion_Triangle
+{
+	float edges[OCCLUSION_MAX_EDGES][3];
+	float planes[OCCLUSION_MAX_PLANES][3];
+	uint32 edgeCount;
+	uint32 planeCount;
+	int32 minX;
+	int32 maxX;
+	int32 minY;
+	int32 maxY;
+} Occlusion_Triangle;
+
+struct OcclusionBuffer
+{
+	uint32 width;
+	uint32 height;
+	float* depth;
+	matrix4x4 viewProjection;
+	Occlusion_Triangle* triangles;
+	uint32 triangleCount;
+	uint32 triangleCapacity;
+	float4* projected;
+	uint32 projectedCapacity;
+	OcclusionBuffer_Stats stats;
+};
+
+static Occluder* Occluder_Allocate(uint32 vertexCount, uint32 indexCount)
+{
+	Occluder* occluder = (Occluder*)malloc(sizeof(Occluder));
+	occluder->positions = (float3*)malloc(sizeof(float3) * (vertexCount > 0 ? vertexCount : 1));
+	occluder->indices = (uint32*)malloc(sizeof(uint32) * (indexCount > 0 ? indexCount : 1));
+	occluder->adjacency = (uint32*)malloc(sizeof(uint32) * (indexCount > 0 ? indexCount : 1));
+	occluder->vertexCount = vertexCount;
+	occluder->indexCount = indexCount;
+	return occluder;
+}
+
+static int Occluder_CompareWelds(const void* a, const void* b)
+{
+	const Occluder_Weld* left = (const Occluder_Weld*)a;
+	const Occluder_Weld* right = (const Occluder_Weld*)b;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (left->position.data[axis] != right->position.data[axis])
+			return left->position.data[axis] < right->position.data[axis] ? -1 : 1;
+	}
+	return 0;
+}
+
+static int Occluder_CompareEdges(const void* a, const void* b)
+{
+	const Occluder_Edge* left = (const Occluder_Edge*)a;
+	const Occluder_Edge* right = (const Occluder_Edge*)b;
+	if (left->v0 != right->v0)
+		return left->v0 < right->v0 ? -1 : 1;
+	if (left->v1 != right->v1)
+		return left->v1 < right->v1 ? -1 : 1;
+	return 0;
+}
+
+// Pairs up triangles sharing an edge. Vertices are welded by position first
+// since meshes split them along texture seams.
+static void Occluder_BuildAdjacency(Occluder* occluder)
+{
+	uint32 triangleCount = occluder->indexCount / 3;
+	for (uint32 i = 0; i < occluder->indexCount; i++)
+	{
+		occluder->adjacency[i] = OCCLUDER_NO_NEIGHBOUR;
+	}
+	if (triangleCount == 0)
+		return;
+
+	Occluder_Weld* welds = (Occluder_Weld*)malloc(sizeof(Occluder_Weld) * occluder->vertexCount);
+	uint32* canonical = (uint32*)malloc(sizeof(uint32) * occluder->vertexCount);
+	for (uint32 i = 0; i < occluder->vertexCount; i++)
+	{
+		welds[i].position = occluder->positions[i];
+		welds[i].vertex = i;
+	}
+	qsort(welds, occluder->vertexCount, sizeof(Occluder_Weld), Occluder_CompareWelds);
+	for (uint32 i = 0; i < occluder->vertexCount; i++)
+	{
+		uint32 first = i > 0 && Occluder_CompareWelds(&welds[i - 1], &welds[i]) == 0 ? canonical[welds[i - 1].vertex] : welds[i].vertex;
+		canonical[welds[i].vertex] = first;
+	}
+
+	Occluder_Edge* edges = (Occluder_Edge*)malloc(sizeof(Occluder_Edge) * triangleCount * 3);
+	for (uint32 i = 0; i < triangleCount * 3; i++)
+	{
+		uint32 a = canonical[occluder->indices[i]];
+		uint32 b = canonical[occluder->indices[i - i % 3 + (i + 1) % 3]];
+		edges[i].v0 = a < b ? a : b;
+		edges[i].v1 = a < b ? b : a;
+		edges[i].index = i;
+	}
+	qsort(edges, triangleCount * 3, sizeof(Occluder_Edge), Occluder_CompareEdges);
+
+	// Within a run of equal edges each one takes the next as its neighbour;
+	// any of them will do for a non-manifold edge.
+	for (uint32 first = 0; first < triangleCount * 3;)
+	{
+		uint32 last = first + 1;
+		while (last < triangleCount * 3 && Occluder_CompareEdges(&edges[first], &edges[last]) == 0)
+			last++;
+		if (last - first > 1)
+		{
+			for (uint32 i = first; i < last; i++)
+			{
+				uint32 other = edges[i + 1 < last ? i + 1 : first].index;
+				occluder->adjacency[edges[i].index] = occluder->indices[other - other % 3 + (other + 2) % 3];
+			}
+		}
+		first = last;
+	}
+
+	free(edges);
+	free(canonical);
+	free(welds);
+}
+
+Occluder* Occluder_Create(const Mesh_Data* mesh_data)
+{
+	Occluder* occluder = Occluder_Allocate(mesh_data->vertexCount, mesh_data->indexCount);
+	for (uint32 i = 0; i < mesh_data->vertexCount; i++)
+	{
+		occluder->positions[i] = mesh_data->vertices[i].position;
+	}
+	memcpy(occluder->indices, mesh_data->indices, sizeof(uint32) * mesh_data->indexCount);
+	Occluder_BuildAdjacency(occluder);
+	return occluder;
+}
+
+// Separating axis test between a triangle, given relative to a cell centre,
+// and the cell. Used by Occluder_Generate to find the cells the surface
+// passes through.
+static int Occluder_TriangleTouchesCell(const float3 v[3], const float3* halfSize)
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float minP = fminf(v[0].data[axis], fminf(v[1].data[axis], v[2].data[axis]));
+		float maxP = fmaxf(v[0].data[axis], fmaxf(v[1].data[axis], v[2].data[axis]));
+		if (minP > halfSize->data[axis] || maxP < -halfSize->data[axis])
+			return 0;
+	}
+
+	float3 edges[3];
+	for (int k = 0; k < 3; k++)
+	{
+		const float3* p = &v[k];
+		const float3* q = &v[(k + 1) % 3];
+		edges[k].x = q->x - p->x;
+		edges[k].y = q->y - p->y;
+		edges[k].z = q->z - p->z;
+	}
+
+	// The triangle plane, then the nine edge / cell axis cross products.
+	float3 axes[10];
+	axes[0].x = edges[0].y * edges[1].z - edges[0].z * edges[1].y;
+	axes[0].y = edges[0].z * edges[1].x - edges[0].x * edges[1].z;
+	axes[0].z = edges[0].x * edges[1].y - edges[0].y * edges[1].x;
+	for (int k = 0; k < 3; k++)
+	{
+		const float3* e = &edges[k];
+		axes[1 + k * 3].x = 0.0f;      axes[1 + k * 3].y = -e->z;     axes[1 + k * 3].z = e->y;
+		axes[2 + k * 3].x = e->z;      axes[2 + k * 3].y = 0.0f;      axes[2 + k * 3].z = -e->x;
+		axes[3 + k * 3].x = -e->y;     axes[3 + k * 3].y = e->x;      axes[3 + k * 3].z = 0.0f;
+	}
+
+	for (int i = 0; i < 10; i++)
+	{
+		const float3* n = &axes[i];
+		float p0 = n->x * v[0].x + n->y * v[0].y + n->z * v[0].z;
+		float p1 = n->x * v[1].x + n->y * v[1].y + n->z * v[1].z;
+		float p2 = n->x * v[2].x + n->y * v[2].y + n->z * v[2].z;
+		float r = fabsf(n->x) * halfSize->x + fabsf(n->y) * halfSize->y + fabsf(n->z) * halfSize->z;
+		if (fminf(p0, fminf(p1, p2)) > r || fmaxf(p0, fmaxf(p1, p2)) < -r)
+			return 0;
+	}
+	return 1;
+}
+
+Occluder* Occluder_Generate(const Mesh_Data* mesh_data, uint32 resolution)
+{
+	ASSERT(resolution > 0 && resolution <= OCCLUSION_MAX_RESOLUTION);
+	if (mesh_data->vertexCount == 0)
+		return Occluder_Allocate(0, 0);
+
+	Aabb bounds;
+	bounds.min = bounds.max = mesh_data->vertices[0].position;
+	for (uint32 i = 1; i < mesh_data->vertexCount; i++)
+	{
+		const float3* p = &mesh_data->vertices[i].position;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (p->data[axis] < bounds.min.data[axis])
+				bounds.min.data[axis] = p->data[axis];
+			if (p->data[axis] > bounds.max.data[axis])
+				bounds.max.data[axis] = p->data[axis];
+		}
+	}
+
+	float3 cellSize;
+	float3 halfSize;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		cellSize.data[axis] = (bounds.max.data[axis] - bounds.min.data[axis]) / resolution;
+		if (cellSize.data[axis] <= 0.0f)
+			return Occluder_Allocate(0, 0);
+		// Slightly oversized so rounding never lets a crossing slip past.
+		halfSize.data[axis] = cellSize.data[axis] * 0.505f;
+	}
+
+	// Mark every cell the surface passes through.
+	uint32 cellCount = resolution * resolution * resolution;
+	uint8* state = (uint8*)malloc(cellCount);
+	memset(state, OCCLUDER_CELL_EMPTY, cellCount);
+	for (uint32 i = 0; i + 2 < mesh_data->indexCount; i += 3)
+	{
+		const float3* p[3] =
+		{
+			&mesh_data->vertices[mesh_data->indices[i]].position,
+			&mesh_data->vertices[mesh_data->indices[i + 1]].position,
+			&mesh_data->vertices[mesh_data->indices[i + 2]].position
+		};
+		uint32 first[3], last[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float minP = fminf(p[0]->data[axis], fminf(p[1]->data[axis], p[2]->data[axis]));
+			float maxP = fmaxf(p[0]->data[axis], fmaxf(p[1]->data[axis], p[2]->data[axis]));
+			int32 f = (int32)((minP - bounds.min.data[axis]) / cellSize.data[axis]) - 1;
+			int32 l = (int32)((maxP - bounds.min.data[axis]) / cellSize.data[axis]) + 1;
+			first[axis] = f < 0 ? 0 : f;
+			last[axis] = l >= (int32)resolution ? resolution - 1 : (uint32)l;
+		}
+
+		for (uint32 z = first[2]; z <= last[2]; z++)
+		for (uint32 y = first[1]; y <= last[1]; y++)
+		for (uint32 x = first[0]; x <= last[0]; x++)
+		{
+			uint32 cell = (z * resolution + y) * resolution + x;
+			if (state[cell] == OCCLUDER_CELL_SURFACE)
+				continue;
+			float3 local[3];
+			for (int k = 0; k < 3; k++)
+			{
+				local[k].x = p[k]->x - (bounds.min.x + (x + 0.5f) * cellSize.x);
+				local[k].y = p[k]->y - (bounds.min.y + (y + 0.5f) * cellSize.y);
+				local[k].z = p[k]->z - (bounds.min.z + (z + 0.5f) * cellSize.z);
+			}
+			if (Occluder_TriangleTouchesCell(local, &halfSize))
+				state[cell] = OCCLUDER_CELL_SURFACE;
+		}
+	}
+
+	// Flood the untouched cells from the grid border; whatever the flood
+	// cannot reach is enclosed by the surface. An open mesh leaks and simply
+	// yields no occluder.
+	uint32* stack = (uint32*)malloc(sizeof(uint32) * cellCount);
+	uint32 stackSize = 0;
+	for (uint32 z = 0; z < resolution; z++)
+	for (uint32 y = 0; y < resolution; y++)
+	for (uint32 x = 0; x < resolution; x++)
+	{
+		if (x != 0 && y != 0 && z != 0 && x != resolution - 1 && y != resolution - 1 && z != resolution - 1)
+			continue;
+		uint32 cell = (z * resolution + y) * resolution + x;
+		if (state[cell] == OCCLUDER_CELL_EMPTY)
+		{
+			state[cell] = OCCLUDER_CELL_OUTSIDE;
+			stack[stackSize++] = cell;
+		}
+	}
+	while (stackSize > 0)
+	{
+		uint32 cell = stack[--stackSize];
+		uint32 x = cell % resolution;
+		uint32 y = (cell / resolution) % resolution;
+		uint32 z = cell / (resolution * resolution);
+		uint32 neighbours[6];
+		uint32 neighbourCount = 0;
+		if (x > 0) neighbours[neighbourCount++] = cell - 1;
+		if (x + 1 < resolution) neighbours[neighbourCount++] = cell + 1;
+		if (y > 0) neighbours[neighbourCount++] = cell - resolution;
+		if (y + 1 < resolution) neighbours[neighbourCount++] = cell + resolution;
+		if (z > 0) neighbours[neighbourCount++] = cell - resolution * resolution;
+		if (z + 1 < resolution) neighbours[neighbourCount++] = cell + resolution * resolution;
+		for (uint32 k = 0; k < neighbourCount; k++)
+		{
+			if (state[neighbours[k]] == OCCLUDER_CELL_EMPTY)
+			{
+				state[neighbours[k]] = OCCLUDER_CELL_OUTSIDE;
+				stack[stackSize++] = neighbours[k];
+			}
+		}
+	}
+	free(stack);
+
+	// Merge the enclosed cells greedily into boxes; every box lies inside
+	// the mesh, so the occluder can never cover more than the mesh does.
+	uint32 boxCount = 0;
+	uint32 boxCapacity = 16;
+	uint32* boxes = (uint32*)malloc(sizeof(uint32) * 6 * boxCapacity);
+	for (uint32 z = 0; z < resolution; z++)
+	for (uint32 y = 0; y < resolution; y++)
+	for (uint32 x = 0; x < resolution; x++)
+	{
+		if (state[(z * resolution + y) * resolution + x] != OCCLUDER_CELL_EMPTY)
+			continue;
+
+		uint32 endX = x + 1;
+		while (endX < resolution && state[(z * resolution + y) * resolution + endX] == OCCLUDER_CELL_EMPTY)
+			endX++;
+
+		uint32 endY = y + 1;
+		for (; endY < resolution; endY++)
+		{
+			uint32 i = x;
+			while (i < endX && state[(z * resolution + endY) * resolution + i] == OCCLUDER_CELL_EMPTY)
+				i++;
+			if (i < endX)
+				break;
+		}
+
+		uint32 endZ = z + 1;
+		for (; endZ < resolution; endZ++)
+		{
+			int full = 1;
+			for (uint32 j = y; j < endY && full; j++)
+			for (uint32 i = x; i < endX && full; i++)
+			{
+				full = state[(endZ * resolution + j) * resolution + i] == OCCLUDER_CELL_EMPTY;
+			}
+			if (!full)
+				break;
+		}
+
+		for (uint32 k = z; k < endZ; k++)
+		for (uint32 j = y; j < endY; j++)
+		for (uint32 i = x; i < endX; i++)
+		{
+			state[(k * resolution + j) * resolution + i] = OCCLUDER_CELL_INSIDE;
+		}
+
+		if (boxCount == boxCapacity)
+		{
+			boxCapacity *= 2;
+			boxes = (uint32*)realloc(boxes, sizeof(uint32) * 6 * boxCapacity);
+		}
+		uint32* box = &boxes[boxCount++ * 6];
+		box[0] = x; box[1] = y; box[2] = z;
+		box[3] = endX; box[4] = endY; box[5] = endZ;
+	}
+
+	static const uint32 boxIndices[36] =
+	{
+		0, 2, 1, 1, 2, 3,
+		4, 5, 6, 5, 7, 6,
+		0, 1, 4, 1, 5, 4,
+		2, 6, 3, 3, 6, 7,
+		0, 4, 2, 2, 4, 6,
+		1, 3, 5, 3, 7, 5
+	};
+
+	Occluder* occluder = Occluder_Allocate(boxCount * 8, boxCount * 36);
+	for (uint32 b = 0; b < boxCount; b++)
+	{
+		const uint32* box = &boxes[b * 6];
+		for (uint32 corner = 0; corner < 8; corner++)
+		{
+			float3* position = &occluder->positions[b * 8 + corner];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				uint32 c = (corner >> axis) & 1 ? box[3 + axis] : box[axis];
+				position->data[axis] = bounds.min.data[axis] + c * cellSize.data[axis];
+			}
+		}
+		for (uint32 i = 0; i < 36; i++)
+		{
+			occluder->indices[b * 36 + i] = b * 8 + boxIndices[i];
+		}
+	}
+
+	free(boxes);
+	free(state);
+	Occluder_BuildAdjacency(occluder);
+	return occluder;
+}
+
+void Occluder_Destroy(Occluder* occluder)
+{
+	free(occluder->positions);
+	free(occluder->indices);
+	free(occluder->adjacency);
+	free(occluder);
+}
+
+uint32 Occluder_GetTriangleCount(const Occluder* occluder)
+{
+	return occluder->indexCount / 3;
+}
+
+OcclusionBuffer* OcclusionBuffer_Create(uint32 width, uint32 height)
+{
+	ASSERT(width > 0 && height > 0);
+	OcclusionBuffer* buffer = (OcclusionBuffer*)malloc(sizeof(OcclusionBuffer));
+	buffer->width = (width + 3) & ~3;
+	buffer->height = height;
+	buffer->depth = (float*)malloc(sizeof(float) * buffer->width * buffer->height);
+	buffer->triangleCount = 0;
+	buffer->triangleCapacity = 1024;
+	buffer->triangles = (Occlusion_Triangle*)malloc(sizeof(Occlusion_Triangle) * buffer->triangleCapacity);
+	buffer->projectedCapacity = 256;
+	buffer->projected = (float4*)malloc(sizeof(float4) * buffer->projectedCapacity);
+	Matrix4x4_Identity(&buffer->viewProjection);
+	memset(&buffer->stats, 0, sizeof(OcclusionBuffer_Stats));
+	return buffer;
+}
+
+void OcclusionBuffer_Destroy(OcclusionBuffer* buffer)
+{
+	free(buffer->projected);
+	free(buffer->triangles);
+	free(buffer->depth);
+	free(buffer);
+}
+
+void OcclusionBuffer_Begin(OcclusionBuffer* buffer, const matrix4x4* viewProjection)
+{
+	buffer->viewProjection = *viewProjection;
+	buffer->triangleCount = 0;
+	memset(&buffer->stats, 0, sizeof(OcclusionBuffer_Stats));
+}
+
+// Adds the edge through p and q to a triangle, facing the side "inside" is
+// on. Inset edges are pulled in by half a pixel so that testing them at a
+// pixel centre accepts only pixels lying wholly on the inner side.
+static void Occlusion_AddEdge(Occlusion_Triangle* triangle, const float4* p, const float4* q, const float4* inside, int inset)
+{
+	float* edge = triangle->edges[triangle->edgeCount++];
+	edge[0] = -(q->y - p->y);
+	edge[1] = q->x - p->x;
+	edge[2] = -(edge[0] * p->x + edge[1] * p->y);
+	if (edge[0] * inside->x + edge[1] * inside->y + edge[2] < 0.0f)
+	{
+		edge[0] = -edge[0];
+		edge[1] = -edge[1];
+		edge[2] = -edge[2];
+	}
+	if (inset)
+		edge[2] -= 0.5f * (fabsf(edge[0]) + fabsf(edge[1]));
+}
+
+// Adds the depth plane through three points, raised to the farthest value
+// it takes within a pixel so the occluder never appears nearer than it is.
+static void Occlusion_AddPlane(Occlusion_Triangle* triangle, const float4* p0, const float4* p1, const float4* p2)
+{
+	float* plane = triangle->planes[triangle->planeCount++];
+	float area = (p1->x - p0->x) * (p2->y - p0->y) - (p2->x - p0->x) * (p1->y - p0->y);
+	plane[0] = ((p1->z - p0->z) * (p2->y - p0->y) - (p2->z - p0->z) * (p1->y - p0->y)) / area;
+	plane[1] = ((p2->z - p0->z) * (p1->x - p0->x) - (p1->z - p0->z) * (p2->x - p0->x)) / area;
+	plane[2] = p0->z - plane[0] * p0->x - plane[1] * p0->y + 0.5f * (fabsf(plane[0]) + fabsf(plane[1]));
+}
+
+static float Occlusion_EdgeSide(const float4* p, const float4* q, const float4* point)
+{
+	return (q->x - p->x) * (point->y - p->y) - (q->y - p->y) * (point->x - p->x);
+}
+
+void OcclusionBuffer_AddOccluder(OcclusionBuffer* buffer, const Occluder* occluder, const matrix4x4* transform)
+{
+	double start = Timer_GetMilliseconds();
+
+	matrix4x4 modelViewProjection;
+	Matrix4x4_Multiply(&buffer->viewProjection, transform, &modelViewProjection);
+
+	if (occluder->vertexCount > buffer->projectedCapacity)
+	{
+		buffer->projectedCapacity = occluder->vertexCount;
+		buffer->projected = (float4*)realloc(buffer->projected, sizeof(float4) * buffer->projectedCapacity);
+	}
+
+	// Vertices in front of the near plane are taken to pixel coordinates and
+	// depth, keeping w so the others can be recognised.
+	float width = (float)buffer->width;
+	float height = (float)buffer->height;
+	for (uint32 i = 0; i < occluder->vertexCount; i++)
+	{
+		float4* v = &buffer->projected[i];
+		Matrix4x4_TransformPoint(&modelViewProjection, &occluder->positions[i], v);
+		if (v->w < OCCLUSION_NEAR)
+			continue;
+		float invW = 1.0f / v->w;
+		v->x = (v->x * invW * 0.5f + 0.5f) * width;
+		v->y = (v->y * invW * 0.5f + 0.5f) * height;
+		v->z = v->z * invW * 0.5f + 0.5f;
+	}
+
+	uint32 added = 0;
+	for (uint32 i = 0; i + 2 < occluder->indexCount; i += 3)
+	{
+		const float4* v[3] =
+		{
+			&buffer->projected[occluder->indices[i]],
+			&buffer->projected[occluder->indices[i + 1]],
+			&buffer->projected[occluder->indices[i + 2]]
+		};
+
+		// Triangles crossing the near plane are dropped, which only ever
+		// removes occlusion and so keeps the test conservative.
+		if (v[0]->w < OCCLUSION_NEAR || v[1]->w < OCCLUSION_NEAR || v[2]->w < OCCLUSION_NEAR)
+			continue;
+
+		float area = Occlusion_EdgeSide(v[0], v[1], v[2]);
+		if (fabsf(area) < 1e-6f)
+			continue;
+
+		float minX = fminf(v[0]->x, fminf(v[1]->x, v[2]->x));
+		float maxX = fmaxf(v[0]->x, fmaxf(v[1]->x, v[2]->x));
+		float minY = fminf(v[0]->y, fminf(v[1]->y, v[2]->y));
+		float maxY = fmaxf(v[0]->y, fmaxf(v[1]->y, v[2]->y));
+		if (maxX < 0.0f || minX >= width || maxY < 0.0f || minY >= height)
+			continue;
+
+		Occlusion_Triangle triangle;
+		triangle.edgeCount = 0;
+		triangle.planeCount = 0;
+		triangle.minX = minX < 0.0f ? 0 : (int32)minX;
+		triangle.maxX = maxX >= width ? (int32)buffer->width - 1 : (int32)maxX;
+		triangle.minY = minY < 0.0f ? 0 : (int32)minY;
+		triangle.maxY = maxY >= height ? (int32)buffer->height - 1 : (int32)maxY;
+		Occlusion_AddPlane(&triangle, v[0], v[1], v[2]);
+
+		// Only whole pixels are written, but an edge shared with a triangle
+		// folding the other way on screen is no silhouette: a pixel may cross
+		// it as long as it stays inside the neighbour's other two edges, and
+		// then takes the farther of both planes.
+		for (int k = 0; k < 3; k++)
+		{
+			const float4* p = v[k];
+			const float4* q = v[(k + 1) % 3];
+			const float4* inside = v[(k + 2) % 3];
+			uint32 neighbour = occluder->adjacency[i + k];
+			const float4* far = neighbour != OCCLUDER_NO_NEIGHBOUR ? &buffer->projected[neighbour] : NULL;
+			if (far != NULL && far->w >= OCCLUSION_NEAR && Occlusion_EdgeSide(p, q, inside) * Occlusion_EdgeSide(p, q, far) < 0.0f && fabsf(Occlusion_EdgeSide(p, q, far)) >= 1e-6f)
+			{
+				Occlusion_AddEdge(&triangle, p, q, inside, 0);
+				Occlusion_AddEdge(&triangle, p, far, q, 1);
+				Occlusion_AddEdge(&triangle, q, far, p, 1);
+				Occlusion_AddPlane(&triangle, p, q, far);
+			}
+			else
+			{
+				Occlusion_AddEdge(&triangle, p, q, inside, 1);
+			}
+		}
+
+		if (buffer->triangleCount == buffer->triangleCapacity)
+		{
+			buffer->triangleCapacity *= 2;
+			buffer->triangles = (Occlusion_Triangle*)realloc(buffer->triangles, sizeof(Occlusion_Triangle) * buffer->triangleCapacity);
+		}
+		buffer->triangles[buffer->triangleCount++] = triangle;
+		added++;
+	}
+
+	buffer->stats.occluderCount++;
+	buffer->stats.triangleCount += added;
+	buffer->stats.setupTime += Timer_GetMilliseconds() - start;
+}
+
+uint32 OcclusionBuffer_GetBandCount(const OcclusionBuffer* buffer)
+{
+	return (buffer->height + OCCLUSION_BAND_HEIGHT - 1) / OCCLUSION_BAND_HEIGHT;
+}
+
+static void OcclusionBuffer_RasterizeTriangle(OcclusionBuffer* buffer, const Occlusion_Triangle* triangle, int32 firstRow, int32 lastRow)
+{
+	uint32 edgeCount = triangle->edgeCount;
+	uint32 planeCount = triangle->planeCount;
+	int32 startX = triangle->minX & ~3;
+	int32 endX = triangle->maxX;
+
+	int32 row = triangle->minY > firstRow ? triangle->minY : firstRow;
+	int32 last = triangle->maxY < lastRow ? triangle->maxY : lastRow;
+
+#ifdef SIMD_SSE
+	__m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	__m128 zero = _mm_setzero_ps();
+	__m128 edgeA[OCCLUSION_MAX_EDGES], edgeRow[OCCLUSION_MAX_EDGES];
+	__m128 planeA[OCCLUSION_MAX_PLANES], planeRow[OCCLUSION_MAX_PLANES];
+	for (uint32 e = 0; e < edgeCount; e++)
+	{
+		edgeA[e] = _mm_set1_ps(triangle->edges[e][0]);
+	}
+	for (uint32 p = 0; p < planeCount; p++)
+	{
+		planeA[p] = _mm_set1_ps(triangle->planes[p][0]);
+	}
+	for (; row <= last; row++)
+	{
+		float py = (float)row + 0.5f;
+		for (uint32 e = 0; e < edgeCount; e++)
+		{
+			edgeRow[e] = _mm_set1_ps(triangle->edges[e][1] * py + triangle->edges[e][2]);
+		}
+		for (uint32 p = 0; p < planeCount; p++)
+		{
+			planeRow[p] = _mm_set1_ps(triangle->planes[p][1] * py + triangle->planes[p][2]);
+		}
+		float* depth = buffer->depth + row * buffer->width;
+		for (int32 column = startX; column <= endX; column += 4)
+		{
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)column), offsets);
+			__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], px), edgeRow[0]), zero);
+			for (uint32 e = 1; e < edgeCount; e++)
+			{
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[e], px), edgeRow[e]), zero));
+			}
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+			__m128 pz = _mm_add_ps(_mm_mul_ps(planeA[0], px), planeRow[0]);
+			for (uint32 p = 1; p < planeCount; p++)
+			{
+				pz = _mm_max_ps(pz, _mm_add_ps(_mm_mul_ps(planeA[p], px), planeRow[p]));
+			}
+			__m128 current = _mm_loadu_ps(depth + column);
+			__m128 nearest = _mm_min_ps(current, pz);
+			_mm_storeu_ps(depth + column, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+		}
+	}
+#else
+	for (; row <= last; row++)
+	{
+		float py = (float)row + 0.5f;
+		float* depth = buffer->depth + row * buffer->width;
+		for (int32 column = startX; column <= endX; column++)
+		{
+			float px = (float)column + 0.5f;
+			uint32 e = 0;
+			while (e < edgeCount && triangle->edges[e][0] * px + triangle->edges[e][1] * py + triangle->edges[e][2] >= 0.0f)
+				e++;
+			if (e < edgeCount)
+				continue;
+			float pz = triangle->planes[0][0] * px + triangle->planes[0][1] * py + triangle->planes[0][2];
+			for (uint32 p = 1; p < planeCount; p++)
+			{
+				pz = fmaxf(pz, triangle->planes[p][0] * px + triangle->planes[p][1] * py + triangle->planes[p][2]);
+			}
+			if (pz < depth[column])
+				depth[column] = pz;
+		}
+	}
+#endif
+}
+
+void OcclusionBuffer_RasterizeBand(OcclusionBuffer* buffer, uint32 band)
+{
+	int32 firstRow = band * OCCLUSION_BAND_HEIGHT;
+	int32 lastRow = firstRow + OCCLUSION_BAND_HEIGHT - 1;
+	if (lastRow >= (int32)buffer->height)
+		lastRow = buffer->height - 1;
+
+	float* depth = buffer->depth + firstRow * buffer->width;
+	uint32 count = (lastRow - firstRow + 1) * buffer->width;
+	for (uint32 i = 0; i < count; i++)
+	{
+		depth[i] = 1.0f;
+	}
+
+	for (uint32 i = 0; i < buffer->triangleCount; i++)
+	{
+		const Occlusion_Triangle* triangle = &buffer->triangles[i];
+		if (triangle->maxY < firstRow || triangle->minY > lastRow)
+			continue;
+		OcclusionBuffer_RasterizeTriangle(buffer, triangle, firstRow, lastRow);
+	}
+}
+
+static void OcclusionBuffer_RasterizeRange(void* userData, uint32 begin, uint32 end)
+{
+	OcclusionBuffer* buffer = (OcclusionBuffer*)userData;
+	for (uint32 band = begin; band < end; band++)
+	{
+		OcclusionBuffer_RasterizeBand(buffer, band);
+	}
+}
+
+void OcclusionBuffer_Rasterize(OcclusionBuffer* buffer)
+{
+	OcclusionBuffer_RasterizeJobs(buffer, NULL);
+}
+
+void OcclusionBuffer_RasterizeJobs(OcclusionBuffer* buffer, JobSystem* jobs)
+{
+	double start = Timer_GetMilliseconds();
+	uint32 bandCount = OcclusionBuffer_GetBandCount(buffer);
+	if (jobs != NULL)
+		JobSystem_ParallelFor(jobs, bandCount, 1, OcclusionBuffer_RasterizeRange, buffer);
+	else
+		OcclusionBuffer_RasterizeRange(buffer, 0, bandCount);
+	buffer->stats.rasterizeTime += Timer_GetMilliseconds() - start;
+}
+
+int OcclusionBuffer_TestAabb(const OcclusionBuffer* buffer, const Aabb* bounds)
+{
+	float width = (float)buffer->width;
+	float height = (float)buffer->height;
+	float minX = width, maxX = -1.0f;
+	float minY = height, maxY = -1.0f;
+	float minZ = 1.0f;
+
+	for (int i = 0; i < 8; i++)
+	{
+		float3 corner;
+		corner.x = (i & 1) ? bounds->max.x : bounds->min.x;
+		corner.y = (i & 2) ? bounds->max.y : bounds->min.y;
+		corner.z = (i & 4) ? bounds->max.z : bounds->min.z;
+
+		float4 clip;
+		Matrix4x4_TransformPoint(&buffer->viewProjection, &corner, &clip);
+		if (clip.w < OCCLUSION_NEAR)
+			return 1;
+
+		float invW = 1.0f / clip.w;
+		float x = (clip.x * invW * 0.5f + 0.5f) * width;
+		float y = (clip.y * invW * 0.5f + 0.5f) * height;
+		float z = clip.z * invW * 0.5f + 0.5f;
+		minX = fminf(minX, x);
+		maxX = fmaxf(maxX, x);
+		minY = fminf(minY, y);
+		maxY = fmaxf(maxY, y);
+		minZ = fminf(minZ, z);
+	}
+
+	if (maxX < 0.0f || minX >= width || maxY < 0.0f || minY >= height)
+		return 1;
+
+	int32 startX = minX < 0.0f ? 0 : ((int32)minX & ~3);
+	int32 endX = maxX >= width ? (int32)buffer->width - 1 : (int32)maxX;
+	int32 startY = minY < 0.0f ? 0 : (int32)minY;
+	int32 endY = maxY >= height ? (int32)buffer->height - 1 : (int32)maxY;
+
+#ifdef SIMD_SSE
+	__m128 nearest = _mm_set1_ps(minZ);
+	for (int32 row = startY; row <= endY; row++)
+	{
+		const float* depth = buffer->depth + row * buffer->width;
+		for (int32 column = startX; column <= endX; column += 4)
+		{
+			if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(depth + column), nearest)) != 0)
+				return 1;
+		}
+	}
+#else
+	for (int32 row = startY; row <= endY; row++)
+	{
+		const float* depth = buffer->depth + row * buffer->width;
+		for (int32 column = startX; column <= endX; column++)
+		{
+			if (depth[column] >= minZ)
+				return 1;
+		}
+	}
+#endif
+	return 0;
+}
+
+uint32 OcclusionBuffer_TestAabbs(OcclusionBuffer* buffer, const Aabb* bounds, uint32 count, uint8* visible)
+{
+	double start = Timer_GetMilliseconds();
+	uint32 visibleCount = 0;
+	for (uint32 i = 0; i < count; i++)
+	{
+		visible[i] = (uint8)OcclusionBuffer_TestAabb(buffer, &bounds[i]);
+		visibleCount += visible[i];
+	}
+	buffer->stats.testedCount += count;
+	buffer->stats.occludedCount += count - visibleCount;
+	buffer->stats.testTime += Timer_GetMilliseconds() - start;
+	return visibleCount;
+}
+
+void OcclusionBuffer_GetStats(const OcclusionBuffer* buffer, OcclusionBuffer_Stats* stats)
+{
+	*stats = buffer->stats;
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef __OCCLUSION_H__
+#define __OCCLUSION_H__
+
+#include "config.h"
+#include "maths.h"
+#include "mesh.h"
+#include "job_system.h"
+
+// Software occlusion culling. Low-poly occluders are rasterized into a small
+// CPU depth buffer, then object bounds are tested against it before they are
+// submitted. The buffer is split into horizontal bands which can be
+// rasterized concurrently; OcclusionBuffer_Rasterize runs them all in turn,
+// OcclusionBuffer_RasterizeJobs spreads them over a job system.
+typedef struct Occluder Occluder;
+typedef struct OcclusionBuffer OcclusionBuffer;
+
+typedef struct OcclusionBuffer_Stats
+{
+	double setupTime;
+	double rasterizeTime;
+	double testTime;
+	uint32 occluderCount;
+	uint32 triangleCount;
+	uint32 testedCount;
+	uint32 occludedCount;
+} OcclusionBuffer_Stats;
+
+Occluder* Occluder_Create(const Mesh_Data* mesh_data);
+// Builds boxes from the cells of a resolution^3 grid that lie wholly inside a
+// closed mesh, so the result never covers more than the mesh itself. Open
+// meshes produce an empty occluder.
+Occluder* Occluder_Generate(const Mesh_Data* mesh_data, uint32 resolution);
+void Occluder_Destroy(Occluder* occluder);
+uint32 Occluder_GetTriangleCount(const Occluder* occluder);
+
+OcclusionBuffer* OcclusionBuffer_Create(uint32 width, uint32 height);
+void OcclusionBuffer_Destroy(OcclusionBuffer* buffer);
+
+void OcclusionBuffer_Begin(OcclusionBuffer* buffer, const matrix4x4* viewProjection);
+void OcclusionBuffer_AddOccluder(OcclusionBuffer* buffer, const Occluder* occluder, const matrix4x4* transform);
+
+uint32 OcclusionBuffer_GetBandCount(const OcclusionBuffer* buffer);
+void OcclusionBuffer_RasterizeBand(OcclusionBuffer* buffer, uint32 band);
+void OcclusionBuffer_Rasterize(OcclusionBuffer* buffer);
+// NULL jobs rasterizes on the calling thread, which must belong to them.
+void OcclusionBuffer_RasterizeJobs(OcclusionBuffer* buffer, JobSystem* jobs);
+
+int OcclusionBuffer_TestAabb(const OcclusionBuffer* buffer, const Aabb* bounds);
+uint32 OcclusionBuffer_TestAabbs(OcclusionBuffer* buffer, const Aabb* bounds, uint32 count, uint8* visible);
+
+void OcclusionBuffer_GetStats(const OcclusionBuffer* buffer, OcclusionBuffer_Stats* stats);
+
+#endif
\ No newline at end of file
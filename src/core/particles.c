@@ -0,0 +1,469 @@
+#include "particles.h"
+#include "simd.h"
+#include "timer.h"
+#include "vertex.h"
+#include <opengl/glad.h>
+#include <opengl/glad_ext.h>
+#include <string.h>
+
+#define PARTICLE_POSITION_X 0
+#define PARTICLE_POSITION_Y 1
+#define PARTICLE_POSITION_Z 2
+#define PARTICLE_VELOCITY_X 3
+#define PARTICLE_VELOCITY_Y 4
+#define PARTICLE_VELOCITY_Z 5
+#define PARTICLE_AGE 6
+#define PARTICLE_LIFE 7
+#define PARTICLE_STREAM_COUNT 8
+
+#define PARTICLE_ALIGNMENT 32
+// Below this a range is not worth a job.
+#define PARTICLE_JOB_GRAIN 4096
+
+struct ParticleEmitter
+{
+	ParticleEmitter_Desc desc;
+	uint32 capacity;
+	uint32 count;
+	void* block;
+	float* streams[PARTICLE_STREAM_COUNT];
+	float spawnAccumulator;
+	uint32 random;
+};
+
+typedef struct ParticleSystem_Entry
+{
+	ParticleEmitter* emitter;
+	Material* material;
+} ParticleSystem_Entry;
+
+typedef struct ParticleSystem_Instance
+{
+	float4 positionSize;
+	float4 color;
+} ParticleSystem_Instance;
+
+struct ParticleSystem
+{
+	ParticleSystem_Entry* entries;
+	uint32 entryCount;
+	uint32 entryCapacity;
+	GLuint vao;
+	GLuint boIds[2];
+	uint32 ringCapacity;
+	uint32 ringOffset;
+	ParticleSystem_Stats stats;
+};
+
+static float ParticleEmitter_Random(ParticleEmitter* emitter)
+{
+	uint32 x = emitter->random;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	emitter->random = x;
+	return (float)(x & 0xffffff) * (2.0f / 16777215.0f) - 1.0f;
+}
+
+ParticleEmitter* ParticleEmitter_Create(const ParticleEmitter_Desc* emitter_desc, uint32 capacity)
+{
+	ParticleEmitter* emitter = (ParticleEmitter*)malloc(sizeof(ParticleEmitter));
+	emitter->desc = *emitter_desc;
+	emitter->capacity = (capacity + 7) & ~7u;
+	emitter->count = 0;
+	emitter->spawnAccumulator = 0.0f;
+	emitter->random = 0x9e3779b9u ^ (uint32)(size_t)emitter;
+	if (emitter->random == 0)
+		emitter->random = 1;
+
+	// One block, every stream starting on a 32 byte boundary for AVX.
+	emitter->block = malloc(sizeof(float) * PARTICLE_STREAM_COUNT * emitter->capacity + PARTICLE_ALIGNMENT);
+	float* base = (float*)(((size_t)emitter->block + PARTICLE_ALIGNMENT - 1) & ~(size_t)(PARTICLE_ALIGNMENT - 1));
+	for (uint32 i = 0; i < PARTICLE_STREAM_COUNT; i++)
+	{
+		emitter->streams[i] = base + i * emitter->capacity;
+	}
+	return emitter;
+}
+
+void ParticleEmitter_Destroy(ParticleEmitter* emitter)
+{
+	free(emitter->block);
+	free(emitter);
+}
+
+void ParticleEmitter_SetPosition(ParticleEmitter* emitter, const float3* position)
+{
+	emitter->desc.position = *position;
+}
+
+void ParticleEmitter_SetRate(ParticleEmitter* emitter, float rate)
+{
+	emitter->desc.rate = rate;
+}
+
+const ParticleEmitter_Desc* ParticleEmitter_GetDesc(const ParticleEmitter* emitter)
+{
+	return &emitter->desc;
+}
+
+uint32 ParticleEmitter_Spawn(ParticleEmitter* emitter, uint32 count)
+{
+	uint32 available = emitter->capacity - emitter->count;
+	count = count < available ? count : available;
+
+	const ParticleEmitter_Desc* desc = &emitter->desc;
+	float** streams = emitter->streams;
+	for (uint32 i = emitter->count; i < emitter->count + count; i++)
+	{
+		streams[PARTICLE_POSITION_X][i] = desc->position.x + desc->positionVariance.x * ParticleEmitter_Random(emitter);
+		streams[PARTICLE_POSITION_Y][i] = desc->position.y + desc->positionVariance.y * ParticleEmitter_Random(emitter);
+		streams[PARTICLE_POSITION_Z][i] = desc->position.z + desc->positionVariance.z * ParticleEmitter_Random(emitter);
+		streams[PARTICLE_VELOCITY_X][i] = desc->velocity.x + desc->velocityVariance.x * ParticleEmitter_Random(emitter);
+		streams[PARTICLE_VELOCITY_Y][i] = desc->velocity.y + desc->velocityVariance.y * ParticleEmitter_Random(emitter);
+		streams[PARTICLE_VELOCITY_Z][i] = desc->velocity.z + desc->velocityVariance.z * ParticleEmitter_Random(emitter);
+		streams[PARTICLE_AGE][i] = 0.0f;
+		float life = desc->lifetime + desc->lifetimeVariance * ParticleEmitter_Random(emitter);
+		streams[PARTICLE_LIFE][i] = life > 0.001f ? life : 0.001f;
+	}
+	emitter->count += count;
+	return count;
+}
+
+uint32 ParticleEmitter_Emit(ParticleEmitter* emitter, float deltaTime)
+{
+	emitter->spawnAccumulator += emitter->desc.rate * deltaTime;
+	uint32 count = (uint32)emitter->spawnAccumulator;
+	emitter->spawnAccumulator -= (float)count;
+	return count > 0 ? ParticleEmitter_Spawn(emitter, count) : 0;
+}
+
+void ParticleEmitter_Simulate(ParticleEmitter* emitter, uint32 first, uint32 count, float deltaTime)
+{
+	const ParticleEmitter_Desc* desc = &emitter->desc;
+	uint32 last = first + count < emitter->count ? first + count : emitter->count;
+	float damping = 1.0f - desc->drag * deltaTime;
+	damping = damping > 0.0f ? damping : 0.0f;
+	float dvx = desc->acceleration.x * deltaTime;
+	float dvy = desc->acceleration.y * deltaTime;
+	float dvz = desc->acceleration.z * deltaTime;
+
+	float* px = emitter->streams[PARTICLE_POSITION_X];
+	float* py = emitter->streams[PARTICLE_POSITION_Y];
+	float* pz = emitter->streams[PARTICLE_POSITION_Z];
+	float* vx = emitter->streams[PARTICLE_VELOCITY_X];
+	float* vy = emitter->streams[PARTICLE_VELOCITY_Y];
+	float* vz = emitter->streams[PARTICLE_VELOCITY_Z];
+	float* age = emitter->streams[PARTICLE_AGE];
+
+	uint32 i = first;
+#if defined(SIMD_AVX)
+	__m256 dt8 = _mm256_set1_ps(deltaTime);
+	__m256 damping8 = _mm256_set1_ps(damping);
+	__m256 dvx8 = _mm256_set1_ps(dvx), dvy8 = _mm256_set1_ps(dvy), dvz8 = _mm256_set1_ps(dvz);
+	for (; i + 8 <= last; i += 8)
+	{
+		__m256 x = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(vx + i), dvx8), damping8);
+		__m256 y = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(vy + i), dvy8), damping8);
+		__m256 z = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(vz + i), dvz8), damping8);
+		_mm256_storeu_ps(vx + i, x);
+		_mm256_storeu_ps(vy + i, y);
+		_mm256_storeu_ps(vz + i, z);
+		_mm256_storeu_ps(px + i, _mm256_add_ps(_mm256_loadu_ps(px + i), _mm256_mul_ps(x, dt8)));
+		_mm256_storeu_ps(py + i, _mm256_add_ps(_mm256_loadu_ps(py + i), _mm256_mul_ps(y, dt8)));
+		_mm256_storeu_ps(pz + i, _mm256_add_ps(_mm256_loadu_ps(pz + i), _mm256_mul_ps(z, dt8)));
+		_mm256_storeu_ps(age + i, _mm256_add_ps(_mm256_loadu_ps(age + i), dt8));
+	}
+#endif
+#if defined(SIMD_SSE)
+	__m128 dt4 = _mm_set1_ps(deltaTime);
+	__m128 damping4 = _mm_set1_ps(damping);
+	__m128 dvx4 = _mm_set1_ps(dvx), dvy4 = _mm_set1_ps(dvy), dvz4 = _mm_set1_ps(dvz);
+	for (; i + 4 <= last; i += 4)
+	{
+		__m128 x = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vx + i), dvx4), damping4);
+		__m128 y = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vy + i), dvy4), damping4);
+		__m128 z = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vz + i), dvz4), damping4);
+		_mm_storeu_ps(vx + i, x);
+		_mm_storeu_ps(vy + i, y);
+		_mm_storeu_ps(vz + i, z);
+		_mm_storeu_ps(px + i, _mm_add_ps(_mm_loadu_ps(px + i), _mm_mul_ps(x, dt4)));
+		_mm_storeu_ps(py + i, _mm_add_ps(_mm_loadu_ps(py + i), _mm_mul_ps(y, dt4)));
+		_mm_storeu_ps(pz + i, _mm_add_ps(_mm_loadu_ps(pz + i), _mm_mul_ps(z, dt4)));
+		_mm_storeu_ps(age + i, _mm_add_ps(_mm_loadu_ps(age + i), dt4));
+	}
+#endif
+	for (; i < last; i++)
+	{
+		vx[i] = (vx[i] + dvx) * damping;
+		vy[i] = (vy[i] + dvy) * damping;
+		vz[i] = (vz[i] + dvz) * damping;
+		px[i] += vx[i] * deltaTime;
+		py[i] += vy[i] * deltaTime;
+		pz[i] += vz[i] * deltaTime;
+		age[i] += deltaTime;
+	}
+}
+
+void ParticleEmitter_Compact(ParticleEmitter* emitter)
+{
+	float** streams = emitter->streams;
+	const float* age = streams[PARTICLE_AGE];
+	const float* life = streams[PARTICLE_LIFE];
+	uint32 i = 0;
+	while (i < emitter->count)
+	{
+		if (age[i] < life[i])
+		{
+			i++;
+			continue;
+		}
+		uint32 last = --emitter->count;
+		for (uint32 s = 0; s < PARTICLE_STREAM_COUNT; s++)
+		{
+			streams[s][i] = streams[s][last];
+		}
+	}
+}
+
+uint32 ParticleEmitter_GetCount(const ParticleEmitter* emitter)
+{
+	return emitter->count;
+}
+
+static void ParticleEmitter_Fill(const ParticleEmitter* emitter, ParticleSystem_Instance* instances, uint32 count)
+{
+	const ParticleEmitter_Desc* desc = &emitter->desc;
+	float* const* streams = emitter->streams;
+	float sizeDelta = desc->endSize - desc->startSize;
+	float4 colorDelta;
+	for (uint32 c = 0; c < 4; c++)
+	{
+		colorDelta.data[c] = desc->endColor.data[c] - desc->startColor.data[c];
+	}
+
+	uint32 i = 0;
+#ifdef SIMD_SSE
+	__m128 startSize = _mm_set1_ps(desc->startSize);
+	__m128 deltaSize = _mm_set1_ps(sizeDelta);
+	__m128 one = _mm_set1_ps(1.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 t = _mm_min_ps(_mm_div_ps(_mm_loadu_ps(streams[PARTICLE_AGE] + i), _mm_loadu_ps(streams[PARTICLE_LIFE] + i)), one);
+		__m128 x = _mm_loadu_ps(streams[PARTICLE_POSITION_X] + i);
+		__m128 y = _mm_loadu_ps(streams[PARTICLE_POSITION_Y] + i);
+		__m128 z = _mm_loadu_ps(streams[PARTICLE_POSITION_Z] + i);
+		__m128 size = _mm_add_ps(startSize, _mm_mul_ps(deltaSize, t));
+		__m128 r = _mm_add_ps(_mm_set1_ps(desc->startColor.r), _mm_mul_ps(_mm_set1_ps(colorDelta.r), t));
+		__m128 g = _mm_add_ps(_mm_set1_ps(desc->startColor.g), _mm_mul_ps(_mm_set1_ps(colorDelta.g), t));
+		__m128 b = _mm_add_ps(_mm_set1_ps(desc->startColor.b), _mm_mul_ps(_mm_set1_ps(colorDelta.b), t));
+		__m128 a = _mm_add_ps(_mm_set1_ps(desc->startColor.a), _mm_mul_ps(_mm_set1_ps(colorDelta.a), t));
+		_MM_TRANSPOSE4_PS(x, y, z, size);
+		_MM_TRANSPOSE4_PS(r, g, b, a);
+		float* out = instances[i].positionSize.data;
+		_mm_storeu_ps(out, x);
+		_mm_storeu_ps(out + 4, r);
+		_mm_storeu_ps(out + 8, y);
+		_mm_storeu_ps(out + 12, g);
+		_mm_storeu_ps(out + 16, z);
+		_mm_storeu_ps(out + 20, b);
+		_mm_storeu_ps(out + 24, size);
+		_mm_storeu_ps(out + 28, a);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		float t = streams[PARTICLE_AGE][i] / streams[PARTICLE_LIFE][i];
+		t = t < 1.0f ? t : 1.0f;
+		ParticleSystem_Instance* instance = &instances[i];
+		instance->positionSize.x = streams[PARTICLE_POSITION_X][i];
+		instance->positionSize.y = streams[PARTICLE_POSITION_Y][i];
+		instance->positionSize.z = streams[PARTICLE_POSITION_Z][i];
+		instance->positionSize.w = desc->startSize + sizeDelta * t;
+		for (uint32 c = 0; c < 4; c++)
+		{
+			instance->color.data[c] = desc->startColor.data[c] + colorDelta.data[c] * t;
+		}
+	}
+}
+
+ParticleSystem* ParticleSystem_Create(uint32 ringCapacity)
+{
+	static const float Corners[8] = { -0.5f, -0.5f, 0.5f, -0.5f, -0.5f, 0.5f, 0.5f, 0.5f };
+
+	ParticleSystem* system = (ParticleSystem*)malloc(sizeof(ParticleSystem));
+	memset(system, 0, sizeof(ParticleSystem));
+	system->entryCapacity = 8;
+	system->entries = (ParticleSystem_Entry*)malloc(sizeof(ParticleSystem_Entry) * system->entryCapacity);
+	system->ringCapacity = ringCapacity;
+
+	glGenVertexArrays(1, &system->vao);
+	glGenBuffers(2, system->boIds);
+	glBindVertexArray(system->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, system->boIds[0]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(Corners), Corners, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (const void*)0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, system->boIds[1]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(ParticleSystem_Instance) * ringCapacity, NULL, GL_STREAM_DRAW);
+	glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_PARTICLE);
+	glVertexAttribDivisor(INSTANCE_ATTRIBUTE_PARTICLE, 1);
+	glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_PARTICLE_COLOR);
+	glVertexAttribDivisor(INSTANCE_ATTRIBUTE_PARTICLE_COLOR, 1);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return system;
+}
+
+void ParticleSystem_Destroy(ParticleSystem* system)
+{
+	glDeleteVertexArrays(1, &system->vao);
+	glDeleteBuffers(2, system->boIds);
+	free(system->entries);
+	free(system);
+}
+
+void ParticleSystem_AddEmitter(ParticleSystem* system, ParticleEmitter* emitter, Material* material)
+{
+	if (system->entryCount == system->entryCapacity)
+	{
+		system->entryCapacity *= 2;
+		system->entries = (ParticleSystem_Entry*)realloc(system->entries, sizeof(ParticleSystem_Entry) * system->entryCapacity);
+	}
+	system->entries[system->entryCount].emitter = emitter;
+	system->entries[system->entryCount].material = material;
+	system->entryCount++;
+}
+
+void ParticleSystem_RemoveEmitter(ParticleSystem* system, ParticleEmitter* emitter)
+{
+	for (uint32 i = 0; i < system->entryCount; i++)
+	{
+		if (system->entries[i].emitter == emitter)
+		{
+			system->entries[i] = system->entries[--system->entryCount];
+			return;
+		}
+	}
+}
+
+uint32 ParticleSystem_GetEmitterCount(const ParticleSystem* system)
+{
+	return system->entryCount;
+}
+
+ParticleEmitter* ParticleSystem_GetEmitter(const ParticleSystem* system, uint32 index)
+{
+	return system->entries[index].emitter;
+}
+
+typedef struct ParticleSystem_SimulateRange
+{
+	ParticleEmitter* emitter;
+	float deltaTime;
+} ParticleSystem_SimulateRange;
+
+static void ParticleSystem_Simulate(void* userData, uint32 begin, uint32 end)
+{
+	ParticleSystem_SimulateRange* range = (ParticleSystem_SimulateRange*)userData;
+	ParticleEmitter_Simulate(range->emitter, begin, end - begin, range->deltaTime);
+}
+
+void ParticleSystem_Update(ParticleSystem* system, float deltaTime)
+{
+	ParticleSystem_UpdateJobs(system, NULL, deltaTime);
+}
+
+void ParticleSystem_UpdateJobs(ParticleSystem* system, JobSystem* jobs, float deltaTime)
+{
+	ParticleSystem_Stats* stats = &system->stats;
+	stats->spawnedCount = 0;
+	stats->particleCount = 0;
+
+	double start = Timer_GetMilliseconds();
+	for (uint32 i = 0; i < system->entryCount; i++)
+	{
+		ParticleEmitter* emitter = system->entries[i].emitter;
+		stats->spawnedCount += ParticleEmitter_Emit(emitter, deltaTime);
+		stats->particleCount += emitter->count;
+		if (jobs != NULL)
+		{
+			ParticleSystem_SimulateRange range = { emitter, deltaTime };
+			JobSystem_ParallelFor(jobs, emitter->count, PARTICLE_JOB_GRAIN, ParticleSystem_Simulate, &range);
+		}
+		else
+		{
+			ParticleEmitter_Simulate(emitter, 0, emitter->count, deltaTime);
+		}
+		ParticleEmitter_Compact(emitter);
+	}
+	stats->updateTime = Timer_GetMilliseconds() - start;
+	stats->particlesPerMillisecond = stats->updateTime > 0.0 ? stats->particleCount / stats->updateTime : 0.0;
+	stats->emitterCount = system->entryCount;
+}
+
+void ParticleSystem_Draw(ParticleSystem* system, const matrix4x4* viewProjection, const float3* cameraRight, const float3* cameraUp)
+{
+	system->stats.drawCallCount = 0;
+	GLboolean blend = glIsEnabled(GL_BLEND);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthMask(GL_FALSE);
+
+	glBindVertexArray(system->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, system->boIds[1]);
+	for (uint32 e = 0; e < system->entryCount; e++)
+	{
+		const ParticleSystem_Entry* entry = &system->entries[e];
+		uint32 count = entry->emitter->count < system->ringCapacity ? entry->emitter->count : system->ringCapacity;
+		if (count == 0)
+			continue;
+
+		// Orphan the storage on wrap-around; until then every write lands in
+		// a range the GPU has not been handed yet, so no sync is needed.
+		if (system->ringOffset + count > system->ringCapacity)
+		{
+			glBufferData(GL_ARRAY_BUFFER, sizeof(ParticleSystem_Instance) * system->ringCapacity, NULL, GL_STREAM_DRAW);
+			system->ringOffset = 0;
+		}
+
+		GLintptr offset = system->ringOffset * sizeof(ParticleSystem_Instance);
+		void* mapped = glMapBufferRange(GL_ARRAY_BUFFER, offset, count * sizeof(ParticleSystem_Instance), GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+		if (mapped == NULL)
+			continue;
+		ParticleEmitter_Fill(entry->emitter, (ParticleSystem_Instance*)mapped, count);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+
+		glVertexAttribPointer(INSTANCE_ATTRIBUTE_PARTICLE, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleSystem_Instance), (const void*)offset);
+		glVertexAttribPointer(INSTANCE_ATTRIBUTE_PARTICLE_COLOR, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleSystem_Instance), (const void*)(offset + sizeof(float4)));
+
+		Shader* shader = Material_Get_Shader(entry->material);
+		Shader_Use(shader);
+		Material_Apply(entry->material);
+		GLint location = Shader_GetLocation(shader, "uViewProjection");
+		if (location != -1)
+			glUniformMatrix4fv(location, 1, GL_FALSE, viewProjection->data);
+		location = Shader_GetLocation(shader, "uCameraRight");
+		if (location != -1)
+			glUniform3f(location, cameraRight->x, cameraRight->y, cameraRight->z);
+		location = Shader_GetLocation(shader, "uCameraUp");
+		if (location != -1)
+			glUniform3f(location, cameraUp->x, cameraUp->y, cameraUp->z);
+
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+		system->ringOffset += count;
+		system->stats.drawCallCount++;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+
+	glDepthMask(GL_TRUE);
+	if (!blend)
+		glDisable(GL_BLEND);
+}
+
+void ParticleSystem_GetStats(const ParticleSystem* system, ParticleSystem_Stats* stats)
+{
+	*stats = system->stats;
+}
\ No newline at end of file
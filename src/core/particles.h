@@ -0,0 +1,77 @@
+#ifndef __PARTICLES_H__
+#define __PARTICLES_H__
+
+#include "config.h"
+#include "maths.h"
+#include "material.h"
+#include "job_system.h"
+
+// CPU particle system. Every emitter owns a structure-of-arrays pool, so the
+// SSE/AVX kernel in ParticleEmitter_Simulate reads its parameters once and
+// streams through positions, velocities and ages. Simulate only touches the
+// given range, so worker threads can split a pool between them; spawning
+// and compaction stay on the owning thread.
+//
+// ParticleSystem_Draw streams the live particles of every emitter into one
+// ring buffer and draws them as camera-facing instanced quads with the
+// emitter's material. The vertex shader gets the quad corner in aPosition,
+// aParticle (position, size) and aParticleColor per instance.
+typedef struct ParticleEmitter ParticleEmitter;
+typedef struct ParticleSystem ParticleSystem;
+
+// Shared with the GPU backend, so an effect can run on either path.
+typedef struct ParticleEmitter_Desc
+{
+	float3 position;
+	float3 positionVariance;
+	float3 velocity;
+	float3 velocityVariance;
+	float3 acceleration;
+	float drag;
+	float lifetime;
+	float lifetimeVariance;
+	float startSize;
+	float endSize;
+	float4 startColor;
+	float4 endColor;
+	float rate;
+} ParticleEmitter_Desc;
+
+typedef struct ParticleSystem_Stats
+{
+	uint32 emitterCount;
+	uint32 particleCount;
+	uint32 spawnedCount;
+	uint32 drawCallCount;
+	double updateTime;
+	double particlesPerMillisecond;
+} ParticleSystem_Stats;
+
+ParticleEmitter* ParticleEmitter_Create(const ParticleEmitter_Desc* emitter_desc, uint32 capacity);
+void ParticleEmitter_Destroy(ParticleEmitter* emitter);
+
+void ParticleEmitter_SetPosition(ParticleEmitter* emitter, const float3* position);
+void ParticleEmitter_SetRate(ParticleEmitter* emitter, float rate);
+const ParticleEmitter_Desc* ParticleEmitter_GetDesc(const ParticleEmitter* emitter);
+uint32 ParticleEmitter_Spawn(ParticleEmitter* emitter, uint32 count);
+uint32 ParticleEmitter_Emit(ParticleEmitter* emitter, float deltaTime);
+void ParticleEmitter_Simulate(ParticleEmitter* emitter, uint32 first, uint32 count, float deltaTime);
+void ParticleEmitter_Compact(ParticleEmitter* emitter);
+uint32 ParticleEmitter_GetCount(const ParticleEmitter* emitter);
+
+ParticleSystem* ParticleSystem_Create(uint32 ringCapacity);
+void ParticleSystem_Destroy(ParticleSystem* system);
+
+void ParticleSystem_AddEmitter(ParticleSystem* system, ParticleEmitter* emitter, Material* material);
+void ParticleSystem_RemoveEmitter(ParticleSystem* system, ParticleEmitter* emitter);
+uint32 ParticleSystem_GetEmitterCount(const ParticleSystem* system);
+ParticleEmitter* ParticleSystem_GetEmitter(const ParticleSystem* system, uint32 index);
+
+void ParticleSystem_Update(ParticleSystem* system, float deltaTime);
+// Same as ParticleSystem_Update with each pool simulated in parallel ranges
+// on the job system; the calling thread must belong to it.
+void ParticleSystem_UpdateJobs(ParticleSystem* system, JobSystem* jobs, float deltaTime);
+void ParticleSystem_Draw(ParticleSystem* system, const matrix4x4* viewProjection, const float3* cameraRight, const float3* cameraUp);
+void ParticleSystem_GetStats(const ParticleSystem* system, ParticleSystem_Stats* stats);
+
+#endif
\ No newline at end of file
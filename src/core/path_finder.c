@@ -0,0 +1,1203 @@
+#include "path_finder.h"
+#include "thread.h"
+#include "timer.h"
+#include "khash.h"
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <limits.h>
+
+// Four borders of at most 8 entrances each.
+#define PATH_FINDER_MAX_CLUSTER_NODES 32
+#define PATH_FINDER_MAX_CLUSTER_SIZE 16
+#define PATH_FINDER_NO_NODE 0xFF
+// Open stretches of a border at least this long get an entrance at both
+// ends instead of one in the middle.
+#define PATH_FINDER_WIDE_ENTRANCE 6
+#define PATH_FINDER_INDEX_BITS 20
+#define PATH_FINDER_INDEX_MASK ((1u << PATH_FINDER_INDEX_BITS) - 1)
+
+KHASH_MAP_INIT_INT64(PathCache, uint32)
+
+typedef struct PathFinder_HeapEntry
+{
+	float value;
+	uint32 node;
+} PathFinder_HeapEntry;
+
+typedef struct PathFinder_Heap
+{
+	PathFinder_HeapEntry* entries;
+	uint32 count;
+	uint32 capacity;
+} PathFinder_Heap;
+
+typedef struct PathFinder_Cluster
+{
+	uint32 nodeCount;
+	uint32 cells[PATH_FINDER_MAX_CLUSTER_NODES];
+	// costs[from * PATH_FINDER_MAX_CLUSTER_NODES + to], FLT_MAX when there
+	// is no way inside the cluster.
+	float costs[PATH_FINDER_MAX_CLUSTER_NODES * PATH_FINDER_MAX_CLUSTER_NODES];
+	// The edges the search follows: those not as cheap through a third
+	// entrance, which leaves the same costs with far fewer relaxations.
+	uint8 edgeCounts[PATH_FINDER_MAX_CLUSTER_NODES];
+	uint8 edges[PATH_FINDER_MAX_CLUSTER_NODES * PATH_FINDER_MAX_CLUSTER_NODES];
+} PathFinder_Cluster;
+
+// A free query links the free list through next.
+typedef struct PathFinder_Query
+{
+	uint32 handle;
+	uint32 generation;
+	uint32 next;
+	int used;
+	PathFinder_Status status;
+	uint32 startCell;
+	uint32 goalCell;
+	float2 start;
+	float2 goal;
+	float2* points;
+	uint32 pointCount;
+	// Earlier query of the same update with the same cache key, whose path
+	// this one waits for instead of searching, or PATH_FINDER_INVALID.
+	uint32 leader;
+} PathFinder_Query;
+
+// An empty entry has no points.
+typedef struct PathFinder_CacheEntry
+{
+	khint64_t key;
+	uint32 lastUse;
+	// Cells covered by the path.
+	int32 minX;
+	int32 minZ;
+	int32 maxX;
+	int32 maxZ;
+	float2* points;
+	uint32 pointCount;
+} PathFinder_CacheEntry;
+
+typedef struct PathFinder_Scratch
+{
+	// Abstract search by node id, start and goal come after the clusters'.
+	float* nodeCosts;
+	float* nodeEstimates;
+	uint32* nodeParents;
+	uint32* nodeStamps;
+	// Search inside one cluster, by cell of the cluster.
+	float cellCosts[PATH_FINDER_MAX_CLUSTER_SIZE * PATH_FINDER_MAX_CLUSTER_SIZE];
+	uint32 cellParents[PATH_FINDER_MAX_CLUSTER_SIZE * PATH_FINDER_MAX_CLUSTER_SIZE];
+	uint32 cellStamps[PATH_FINDER_MAX_CLUSTER_SIZE * PATH_FINDER_MAX_CLUSTER_SIZE];
+	// Costs of the cluster searched last with a one cell border, cells
+	// outside the grid as walls.
+	uint8 tile[(PATH_FINDER_MAX_CLUSTER_SIZE + 2) * (PATH_FINDER_MAX_CLUSTER_SIZE + 2)];
+	uint32 tileCluster;
+	uint32 stamp;
+	PathFinder_Heap heap;
+	float startCosts[PATH_FINDER_MAX_CLUSTER_NODES];
+	float goalCosts[PATH_FINDER_MAX_CLUSTER_NODES];
+	// Abstract path from the goal back, then the refined path in cells.
+	uint32* nodes;
+	uint32 nodeCapacity;
+	uint32* cells;
+	uint32 cellCount;
+	uint32 cellCapacity;
+	uint32 searchCount;
+	uint32 notFoundCount;
+	uint32 nodeExpandedCount;
+	uint32 cellExpandedCount;
+} PathFinder_Scratch;
+
+struct PathFinder
+{
+	uint32 width;
+	uint32 height;
+	float cellSize;
+	float inverseCellSize;
+	uint32 clusterSize;
+	uint32 clusterColumns;
+	uint32 clusterRows;
+	uint32 nodeIdCount;
+	uint8* costs;
+	// Slot of the entrance node on each cell in its cluster, or
+	// PATH_FINDER_NO_NODE.
+	uint8* nodeAt;
+	PathFinder_Cluster* clusters;
+	uint8* rebuild;
+	PathFinder_Query* queries;
+	uint32 maxRequests;
+	uint32 freeQuery;
+	uint32* queue;
+	uint32 queueHead;
+	uint32 queueCount;
+	// Queue entries handed out by the running update.
+	volatile int32 nextQueued;
+	uint32 batchCount;
+	double deadline;
+	JobSystem* jobs;
+	PathFinder_CacheEntry* cache;
+	uint32 cacheSize;
+	uint32 cacheBlock;
+	uint32 cacheColumns;
+	uint32 useCount;
+	khash_t(PathCache)* cacheMap;
+	// Cache key to query of the running update.
+	khash_t(PathCache)* batchMap;
+	PathFinder_Scratch* scratch;
+	uint32 scratchCount;
+	PathFinder_Stats stats;
+};
+
+static const int32 PathFinder_StepX[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+static const int32 PathFinder_StepZ[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+static const float PathFinder_StepLength[8] = { 1.0f, 1.41421356f, 1.0f, 1.41421356f, 1.0f, 1.41421356f, 1.0f, 1.41421356f };
+
+static void PathFinder_Push(PathFinder_Heap* heap, float value, uint32 node)
+{
+	if (heap->count == heap->capacity)
+	{
+		heap->capacity = heap->capacity > 0 ? heap->capacity * 2 : 1024;
+		heap->entries = (PathFinder_HeapEntry*)realloc(heap->entries, sizeof(PathFinder_HeapEntry) * heap->capacity);
+	}
+	PathFinder_HeapEntry* entries = heap->entries;
+	uint32 i = heap->count++;
+	while (i > 0)
+	{
+		uint32 parent = (i - 1) >> 1;
+		if (entries[parent].value <= value)
+			break;
+		entries[i] = entries[parent];
+		i = parent;
+	}
+	entries[i].value = value;
+	entries[i].node = node;
+}
+
+static PathFinder_HeapEntry PathFinder_Pop(PathFinder_Heap* heap)
+{
+	PathFinder_HeapEntry* entries = heap->entries;
+	PathFinder_HeapEntry top = entries[0];
+	PathFinder_HeapEntry last = entries[--heap->count];
+	uint32 count = heap->count;
+	uint32 i = 0;
+	for (;;)
+	{
+		uint32 child = 2 * i + 1;
+		if (child >= count)
+			break;
+		if (child + 1 < count && entries[child + 1].value < entries[child].value)
+			child++;
+		if (entries[child].value >= last.value)
+			break;
+		entries[i] = entries[child];
+		i = child;
+	}
+	entries[i] = last;
+	return top;
+}
+
+static uint32 PathFinder_GetCluster(const PathFinder* finder, uint32 cell)
+{
+	uint32 x = cell % finder->width;
+	uint32 z = cell / finder->width;
+	return (z / finder->clusterSize) * finder->clusterColumns + x / finder->clusterSize;
+}
+
+// Diagonal steps may not cut a wall's corner.
+static int PathFinder_CanStep(const PathFinder* finder, uint32 x, uint32 z, uint32 direction)
+{
+	int32 nx = (int32)x + PathFinder_StepX[direction];
+	int32 nz = (int32)z + PathFinder_StepZ[direction];
+	if (nx < 0 || nz < 0 || nx >= (int32)finder->width || nz >= (int32)finder->height)
+		return 0;
+	if (finder->costs[nz * finder->width + nx] == PATH_FINDER_IMPASSABLE)
+		return 0;
+	if ((direction & 1) == 0)
+		return 1;
+	return finder->costs[z * finder->width + nx] != PATH_FINDER_IMPASSABLE && finder->costs[nz * finder->width + x] != PATH_FINDER_IMPASSABLE;
+}
+
+static float PathFinder_Estimate(const PathFinder* finder, uint32 from, uint32 to)
+{
+	int32 dx = (int32)(from % finder->width) - (int32)(to % finder->width);
+	int32 dz = (int32)(from / finder->width) - (int32)(to / finder->width);
+	float ax = (float)(dx < 0 ? -dx : dx);
+	float az = (float)(dz < 0 ? -dz : dz);
+	return ax > az ? ax + 0.41421356f * az : az + 0.41421356f * ax;
+}
+
+static uint32 PathFinder_GetLocal(const PathFinder* finder, uint32 cell)
+{
+	uint32 size = finder->clusterSize;
+	return ((cell / finder->width) % size) * size + (cell % finder->width) % size;
+}
+
+static float PathFinder_GetLocalCost(const PathFinder_Scratch* scratch, uint32 local)
+{
+	return scratch->cellStamps[local] == scratch->stamp ? scratch->cellCosts[local] : FLT_MAX;
+}
+
+static void PathFinder_LoadTile(const PathFinder* finder, PathFinder_Scratch* scratch, uint32 cluster)
+{
+	if (scratch->tileCluster == cluster)
+		return;
+
+	uint32 size = finder->clusterSize;
+	uint32 pitch = size + 2;
+	int32 x0 = (int32)((cluster % finder->clusterColumns) * size) - 1;
+	int32 z0 = (int32)((cluster / finder->clusterColumns) * size) - 1;
+	for (uint32 row = 0; row < pitch; row++)
+	{
+		int32 z = z0 + (int32)row;
+		for (uint32 column = 0; column < pitch; column++)
+		{
+			int32 x = x0 + (int32)column;
+			int outside = x < 0 || z < 0 || x >= (int32)finder->width || z >= (int32)finder->height;
+			scratch->tile[row * pitch + column] = outside ? PATH_FINDER_IMPASSABLE : finder->costs[z * finder->width + x];
+		}
+	}
+	scratch->tileCluster = cluster;
+}
+
+static float PathFinder_EstimateLocal(uint32 size, uint32 from, uint32 to)
+{
+	if (to == PATH_FINDER_INVALID)
+		return 0.0f;
+	int32 dx = (int32)(from % size) - (int32)(to % size);
+	int32 dz = (int32)(from / size) - (int32)(to / size);
+	float ax = (float)(dx < 0 ? -dx : dx);
+	float az = (float)(dz < 0 ? -dz : dz);
+	return ax > az ? ax + 0.41421356f * az : az + 0.41421356f * ax;
+}
+
+// Dijkstra from a cell without leaving its cluster, or A* when there is a
+// target cell. Without one it stops once entranceCount entrances are
+// settled, unless that is 0. Reversed, the costs are those of reaching the
+// cell instead of leaving it.
+static void PathFinder_SearchCluster(const PathFinder* finder, PathFinder_Scratch* scratch, uint32 from, int reverse, uint32 target, uint32 entranceCount)
+{
+	uint32 size = finder->clusterSize;
+	uint32 pitch = size + 2;
+	uint32 cluster = PathFinder_GetCluster(finder, from);
+	const uint8* nodeAt = finder->nodeAt + (cluster / finder->clusterColumns) * size * finder->width + (cluster % finder->clusterColumns) * size;
+	PathFinder_LoadTile(finder, scratch, cluster);
+	const uint8* tile = scratch->tile;
+	uint32 stamp = ++scratch->stamp;
+	uint32 targetLocal = target != PATH_FINDER_INVALID ? PathFinder_GetLocal(finder, target) : PATH_FINDER_INVALID;
+	PathFinder_Heap* heap = &scratch->heap;
+
+	uint32 local = PathFinder_GetLocal(finder, from);
+	scratch->cellCosts[local] = 0.0f;
+	scratch->cellParents[local] = PATH_FINDER_INVALID;
+	scratch->cellStamps[local] = stamp;
+	heap->count = 0;
+	PathFinder_Push(heap, 0.0f, local);
+	while (heap->count > 0)
+	{
+		PathFinder_HeapEntry entry = PathFinder_Pop(heap);
+		float current = scratch->cellCosts[entry.node];
+		if (entry.value > current + PathFinder_EstimateLocal(size, entry.node, targetLocal))
+			continue;
+		if (entry.node == targetLocal)
+			break;
+		scratch->cellExpandedCount++;
+
+		uint32 lx = entry.node % size;
+		uint32 lz = entry.node / size;
+		if (entranceCount > 0 && nodeAt[lz * finder->width + lx] != PATH_FINDER_NO_NODE && --entranceCount == 0)
+			break;
+		uint32 cell = (lz + 1) * pitch + lx + 1;
+		for (uint32 d = 0; d < 8; d++)
+		{
+			uint32 nlx = lx + PathFinder_StepX[d];
+			uint32 nlz = lz + PathFinder_StepZ[d];
+			int32 dx = PathFinder_StepX[d];
+			int32 dz = PathFinder_StepZ[d] * (int32)pitch;
+			if (nlx >= size || nlz >= size || tile[cell + dx + dz] == PATH_FINDER_IMPASSABLE)
+				continue;
+			// Diagonal steps may not cut a wall's corner.
+			if ((d & 1) != 0 && (tile[cell + dx] == PATH_FINDER_IMPASSABLE || tile[cell + dz] == PATH_FINDER_IMPASSABLE))
+				continue;
+			float cost = reverse ? tile[cell] : tile[cell + dx + dz];
+			float candidate = current + cost * PathFinder_StepLength[d];
+			uint32 neighbour = nlz * size + nlx;
+			if (scratch->cellStamps[neighbour] != stamp || candidate < scratch->cellCosts[neighbour])
+			{
+				scratch->cellCosts[neighbour] = candidate;
+				scratch->cellParents[neighbour] = entry.node;
+				scratch->cellStamps[neighbour] = stamp;
+				PathFinder_Push(heap, candidate + PathFinder_EstimateLocal(size, neighbour, targetLocal), neighbour);
+			}
+		}
+	}
+}
+
+// The neighbour of a cluster on a side (+x, +z, -x, -z), or
+// PATH_FINDER_INVALID at the edge of the grid.
+static uint32 PathFinder_GetNeighbour(const PathFinder* finder, uint32 cluster, uint32 side)
+{
+	uint32 cx = cluster % finder->clusterColumns;
+	uint32 cz = cluster / finder->clusterColumns;
+	if ((side == 0 && cx + 1 == finder->clusterColumns) || (side == 1 && cz + 1 == finder->clusterRows) || (side == 2 && cx == 0) || (side == 3 && cz == 0))
+		return PATH_FINDER_INVALID;
+	if (side == 0)
+		return cluster + 1;
+	if (side == 1)
+		return cluster + finder->clusterColumns;
+	if (side == 2)
+		return cluster - 1;
+	return cluster - finder->clusterColumns;
+}
+
+// Cell i of a border and the one across it, in the same order from both
+// sides so both clusters agree on the entrances.
+static void PathFinder_GetBorderCells(const PathFinder* finder, uint32 cluster, uint32 side, uint32 i, uint32* inside, uint32* across)
+{
+	uint32 size = finder->clusterSize;
+	uint32 x = (cluster % finder->clusterColumns) * size + (side == 0 ? size - 1 : (side == 2 ? 0 : i));
+	uint32 z = (cluster / finder->clusterColumns) * size + (side == 1 ? size - 1 : (side == 3 ? 0 : i));
+	uint32 ax = side == 0 ? x + 1 : (side == 2 ? x - 1 : x);
+	uint32 az = side == 1 ? z + 1 : (side == 3 ? z - 1 : z);
+	*inside = z * finder->width + x;
+	*across = az * finder->width + ax;
+}
+
+static void PathFinder_AddEntrances(PathFinder* finder, uint32 cluster, uint32 side)
+{
+	uint32 size = finder->clusterSize;
+	if (PathFinder_GetNeighbour(finder, cluster, side) == PATH_FINDER_INVALID)
+		return;
+
+	uint32 inside[PATH_FINDER_MAX_CLUSTER_SIZE];
+	uint8 open[PATH_FINDER_MAX_CLUSTER_SIZE];
+	for (uint32 i = 0; i < size; i++)
+	{
+		uint32 across;
+		PathFinder_GetBorderCells(finder, cluster, side, i, &inside[i], &across);
+		open[i] = finder->costs[inside[i]] != PATH_FINDER_IMPASSABLE && finder->costs[across] != PATH_FINDER_IMPASSABLE;
+	}
+
+	PathFinder_Cluster* current = &finder->clusters[cluster];
+	for (uint32 i = 0; i < size; i++)
+	{
+		if (!open[i])
+			continue;
+		uint32 last = i;
+		while (last + 1 < size && open[last + 1])
+		{
+			last++;
+		}
+		uint32 picks[2];
+		uint32 pickCount = 0;
+		if (last - i + 1 < PATH_FINDER_WIDE_ENTRANCE)
+		{
+			picks[pickCount++] = (i + last) / 2;
+		}
+		else
+		{
+			picks[pickCount++] = i;
+			picks[pickCount++] = last;
+		}
+		for (uint32 k = 0; k < pickCount; k++)
+		{
+			uint32 cell = inside[picks[k]];
+			if (finder->nodeAt[cell] != PATH_FINDER_NO_NODE)
+				continue;
+			ASSERT(current->nodeCount < PATH_FINDER_MAX_CLUSTER_NODES);
+			finder->nodeAt[cell] = (uint8)current->nodeCount;
+			current->cells[current->nodeCount++] = cell;
+		}
+		i = last;
+	}
+}
+
+static void PathFinder_RebuildCluster(PathFinder* finder, PathFinder_Scratch* scratch, uint32 cluster)
+{
+	PathFinder_Cluster* current = &finder->clusters[cluster];
+	for (uint32 i = 0; i < current->nodeCount; i++)
+	{
+		finder->nodeAt[current->cells[i]] = PATH_FINDER_NO_NODE;
+	}
+	current->nodeCount = 0;
+	for (uint32 side = 0; side < 4; side++)
+	{
+		PathFinder_AddEntrances(finder, cluster, side);
+	}
+
+	for (uint32 i = 0; i < current->nodeCount; i++)
+	{
+		float* costs = current->costs + i * PATH_FINDER_MAX_CLUSTER_NODES;
+		PathFinder_SearchCluster(finder, scratch, current->cells[i], 0, PATH_FINDER_INVALID, current->nodeCount);
+		for (uint32 j = 0; j < current->nodeCount; j++)
+		{
+			costs[j] = PathFinder_GetLocalCost(scratch, PathFinder_GetLocal(finder, current->cells[j]));
+		}
+	}
+
+	uint32 count = current->nodeCount;
+	for (uint32 i = 0; i < count; i++)
+	{
+		const float* from = current->costs + i * PATH_FINDER_MAX_CLUSTER_NODES;
+		uint8* edges = current->edges + i * PATH_FINDER_MAX_CLUSTER_NODES;
+		uint32 edgeCount = 0;
+		for (uint32 j = 0; j < count; j++)
+		{
+			if (j == i || from[j] == FLT_MAX)
+				continue;
+			int dominated = 0;
+			for (uint32 k = 0; k < count && !dominated; k++)
+			{
+				float through = current->costs[k * PATH_FINDER_MAX_CLUSTER_NODES + j];
+				dominated = k != i && k != j && from[k] != FLT_MAX && through != FLT_MAX && from[k] + through <= from[j];
+			}
+			if (!dominated)
+				edges[edgeCount++] = (uint8)j;
+		}
+		current->edgeCounts[i] = (uint8)edgeCount;
+	}
+	finder->stats.clusterRebuildCount++;
+}
+
+static void PathFinder_ReserveScratch(PathFinder* finder, uint32 count)
+{
+	if (count <= finder->scratchCount)
+		return;
+
+	finder->scratch = (PathFinder_Scratch*)realloc(finder->scratch, sizeof(PathFinder_Scratch) * count);
+	for (uint32 i = finder->scratchCount; i < count; i++)
+	{
+		PathFinder_Scratch* scratch = &finder->scratch[i];
+		memset(scratch, 0, sizeof(PathFinder_Scratch));
+		scratch->nodeCosts = (float*)malloc(sizeof(float) * finder->nodeIdCount);
+		scratch->nodeEstimates = (float*)malloc(sizeof(float) * finder->nodeIdCount);
+		scratch->nodeParents = (uint32*)malloc(sizeof(uint32) * finder->nodeIdCount);
+		scratch->nodeStamps = (uint32*)malloc(sizeof(uint32) * finder->nodeIdCount);
+		memset(scratch->nodeStamps, 0, sizeof(uint32) * finder->nodeIdCount);
+		scratch->tileCluster = PATH_FINDER_INVALID;
+	}
+	finder->scratchCount = count;
+}
+
+static void PathFinder_AppendCell(PathFinder_Scratch* scratch, uint32 cell)
+{
+	if (scratch->cellCount == scratch->cellCapacity)
+	{
+		scratch->cellCapacity = scratch->cellCapacity > 0 ? scratch->cellCapacity * 2 : 256;
+		scratch->cells = (uint32*)realloc(scratch->cells, sizeof(uint32) * scratch->cellCapacity);
+	}
+	scratch->cells[scratch->cellCount++] = cell;
+}
+
+// Appends the cells after from up to to, both in one cluster.
+static void PathFinder_Refine(const PathFinder* finder, PathFinder_Scratch* scratch, uint32 from, uint32 to)
+{
+	if (PathFinder_GetCluster(finder, from) != PathFinder_GetCluster(finder, to))
+	{
+		PathFinder_AppendCell(scratch, to);
+		return;
+	}
+
+	PathFinder_SearchCluster(finder, scratch, from, 0, to, 0);
+	uint32 size = finder->clusterSize;
+	uint32 first = scratch->cellCount;
+	uint32 x0 = to % finder->width - (to % finder->width) % size;
+	uint32 z0 = to / finder->width - (to / finder->width) % size;
+	for (uint32 local = PathFinder_GetLocal(finder, to); scratch->cellParents[local] != PATH_FINDER_INVALID; local = scratch->cellParents[local])
+	{
+		PathFinder_AppendCell(scratch, (z0 + local / size) * finder->width + x0 + local % size);
+	}
+	for (uint32 i = first, j = scratch->cellCount - 1; i < j; i++, j--)
+	{
+		uint32 cell = scratch->cells[i];
+		scratch->cells[i] = scratch->cells[j];
+		scratch->cells[j] = cell;
+	}
+}
+
+static uint32 PathFinder_GetNodeCell(const PathFinder* finder, const PathFinder_Query* query, uint32 node)
+{
+	uint32 startNode = finder->nodeIdCount - 2;
+	if (node == startNode)
+		return query->startCell;
+	if (node == startNode + 1)
+		return query->goalCell;
+	return finder->clusters[node / PATH_FINDER_MAX_CLUSTER_NODES].cells[node % PATH_FINDER_MAX_CLUSTER_NODES];
+}
+
+static void PathFinder_Relax(const PathFinder* finder, PathFinder_Scratch* scratch, const PathFinder_Query* query, uint32 stamp, uint32 from, uint32 node, float cost)
+{
+	if (scratch->nodeStamps[node] != stamp)
+	{
+		scratch->nodeEstimates[node] = PathFinder_Estimate(finder, PathFinder_GetNodeCell(finder, query, node), query->goalCell);
+		scratch->nodeStamps[node] = stamp;
+	}
+	else if (cost >= scratch->nodeCosts[node])
+	{
+		return;
+	}
+	scratch->nodeCosts[node] = cost;
+	scratch->nodeParents[node] = from;
+	PathFinder_Push(&scratch->heap, cost + scratch->nodeEstimates[node], node);
+}
+
+static void PathFinder_Solve(const PathFinder* finder, PathFinder_Scratch* scratch, PathFinder_Query* query)
+{
+	scratch->searchCount++;
+	query->status = PATH_FINDER_NOT_FOUND;
+	if (finder->costs[query->startCell] == PATH_FINDER_IMPASSABLE || finder->costs[query->goalCell] == PATH_FINDER_IMPASSABLE)
+	{
+		scratch->notFoundCount++;
+		return;
+	}
+
+	// Attach start and goal to the entrances of their clusters.
+	uint32 startCluster = PathFinder_GetCluster(finder, query->startCell);
+	uint32 goalCluster = PathFinder_GetCluster(finder, query->goalCell);
+	const PathFinder_Cluster* start = &finder->clusters[startCluster];
+	const PathFinder_Cluster* goal = &finder->clusters[goalCluster];
+	PathFinder_SearchCluster(finder, scratch, query->startCell, 0, PATH_FINDER_INVALID, startCluster == goalCluster ? 0 : start->nodeCount);
+	for (uint32 i = 0; i < start->nodeCount; i++)
+	{
+		scratch->startCosts[i] = PathFinder_GetLocalCost(scratch, PathFinder_GetLocal(finder, start->cells[i]));
+	}
+	float direct = startCluster == goalCluster ? PathFinder_GetLocalCost(scratch, PathFinder_GetLocal(finder, query->goalCell)) : FLT_MAX;
+	PathFinder_SearchCluster(finder, scratch, query->goalCell, 1, PATH_FINDER_INVALID, goal->nodeCount);
+	for (uint32 i = 0; i < goal->nodeCount; i++)
+	{
+		scratch->goalCosts[i] = PathFinder_GetLocalCost(scratch, PathFinder_GetLocal(finder, goal->cells[i]));
+	}
+
+	uint32 startNode = finder->nodeIdCount - 2;
+	uint32 goalNode = startNode + 1;
+	uint32 stamp = ++scratch->stamp;
+	PathFinder_Heap* heap = &scratch->heap;
+	heap->count = 0;
+	PathFinder_Relax(finder, scratch, query, stamp, PATH_FINDER_INVALID, startNode, 0.0f);
+	int found = 0;
+	while (heap->count > 0)
+	{
+		PathFinder_HeapEntry entry = PathFinder_Pop(heap);
+		uint32 node = entry.node;
+		float cost = scratch->nodeCosts[node];
+		if (entry.value > cost + scratch->nodeEstimates[node])
+			continue;
+		if (node == goalNode)
+		{
+			found = 1;
+			break;
+		}
+		scratch->nodeExpandedCount++;
+
+		if (node == startNode)
+		{
+			for (uint32 i = 0; i < start->nodeCount; i++)
+			{
+				if (scratch->startCosts[i] != FLT_MAX)
+					PathFinder_Relax(finder, scratch, query, stamp, node, startCluster * PATH_FINDER_MAX_CLUSTER_NODES + i, scratch->startCosts[i]);
+			}
+			if (direct != FLT_MAX)
+				PathFinder_Relax(finder, scratch, query, stamp, node, goalNode, direct);
+			continue;
+		}
+
+		uint32 cluster = node / PATH_FINDER_MAX_CLUSTER_NODES;
+		uint32 slot = node % PATH_FINDER_MAX_CLUSTER_NODES;
+		const PathFinder_Cluster* current = &finder->clusters[cluster];
+		const float* costs = current->costs + slot * PATH_FINDER_MAX_CLUSTER_NODES;
+		const uint8* edges = current->edges + slot * PATH_FINDER_MAX_CLUSTER_NODES;
+		for (uint32 i = 0; i < current->edgeCounts[slot]; i++)
+		{
+			uint32 next = edges[i];
+			PathFinder_Relax(finder, scratch, query, stamp, node, cluster * PATH_FINDER_MAX_CLUSTER_NODES + next, cost + costs[next]);
+		}
+		if (cluster == goalCluster && scratch->goalCosts[slot] != FLT_MAX)
+			PathFinder_Relax(finder, scratch, query, stamp, node, goalNode, cost + scratch->goalCosts[slot]);
+
+		// Entrances are paired straight across cluster borders.
+		uint32 cell = current->cells[slot];
+		uint32 x = cell % finder->width;
+		uint32 z = cell / finder->width;
+		for (uint32 d = 0; d < 8; d += 2)
+		{
+			if (!PathFinder_CanStep(finder, x, z, d))
+				continue;
+			uint32 across = (z + PathFinder_StepZ[d]) * finder->width + x + PathFinder_StepX[d];
+			uint32 acrossCluster = PathFinder_GetCluster(finder, across);
+			uint8 acrossSlot = finder->nodeAt[across];
+			if (acrossCluster != cluster && acrossSlot != PATH_FINDER_NO_NODE)
+				PathFinder_Relax(finder, scratch, query, stamp, node, acrossCluster * PATH_FINDER_MAX_CLUSTER_NODES + acrossSlot, cost + finder->costs[across]);
+		}
+	}
+	if (!found)
+	{
+		scratch->notFoundCount++;
+		return;
+	}
+
+	uint32 nodeCount = 0;
+	for (uint32 node = goalNode; node != PATH_FINDER_INVALID; node = scratch->nodeParents[node])
+	{
+		if (nodeCount == scratch->nodeCapacity)
+		{
+			scratch->nodeCapacity = scratch->nodeCapacity > 0 ? scratch->nodeCapacity * 2 : 256;
+			scratch->nodes = (uint32*)realloc(scratch->nodes, sizeof(uint32) * scratch->nodeCapacity);
+		}
+		scratch->nodes[nodeCount++] = node;
+	}
+
+	scratch->cellCount = 0;
+	PathFinder_AppendCell(scratch, query->startCell);
+	for (uint32 i = nodeCount - 1; i > 0; i--)
+	{
+		uint32 from = PathFinder_GetNodeCell(finder, query, scratch->nodes[i]);
+		uint32 to = PathFinder_GetNodeCell(finder, query, scratch->nodes[i - 1]);
+		if (from != to)
+			PathFinder_Refine(finder, scratch, from, to);
+	}
+
+	// Keep the cells where the direction changes.
+	uint32 count = scratch->cellCount;
+	float2* points = (float2*)malloc(sizeof(float2) * (count + 1));
+	uint32 pointCount = 0;
+	points[pointCount++] = query->start;
+	for (uint32 i = 1; i + 1 < count; i++)
+	{
+		int32 before = (int32)scratch->cells[i] - (int32)scratch->cells[i - 1];
+		int32 after = (int32)scratch->cells[i + 1] - (int32)scratch->cells[i];
+		if (before == after)
+			continue;
+		points[pointCount].x = ((scratch->cells[i] % finder->width) + 0.5f) * finder->cellSize;
+		points[pointCount].y = ((scratch->cells[i] / finder->width) + 0.5f) * finder->cellSize;
+		pointCount++;
+	}
+	points[pointCount++] = query->goal;
+	query->points = points;
+	query->pointCount = pointCount;
+	query->status = PATH_FINDER_FOUND;
+}
+
+static PathFinder_Query* PathFinder_GetQuery(const PathFinder* finder, uint32 request)
+{
+	uint32 index = request & PATH_FINDER_INDEX_MASK;
+	if (request == PATH_FINDER_INVALID || index >= finder->maxRequests)
+		return NULL;
+	PathFinder_Query* query = &finder->queries[index];
+	return query->used && query->handle == request ? query : NULL;
+}
+
+static khint64_t PathFinder_GetCacheKey(const PathFinder* finder, uint32 startCell, uint32 goalCell)
+{
+	uint32 block = (startCell / finder->width / finder->cacheBlock) * finder->cacheColumns + (startCell % finder->width) / finder->cacheBlock;
+	return ((khint64_t)block << 32) | goalCell;
+}
+
+static void PathFinder_DropCacheEntry(PathFinder* finder, PathFinder_CacheEntry* entry)
+{
+	khiter_t k = kh_get(PathCache, finder->cacheMap, entry->key);
+	if (k != kh_end(finder->cacheMap))
+		kh_del(PathCache, finder->cacheMap, k);
+	free(entry->points);
+	entry->points = NULL;
+	entry->pointCount = 0;
+}
+
+static void PathFinder_CachePath(PathFinder* finder, const PathFinder_Query* query)
+{
+	khint64_t key = PathFinder_GetCacheKey(finder, query->startCell, query->goalCell);
+	if (kh_get(PathCache, finder->cacheMap, key) != kh_end(finder->cacheMap))
+		return;
+
+	PathFinder_CacheEntry* entry = NULL;
+	for (uint32 i = 0; i < finder->cacheSize; i++)
+	{
+		PathFinder_CacheEntry* candidate = &finder->cache[i];
+		if (candidate->pointCount == 0)
+		{
+			entry = candidate;
+			break;
+		}
+		if (entry == NULL || candidate->lastUse < entry->lastUse)
+			entry = candidate;
+	}
+	if (entry->pointCount > 0)
+		PathFinder_DropCacheEntry(finder, entry);
+
+	entry->key = key;
+	entry->lastUse = ++finder->useCount;
+	entry->pointCount = query->pointCount;
+	entry->points = (float2*)malloc(sizeof(float2) * query->pointCount);
+	memcpy(entry->points, query->points, sizeof(float2) * query->pointCount);
+	entry->minX = entry->minZ = INT_MAX;
+	entry->maxX = entry->maxZ = INT_MIN;
+	for (uint32 i = 0; i < query->pointCount; i++)
+	{
+		int32 x = (int32)floorf(query->points[i].x * finder->inverseCellSize);
+		int32 z = (int32)floorf(query->points[i].y * finder->inverseCellSize);
+		entry->minX = x < entry->minX ? x : entry->minX;
+		entry->minZ = z < entry->minZ ? z : entry->minZ;
+		entry->maxX = x > entry->maxX ? x : entry->maxX;
+		entry->maxZ = z > entry->maxZ ? z : entry->maxZ;
+	}
+
+	int ret;
+	khiter_t k = kh_put(PathCache, finder->cacheMap, key, &ret);
+	ASSERT(ret >= 0);
+	kh_value(finder->cacheMap, k) = (uint32)(entry - finder->cache);
+}
+
+PathFinder* PathFinder_Create(const PathFinder_Desc* path_finder_desc)
+{
+	ASSERT(path_finder_desc->cellSize > 0.0f);
+
+	PathFinder* finder = (PathFinder*)malloc(sizeof(PathFinder));
+	memset(finder, 0, sizeof(PathFinder));
+	finder->width = path_finder_desc->width;
+	finder->height = path_finder_desc->height;
+	finder->cellSize = path_finder_desc->cellSize;
+	finder->inverseCellSize = 1.0f / path_finder_desc->cellSize;
+	finder->clusterSize = path_finder_desc->clusterSize > 0 ? path_finder_desc->clusterSize : 16;
+	ASSERT(finder->clusterSize >= 2 && finder->clusterSize <= PATH_FINDER_MAX_CLUSTER_SIZE);
+	ASSERT(finder->width % finder->clusterSize == 0 && finder->height % finder->clusterSize == 0);
+	finder->clusterColumns = finder->width / finder->clusterSize;
+	finder->clusterRows = finder->height / finder->clusterSize;
+	uint32 clusterCount = finder->clusterColumns * finder->clusterRows;
+	finder->nodeIdCount = clusterCount * PATH_FINDER_MAX_CLUSTER_NODES + 2;
+
+	uint32 cellCount = finder->width * finder->height;
+	finder->costs = (uint8*)malloc(cellCount);
+	if (path_finder_desc->costs != NULL)
+		memcpy(finder->costs, path_finder_desc->costs, cellCount);
+	else
+		memset(finder->costs, 1, cellCount);
+	finder->nodeAt = (uint8*)malloc(cellCount);
+	memset(finder->nodeAt, PATH_FINDER_NO_NODE, cellCount);
+	finder->clusters = (PathFinder_Cluster*)malloc(sizeof(PathFinder_Cluster) * clusterCount);
+	memset(finder->clusters, 0, sizeof(PathFinder_Cluster) * clusterCount);
+	finder->rebuild = (uint8*)malloc(clusterCount);
+
+	finder->maxRequests = path_finder_desc->maxRequests > 0 ? path_finder_desc->maxRequests : 1024;
+	ASSERT(finder->maxRequests <= PATH_FINDER_INDEX_MASK);
+	finder->queries = (PathFinder_Query*)malloc(sizeof(PathFinder_Query) * finder->maxRequests);
+	memset(finder->queries, 0, sizeof(PathFinder_Query) * finder->maxRequests);
+	for (uint32 i = 0; i < finder->maxRequests; i++)
+	{
+		finder->queries[i].next = i + 1 < finder->maxRequests ? i + 1 : PATH_FINDER_INVALID;
+	}
+	finder->queue = (uint32*)malloc(sizeof(uint32) * finder->maxRequests);
+
+	finder->cacheSize = path_finder_desc->cacheSize > 0 ? path_finder_desc->cacheSize : 256;
+	finder->cacheBlock = path_finder_desc->cacheBlock > 0 ? path_finder_desc->cacheBlock : 4;
+	finder->cacheColumns = (finder->width + finder->cacheBlock - 1) / finder->cacheBlock;
+	finder->cache = (PathFinder_CacheEntry*)malloc(sizeof(PathFinder_CacheEntry) * finder->cacheSize);
+	memset(finder->cache, 0, sizeof(PathFinder_CacheEntry) * finder->cacheSize);
+	finder->cacheMap = kh_init(PathCache);
+	finder->batchMap = kh_init(PathCache);
+
+	PathFinder_ReserveScratch(finder, 1);
+	for (uint32 i = 0; i < clusterCount; i++)
+	{
+		PathFinder_RebuildCluster(finder, &finder->scratch[0], i);
+	}
+	return finder;
+}
+
+void PathFinder_Destroy(PathFinder* finder)
+{
+	for (uint32 i = 0; i < finder->scratchCount; i++)
+	{
+		PathFinder_Scratch* scratch = &finder->scratch[i];
+		free(scratch->nodeCosts);
+		free(scratch->nodeEstimates);
+		free(scratch->nodeParents);
+		free(scratch->nodeStamps);
+		free(scratch->heap.entries);
+		free(scratch->nodes);
+		free(scratch->cells);
+	}
+	free(finder->scratch);
+	for (uint32 i = 0; i < finder->cacheSize; i++)
+	{
+		free(finder->cache[i].points);
+	}
+	kh_destroy(PathCache, finder->cacheMap);
+	kh_destroy(PathCache, finder->batchMap);
+	free(finder->cache);
+	for (uint32 i = 0; i < finder->maxRequests; i++)
+	{
+		free(finder->queries[i].points);
+	}
+	free(finder->queue);
+	free(finder->queries);
+	free(finder->rebuild);
+	free(finder->clusters);
+	free(finder->nodeAt);
+	free(finder->costs);
+	free(finder);
+}
+
+void PathFinder_SetCosts(PathFinder* finder, uint32 x, uint32 z, uint32 width, uint32 height, const uint8* costs)
+{
+	ASSERT(x + width <= finder->width && z + height <= finder->height);
+	if (width == 0 || height == 0)
+		return;
+	for (uint32 row = 0; row < height; row++)
+	{
+		memcpy(finder->costs + (z + row) * finder->width + x, costs + row * width, width);
+	}
+	for (uint32 i = 0; i < finder->scratchCount; i++)
+	{
+		finder->scratch[i].tileCluster = PATH_FINDER_INVALID;
+	}
+
+	// The clusters holding the change get new entrances and costs. Their
+	// neighbours' costs stay, they only follow when an entrance on the
+	// shared border moved.
+	uint32 size = finder->clusterSize;
+	uint32 cx0 = x / size;
+	uint32 cz0 = z / size;
+	uint32 cx1 = (x + width - 1) / size;
+	uint32 cz1 = (z + height - 1) / size;
+	memset(finder->rebuild, 0, finder->clusterColumns * finder->clusterRows);
+	for (uint32 cz = cz0; cz <= cz1; cz++)
+	{
+		for (uint32 cx = cx0; cx <= cx1; cx++)
+		{
+			uint32 cluster = cz * finder->clusterColumns + cx;
+			finder->rebuild[cluster] = 1;
+			PathFinder_RebuildCluster(finder, &finder->scratch[0], cluster);
+		}
+	}
+	for (uint32 cz = cz0; cz <= cz1; cz++)
+	{
+		for (uint32 cx = cx0; cx <= cx1; cx++)
+		{
+			uint32 cluster = cz * finder->clusterColumns + cx;
+			for (uint32 side = 0; side < 4; side++)
+			{
+				uint32 neighbour = PathFinder_GetNeighbour(finder, cluster, side);
+				if (neighbour == PATH_FINDER_INVALID || finder->rebuild[neighbour])
+					continue;
+				for (uint32 i = 0; i < size; i++)
+				{
+					uint32 inside, across;
+					PathFinder_GetBorderCells(finder, cluster, side, i, &inside, &across);
+					if ((finder->nodeAt[inside] == PATH_FINDER_NO_NODE) != (finder->nodeAt[across] == PATH_FINDER_NO_NODE))
+					{
+						finder->rebuild[neighbour] = 1;
+						PathFinder_RebuildCluster(finder, &finder->scratch[0], neighbour);
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	// Diagonal steps next to the change depend on it too.
+	int32 minX = (int32)x - 1;
+	int32 minZ = (int32)z - 1;
+	int32 maxX = (int32)(x + width);
+	int32 maxZ = (int32)(z + height);
+	for (uint32 i = 0; i < finder->cacheSize; i++)
+	{
+		PathFinder_CacheEntry* entry = &finder->cache[i];
+		if (entry->pointCount > 0 && entry->minX <= maxX && entry->maxX >= minX && entry->minZ <= maxZ && entry->maxZ >= minZ)
+			PathFinder_DropCacheEntry(finder, entry);
+	}
+}
+
+uint8 PathFinder_GetCost(const PathFinder* finder, uint32 x, uint32 z)
+{
+	ASSERT(x < finder->width && z < finder->height);
+	return finder->costs[z * finder->width + x];
+}
+
+static uint32 PathFinder_GetCell(const PathFinder* finder, const float2* position)
+{
+	int32 x = (int32)floorf(position->x * finder->inverseCellSize);
+	int32 z = (int32)floorf(position->y * finder->inverseCellSize);
+	x = x < 0 ? 0 : (x >= (int32)finder->width ? (int32)finder->width - 1 : x);
+	z = z < 0 ? 0 : (z >= (int32)finder->height ? (int32)finder->height - 1 : z);
+	return (uint32)z * finder->width + (uint32)x;
+}
+
+// Walks the cells under the segment, both sides where it passes exactly
+// through a corner, and fails on the first impassable one.
+static int PathFinder_IsLegClear(const PathFinder* finder, const float2* from, const float2* to)
+{
+	float limitX = (float)finder->width - 0.001f;
+	float limitZ = (float)finder->height - 0.001f;
+	float fx = from->x * finder->inverseCellSize;
+	float fz = from->y * finder->inverseCellSize;
+	float tx = to->x * finder->inverseCellSize;
+	float tz = to->y * finder->inverseCellSize;
+	fx = fx < 0.0f ? 0.0f : (fx > limitX ? limitX : fx);
+	fz = fz < 0.0f ? 0.0f : (fz > limitZ ? limitZ : fz);
+	tx = tx < 0.0f ? 0.0f : (tx > limitX ? limitX : tx);
+	tz = tz < 0.0f ? 0.0f : (tz > limitZ ? limitZ : tz);
+
+	int32 x = (int32)fx;
+	int32 z = (int32)fz;
+	int32 endX = (int32)tx;
+	int32 endZ = (int32)tz;
+	int32 stepX = endX > x ? 1 : -1;
+	int32 stepZ = endZ > z ? 1 : -1;
+	float dx = fabsf(tx - fx);
+	float dz = fabsf(tz - fz);
+	float deltaX = dx > 0.0f ? 1.0f / dx : FLT_MAX;
+	float deltaZ = dz > 0.0f ? 1.0f / dz : FLT_MAX;
+	float nextX = dx > 0.0f ? (stepX > 0 ? x + 1 - fx : fx - x) * deltaX : FLT_MAX;
+	float nextZ = dz > 0.0f ? (stepZ > 0 ? z + 1 - fz : fz - z) * deltaZ : FLT_MAX;
+
+	// Each step moves towards the end cell, so it is reached whatever the
+	// rounding.
+	for (;;)
+	{
+		if (finder->costs[z * finder->width + x] == PATH_FINDER_IMPASSABLE)
+			return 0;
+		if (x == endX && z == endZ)
+			return 1;
+		if (z == endZ || (x != endX && nextX < nextZ))
+		{
+			x += stepX;
+			nextX += deltaX;
+		}
+		else if (x == endX || nextZ < nextX)
+		{
+			z += stepZ;
+			nextZ += deltaZ;
+		}
+		else
+		{
+			if (finder->costs[z * finder->width + x + stepX] == PATH_FINDER_IMPASSABLE || finder->costs[(z + stepZ) * finder->width + x] == PATH_FINDER_IMPASSABLE)
+				return 0;
+			x += stepX;
+			z += stepZ;
+			nextX += deltaX;
+			nextZ += deltaZ;
+		}
+	}
+}
+
+static int PathFinder_FindCached(PathFinder* finder, PathFinder_Query* query)
+{
+	khiter_t k = kh_get(PathCache, finder->cacheMap, PathFinder_GetCacheKey(finder, query->startCell, query->goalCell));
+	if (k == kh_end(finder->cacheMap))
+		return 0;
+
+	// The path was found from another start in the block and for another
+	// goal in the cell; the legs to and from them are new and must be
+	// clear, otherwise the request searches on its own.
+	PathFinder_CacheEntry* entry = &finder->cache[kh_value(finder->cacheMap, k)];
+	if (entry->pointCount > 2)
+	{
+		if (!PathFinder_IsLegClear(finder, &query->start, &entry->points[1]) || !PathFinder_IsLegClear(finder, &entry->points[entry->pointCount - 2], &query->goal))
+			return 0;
+	}
+	else if (!PathFinder_IsLegClear(finder, &query->start, &query->goal))
+	{
+		return 0;
+	}
+
+	entry->lastUse = ++finder->useCount;
+	query->points = (float2*)malloc(sizeof(float2) * entry->pointCount);
+	memcpy(query->points, entry->points, sizeof(float2) * entry->pointCount);
+	query->pointCount = entry->pointCount;
+	query->points[0] = query->start;
+	query->points[query->pointCount - 1] = query->goal;
+	query->status = PATH_FINDER_FOUND;
+	finder->stats.cacheHitCount++;
+	return 1;
+}
+
+uint32 PathFinder_Request(PathFinder* finder, const float2* start, const float2* goal)
+{
+	uint32 index = finder->freeQuery;
+	if (index == PATH_FINDER_INVALID)
+	{
+		LOG_W("PathFinder: all %u requests are in use\n", finder->maxRequests);
+		return PATH_FINDER_INVALID;
+	}
+	PathFinder_Query* query = &finder->queries[index];
+	finder->freeQuery = query->next;
+	query->generation = (query->generation + 1) & (0xFFFFFFFFu >> PATH_FINDER_INDEX_BITS);
+	query->handle = (query->generation << PATH_FINDER_INDEX_BITS) | index;
+	query->used = 1;
+	query->start = *start;
+	query->goal = *goal;
+	query->startCell = PathFinder_GetCell(finder, start);
+	query->goalCell = PathFinder_GetCell(finder, goal);
+	query->points = NULL;
+	query->pointCount = 0;
+	query->leader = PATH_FINDER_INVALID;
+	finder->stats.requestCount++;
+
+	if (PathFinder_FindCached(finder, query))
+		return query->handle;
+
+	query->status = PATH_FINDER_PENDING;
+	finder->queue[(finder->queueHead + finder->queueCount) % finder->maxRequests] = query->handle;
+	finder->queueCount++;
+	finder->stats.queuedCount = finder->queueCount;
+	return query->handle;
+}
+
+static void PathFinder_SolveRange(void* userData, uint32 begin, uint32 end)
+{
+	PathFinder* finder = (PathFinder*)userData;
+	uint32 thread = finder->jobs != NULL ? JobSystem_GetThreadIndex(finder->jobs) : 0;
+	PathFinder_Scratch* scratch = &finder->scratch[thread];
+	for (uint32 lane = begin; lane < end; lane++)
+	{
+		int solved = 0;
+		for (;;)
+		{
+			if (solved && Timer_GetMilliseconds() > finder->deadline)
+				break;
+			uint32 taken = (uint32)(Atomic_Add(&finder->nextQueued, 1) - 1);
+			if (taken >= finder->batchCount)
+				break;
+			PathFinder_Query* query = PathFinder_GetQuery(finder, finder->queue[(finder->queueHead + taken) % finder->maxRequests]);
+			if (query == NULL || query->status != PATH_FINDER_PENDING || query->leader != PATH_FINDER_INVALID)
+				continue;
+			PathFinder_Solve(finder, scratch, query);
+			solved = 1;
+		}
+	}
+}
+
+void PathFinder_Update(PathFinder* finder, JobSystem* jobs, double budget)
+{
+	if (finder->queueCount == 0)
+		return;
+
+	double start = Timer_GetMilliseconds();
+	uint32 lanes = jobs != NULL ? JobSystem_GetThreadCount(jobs) : 1;
+	PathFinder_ReserveScratch(finder, lanes);
+	finder->jobs = jobs;
+	finder->deadline = start + budget;
+	finder->batchCount = finder->queueCount;
+
+	// Requests queued together towards one goal, a squad most of the time,
+	// search once and take the rest from the cache afterwards.
+	kh_clear(PathCache, finder->batchMap);
+	for (uint32 i = 0; i < finder->batchCount; i++)
+	{
+		PathFinder_Query* query = PathFinder_GetQuery(finder, finder->queue[(finder->queueHead + i) % finder->maxRequests]);
+		if (query == NULL)
+			continue;
+		int ret;
+		khiter_t k = kh_put(PathCache, finder->batchMap, PathFinder_GetCacheKey(finder, query->startCell, query->goalCell), &ret);
+		ASSERT(ret >= 0);
+		if (ret == 0)
+			query->leader = kh_value(finder->batchMap, k);
+		else
+			kh_value(finder->batchMap, k) = (uint32)(query - finder->queries);
+	}
+
+	Atomic_Store(&finder->nextQueued, 0);
+	if (jobs != NULL)
+		JobSystem_ParallelFor(jobs, lanes, 1, PathFinder_SolveRange, finder);
+	else
+		PathFinder_SolveRange(finder, 0, 1);
+
+	uint32 taken = (uint32)Atomic_Load(&finder->nextQueued);
+	taken = taken < finder->batchCount ? taken : finder->batchCount;
+	for (uint32 i = 0; i < taken; i++)
+	{
+		PathFinder_Query* query = PathFinder_GetQuery(finder, finder->queue[(finder->queueHead + i) % finder->maxRequests]);
+		if (query == NULL)
+			continue;
+		if (query->leader == PATH_FINDER_INVALID)
+		{
+			if (query->status == PATH_FINDER_FOUND)
+				PathFinder_CachePath(finder, query);
+			continue;
+		}
+
+		const PathFinder_Query* leader = &finder->queries[query->leader];
+		query->leader = PATH_FINDER_INVALID;
+		if (PathFinder_FindCached(finder, query))
+			continue;
+		if (leader->status == PATH_FINDER_NOT_FOUND && leader->startCell == query->startCell)
+		{
+			query->status = PATH_FINDER_NOT_FOUND;
+			continue;
+		}
+		PathFinder_Solve(finder, &finder->scratch[0], query);
+		if (query->status == PATH_FINDER_FOUND)
+			PathFinder_CachePath(finder, query);
+	}
+	// Followers left in the queue search on their own next time.
+	for (uint32 i = taken; i < finder->batchCount; i++)
+	{
+		PathFinder_Query* query = PathFinder_GetQuery(finder, finder->queue[(finder->queueHead + i) % finder->maxRequests]);
+		if (query != NULL)
+			query->leader = PATH_FINDER_INVALID;
+	}
+	finder->queueHead = (finder->queueHead + taken) % finder->maxRequests;
+	finder->queueCount -= taken;
+
+	for (uint32 i = 0; i < finder->scratchCount; i++)
+	{
+		PathFinder_Scratch* scratch = &finder->scratch[i];
+		finder->stats.searchCount += scratch->searchCount;
+		finder->stats.notFoundCount += scratch->notFoundCount;
+		finder->stats.nodeExpandedCount += scratch->nodeExpandedCount;
+		finder->stats.cellExpandedCount += scratch->cellExpandedCount;
+		scratch->searchCount = scratch->notFoundCount = scratch->nodeExpandedCount = scratch->cellExpandedCount = 0;
+	}
+	finder->stats.queuedCount = finder->queueCount;
+	finder->stats.searchTime += Timer_GetMilliseconds() - start;
+}
+
+PathFinder_Status PathFinder_GetStatus(const PathFinder* finder, uint32 request)
+{
+	const PathFinder_Query* query = PathFinder_GetQuery(finder, request);
+	ASSERT(query != NULL);
+	return query->status;
+}
+
+uint32 PathFinder_GetPath(const PathFinder* finder, uint32 request, const float2** points)
+{
+	const PathFinder_Query* query = PathFinder_GetQuery(finder, request);
+	ASSERT(query != NULL);
+	*points = query->points;
+	return query->pointCount;
+}
+
+void PathFinder_Free(PathFinder* finder, uint32 request)
+{
+	PathFinder_Query* query = PathFinder_GetQuery(finder, request);
+	ASSERT(query != NULL);
+	if (query->status == PATH_FINDER_PENDING)
+	{
+		uint32 kept = 0;
+		for (uint32 i = 0; i < finder->queueCount; i++)
+		{
+			uint32 handle = finder->queue[(finder->queueHead + i) % finder->maxRequests];
+			if (handle != request)
+				finder->queue[(finder->queueHead + kept++) % finder->maxRequests] = handle;
+		}
+		finder->queueCount = kept;
+		finder->stats.queuedCount = kept;
+	}
+	free(query->points);
+	query->points = NULL;
+	query->pointCount = 0;
+	query->used = 0;
+	query->next = finder->freeQuery;
+	finder->freeQuery = (uint32)(query - finder->queries);
+}
+
+void PathFinder_GetStats(const PathFinder* finder, PathFinder_Stats* stats)
+{
+	*stats = finder->stats;
+}
+
+void PathFinder_ResetStats(PathFinder* finder)
+{
+	uint32 queuedCount = finder->queueCount;
+	memset(&finder->stats, 0, sizeof(PathFinder_Stats));
+	finder->stats.queuedCount = queuedCount;
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+#ifndef __PATH_FINDER_H__
+#define __PATH_FINDER_H__
+
+#include "config.h"
+#include "maths.h"
+#include "job_system.h"
+
+#define PATH_FINDER_IMPASSABLE 255
+#define PATH_FINDER_INVALID 0xFFFFFFFFu
+
+// Hierarchical A* (HPA*) for single units and small squads over a grid of
+// movement costs (1..254 per cell, PATH_FINDER_IMPASSABLE for walls). The
+// grid is cut into square clusters; every open stretch of a cluster border
+// becomes one or two entrance nodes, and the cost between the entrances of
+// a cluster is found once by a search inside it. A path is searched on
+// that small graph, with start and goal attached to the entrances of their
+// clusters, and refined cluster by cluster into cells. Changing costs only
+// rebuilds the clusters around the change.
+//
+// Requests are queued; PathFinder_Update works through the queue on the
+// job system until its time budget is spent, the rest waits for the next
+// call. Found paths are kept in an LRU cache keyed by goal cell and the
+// block of cells around the start, so a squad ordered to one spot is
+// served from the first path, also when its requests wait in the queue
+// together; such a path may begin up to a block away from a unit, and is
+// only reused when the new first and last legs cross no impassable cell.
+// Cost changes drop the cached paths that cross them.
+//
+// Paths are cell centres with straight runs merged, from the requested
+// start to the requested goal, in world units. All calls belong to one
+// thread and cost changes must not happen during PathFinder_Update.
+typedef struct PathFinder PathFinder;
+
+typedef enum PathFinder_Status
+{
+	PATH_FINDER_PENDING,
+	PATH_FINDER_FOUND,
+	PATH_FINDER_NOT_FOUND
+} PathFinder_Status;
+
+typedef struct PathFinder_Desc
+{
+	// Cells; multiples of clusterSize.
+	uint32 width;
+	uint32 height;
+	float cellSize;
+	// 16 when 0, at most 16 so a cluster border holds at most 8 entrances.
+	uint32 clusterSize;
+	// Requests not yet freed, 1024 when 0.
+	uint32 maxRequests;
+	// Cached paths, 256 when 0.
+	uint32 cacheSize;
+	// Cells per side of the start block of the cache key, 4 when 0.
+	uint32 cacheBlock;
+	// Row-major, all 1 when NULL.
+	const uint8* costs;
+} PathFinder_Desc;
+
+typedef struct PathFinder_Stats
+{
+	uint32 requestCount;
+	uint32 cacheHitCount;
+	uint32 searchCount;
+	uint32 notFoundCount;
+	// Abstract nodes taken off the open list and cells expanded while
+	// refining and attaching start and goal.
+	uint32 nodeExpandedCount;
+	uint32 cellExpandedCount;
+	uint32 clusterRebuildCount;
+	uint32 queuedCount;
+	double searchTime;
+} PathFinder_Stats;
+
+PathFinder* PathFinder_Create(const PathFinder_Desc* path_finder_desc);
+void PathFinder_Destroy(PathFinder* finder);
+
+void PathFinder_SetCosts(PathFinder* finder, uint32 x, uint32 z, uint32 width, uint32 height, const uint8* costs);
+uint8 PathFinder_GetCost(const PathFinder* finder, uint32 x, uint32 z);
+
+// Returns PATH_FINDER_INVALID when maxRequests are not freed yet. Cache
+// hits are found at once.
+uint32 PathFinder_Request(PathFinder* finder, const float2* start, const float2* goal);
+// Runs queued searches until budget milliseconds passed; every thread of
+// the job system (NULL for the calling one) finishes at least one.
+void PathFinder_Update(PathFinder* finder, JobSystem* jobs, double budget);
+PathFinder_Status PathFinder_GetStatus(const PathFinder* finder, uint32 request);
+// Points stay valid until the request is freed.
+uint32 PathFinder_GetPath(const PathFinder* finder, uint32 request, const float2** points);
+// Pending requests are dropped from the queue.
+void PathFinder_Free(PathFinder* finder, uint32 request);
+
+void PathFinder_GetStats(const PathFinder* finder, PathFinder_Stats* stats);
+void PathFinder_ResetStats(PathFinder* finder);
+
+#endif
\ No newline at end of file
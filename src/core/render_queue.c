@@ -0,0 +1,399 @@
+#include "render_queue.h"
+#include "vertex.h"
+#include <string.h>
+#include <opengl/glad_ext.h>
+
+#define RENDER_QUEUE_TRANSFORMS 0
+#define RENDER_QUEUE_DRAW_IDS 1
+#define RENDER_QUEUE_COMMANDS 2
+
+typedef struct RenderQueue_Item
+{
+	Chunk* chunk;
+	Material* material;
+	GeometryPool* pool;
+	uint32 order;
+	uint32 firstInstance;
+	uint32 instanceCount;
+} RenderQueue_Item;
+
+typedef struct RenderQueue_DrawCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+} RenderQueue_DrawCommand;
+
+struct RenderQueue
+{
+	matrix4x4 viewProjection;
+	RenderQueue_Item* items;
+	RenderQueue_DrawCommand* commands;
+	uint32 itemCount;
+	uint32 itemCapacity;
+	matrix4x4* transforms;
+	uint32 instanceCount;
+	uint32 maxInstances;
+	GLuint boIds[3];
+	uint32 drawCallCount;
+	int multiDraw;
+	GpuCull* cull;
+	Material* overrideMaterial;
+	GpuCull_Instance* cullInstances;
+	OcclusionBuffer* occlusion;
+	Aabb* occlusionBounds;
+	uint8* occlusionVisible;
+};
+
+static int RenderQueue_CompareItems(const void* a, const void* b)
+{
+	const RenderQueue_Item* left = (const RenderQueue_Item*)a;
+	const RenderQueue_Item* right = (const RenderQueue_Item*)b;
+	if (left->material != right->material)
+		return (size_t)left->material < (size_t)right->material ? -1 : 1;
+	if (left->pool != right->pool)
+		return (size_t)left->pool < (size_t)right->pool ? -1 : 1;
+	return (int)left->order - (int)right->order;
+}
+
+static void RenderQueue_TransformBounds(const matrix4x4* transform, const Aabb* bounds, Aabb* out)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		float3 corner;
+		corner.x = (i & 1) ? bounds->max.x : bounds->min.x;
+		corner.y = (i & 2) ? bounds->max.y : bounds->min.y;
+		corner.z = (i & 4) ? bounds->max.z : bounds->min.z;
+
+		float4 point;
+		Matrix4x4_TransformPoint(transform, &corner, &point);
+		if (i == 0)
+		{
+			out->min.x = out->max.x = point.x;
+			out->min.y = out->max.y = point.y;
+			out->min.z = out->max.z = point.z;
+			continue;
+		}
+		out->min.x = point.x < out->min.x ? point.x : out->min.x;
+		out->min.y = point.y < out->min.y ? point.y : out->min.y;
+		out->min.z = point.z < out->min.z ? point.z : out->min.z;
+		out->max.x = point.x > out->max.x ? point.x : out->max.x;
+		out->max.y = point.y > out->max.y ? point.y : out->max.y;
+		out->max.z = point.z > out->max.z ? point.z : out->max.z;
+	}
+}
+
+static void RenderQueue_BindInstanceAttributes(GLuint drawIds, GLuint transforms, uint32 firstInstance)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, drawIds);
+	glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_DRAW_ID);
+	glVertexAttribIPointer(INSTANCE_ATTRIBUTE_DRAW_ID, 1, GL_UNSIGNED_INT, sizeof(GLuint), (const void*)(firstInstance * sizeof(GLuint)));
+	glVertexAttribDivisor(INSTANCE_ATTRIBUTE_DRAW_ID, 1);
+
+	glBindBuffer(GL_ARRAY_BUFFER, transforms);
+	for (int i = 0; i < 4; i++)
+	{
+		glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_MODEL + i);
+		glVertexAttribPointer(INSTANCE_ATTRIBUTE_MODEL + i, 4, GL_FLOAT, GL_FALSE, sizeof(matrix4x4), (const void*)(firstInstance * sizeof(matrix4x4) + i * sizeof(float4)));
+		glVertexAttribDivisor(INSTANCE_ATTRIBUTE_MODEL + i, 1);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+static void RenderQueue_UnbindInstanceAttributes(RenderQueue* queue)
+{
+	glVertexAttribDivisor(INSTANCE_ATTRIBUTE_DRAW_ID, 0);
+	glDisableVertexAttribArray(INSTANCE_ATTRIBUTE_DRAW_ID);
+	for (int i = 0; i < 4; i++)
+	{
+		glVertexAttribDivisor(INSTANCE_ATTRIBUTE_MODEL + i, 0);
+		glDisableVertexAttribArray(INSTANCE_ATTRIBUTE_MODEL + i);
+	}
+}
+
+static void RenderQueue_ApplyMaterial(RenderQueue* queue, Material* material)
+{
+	Shader* shader = Material_Get_Shader(material);
+	Shader_Use(shader);
+	Material_Apply(material);
+	GLint location = Shader_GetLocation(shader, "uViewProjection");
+	if (location != -1)
+	{
+		glUniformMatrix4fv(location, 1, GL_FALSE, queue->viewProjection.data);
+	}
+}
+
+RenderQueue* RenderQueue_Create(uint32 maxInstances)
+{
+	ASSERT(maxInstances > 0);
+	if (!GLAD_GL_VERSION_3_3)
+	{
+		LOG_E("Render queue requires OpenGL 3.3 for instanced arrays\n");
+		return NULL;
+	}
+
+	RenderQueue* queue = (RenderQueue*)malloc(sizeof(RenderQueue));
+	queue->itemCount = 0;
+	queue->itemCapacity = 64;
+	queue->items = (RenderQueue_Item*)malloc(sizeof(RenderQueue_Item) * queue->itemCapacity);
+	queue->commands = (RenderQueue_DrawCommand*)malloc(sizeof(RenderQueue_DrawCommand) * queue->itemCapacity);
+	queue->instanceCount = 0;
+	queue->maxInstances = maxInstances;
+	queue->transforms = (matrix4x4*)malloc(sizeof(matrix4x4) * maxInstances);
+	queue->drawCallCount = 0;
+	queue->multiDraw = GLAD_GL_VERSION_4_3;
+	queue->cull = NULL;
+	queue->overrideMaterial = NULL;
+	queue->cullInstances = NULL;
+	queue->occlusion = NULL;
+	queue->occlusionBounds = NULL;
+	queue->occlusionVisible = NULL;
+
+	glGenBuffers(3, queue->boIds);
+
+	GLuint* drawIds = (GLuint*)malloc(sizeof(GLuint) * maxInstances);
+	for (uint32 i = 0; i < maxInstances; i++)
+	{
+		drawIds[i] = i;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, queue->boIds[RENDER_QUEUE_DRAW_IDS]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GLuint) * maxInstances, drawIds, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, queue->boIds[RENDER_QUEUE_TRANSFORMS]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(matrix4x4) * maxInstances, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	free(drawIds);
+
+	memset(&queue->viewProjection, 0, sizeof(matrix4x4));
+	queue->viewProjection.a1 = queue->viewProjection.b2 = queue->viewProjection.c3 = queue->viewProjection.d4 = 1.0f;
+
+	return queue;
+}
+
+void RenderQueue_Destroy(RenderQueue* queue)
+{
+	glDeleteBuffers(3, queue->boIds);
+	free(queue->cullInstances);
+	free(queue->occlusionBounds);
+	free(queue->occlusionVisible);
+	free(queue->transforms);
+	free(queue->commands);
+	free(queue->items);
+	free(queue);
+}
+
+void RenderQueue_SetMultiDraw(RenderQueue* queue, int enabled)
+{
+	queue->multiDraw = enabled && GLAD_GL_VERSION_4_3;
+}
+
+int RenderQueue_GetMultiDraw(const RenderQueue* queue)
+{
+	return queue->multiDraw;
+}
+
+void RenderQueue_SetGpuCull(RenderQueue* queue, GpuCull* cull)
+{
+	queue->cull = cull;
+	if (cull != NULL && queue->cullInstances == NULL)
+	{
+		queue->cullInstances = (GpuCull_Instance*)malloc(sizeof(GpuCull_Instance) * queue->maxInstances);
+	}
+}
+
+void RenderQueue_SetOcclusionBuffer(RenderQueue* queue, OcclusionBuffer* buffer)
+{
+	queue->occlusion = buffer;
+	if (buffer != NULL && queue->occlusionBounds == NULL)
+	{
+		queue->occlusionBounds = (Aabb*)malloc(sizeof(Aabb) * queue->maxInstances);
+		queue->occlusionVisible = (uint8*)malloc(sizeof(uint8) * queue->maxInstances);
+	}
+}
+
+OcclusionBuffer* RenderQueue_GetOcclusionBuffer(const RenderQueue* queue)
+{
+	return queue->occlusion;
+}
+
+void RenderQueue_SetOverrideMaterial(RenderQueue* queue, Material* material)
+{
+	queue->overrideMaterial = material;
+}
+
+void RenderQueue_Begin(RenderQueue* queue, const matrix4x4* viewProjection)
+{
+	queue->itemCount = 0;
+	queue->instanceCount = 0;
+	if (viewProjection != NULL)
+	{
+		queue->viewProjection = *viewProjection;
+	}
+}
+
+Result RenderQueue_Add(RenderQueue* queue, Chunk* chunk, const matrix4x4* transforms, uint32 instanceCount)
+{
+	ASSERT(chunk != NULL && transforms != NULL);
+	if (instanceCount == 0)
+		return Result_SUCCESS;
+	if (queue->instanceCount + instanceCount > queue->maxInstances)
+	{
+		LOG_W("Render queue is full, dropping %u instances\n", instanceCount);
+		return Result_FAILURE;
+	}
+
+	matrix4x4* destination = &queue->transforms[queue->instanceCount];
+	if (queue->occlusion != NULL)
+	{
+		Aabb bounds;
+		Mesh_GetBounds(Chunk_Get_Mesh(chunk), &bounds);
+		for (uint32 i = 0; i < instanceCount; i++)
+		{
+			RenderQueue_TransformBounds(&transforms[i], &bounds, &queue->occlusionBounds[i]);
+		}
+		OcclusionBuffer_TestAabbs(queue->occlusion, queue->occlusionBounds, instanceCount, queue->occlusionVisible);
+
+		uint32 visibleCount = 0;
+		for (uint32 i = 0; i < instanceCount; i++)
+		{
+			if (queue->occlusionVisible[i])
+				destination[visibleCount++] = transforms[i];
+		}
+		if (visibleCount == 0)
+			return Result_SUCCESS;
+		instanceCount = visibleCount;
+	}
+	else
+	{
+		memcpy(destination, transforms, sizeof(matrix4x4) * instanceCount);
+	}
+
+	if (queue->itemCount == queue->itemCapacity)
+	{
+		queue->itemCapacity *= 2;
+		queue->items = (RenderQueue_Item*)realloc(queue->items, sizeof(RenderQueue_Item) * queue->itemCapacity);
+		queue->commands = (RenderQueue_DrawCommand*)realloc(queue->commands, sizeof(RenderQueue_DrawCommand) * queue->itemCapacity);
+	}
+
+	RenderQueue_Item* item = &queue->items[queue->itemCount];
+	item->chunk = chunk;
+	item->material = queue->overrideMaterial != NULL ? queue->overrideMaterial : Chunk_Get_Material(chunk);
+	item->pool = Mesh_GetPool(Chunk_Get_Mesh(chunk));
+	item->order = queue->itemCount;
+	item->firstInstance = queue->instanceCount;
+	item->instanceCount = instanceCount;
+	queue->itemCount++;
+	queue->instanceCount += instanceCount;
+	return Result_SUCCESS;
+}
+
+void RenderQueue_Submit(RenderQueue* queue)
+{
+	queue->drawCallCount = 0;
+	if (queue->itemCount == 0)
+		return;
+
+	qsort(queue->items, queue->itemCount, sizeof(RenderQueue_Item), RenderQueue_CompareItems);
+
+	for (uint32 i = 0; i < queue->itemCount; i++)
+	{
+		GeometryPool_Range range;
+		Mesh_GetRange(Chunk_Get_Mesh(queue->items[i].chunk), &range);
+		RenderQueue_DrawCommand* command = &queue->commands[i];
+		command->count = range.indexCount;
+		command->instanceCount = queue->items[i].instanceCount;
+		command->firstIndex = range.firstIndex;
+		command->baseVertex = range.baseVertex;
+		command->baseInstance = queue->items[i].firstInstance;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, queue->boIds[RENDER_QUEUE_TRANSFORMS]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(matrix4x4) * queue->maxInstances, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(matrix4x4) * queue->instanceCount, queue->transforms);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	GLuint drawIds = queue->boIds[RENDER_QUEUE_DRAW_IDS];
+	GLuint transforms = queue->boIds[RENDER_QUEUE_TRANSFORMS];
+	if (queue->multiDraw)
+	{
+		int gpuCull = queue->cull != NULL;
+		if (gpuCull)
+		{
+			for (uint32 i = 0; i < queue->itemCount; i++)
+			{
+				const RenderQueue_Item* item = &queue->items[i];
+				float4 sphere;
+				Mesh_GetBoundingSphere(Chunk_Get_Mesh(item->chunk), &sphere);
+				for (uint32 k = 0; k < item->instanceCount; k++)
+				{
+					GpuCull_Instance* instance = &queue->cullInstances[item->firstInstance + k];
+					instance->sphere = sphere;
+					instance->command = i;
+				}
+				queue->commands[i].instanceCount = 0;
+			}
+		}
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, queue->boIds[RENDER_QUEUE_COMMANDS]);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(RenderQueue_DrawCommand) * queue->itemCount, queue->commands, GL_STREAM_DRAW);
+
+		if (gpuCull)
+		{
+			GpuCull_Dispatch(queue->cull, &queue->viewProjection, queue->cullInstances, queue->instanceCount, queue->boIds[RENDER_QUEUE_TRANSFORMS], queue->boIds[RENDER_QUEUE_COMMANDS]);
+			drawIds = GpuCull_GetVisibleBuffer(queue->cull);
+			transforms = GpuCull_GetVisibleTransformBuffer(queue->cull);
+		}
+	}
+	if (GLAD_GL_VERSION_4_3)
+	{
+		// aDrawID shaders fetch from here on either path.
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, queue->boIds[RENDER_QUEUE_TRANSFORMS]);
+	}
+
+	uint32 first = 0;
+	while (first < queue->itemCount)
+	{
+		Material* material = queue->items[first].material;
+		GeometryPool* pool = queue->items[first].pool;
+		uint32 last = first + 1;
+		while (last < queue->itemCount && queue->items[last].material == material && queue->items[last].pool == pool)
+		{
+			last++;
+		}
+
+		RenderQueue_ApplyMaterial(queue, material);
+		GeometryPool_Bind(pool);
+
+		if (queue->multiDraw)
+		{
+			RenderQueue_BindInstanceAttributes(drawIds, transforms, 0);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, (const void*)(first * sizeof(RenderQueue_DrawCommand)), last - first, 0);
+			queue->drawCallCount++;
+		}
+		else
+		{
+			for (uint32 i = first; i < last; i++)
+			{
+				const RenderQueue_DrawCommand* command = &queue->commands[i];
+				RenderQueue_BindInstanceAttributes(drawIds, transforms, command->baseInstance);
+				glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command->count, GL_UNSIGNED_SHORT, (const void*)(command->firstIndex * sizeof(GLushort)), command->instanceCount, command->baseVertex);
+				queue->drawCallCount++;
+			}
+		}
+
+		RenderQueue_UnbindInstanceAttributes(queue);
+		GeometryPool_Unbind(pool);
+		first = last;
+	}
+
+	if (queue->multiDraw)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+}
+
+uint32 RenderQueue_GetDrawCallCount(const RenderQueue* queue)
+{
+	return queue->drawCallCount;
+}
\ No newline at end of file
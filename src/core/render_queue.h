@@ -0,0 +1,50 @@
+#ifndef __RENDER_QUEUE_H__
+#define __RENDER_QUEUE_H__
+
+#include "config.h"
+#include "maths.h"
+#include "chunk.h"
+#include "gpu_cull.h"
+#include "occlusion.h"
+
+// Collects the chunks of a frame, buckets them by material and geometry
+// pool, and submits every bucket with one glMultiDrawElementsIndirect on
+// GL 4.3. Shaders read the instance transform either from the aModel
+// attribute or, on GL 4.3, with aDrawID from the storage buffer at binding 0
+// (data/triangle_mdi.glsl). Without multi-draw each chunk falls back to one
+// instanced draw, which feeds both the same way.
+//
+// With a GpuCull attached, multi-draw submission culls the instances on the
+// GPU first. aModel then reads the compacted transforms of the survivors and
+// aDrawID their original index, so both kinds of shader keep working.
+//
+// An override material replaces the chunk materials for every item added
+// while it is set, which turns the queue into a depth-only pass for shadow
+// maps. Such passes should run on a queue without GpuCull, whose Hi-Z
+// buffer belongs to the camera.
+//
+// With an OcclusionBuffer attached, RenderQueue_Add drops the instances
+// whose world bounds are hidden behind its occluders, so it has to be
+// rasterized for the queue's camera before the first item is added.
+// RenderSnapshot_Submit does that with the snapshot's occluders. Like
+// GpuCull, it belongs to the camera queue only.
+typedef struct RenderQueue RenderQueue;
+
+// Returns NULL without OpenGL 3.3, whose instanced arrays carry the transforms.
+RenderQueue* RenderQueue_Create(uint32 maxInstances);
+void RenderQueue_Destroy(RenderQueue* queue);
+
+void RenderQueue_SetMultiDraw(RenderQueue* queue, int enabled);
+int RenderQueue_GetMultiDraw(const RenderQueue* queue);
+void RenderQueue_SetGpuCull(RenderQueue* queue, GpuCull* cull);
+void RenderQueue_SetOcclusionBuffer(RenderQueue* queue, OcclusionBuffer* buffer);
+OcclusionBuffer* RenderQueue_GetOcclusionBuffer(const RenderQueue* queue);
+void RenderQueue_SetOverrideMaterial(RenderQueue* queue, Material* material);
+
+void RenderQueue_Begin(RenderQueue* queue, const matrix4x4* viewProjection);
+Result RenderQueue_Add(RenderQueue* queue, Chunk* chunk, const matrix4x4* transforms, uint32 instanceCount);
+void RenderQueue_Submit(RenderQueue* queue);
+
+uint32 RenderQueue_GetDrawCallCount(const RenderQueue* queue);
+
+#endif
\ No newline at end of file
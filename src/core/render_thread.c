@@ -0,0 +1,382 @@
+#include "render_thread.h"
+#include "thread.h"
+#include "timer.h"
+#include "khash.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define RENDER_THREAD_SLOTS 3
+
+KHASH_SET_INIT_STR(render_name)
+
+typedef struct RenderSnapshot_Item
+{
+	Chunk* chunk;
+	uint32 firstInstance;
+	uint32 instanceCount;
+} RenderSnapshot_Item;
+
+typedef struct RenderSnapshot_Occluder
+{
+	const Occluder* occluder;
+	matrix4x4 transform;
+} RenderSnapshot_Occluder;
+
+typedef struct RenderSnapshot_Parameter
+{
+	Material* material;
+	const char* name;
+	float4 value;
+} RenderSnapshot_Parameter;
+
+struct RenderSnapshot
+{
+	uint32 frame;
+	matrix4x4 viewProjection;
+	RenderSnapshot_Item* items;
+	uint32 itemCount;
+	uint32 maxItems;
+	matrix4x4* transforms;
+	uint32 instanceCount;
+	uint32 maxInstances;
+	RenderSnapshot_Parameter* parameters;
+	uint32 parameterCount;
+	uint32 maxParameters;
+	RenderSnapshot_Occluder* occluders;
+	uint32 occluderCount;
+	uint32 maxOccluders;
+	// Shared by all the slots, owned by the thread.
+	khash_t(render_name)* names;
+};
+
+struct RenderThread
+{
+	RenderThread_Desc desc;
+	RenderSnapshot snapshots[RENDER_THREAD_SLOTS];
+	uint32 writing;
+	uint32 latest;
+	uint32 reading;
+	int pending;
+	int running;
+	int started;
+	uint32 frame;
+	Thread* thread;
+	Mutex* mutex;
+	Condition* condition;
+	RenderThread_Stats stats;
+	// Interned parameter names. Materials keep the name as their key, so
+	// the copies live as long as the thread rather than one snapshot.
+	khash_t(render_name)* names;
+};
+
+static void RenderThread_Render(RenderThread* thread, const RenderSnapshot* snapshot)
+{
+	double start = Timer_GetMilliseconds();
+	thread->desc.render(snapshot, thread->desc.userData);
+	double elapsed = Timer_GetMilliseconds() - start;
+
+	if (thread->mutex != NULL)
+		Mutex_Lock(thread->mutex);
+	thread->stats.renderedCount++;
+	thread->stats.renderTime = elapsed;
+	if (thread->mutex != NULL)
+		Mutex_Unlock(thread->mutex);
+}
+
+static void RenderThread_Main(void* userData)
+{
+	RenderThread* thread = (RenderThread*)userData;
+	if (thread->desc.start != NULL)
+		thread->desc.start(thread->desc.userData);
+
+	Mutex_Lock(thread->mutex);
+	thread->started = 1;
+	Condition_Broadcast(thread->condition);
+	for (;;)
+	{
+		while (!thread->pending && thread->running)
+		{
+			Condition_Wait(thread->condition, thread->mutex);
+		}
+		if (!thread->pending)
+			break;
+
+		uint32 swap = thread->reading;
+		thread->reading = thread->latest;
+		thread->latest = swap;
+		thread->pending = 0;
+		Condition_Broadcast(thread->condition);
+		Mutex_Unlock(thread->mutex);
+
+		RenderThread_Render(thread, &thread->snapshots[thread->reading]);
+		Mutex_Lock(thread->mutex);
+	}
+	Mutex_Unlock(thread->mutex);
+
+	if (thread->desc.stop != NULL)
+		thread->desc.stop(thread->desc.userData);
+}
+
+static void RenderSnapshot_Clear(RenderSnapshot* snapshot, uint32 frame)
+{
+	snapshot->frame = frame;
+	snapshot->itemCount = 0;
+	snapshot->instanceCount = 0;
+	snapshot->parameterCount = 0;
+	snapshot->occluderCount = 0;
+}
+
+RenderThread* RenderThread_Create(const RenderThread_Desc* render_thread_desc)
+{
+	ASSERT(render_thread_desc != NULL && render_thread_desc->render != NULL);
+
+	RenderThread* thread = (RenderThread*)malloc(sizeof(RenderThread));
+	memset(thread, 0, sizeof(RenderThread));
+	thread->desc = *render_thread_desc;
+	thread->names = kh_init(render_name);
+	for (uint32 i = 0; i < RENDER_THREAD_SLOTS; i++)
+	{
+		RenderSnapshot* snapshot = &thread->snapshots[i];
+		Matrix4x4_Identity(&snapshot->viewProjection);
+		snapshot->maxItems = render_thread_desc->maxItems;
+		snapshot->maxInstances = render_thread_desc->maxInstances;
+		snapshot->maxParameters = render_thread_desc->maxParameters;
+		snapshot->maxOccluders = render_thread_desc->maxOccluders;
+		snapshot->items = (RenderSnapshot_Item*)malloc(sizeof(RenderSnapshot_Item) * (snapshot->maxItems > 0 ? snapshot->maxItems : 1));
+		snapshot->transforms = (matrix4x4*)malloc(sizeof(matrix4x4) * (snapshot->maxInstances > 0 ? snapshot->maxInstances : 1));
+		snapshot->parameters = (RenderSnapshot_Parameter*)malloc(sizeof(RenderSnapshot_Parameter) * (snapshot->maxParameters > 0 ? snapshot->maxParameters : 1));
+		snapshot->occluders = (RenderSnapshot_Occluder*)malloc(sizeof(RenderSnapshot_Occluder) * (snapshot->maxOccluders > 0 ? snapshot->maxOccluders : 1));
+		snapshot->names = thread->names;
+	}
+	thread->writing = 0;
+	thread->latest = 1;
+	thread->reading = 2;
+	thread->running = 1;
+
+	if (!render_thread_desc->threaded)
+	{
+		if (thread->desc.start != NULL)
+			thread->desc.start(thread->desc.userData);
+		return thread;
+	}
+
+	thread->mutex = Mutex_Create();
+	thread->condition = Condition_Create();
+	thread->thread = Thread_Create(RenderThread_Main, thread);
+	if (thread->thread == NULL)
+	{
+		LOG_W("Falling back to rendering on the calling thread\n");
+		Condition_Destroy(thread->condition);
+		Mutex_Destroy(thread->mutex);
+		thread->condition = NULL;
+		thread->mutex = NULL;
+		thread->desc.threaded = 0;
+		if (thread->desc.start != NULL)
+			thread->desc.start(thread->desc.userData);
+		return thread;
+	}
+
+	Mutex_Lock(thread->mutex);
+	while (!thread->started)
+	{
+		Condition_Wait(thread->condition, thread->mutex);
+	}
+	Mutex_Unlock(thread->mutex);
+	return thread;
+}
+
+void RenderThread_Destroy(RenderThread* thread)
+{
+	if (thread->desc.threaded)
+	{
+		Mutex_Lock(thread->mutex);
+		thread->running = 0;
+		Condition_Broadcast(thread->condition);
+		Mutex_Unlock(thread->mutex);
+		Thread_Join(thread->thread);
+		Condition_Destroy(thread->condition);
+		Mutex_Destroy(thread->mutex);
+	}
+	else if (thread->desc.stop != NULL)
+	{
+		thread->desc.stop(thread->desc.userData);
+	}
+
+	for (uint32 i = 0; i < RENDER_THREAD_SLOTS; i++)
+	{
+		free(thread->snapshots[i].items);
+		free(thread->snapshots[i].transforms);
+		free(thread->snapshots[i].parameters);
+		free(thread->snapshots[i].occluders);
+	}
+	for (khiter_t k = kh_begin(thread->names); k != kh_end(thread->names); k++)
+	{
+		if (kh_exist(thread->names, k))
+			free((char*)kh_key(thread->names, k));
+	}
+	kh_destroy(render_name, thread->names);
+	free(thread);
+}
+
+RenderSnapshot* RenderThread_BeginFrame(RenderThread* thread)
+{
+	// Only the game thread touches the writing slot, no lock needed.
+	RenderSnapshot* snapshot = &thread->snapshots[thread->writing];
+	RenderSnapshot_Clear(snapshot, ++thread->frame);
+	return snapshot;
+}
+
+void RenderThread_Publish(RenderThread* thread)
+{
+	if (!thread->desc.threaded)
+	{
+		thread->stats.publishedCount++;
+		RenderThread_Render(thread, &thread->snapshots[thread->writing]);
+		return;
+	}
+
+	Mutex_Lock(thread->mutex);
+	uint32 swap = thread->latest;
+	thread->latest = thread->writing;
+	thread->writing = swap;
+	if (thread->pending)
+		thread->stats.droppedCount++;
+	thread->pending = 1;
+	thread->stats.publishedCount++;
+	Condition_Signal(thread->condition);
+	Mutex_Unlock(thread->mutex);
+}
+
+void RenderThread_Wait(RenderThread* thread)
+{
+	if (!thread->desc.threaded)
+		return;
+
+	Mutex_Lock(thread->mutex);
+	while (thread->pending)
+	{
+		Condition_Wait(thread->condition, thread->mutex);
+	}
+	Mutex_Unlock(thread->mutex);
+}
+
+int RenderThread_IsThreaded(const RenderThread* thread)
+{
+	return thread->desc.threaded;
+}
+
+void RenderThread_GetStats(RenderThread* thread, RenderThread_Stats* stats)
+{
+	if (thread->mutex != NULL)
+		Mutex_Lock(thread->mutex);
+	*stats = thread->stats;
+	if (thread->mutex != NULL)
+		Mutex_Unlock(thread->mutex);
+}
+
+void RenderSnapshot_SetCamera(RenderSnapshot* snapshot, const matrix4x4* viewProjection)
+{
+	snapshot->viewProjection = *viewProjection;
+}
+
+Result RenderSnapshot_AddChunk(RenderSnapshot* snapshot, Chunk* chunk, const matrix4x4* transforms, uint32 instanceCount)
+{
+	ASSERT(chunk != NULL && transforms != NULL);
+	if (instanceCount == 0)
+		return Result_SUCCESS;
+	if (snapshot->itemCount == snapshot->maxItems || snapshot->instanceCount + instanceCount > snapshot->maxInstances)
+	{
+		LOG_W("Render snapshot is full, dropping %u instances\n", instanceCount);
+		return Result_FAILURE;
+	}
+
+	RenderSnapshot_Item* item = &snapshot->items[snapshot->itemCount++];
+	item->chunk = chunk;
+	item->firstInstance = snapshot->instanceCount;
+	item->instanceCount = instanceCount;
+	memcpy(&snapshot->transforms[snapshot->instanceCount], transforms, sizeof(matrix4x4) * instanceCount);
+	snapshot->instanceCount += instanceCount;
+	return Result_SUCCESS;
+}
+
+Result RenderSnapshot_SetFloat4(RenderSnapshot* snapshot, Material* material, const char* name, const float4* value)
+{
+	ASSERT(material != NULL && name != NULL && value != NULL);
+	if (snapshot->parameterCount == snapshot->maxParameters)
+	{
+		LOG_W("Render snapshot is full, dropping parameter %s\n", name);
+		return Result_FAILURE;
+	}
+
+	// Only the game thread adds names, and an interned copy never moves, so
+	// the render thread can read it without a lock.
+	khiter_t k = kh_get(render_name, snapshot->names, name);
+	if (k == kh_end(snapshot->names))
+	{
+		size_t length = strlen(name) + 1;
+		char* copy = (char*)malloc(length);
+		memcpy(copy, name, length);
+		int ret;
+		k = kh_put(render_name, snapshot->names, copy, &ret);
+	}
+
+	RenderSnapshot_Parameter* parameter = &snapshot->parameters[snapshot->parameterCount++];
+	parameter->material = material;
+	parameter->name = kh_key(snapshot->names, k);
+	parameter->value = *value;
+	return Result_SUCCESS;
+}
+
+Result RenderSnapshot_AddOccluder(RenderSnapshot* snapshot, const Occluder* occluder, const matrix4x4* transform)
+{
+	ASSERT(occluder != NULL && transform != NULL);
+	if (snapshot->occluderCount == snapshot->maxOccluders)
+	{
+		LOG_W("Render snapshot is full, dropping an occluder\n");
+		return Result_FAILURE;
+	}
+
+	RenderSnapshot_Occluder* entry = &snapshot->occluders[snapshot->occluderCount++];
+	entry->occluder = occluder;
+	entry->transform = *transform;
+	return Result_SUCCESS;
+}
+
+uint32 RenderSnapshot_GetFrame(const RenderSnapshot* snapshot)
+{
+	return snapshot->frame;
+}
+
+const matrix4x4* RenderSnapshot_GetCamera(const RenderSnapshot* snapshot)
+{
+	return &snapshot->viewProjection;
+}
+
+void RenderSnapshot_Submit(const RenderSnapshot* snapshot, RenderQueue* queue)
+{
+	for (uint32 i = 0; i < snapshot->parameterCount; i++)
+	{
+		const RenderSnapshot_Parameter* parameter = &snapshot->parameters[i];
+		float4 value = parameter->value;
+		Material_Set_Float4(parameter->material, parameter->name, &value);
+	}
+
+	OcclusionBuffer* occlusion = RenderQueue_GetOcclusionBuffer(queue);
+	if (occlusion != NULL)
+	{
+		OcclusionBuffer_Begin(occlusion, &snapshot->viewProjection);
+		for (uint32 i = 0; i < snapshot->occluderCount; i++)
+		{
+			OcclusionBuffer_AddOccluder(occlusion, snapshot->occluders[i].occluder, &snapshot->occluders[i].transform);
+		}
+		OcclusionBuffer_Rasterize(occlusion);
+	}
+
+	RenderQueue_Begin(queue, &snapshot->viewProjection);
+	for (uint32 i = 0; i < snapshot->itemCount; i++)
+	{
+		const RenderSnapshot_Item* item = &snapshot->items[i];
+		RenderQueue_Add(queue, item->chunk, &snapshot->transforms[item->firstInstance], item->instanceCount);
+	}
+	RenderQueue_Submit(queue);
+}
\ No newline at end of file
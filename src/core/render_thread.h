@@ -0,0 +1,78 @@
+#ifndef __RENDER_THREAD_H__
+#define __RENDER_THREAD_H__
+
+#include "config.h"
+#include "maths.h"
+#include "chunk.h"
+#include "material.h"
+#include "render_queue.h"
+
+// Runs rendering on a thread of its own that owns the GL context. The game
+// thread fills the snapshot returned by RenderThread_BeginFrame with
+// everything the frame needs (camera, visible chunks with their transforms,
+// material parameters) and publishes it; the render thread always draws the
+// newest published snapshot. Three snapshots rotate between writer, latest
+// and reader, so neither side ever waits for the other: game frame N + 1 is
+// built while frame N renders, and a snapshot that was overtaken before the
+// render thread got to it is dropped.
+//
+// The start callback runs on the render thread before anything else (make
+// the context current, create GL resources) and RenderThread_Create returns
+// only after it finished. Chunks and materials referenced by snapshots
+// belong to the render thread from then on; the game thread changes
+// material parameters through RenderSnapshot_SetFloat4 only. Occluders are
+// only read by the render thread and must outlive the snapshots using them.
+//
+// Without desc.threaded every callback runs inline on the calling thread,
+// which keeps the same code path debuggable on one thread.
+typedef struct RenderThread RenderThread;
+typedef struct RenderSnapshot RenderSnapshot;
+
+typedef struct RenderThread_Desc
+{
+	int threaded;
+	uint32 maxItems;
+	uint32 maxInstances;
+	uint32 maxParameters;
+	uint32 maxOccluders;
+	void (*start)(void* userData);
+	void (*render)(const RenderSnapshot* snapshot, void* userData);
+	void (*stop)(void* userData);
+	void* userData;
+} RenderThread_Desc;
+
+typedef struct RenderThread_Stats
+{
+	uint32 publishedCount;
+	uint32 renderedCount;
+	uint32 droppedCount;
+	double renderTime;
+} RenderThread_Stats;
+
+RenderThread* RenderThread_Create(const RenderThread_Desc* render_thread_desc);
+// Renders the snapshot still pending, runs stop on the render thread and
+// joins it.
+void RenderThread_Destroy(RenderThread* thread);
+
+RenderSnapshot* RenderThread_BeginFrame(RenderThread* thread);
+void RenderThread_Publish(RenderThread* thread);
+// Blocks until the render thread picked up the last published snapshot.
+// Called before building the next one, it paces the game thread to the
+// display rate while still letting it work one frame ahead.
+void RenderThread_Wait(RenderThread* thread);
+int RenderThread_IsThreaded(const RenderThread* thread);
+void RenderThread_GetStats(RenderThread* thread, RenderThread_Stats* stats);
+
+void RenderSnapshot_SetCamera(RenderSnapshot* snapshot, const matrix4x4* viewProjection);
+Result RenderSnapshot_AddChunk(RenderSnapshot* snapshot, Chunk* chunk, const matrix4x4* transforms, uint32 instanceCount);
+// Rasterized by RenderSnapshot_Submit when the queue has an OcclusionBuffer.
+Result RenderSnapshot_AddOccluder(RenderSnapshot* snapshot, const Occluder* occluder, const matrix4x4* transform);
+// The name is copied, the caller may free it right away.
+Result RenderSnapshot_SetFloat4(RenderSnapshot* snapshot, Material* material, const char* name, const float4* value);
+uint32 RenderSnapshot_GetFrame(const RenderSnapshot* snapshot);
+const matrix4x4* RenderSnapshot_GetCamera(const RenderSnapshot* snapshot);
+// Render thread only: applies the material parameters, rasterizes the
+// occluders and submits the chunks through the queue.
+void RenderSnapshot_Submit(const RenderSnapshot* snapshot, RenderQueue* queue);
+
+#endif
\ No newline at end of file
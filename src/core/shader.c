@@ -2,7 +2,8 @@
 #include "vertex.h"
 #include "khash.h"
 #include <stdlib.h>
-#include <opengl/glad.h>
+#include <string.h>
+#include <opengl/glad_ext.h>
 
 #define LOG_SHADER_ERR(shader)											\
 	GLint infoLen = 0;													\
@@ -71,11 +72,45 @@ struct Shader
 {
 	char fileName[INTRINSIC_STRING_LENGTH];
 	GLuint program;
-	GLuint attribLocations[VERTEX_ATTRIBUTE_COUNTS];
 	khash_t(location)* locations;
 };
 
-Shader* Shader_Compile(const char* sourceCode)
+static Shader* Shader_CreateFromProgram(GLuint program)
+{
+	Shader* shader = (Shader*)malloc(sizeof(Shader));
+	shader->program = program;
+	shader->locations = kh_init(location);
+
+	GLint count;
+	GLchar name[64];
+
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+	LOG_I("Active Uniforms: %d\n", count);
+
+	for (GLuint i = 0; i < count; i++)
+	{
+		glGetActiveUniform(program, i, sizeof(name), NULL, NULL, NULL, name);
+		LOG_I("Uniform #%d Name: %s\n", i, name);
+
+		GLint location = glGetUniformLocation(program, name);
+		if (location >= 0)
+		{
+			int ret;
+			char* key = (char*)malloc(strlen(name) + 1);
+			strcpy(key, name);
+			khiter_t k = kh_put(location, shader->locations, key, &ret);
+			if (ret == 0)
+			{
+				free(key);
+			}
+			kh_value(shader->locations, k) = (GLuint)location;
+		}
+	}
+
+	return shader;
+}
+
+static Shader* Shader_Link(const char* sourceCode, const char** varyings, uint32 varyingCount)
 {
 	ASSERT(sourceCode != NULL);
 
@@ -133,53 +168,99 @@ Shader* Shader_Compile(const char* sourceCode)
 
 	glAttachShader(program, vertexShader);
 	glAttachShader(program, fragmentShader);
+	for (int i = 0; i < VERTEX_ATTRIBUTE_COUNTS; i++)
+	{
+		glBindAttribLocation(program, i, VertexAttributes[i].name);
+	}
+	glBindAttribLocation(program, INSTANCE_ATTRIBUTE_DRAW_ID, "aDrawID");
+	glBindAttribLocation(program, INSTANCE_ATTRIBUTE_MODEL, "aModel");
+	glBindAttribLocation(program, INSTANCE_ATTRIBUTE_PARTICLE, "aParticle");
+	glBindAttribLocation(program, INSTANCE_ATTRIBUTE_PARTICLE_COLOR, "aParticleColor");
+	glBindAttribLocation(program, INSTANCE_ATTRIBUTE_PARTICLE_VELOCITY, "aParticleVelocity");
+	glBindAttribLocation(program, INSTANCE_ATTRIBUTE_PARTICLE_LIFE, "aParticleLife");
+	glBindAttribLocation(program, INSTANCE_ATTRIBUTE_DECAL, "aDecal");
+	glBindAttribLocation(program, INSTANCE_ATTRIBUTE_DECAL_AXIS, "aDecalAxis");
+	glBindAttribLocation(program, INSTANCE_ATTRIBUTE_DECAL_ATLAS, "aDecalAtlas");
+	glBindAttribLocation(program, INSTANCE_ATTRIBUTE_DECAL_COLOR, "aDecalColor");
+	if (varyingCount > 0)
+	{
+		glTransformFeedbackVaryings(program, varyingCount, varyings, GL_INTERLEAVED_ATTRIBS);
+	}
 	glLinkProgram(program);
 	glDeleteShader(vertexShader);
 	glDeleteShader(fragmentShader);
 	glGetProgramiv(program, GL_LINK_STATUS, &status);
 	if (status != GL_TRUE)
 	{
-		LOG_SHADER_ERR(program);
+		LOG_PROGRAM_ERR(program);
 		glDeleteProgram(program);
 		return NULL;
 	}
 
-	Shader* shader = (Shader*)malloc(sizeof(Shader));
-	shader->program = program;
+	return Shader_CreateFromProgram(program);
+}
 
-	for (int i = 0; i < VERTEX_ATTRIBUTE_COUNTS; i++)
-	{
-		shader->attribLocations[i] = glGetAttribLocation(program, VertexAttributes[i].name);
-	}
+Shader* Shader_Compile(const char* sourceCode)
+{
+	return Shader_Link(sourceCode, NULL, 0);
+}
 
-	GLint count;
-	GLchar name[16];
+Shader* Shader_CompileFeedback(const char* sourceCode, const char** varyings, uint32 varyingCount)
+{
+	ASSERT(varyings != NULL && varyingCount > 0);
+	return Shader_Link(sourceCode, varyings, varyingCount);
+}
 
-	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
-	LOG_I("Active Uniforms: %d\n", count);
+Shader* Shader_CompileCompute(const char* sourceCode)
+{
+	ASSERT(sourceCode != NULL);
 
-	for (GLuint i = 0; i < count; i++)
+	GLint status = 0;
+	GLuint computeShader = glCreateShader(GL_COMPUTE_SHADER);
+	if (computeShader == 0)
 	{
-		glGetActiveUniform(program, i, 16, NULL, NULL, NULL, name);
-		LOG_I("Uniform #%d Name: %s\n", i, name);
+		LOG_E("Cannot create compute shader");
+		return NULL;
+	}
+	glShaderSource(computeShader, 1, &sourceCode, NULL);
+	glCompileShader(computeShader);
+	glGetShaderiv(computeShader, GL_COMPILE_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		LOG_SHADER_ERR(computeShader);
+		glDeleteShader(computeShader);
+		return NULL;
+	}
 
-		GLint location = glGetUniformLocation(program, name);
-		if (location >= 0)
-		{
-			int ret;
-			khiter_t k = kh_put(location, shader->locations, name, &ret);
-			if (ret != 0)
-			{
-				kh_value(shader->locations, k) = (GLuint)location;
-			}
-		}
+	GLuint program = glCreateProgram();
+	if (program == 0)
+	{
+		LOG_E("Error while creating a new shader program");
+		glDeleteShader(computeShader);
+		return NULL;
 	}
 
-	return shader;
+	glAttachShader(program, computeShader);
+	glLinkProgram(program);
+	glDeleteShader(computeShader);
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		LOG_PROGRAM_ERR(program);
+		glDeleteProgram(program);
+		return NULL;
+	}
+
+	return Shader_CreateFromProgram(program);
 }
 
 void Shader_Destroy(Shader* shader)
 {
+	for (khiter_t k = kh_begin(shader->locations); k != kh_end(shader->locations); k++)
+	{
+		if (kh_exist(shader->locations, k))
+			free((char*)kh_key(shader->locations, k));
+	}
 	kh_destroy(location, shader->locations);
 	glDeleteProgram(shader->program);
 	free(shader);
@@ -200,11 +281,12 @@ void Shader_Use(Shader* shader)
 	glUseProgram(shader->program);
 }
 
-void Shader_EnableVertexArray(Shader* shader)
+void Shader_EnableVertexLayout(uint32 baseVertex)
 {
+	size_t base = (size_t)baseVertex * sizeof(Vertex);
 	for (int i = 0; i < VERTEX_ATTRIBUTE_COUNTS; i++)
 	{
-		glEnableVertexAttribArray(shader->attribLocations[i]);
-		glVertexAttribPointer(shader->attribLocations[i], VertexAttributes[i].componentCounts, VertexAttributes[i].type, GL_FALSE, sizeof(Vertex), (const void*)(VertexAttributes[i].offset));
+		glEnableVertexAttribArray(i);
+		glVertexAttribPointer(i, VertexAttributes[i].componentCounts, VertexAttributes[i].type, GL_FALSE, sizeof(Vertex), (const void*)(base + VertexAttributes[i].offset));
 	}
 }
\ No newline at end of file
@@ -6,9 +6,15 @@
 typedef struct Shader Shader;
 
 Shader* Shader_Compile(const char* sourceCode);
+// Links the vertex stage outputs named in varyings, interleaved and in
+// that order, into the bound transform feedback buffer.
+Shader* Shader_CompileFeedback(const char* sourceCode, const char** varyings, uint32 varyingCount);
+Shader* Shader_CompileCompute(const char* sourceCode);
 void Shader_Destroy(Shader* shader);
 void Shader_Use(Shader* shader);
-void Shader_EnableVertexArray(Shader* shader);
-uint32 Shader_GetLocation(const Shader* shader, const char* name);
+// Points the fixed attribute locations at the bound vertex buffer, starting
+// at baseVertex.
+void Shader_EnableVertexLayout(uint32 baseVertex);
+int32 Shader_GetLocation(const Shader* shader, const char* name);
 
 #endif
\ No newline at end of file
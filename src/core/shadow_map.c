@@ -0,0 +1,389 @@
+#include "shadow_map.h"
+#include "framebuffer.h"
+#include <opengl/glad.h>
+#include <math.h>
+#include <string.h>
+
+typedef struct ShadowMap_Cascade
+{
+	float centerX;
+	float centerY;
+	float radius;
+	float halfSize;
+	float depthMin;
+	float depthMax;
+	int valid;
+	matrix4x4 viewProjection;
+} ShadowMap_Cascade;
+
+struct ShadowMap
+{
+	ShadowMap_Desc desc;
+	Texture* cache;
+	Texture* depth;
+	Framebuffer* cacheTargets[SHADOW_MAP_MAX_CASCADES];
+	Framebuffer* depthTargets[SHADOW_MAP_MAX_CASCADES];
+	ShadowMap_Cascade cascades[SHADOW_MAP_MAX_CASCADES];
+	float3 lightDirection;
+	float3 lightRight;
+	float3 lightUp;
+	Aabb sceneBounds;
+	int hasSceneBounds;
+	GLint viewport[4];
+	GLboolean depthTest;
+	ShadowMap_Stats stats;
+};
+
+static float ShadowMap_Dot(const float3* a, const float3* b)
+{
+	return a->x * b->x + a->y * b->y + a->z * b->z;
+}
+
+static void ShadowMap_Cross(const float3* a, const float3* b, float3* out)
+{
+	float3 result;
+	result.x = a->y * b->z - a->z * b->y;
+	result.y = a->z * b->x - a->x * b->z;
+	result.z = a->x * b->y - a->y * b->x;
+	*out = result;
+}
+
+static void ShadowMap_Normalize(float3* v)
+{
+	float length = sqrtf(ShadowMap_Dot(v, v));
+	if (length > 0.0f)
+	{
+		v->x /= length;
+		v->y /= length;
+		v->z /= length;
+	}
+}
+
+static void ShadowMap_GetCorners(const Aabb* bounds, float3* corners)
+{
+	for (uint32 i = 0; i < 8; i++)
+	{
+		corners[i].x = (i & 1) ? bounds->max.x : bounds->min.x;
+		corners[i].y = (i & 2) ? bounds->max.y : bounds->min.y;
+		corners[i].z = (i & 4) ? bounds->max.z : bounds->min.z;
+	}
+}
+
+static Texture* ShadowMap_CreateDepthArray(const ShadowMap_Desc* desc)
+{
+	Texture_Desc texture_desc =
+	{
+		TEXTURE_2D_ARRAY,
+		TEXTURE_DEPTH_32F,
+		desc->resolution,
+		desc->resolution,
+		desc->cascadeCount,
+		1,
+		FILTER_POINT,
+		FILTER_POINT,
+		WRAP_CLAMP,
+		WRAP_CLAMP
+	};
+	Texture* texture = Texture_Create(&texture_desc);
+	Texture_SetData(texture, 0, NULL);
+	return texture;
+}
+
+ShadowMap* ShadowMap_Create(const ShadowMap_Desc* shadow_map_desc)
+{
+	ASSERT(shadow_map_desc->cascadeCount > 0 && shadow_map_desc->cascadeCount <= SHADOW_MAP_MAX_CASCADES);
+
+	ShadowMap* shadowMap = (ShadowMap*)malloc(sizeof(ShadowMap));
+	memset(shadowMap, 0, sizeof(ShadowMap));
+	shadowMap->desc = *shadow_map_desc;
+	shadowMap->cache = ShadowMap_CreateDepthArray(shadow_map_desc);
+	shadowMap->depth = ShadowMap_CreateDepthArray(shadow_map_desc);
+	for (uint32 i = 0; i < shadow_map_desc->cascadeCount; i++)
+	{
+		shadowMap->cacheTargets[i] = Framebuffer_Create();
+		Framebuffer_AttachDepth(shadowMap->cacheTargets[i], shadowMap->cache, i);
+		shadowMap->depthTargets[i] = Framebuffer_Create();
+		Framebuffer_AttachDepth(shadowMap->depthTargets[i], shadowMap->depth, i);
+		ASSERT(Framebuffer_IsComplete(shadowMap->depthTargets[i]));
+	}
+	return shadowMap;
+}
+
+void ShadowMap_Destroy(ShadowMap* shadowMap)
+{
+	for (uint32 i = 0; i < shadowMap->desc.cascadeCount; i++)
+	{
+		Framebuffer_Destroy(shadowMap->cacheTargets[i]);
+		Framebuffer_Destroy(shadowMap->depthTargets[i]);
+	}
+	Texture_Destroy(shadowMap->cache);
+	Texture_Destroy(shadowMap->depth);
+	free(shadowMap);
+}
+
+void ShadowMap_SetSceneBounds(ShadowMap* shadowMap, const Aabb* bounds)
+{
+	shadowMap->hasSceneBounds = bounds != NULL;
+	if (bounds != NULL)
+		shadowMap->sceneBounds = *bounds;
+	ShadowMap_InvalidateStatic(shadowMap, NULL);
+	for (uint32 i = 0; i < shadowMap->desc.cascadeCount; i++)
+	{
+		shadowMap->cascades[i].halfSize = 0.0f;
+	}
+}
+
+static void ShadowMap_BuildMatrix(const ShadowMap* shadowMap, ShadowMap_Cascade* cascade)
+{
+	// Orthographic projection along the light: x and y span the cascade
+	// square, z maps the depth range to [-1, 1].
+	const float3* right = &shadowMap->lightRight;
+	const float3* up = &shadowMap->lightUp;
+	const float3* direction = &shadowMap->lightDirection;
+	float inverseHalf = 1.0f / cascade->halfSize;
+	float depthScale = 2.0f / (cascade->depthMax - cascade->depthMin);
+	matrix4x4* m = &cascade->viewProjection;
+	for (uint32 axis = 0; axis < 3; axis++)
+	{
+		m->data2D[axis][0] = right->data[axis] * inverseHalf;
+		m->data2D[axis][1] = up->data[axis] * inverseHalf;
+		m->data2D[axis][2] = direction->data[axis] * depthScale;
+		m->data2D[axis][3] = 0.0f;
+	}
+	m->data2D[3][0] = -cascade->centerX * inverseHalf;
+	m->data2D[3][1] = -cascade->centerY * inverseHalf;
+	m->data2D[3][2] = -cascade->depthMin * depthScale - 1.0f;
+	m->data2D[3][3] = 1.0f;
+}
+
+static void ShadowMap_FitCascade(ShadowMap* shadowMap, ShadowMap_Cascade* cascade, const ShadowMap_Camera* camera, float sliceNear, float sliceFar)
+{
+	float3 right, up;
+	ShadowMap_Cross(&camera->forward, &camera->up, &right);
+	ShadowMap_Normalize(&right);
+	ShadowMap_Cross(&right, &camera->forward, &up);
+
+	float3 corners[8];
+	float3 center = { { 0.0f, 0.0f, 0.0f } };
+	float tangent = tanf(camera->fovY * 0.5f);
+	for (uint32 i = 0; i < 8; i++)
+	{
+		float distance = (i & 4) ? sliceFar : sliceNear;
+		float halfHeight = tangent * distance * ((i & 2) ? 1.0f : -1.0f);
+		float halfWidth = tangent * distance * camera->aspect * ((i & 1) ? 1.0f : -1.0f);
+		for (uint32 axis = 0; axis < 3; axis++)
+		{
+			corners[i].data[axis] = camera->position.data[axis] + camera->forward.data[axis] * distance + right.data[axis] * halfWidth + up.data[axis] * halfHeight;
+			center.data[axis] += corners[i].data[axis] * 0.125f;
+		}
+	}
+
+	float radius = 0.0f;
+	for (uint32 i = 0; i < 8; i++)
+	{
+		float dx = corners[i].x - center.x;
+		float dy = corners[i].y - center.y;
+		float dz = corners[i].z - center.z;
+		float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+		radius = distance > radius ? distance : radius;
+	}
+	// Quantized so the cascade size does not flicker with float noise.
+	radius = ceilf(radius * 16.0f) / 16.0f;
+
+	float x = ShadowMap_Dot(&center, &shadowMap->lightRight);
+	float y = ShadowMap_Dot(&center, &shadowMap->lightUp);
+	if (cascade->halfSize > 0.0f && cascade->radius == radius &&
+		fabsf(x - cascade->centerX) + radius <= cascade->halfSize &&
+		fabsf(y - cascade->centerY) + radius <= cascade->halfSize)
+	{
+		return;
+	}
+
+	// Re-centre on a texel boundary, so static shadows do not swim.
+	float halfSize = radius * (1.0f + shadowMap->desc.cacheMargin);
+	float texel = 2.0f * halfSize / shadowMap->desc.resolution;
+	cascade->radius = radius;
+	cascade->halfSize = halfSize;
+	cascade->centerX = floorf(x / texel + 0.5f) * texel;
+	cascade->centerY = floorf(y / texel + 0.5f) * texel;
+
+	float depth = ShadowMap_Dot(&center, &shadowMap->lightDirection);
+	cascade->depthMin = depth - halfSize;
+	cascade->depthMax = depth + halfSize;
+	if (shadowMap->hasSceneBounds)
+	{
+		float3 sceneCorners[8];
+		ShadowMap_GetCorners(&shadowMap->sceneBounds, sceneCorners);
+		for (uint32 i = 0; i < 8; i++)
+		{
+			float d = ShadowMap_Dot(&sceneCorners[i], &shadowMap->lightDirection);
+			cascade->depthMin = d < cascade->depthMin ? d : cascade->depthMin;
+			cascade->depthMax = d > cascade->depthMax ? d : cascade->depthMax;
+		}
+	}
+
+	ShadowMap_BuildMatrix(shadowMap, cascade);
+	cascade->valid = 0;
+}
+
+void ShadowMap_Update(ShadowMap* shadowMap, const ShadowMap_Camera* camera, const float3* lightDirection)
+{
+	float3 direction = *lightDirection;
+	ShadowMap_Normalize(&direction);
+	if (ShadowMap_Dot(&direction, &shadowMap->lightDirection) < 0.99999f)
+	{
+		float3 reference = { { 0.0f, 1.0f, 0.0f } };
+		if (fabsf(direction.y) > 0.99f)
+		{
+			reference.x = 1.0f;
+			reference.y = 0.0f;
+		}
+		shadowMap->lightDirection = direction;
+		ShadowMap_Cross(&reference, &direction, &shadowMap->lightRight);
+		ShadowMap_Normalize(&shadowMap->lightRight);
+		ShadowMap_Cross(&direction, &shadowMap->lightRight, &shadowMap->lightUp);
+		for (uint32 i = 0; i < shadowMap->desc.cascadeCount; i++)
+		{
+			shadowMap->cascades[i].halfSize = 0.0f;
+		}
+	}
+
+	// Practical split scheme: a blend of logarithmic and uniform splits.
+	uint32 count = shadowMap->desc.cascadeCount;
+	float nearPlane = camera->nearPlane;
+	float farPlane = camera->farPlane < shadowMap->desc.maxDistance ? camera->farPlane : shadowMap->desc.maxDistance;
+	float lambda = shadowMap->desc.splitLambda;
+	float sliceNear = nearPlane;
+	for (uint32 i = 0; i < count; i++)
+	{
+		float fraction = (float)(i + 1) / count;
+		float logarithmic = nearPlane * powf(farPlane / nearPlane, fraction);
+		float uniform = nearPlane + (farPlane - nearPlane) * fraction;
+		float sliceFar = lambda * logarithmic + (1.0f - lambda) * uniform;
+		ShadowMap_FitCascade(shadowMap, &shadowMap->cascades[i], camera, sliceNear, sliceFar);
+		sliceNear = sliceFar;
+	}
+
+	shadowMap->stats.staticRenders = 0;
+	shadowMap->stats.dynamicRenders = 0;
+}
+
+void ShadowMap_InvalidateStatic(ShadowMap* shadowMap, const Aabb* region)
+{
+	float3 corners[8];
+	float minX = 0.0f, maxX = 0.0f, minY = 0.0f, maxY = 0.0f;
+	if (region != NULL)
+	{
+		ShadowMap_GetCorners(region, corners);
+		for (uint32 i = 0; i < 8; i++)
+		{
+			float x = ShadowMap_Dot(&corners[i], &shadowMap->lightRight);
+			float y = ShadowMap_Dot(&corners[i], &shadowMap->lightUp);
+			minX = (i == 0 || x < minX) ? x : minX;
+			maxX = (i == 0 || x > maxX) ? x : maxX;
+			minY = (i == 0 || y < minY) ? y : minY;
+			maxY = (i == 0 || y > maxY) ? y : maxY;
+		}
+	}
+
+	for (uint32 i = 0; i < shadowMap->desc.cascadeCount; i++)
+	{
+		ShadowMap_Cascade* cascade = &shadowMap->cascades[i];
+		if (region == NULL ||
+			(minX <= cascade->centerX + cascade->halfSize && maxX >= cascade->centerX - cascade->halfSize &&
+			minY <= cascade->centerY + cascade->halfSize && maxY >= cascade->centerY - cascade->halfSize))
+		{
+			cascade->valid = 0;
+		}
+	}
+}
+
+static void ShadowMap_BeginTarget(ShadowMap* shadowMap, const Framebuffer* target)
+{
+	glGetIntegerv(GL_VIEWPORT, shadowMap->viewport);
+	shadowMap->depthTest = glIsEnabled(GL_DEPTH_TEST);
+	Framebuffer_Bind(target);
+	glViewport(0, 0, shadowMap->desc.resolution, shadowMap->desc.resolution);
+	glEnable(GL_DEPTH_TEST);
+	glDepthMask(GL_TRUE);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(shadowMap->desc.slopeBias, shadowMap->desc.depthBias);
+}
+
+int ShadowMap_BeginStatic(ShadowMap* shadowMap, uint32 cascade, matrix4x4* viewProjection)
+{
+	ASSERT(cascade < shadowMap->desc.cascadeCount);
+	ShadowMap_Cascade* current = &shadowMap->cascades[cascade];
+	if (current->valid)
+		return 0;
+
+	ShadowMap_BeginTarget(shadowMap, shadowMap->cacheTargets[cascade]);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	*viewProjection = current->viewProjection;
+	current->valid = 1;
+	shadowMap->stats.staticRenders++;
+	return 1;
+}
+
+void ShadowMap_BeginDynamic(ShadowMap* shadowMap, uint32 cascade, matrix4x4* viewProjection)
+{
+	ASSERT(cascade < shadowMap->desc.cascadeCount);
+	Framebuffer_BlitDepth(shadowMap->cacheTargets[cascade], shadowMap->depthTargets[cascade], shadowMap->desc.resolution, shadowMap->desc.resolution);
+	ShadowMap_BeginTarget(shadowMap, shadowMap->depthTargets[cascade]);
+	*viewProjection = shadowMap->cascades[cascade].viewProjection;
+	shadowMap->stats.dynamicRenders++;
+}
+
+void ShadowMap_End(ShadowMap* shadowMap)
+{
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	if (!shadowMap->depthTest)
+		glDisable(GL_DEPTH_TEST);
+	Framebuffer_Unbind();
+	glViewport(shadowMap->viewport[0], shadowMap->viewport[1], shadowMap->viewport[2], shadowMap->viewport[3]);
+}
+
+void ShadowMap_Bind(const ShadowMap* shadowMap, Shader* shader, uint32 unit)
+{
+	Shader_Use(shader);
+	GLint location = Shader_GetLocation(shader, "uShadowMap");
+	if (location != -1)
+		glUniform1i(location, unit);
+	location = Shader_GetLocation(shader, "uShadowCascadeCount");
+	if (location != -1)
+		glUniform1i(location, shadowMap->desc.cascadeCount);
+	location = Shader_GetLocation(shader, "uShadowTexelSize");
+	if (location != -1)
+		glUniform1f(location, 1.0f / shadowMap->desc.resolution);
+	location = Shader_GetLocation(shader, "uShadowMatrices[0]");
+	if (location != -1)
+	{
+		matrix4x4 matrices[SHADOW_MAP_MAX_CASCADES];
+		for (uint32 i = 0; i < shadowMap->desc.cascadeCount; i++)
+		{
+			matrices[i] = shadowMap->cascades[i].viewProjection;
+		}
+		glUniformMatrix4fv(location, shadowMap->desc.cascadeCount, GL_FALSE, (const GLfloat*)matrices);
+	}
+	Texture_Bind(shadowMap->depth, unit);
+}
+
+uint32 ShadowMap_GetCascadeCount(const ShadowMap* shadowMap)
+{
+	return shadowMap->desc.cascadeCount;
+}
+
+void ShadowMap_GetCascadeMatrix(const ShadowMap* shadowMap, uint32 cascade, matrix4x4* viewProjection)
+{
+	*viewProjection = shadowMap->cascades[cascade].viewProjection;
+}
+
+Texture* ShadowMap_GetTexture(const ShadowMap* shadowMap)
+{
+	return shadowMap->depth;
+}
+
+void ShadowMap_GetStats(const ShadowMap* shadowMap, ShadowMap_Stats* stats)
+{
+	*stats = shadowMap->stats;
+}
\ No newline at end of file
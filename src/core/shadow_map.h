@@ -0,0 +1,74 @@
+#ifndef __SHADOW_MAP_H__
+#define __SHADOW_MAP_H__
+
+#include "config.h"
+#include "maths.h"
+#include "shader.h"
+#include "texture.h"
+
+#define SHADOW_MAP_MAX_CASCADES 4
+
+// Cascaded shadow maps for a directional light. Every cascade owns a layer of
+// a static depth cache and a layer of the depth array sampled by receivers.
+// Cascades are fitted with some slack and only re-centred once the camera
+// leaves it, so static geometry is re-rendered into the cache only when a
+// cascade moves, the light turns or ShadowMap_InvalidateStatic reports a map
+// change. Dynamic casters are drawn every frame over a copy of the cache.
+//
+// A frame looks like:
+//   ShadowMap_Update(...);
+//   for each cascade: if (ShadowMap_BeginStatic(...)) { draw static; ShadowMap_End(...); }
+//   for each cascade: ShadowMap_BeginDynamic(...); draw units; ShadowMap_End(...);
+//   ShadowMap_Bind(...) before drawing receivers.
+//
+// terrain.glsl and lit.glsl both read the cascades. A lit.glsl user without
+// shadows must still point uShadowMap at a free unit, since samplers of
+// different types must never share one.
+typedef struct ShadowMap ShadowMap;
+
+typedef struct ShadowMap_Desc
+{
+	uint32 resolution;
+	uint32 cascadeCount;
+	float maxDistance;
+	float splitLambda;
+	float cacheMargin;
+	float depthBias;
+	float slopeBias;
+} ShadowMap_Desc;
+
+typedef struct ShadowMap_Camera
+{
+	float3 position;
+	float3 forward;
+	float3 up;
+	float fovY;
+	float aspect;
+	float nearPlane;
+	float farPlane;
+} ShadowMap_Camera;
+
+typedef struct ShadowMap_Stats
+{
+	uint32 staticRenders;
+	uint32 dynamicRenders;
+} ShadowMap_Stats;
+
+ShadowMap* ShadowMap_Create(const ShadowMap_Desc* shadow_map_desc);
+void ShadowMap_Destroy(ShadowMap* shadowMap);
+
+void ShadowMap_SetSceneBounds(ShadowMap* shadowMap, const Aabb* bounds);
+void ShadowMap_Update(ShadowMap* shadowMap, const ShadowMap_Camera* camera, const float3* lightDirection);
+void ShadowMap_InvalidateStatic(ShadowMap* shadowMap, const Aabb* region);
+
+int ShadowMap_BeginStatic(ShadowMap* shadowMap, uint32 cascade, matrix4x4* viewProjection);
+void ShadowMap_BeginDynamic(ShadowMap* shadowMap, uint32 cascade, matrix4x4* viewProjection);
+void ShadowMap_End(ShadowMap* shadowMap);
+
+void ShadowMap_Bind(const ShadowMap* shadowMap, Shader* shader, uint32 unit);
+uint32 ShadowMap_GetCascadeCount(const ShadowMap* shadowMap);
+void ShadowMap_GetCascadeMatrix(const ShadowMap* shadowMap, uint32 cascade, matrix4x4* viewProjection);
+Texture* ShadowMap_GetTexture(const ShadowMap* shadowMap);
+void ShadowMap_GetStats(const ShadowMap* shadowMap, ShadowMap_Stats* stats);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,14 @@
+#ifndef __SIMD_H__
+#define __SIMD_H__
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SIMD_SSE 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX__)
+#define SIMD_AVX 1
+#include <immintrin.h>
+#endif
+
+#endif
\ No newline at end of file
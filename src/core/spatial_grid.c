@@ -0,0 +1,393 @@
+#include "spatial_grid.h"
+#include <string.h>
+#include <math.h>
+
+#define SPATIAL_GRID_PAGE_SIZE 16
+#define SPATIAL_GRID_MAX_LOCAL_K 64
+
+// Every page of a chain is full except the head, which takes inserts and
+// gives up its last entry to fill the hole of a removal.
+typedef struct SpatialGrid_Page
+{
+	uint32 next;
+	uint32 count;
+	uint32 ids[SPATIAL_GRID_PAGE_SIZE];
+	uint32 items[SPATIAL_GRID_PAGE_SIZE];
+	float x[SPATIAL_GRID_PAGE_SIZE];
+	float z[SPATIAL_GRID_PAGE_SIZE];
+} SpatialGrid_Page;
+
+// A free item has page SPATIAL_GRID_INVALID and links the free list
+// through slot.
+typedef struct SpatialGrid_Item
+{
+	uint32 cell;
+	uint32 page;
+	uint32 slot;
+} SpatialGrid_Item;
+
+struct SpatialGrid
+{
+	SpatialGrid_Desc desc;
+	float inverseCellSize;
+	uint32* cells;
+	SpatialGrid_Page* pages;
+	uint32 pageCount;
+	uint32 maxPages;
+	uint32 freePage;
+	SpatialGrid_Item* items;
+	uint32 itemCount;
+	uint32 usedItems;
+	uint32 freeItem;
+	SpatialGrid_Stats stats;
+};
+
+static int32 SpatialGrid_Column(const SpatialGrid* grid, float x)
+{
+	int32 column = (int32)floorf((x - grid->desc.originX) * grid->inverseCellSize);
+	if (column < 0)
+		return 0;
+	if (column >= (int32)grid->desc.columns)
+		return (int32)grid->desc.columns - 1;
+	return column;
+}
+
+static int32 SpatialGrid_Row(const SpatialGrid* grid, float z)
+{
+	int32 row = (int32)floorf((z - grid->desc.originZ) * grid->inverseCellSize);
+	if (row < 0)
+		return 0;
+	if (row >= (int32)grid->desc.rows)
+		return (int32)grid->desc.rows - 1;
+	return row;
+}
+
+static uint32 SpatialGrid_AllocatePage(SpatialGrid* grid)
+{
+	uint32 page = grid->freePage;
+	if (page != SPATIAL_GRID_INVALID)
+	{
+		grid->freePage = grid->pages[page].next;
+		return page;
+	}
+
+	if (grid->pageCount == grid->maxPages)
+	{
+		grid->maxPages = grid->maxPages > 0 ? grid->maxPages * 2 : 64;
+		grid->pages = (SpatialGrid_Page*)realloc(grid->pages, sizeof(SpatialGrid_Page) * grid->maxPages);
+	}
+	return grid->pageCount++;
+}
+
+static void SpatialGrid_Link(SpatialGrid* grid, uint32 handle, uint32 id, uint32 cell, float x, float z)
+{
+	uint32 head = grid->cells[cell];
+	if (head == SPATIAL_GRID_INVALID || grid->pages[head].count == SPATIAL_GRID_PAGE_SIZE)
+	{
+		uint32 page = SpatialGrid_AllocatePage(grid);
+		grid->pages[page].next = head;
+		grid->pages[page].count = 0;
+		grid->cells[cell] = page;
+		head = page;
+	}
+
+	SpatialGrid_Page* page = &grid->pages[head];
+	uint32 slot = page->count++;
+	page->ids[slot] = id;
+	page->items[slot] = handle;
+	page->x[slot] = x;
+	page->z[slot] = z;
+
+	SpatialGrid_Item* item = &grid->items[handle];
+	item->cell = cell;
+	item->page = head;
+	item->slot = slot;
+}
+
+static void SpatialGrid_Unlink(SpatialGrid* grid, uint32 handle)
+{
+	SpatialGrid_Item* item = &grid->items[handle];
+	uint32 headIndex = grid->cells[item->cell];
+	SpatialGrid_Page* head = &grid->pages[headIndex];
+	SpatialGrid_Page* page = &grid->pages[item->page];
+	uint32 last = head->count - 1;
+	if (page != head || item->slot != last)
+	{
+		page->ids[item->slot] = head->ids[last];
+		page->items[item->slot] = head->items[last];
+		page->x[item->slot] = head->x[last];
+		page->z[item->slot] = head->z[last];
+		SpatialGrid_Item* moved = &grid->items[head->items[last]];
+		moved->page = item->page;
+		moved->slot = item->slot;
+	}
+
+	head->count--;
+	if (head->count == 0)
+	{
+		grid->cells[item->cell] = head->next;
+		head->next = grid->freePage;
+		grid->freePage = headIndex;
+	}
+}
+
+SpatialGrid* SpatialGrid_Create(const SpatialGrid_Desc* spatial_grid_desc)
+{
+	ASSERT(spatial_grid_desc != NULL && spatial_grid_desc->cellSize > 0.0f);
+	ASSERT(spatial_grid_desc->columns > 0 && spatial_grid_desc->rows > 0 && spatial_grid_desc->maxItems > 0);
+
+	SpatialGrid* grid = (SpatialGrid*)malloc(sizeof(SpatialGrid));
+	memset(grid, 0, sizeof(SpatialGrid));
+	grid->desc = *spatial_grid_desc;
+	grid->inverseCellSize = 1.0f / spatial_grid_desc->cellSize;
+	grid->cells = (uint32*)malloc(sizeof(uint32) * spatial_grid_desc->columns * spatial_grid_desc->rows);
+	grid->items = (SpatialGrid_Item*)malloc(sizeof(SpatialGrid_Item) * spatial_grid_desc->maxItems);
+	SpatialGrid_Clear(grid);
+	return grid;
+}
+
+void SpatialGrid_Destroy(SpatialGrid* grid)
+{
+	free(grid->cells);
+	free(grid->pages);
+	free(grid->items);
+	free(grid);
+}
+
+void SpatialGrid_Clear(SpatialGrid* grid)
+{
+	memset(grid->cells, 0xFF, sizeof(uint32) * grid->desc.columns * grid->desc.rows);
+	grid->freePage = SPATIAL_GRID_INVALID;
+	for (uint32 i = grid->pageCount; i > 0; i--)
+	{
+		grid->pages[i - 1].next = grid->freePage;
+		grid->freePage = i - 1;
+	}
+	grid->itemCount = 0;
+	grid->usedItems = 0;
+	grid->freeItem = SPATIAL_GRID_INVALID;
+}
+
+uint32 SpatialGrid_Insert(SpatialGrid* grid, uint32 id, float x, float z)
+{
+	uint32 handle = grid->freeItem;
+	if (handle != SPATIAL_GRID_INVALID)
+	{
+		grid->freeItem = grid->items[handle].slot;
+	}
+	else
+	{
+		if (grid->usedItems == grid->desc.maxItems)
+		{
+			LOG_W("Spatial grid is full, cannot insert more than %u items\n", grid->desc.maxItems);
+			return SPATIAL_GRID_INVALID;
+		}
+		handle = grid->usedItems++;
+	}
+
+	uint32 cell = (uint32)SpatialGrid_Row(grid, z) * grid->desc.columns + (uint32)SpatialGrid_Column(grid, x);
+	SpatialGrid_Link(grid, handle, id, cell, x, z);
+	grid->itemCount++;
+	return handle;
+}
+
+void SpatialGrid_Update(SpatialGrid* grid, uint32 handle, float x, float z)
+{
+	ASSERT(handle < grid->usedItems && grid->items[handle].page != SPATIAL_GRID_INVALID);
+	SpatialGrid_Item* item = &grid->items[handle];
+	uint32 cell = (uint32)SpatialGrid_Row(grid, z) * grid->desc.columns + (uint32)SpatialGrid_Column(grid, x);
+	if (cell == item->cell)
+	{
+		SpatialGrid_Page* page = &grid->pages[item->page];
+		page->x[item->slot] = x;
+		page->z[item->slot] = z;
+		return;
+	}
+
+	uint32 id = grid->pages[item->page].ids[item->slot];
+	SpatialGrid_Unlink(grid, handle);
+	SpatialGrid_Link(grid, handle, id, cell, x, z);
+	grid->stats.cellChangeCount++;
+}
+
+void SpatialGrid_Remove(SpatialGrid* grid, uint32 handle)
+{
+	ASSERT(handle < grid->usedItems && grid->items[handle].page != SPATIAL_GRID_INVALID);
+	SpatialGrid_Unlink(grid, handle);
+	grid->items[handle].page = SPATIAL_GRID_INVALID;
+	grid->items[handle].slot = grid->freeItem;
+	grid->freeItem = handle;
+	grid->itemCount--;
+}
+
+uint32 SpatialGrid_QueryRadius(const SpatialGrid* grid, float x, float z, float radius, uint32* ids, uint32 maxCount)
+{
+	int32 minColumn = SpatialGrid_Column(grid, x - radius);
+	int32 maxColumn = SpatialGrid_Column(grid, x + radius);
+	int32 minRow = SpatialGrid_Row(grid, z - radius);
+	int32 maxRow = SpatialGrid_Row(grid, z + radius);
+	float radiusSquared = radius * radius;
+	uint32 count = 0;
+	for (int32 row = minRow; row <= maxRow; row++)
+	{
+		for (int32 column = minColumn; column <= maxColumn; column++)
+		{
+			uint32 pageIndex = grid->cells[(uint32)row * grid->desc.columns + (uint32)column];
+			while (pageIndex != SPATIAL_GRID_INVALID)
+			{
+				const SpatialGrid_Page* page = &grid->pages[pageIndex];
+				for (uint32 i = 0; i < page->count; i++)
+				{
+					float dx = page->x[i] - x;
+					float dz = page->z[i] - z;
+					if (dx * dx + dz * dz > radiusSquared)
+						continue;
+					if (count == maxCount)
+						return count;
+					ids[count++] = page->ids[i];
+				}
+				pageIndex = page->next;
+			}
+		}
+	}
+	return count;
+}
+
+uint32 SpatialGrid_QueryBox(const SpatialGrid* grid, float minX, float minZ, float maxX, float maxZ, uint32* ids, uint32 maxCount)
+{
+	int32 minColumn = SpatialGrid_Column(grid, minX);
+	int32 maxColumn = SpatialGrid_Column(grid, maxX);
+	int32 minRow = SpatialGrid_Row(grid, minZ);
+	int32 maxRow = SpatialGrid_Row(grid, maxZ);
+	uint32 count = 0;
+	for (int32 row = minRow; row <= maxRow; row++)
+	{
+		for (int32 column = minColumn; column <= maxColumn; column++)
+		{
+			// Inner cells lie inside the box entirely, only the rim tests.
+			int inside = row > minRow && row < maxRow && column > minColumn && column < maxColumn;
+			uint32 pageIndex = grid->cells[(uint32)row * grid->desc.columns + (uint32)column];
+			while (pageIndex != SPATIAL_GRID_INVALID)
+			{
+				const SpatialGrid_Page* page = &grid->pages[pageIndex];
+				for (uint32 i = 0; i < page->count; i++)
+				{
+					if (!inside && (page->x[i] < minX || page->x[i] > maxX || page->z[i] < minZ || page->z[i] > maxZ))
+						continue;
+					if (count == maxCount)
+						return count;
+					ids[count++] = page->ids[i];
+				}
+				pageIndex = page->next;
+			}
+		}
+	}
+	return count;
+}
+
+static void SpatialGrid_VisitNearest(const SpatialGrid* grid, uint32 cell, float x, float z, float limit, uint32 k, uint32* ids, float* distances, uint32* count)
+{
+	uint32 pageIndex = grid->cells[cell];
+	while (pageIndex != SPATIAL_GRID_INVALID)
+	{
+		const SpatialGrid_Page* page = &grid->pages[pageIndex];
+		for (uint32 i = 0; i < page->count; i++)
+		{
+			float dx = page->x[i] - x;
+			float dz = page->z[i] - z;
+			float distance = dx * dx + dz * dz;
+			if (distance > limit || (*count == k && distance >= distances[k - 1]))
+				continue;
+
+			// Insertion into the sorted result, dropping the farthest when
+			// full.
+			uint32 position = *count < k ? (*count)++ : k - 1;
+			while (position > 0 && distances[position - 1] > distance)
+			{
+				distances[position] = distances[position - 1];
+				ids[position] = ids[position - 1];
+				position--;
+			}
+			distances[position] = distance;
+			ids[position] = page->ids[i];
+		}
+		pageIndex = page->next;
+	}
+}
+
+uint32 SpatialGrid_QueryNearest(const SpatialGrid* grid, float x, float z, float maxRadius, uint32 k, uint32* ids, float* distancesSquared)
+{
+	if (k == 0)
+		return 0;
+
+	// Ranking needs the distances; without a caller buffer k is bounded by
+	// the local one.
+	float localDistances[SPATIAL_GRID_MAX_LOCAL_K];
+	float* distances = distancesSquared;
+	if (distances == NULL)
+	{
+		ASSERT(k <= SPATIAL_GRID_MAX_LOCAL_K);
+		distances = localDistances;
+	}
+
+	int32 column = SpatialGrid_Column(grid, x);
+	int32 row = SpatialGrid_Row(grid, z);
+	float limit = maxRadius * maxRadius;
+
+	// A cell on ring r is at least r - 1 cells plus the distance to the
+	// nearest edge of the centre cell away.
+	float fx = (x - grid->desc.originX) * grid->inverseCellSize - column;
+	float fz = (z - grid->desc.originZ) * grid->inverseCellSize - row;
+	float edge = fx < 1.0f - fx ? fx : 1.0f - fx;
+	edge = fz < edge ? fz : edge;
+	edge = 1.0f - fz < edge ? 1.0f - fz : edge;
+	edge = edge > 0.0f ? edge : 0.0f;
+
+	int32 maxRing = (int32)(grid->desc.columns > grid->desc.rows ? grid->desc.columns : grid->desc.rows);
+	uint32 count = 0;
+	for (int32 ring = 0; ring <= maxRing; ring++)
+	{
+		if (ring > 0)
+		{
+			float bound = ((float)(ring - 1) + edge) * grid->desc.cellSize;
+			bound *= bound;
+			if (bound > limit || (count == k && bound >= distances[k - 1]))
+				break;
+		}
+
+		int32 top = row - ring;
+		int32 bottom = row + ring;
+		int32 left = column - ring;
+		int32 right = column + ring;
+		if (top < 0 && bottom >= (int32)grid->desc.rows && left < 0 && right >= (int32)grid->desc.columns)
+			break;
+		for (int32 r = top; r <= bottom; r++)
+		{
+			if (r < 0 || r >= (int32)grid->desc.rows)
+				continue;
+			// Inner rows of the ring only have their two end cells.
+			int32 step = (r == top || r == bottom) ? 1 : right - left;
+			if (step == 0)
+				step = 1;
+			for (int32 c = left; c <= right; c += step)
+			{
+				if (c < 0 || c >= (int32)grid->desc.columns)
+					continue;
+				SpatialGrid_VisitNearest(grid, (uint32)r * grid->desc.columns + (uint32)c, x, z, limit, k, ids, distances, &count);
+			}
+		}
+	}
+	return count;
+}
+
+void SpatialGrid_GetStats(const SpatialGrid* grid, SpatialGrid_Stats* stats)
+{
+	*stats = grid->stats;
+	stats->itemCount = grid->itemCount;
+	stats->pageCount = grid->pageCount;
+}
+
+void SpatialGrid_ResetStats(SpatialGrid* grid)
+{
+	grid->stats.cellChangeCount = 0;
+}
\ No newline at end of file
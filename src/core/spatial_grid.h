@@ -0,0 +1,60 @@
+#ifndef __SPATIAL_GRID_H__
+#define __SPATIAL_GRID_H__
+
+#include "config.h"
+
+// Dense uniform grid over the XZ plane for "units near X" queries. Every
+// cell keeps its items in a chain of fixed-size pages holding ids and
+// positions side by side, so a query reads a cell as a few contiguous
+// arrays and never touches the units themselves. Positions outside the
+// grid count towards the border cells; results are exact either way.
+//
+// Items are tracked by the handle SpatialGrid_Insert returns, the id is
+// what queries report (an Entity, an index, ...). Moving within a cell
+// only rewrites the stored position; crossing into another cell moves the
+// entry between page chains in constant time. Pages come from a pool that
+// only grows on insert. Queries write into caller buffers, stop when they
+// are full and return the number of results; they never allocate and may
+// run concurrently with each other, but not with changes.
+typedef struct SpatialGrid SpatialGrid;
+
+#define SPATIAL_GRID_INVALID 0xFFFFFFFFu
+
+typedef struct SpatialGrid_Desc
+{
+	float originX;
+	float originZ;
+	float cellSize;
+	uint32 columns;
+	uint32 rows;
+	uint32 maxItems;
+} SpatialGrid_Desc;
+
+typedef struct SpatialGrid_Stats
+{
+	uint32 itemCount;
+	uint32 pageCount;
+	uint32 cellChangeCount;
+} SpatialGrid_Stats;
+
+SpatialGrid* SpatialGrid_Create(const SpatialGrid_Desc* spatial_grid_desc);
+void SpatialGrid_Destroy(SpatialGrid* grid);
+// Removes every item; the pages are kept for the next fill.
+void SpatialGrid_Clear(SpatialGrid* grid);
+
+// Returns SPATIAL_GRID_INVALID when maxItems are in the grid already.
+uint32 SpatialGrid_Insert(SpatialGrid* grid, uint32 id, float x, float z);
+void SpatialGrid_Update(SpatialGrid* grid, uint32 handle, float x, float z);
+void SpatialGrid_Remove(SpatialGrid* grid, uint32 handle);
+
+uint32 SpatialGrid_QueryRadius(const SpatialGrid* grid, float x, float z, float radius, uint32* ids, uint32 maxCount);
+uint32 SpatialGrid_QueryBox(const SpatialGrid* grid, float minX, float minZ, float maxX, float maxZ, uint32* ids, uint32 maxCount);
+// The k items nearest to (x, z) within maxRadius, closest first, with
+// their squared distances when distancesSquared is not NULL (k is at most
+// 64 without it).
+uint32 SpatialGrid_QueryNearest(const SpatialGrid* grid, float x, float z, float maxRadius, uint32 k, uint32* ids, float* distancesSquared);
+
+void SpatialGrid_GetStats(const SpatialGrid* grid, SpatialGrid_Stats* stats);
+void SpatialGrid_ResetStats(SpatialGrid* grid);
+
+#endif
\ No newline at end of file
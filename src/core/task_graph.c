@@ -0,0 +1,298 @@
+#include "task_graph.h"
+#include "thread.h"
+#include "timer.h"
+#include <string.h>
+
+// Frame N + 1 is set up while N - 1 may still be reported on.
+#define TASK_GRAPH_FRAME_SLOTS 4
+#define TASK_GRAPH_KICK -1
+
+typedef struct TaskGraph_Frame TaskGraph_Frame;
+
+typedef struct TaskGraph_Instance
+{
+	TaskGraph* graph;
+	TaskGraph_Frame* frame;
+	uint32 stage;
+	volatile int32 pending;
+	// Stage whose release started this one: an index of the same frame,
+	// index + TASK_GRAPH_MAX_STAGES for the previous frame, or
+	// TASK_GRAPH_KICK.
+	int32 releasedBy;
+	double start;
+	double end;
+} TaskGraph_Instance;
+
+struct TaskGraph_Frame
+{
+	uint32 frame;
+	volatile int32 remaining;
+	double kickTime;
+	Job* root;
+	TaskGraph_Instance instances[TASK_GRAPH_MAX_STAGES];
+};
+
+struct TaskGraph
+{
+	JobSystem* jobs;
+	TaskGraph_Stage stages[TASK_GRAPH_MAX_STAGES];
+	uint32 stageCount;
+	// Bit k of successors[i] is set when stage k of the same frame waits
+	// for stage i, crossSuccessors for stage k of the next frame.
+	uint32 successors[TASK_GRAPH_MAX_STAGES];
+	uint32 crossSuccessors[TASK_GRAPH_MAX_STAGES];
+	uint32 predecessorCounts[TASK_GRAPH_MAX_STAGES];
+	uint32 crossPredecessorCounts[TASK_GRAPH_MAX_STAGES];
+	TaskGraph_Frame frames[TASK_GRAPH_FRAME_SLOTS];
+	uint32 frame;
+	uint32 completed;
+	Mutex* reportMutex;
+	TaskGraph_Report report;
+	int hasReport;
+};
+
+static int TaskGraph_Conflict(const TaskGraph_Stage* a, const TaskGraph_Stage* b)
+{
+	return (a->writes & (b->reads | b->writes)) != 0 || (a->reads & b->writes) != 0;
+}
+
+static TaskGraph_Frame* TaskGraph_GetFrame(TaskGraph* graph, uint32 frame)
+{
+	return &graph->frames[frame % TASK_GRAPH_FRAME_SLOTS];
+}
+
+static void TaskGraph_Nothing(JobSystem* jobs, Job* job, void* userData)
+{
+}
+
+static void TaskGraph_RunStage(JobSystem* jobs, Job* job, void* userData);
+
+static void TaskGraph_Release(TaskGraph* graph, TaskGraph_Instance* instance, int32 releasedBy)
+{
+	if (Atomic_Add(&instance->pending, -1) != 0)
+		return;
+
+	instance->releasedBy = releasedBy;
+	Job* job = JobSystem_CreateJob(graph->jobs, TaskGraph_RunStage, instance);
+	if (graph->stages[instance->stage].mainThread)
+		Job_SetMainThread(job);
+	JobSystem_Run(graph->jobs, job);
+}
+
+static void TaskGraph_Record(TaskGraph* graph, TaskGraph_Frame* frame, uint32 last)
+{
+	TaskGraph_Report report;
+	memset(&report, 0, sizeof(TaskGraph_Report));
+	report.frame = frame->frame;
+	report.frameTime = frame->instances[last].end - frame->kickTime;
+	for (uint32 i = 0; i < graph->stageCount; i++)
+	{
+		report.stageTimes[i] = frame->instances[i].end - frame->instances[i].start;
+	}
+
+	// Walk back from the last stage; a stage released by the previous frame
+	// ends the walk there, that frame's slot is about to be reused.
+	TaskGraph_PathEntry path[TASK_GRAPH_MAX_STAGES + 1];
+	uint32 length = 0;
+	const TaskGraph_Frame* current = frame;
+	uint32 stage = last;
+	for (;;)
+	{
+		const TaskGraph_Instance* instance = &current->instances[stage];
+		TaskGraph_PathEntry* entry = &path[length++];
+		entry->stage = stage;
+		entry->frame = current->frame;
+		entry->start = instance->start - frame->kickTime;
+		entry->end = instance->end - frame->kickTime;
+		if (current != frame || instance->releasedBy == TASK_GRAPH_KICK || length == TASK_GRAPH_MAX_STAGES + 1)
+			break;
+		if (instance->releasedBy >= TASK_GRAPH_MAX_STAGES)
+		{
+			current = TaskGraph_GetFrame(graph, frame->frame - 1);
+			stage = instance->releasedBy - TASK_GRAPH_MAX_STAGES;
+		}
+		else
+		{
+			stage = instance->releasedBy;
+		}
+	}
+
+	double longest = -1.0;
+	for (uint32 i = 0; i < length; i++)
+	{
+		report.path[i] = path[length - 1 - i];
+		double time = report.path[i].end - report.path[i].start;
+		if (time > longest)
+		{
+			longest = time;
+			report.boundingStage = report.path[i].stage;
+		}
+	}
+	report.pathLength = length;
+
+	Mutex_Lock(graph->reportMutex);
+	graph->report = report;
+	graph->hasReport = 1;
+	Mutex_Unlock(graph->reportMutex);
+}
+
+static void TaskGraph_RunStage(JobSystem* jobs, Job* job, void* userData)
+{
+	TaskGraph_Instance* instance = (TaskGraph_Instance*)userData;
+	TaskGraph* graph = instance->graph;
+	TaskGraph_Frame* frame = instance->frame;
+	uint32 stage = instance->stage;
+	const TaskGraph_Stage* desc = &graph->stages[stage];
+
+	instance->start = Timer_GetMilliseconds();
+	desc->function(desc->userData, frame->frame);
+	instance->end = Timer_GetMilliseconds();
+
+	// Recorded before this stage releases the next frame, which therefore
+	// cannot finish yet and let a kick reuse the previous frame's slot.
+	if (Atomic_Add(&frame->remaining, -1) == 0)
+	{
+		TaskGraph_Record(graph, frame, stage);
+		JobSystem_Run(jobs, frame->root);
+	}
+
+	for (uint32 bits = graph->successors[stage]; bits != 0; bits &= bits - 1)
+	{
+		uint32 next = 0;
+		while (((bits >> next) & 1) == 0)
+		{
+			next++;
+		}
+		TaskGraph_Release(graph, &frame->instances[next], (int32)stage);
+	}
+	TaskGraph_Frame* following = TaskGraph_GetFrame(graph, frame->frame + 1);
+	for (uint32 bits = graph->crossSuccessors[stage]; bits != 0; bits &= bits - 1)
+	{
+		uint32 next = 0;
+		while (((bits >> next) & 1) == 0)
+		{
+			next++;
+		}
+		TaskGraph_Release(graph, &following->instances[next], (int32)(stage + TASK_GRAPH_MAX_STAGES));
+	}
+}
+
+static void TaskGraph_Prepare(TaskGraph* graph, uint32 frameIndex)
+{
+	TaskGraph_Frame* frame = TaskGraph_GetFrame(graph, frameIndex);
+	frame->frame = frameIndex;
+	frame->root = NULL;
+	Atomic_Store(&frame->remaining, (int32)graph->stageCount);
+	for (uint32 i = 0; i < graph->stageCount; i++)
+	{
+		TaskGraph_Instance* instance = &frame->instances[i];
+		instance->graph = graph;
+		instance->frame = frame;
+		instance->stage = i;
+		instance->releasedBy = TASK_GRAPH_KICK;
+		instance->start = instance->end = 0.0;
+		// One more for the kick, so nothing starts before the frame does.
+		uint32 pending = graph->predecessorCounts[i] + 1;
+		if (frameIndex > 0)
+			pending += graph->crossPredecessorCounts[i];
+		Atomic_Store(&instance->pending, (int32)pending);
+	}
+}
+
+TaskGraph* TaskGraph_Create(JobSystem* jobs, const TaskGraph_Stage* stages, uint32 stageCount)
+{
+	ASSERT(jobs != NULL && stages != NULL && stageCount > 0 && stageCount <= TASK_GRAPH_MAX_STAGES);
+
+	TaskGraph* graph = (TaskGraph*)malloc(sizeof(TaskGraph));
+	memset(graph, 0, sizeof(TaskGraph));
+	graph->jobs = jobs;
+	graph->stageCount = stageCount;
+	memcpy(graph->stages, stages, sizeof(TaskGraph_Stage) * stageCount);
+
+	for (uint32 i = 0; i < stageCount; i++)
+	{
+		ASSERT(stages[i].function != NULL);
+		for (uint32 k = 0; k < stageCount; k++)
+		{
+			int conflict = i == k || TaskGraph_Conflict(&stages[i], &stages[k]);
+			if (!conflict)
+				continue;
+			if (i < k)
+			{
+				graph->successors[i] |= 1u << k;
+				graph->predecessorCounts[k]++;
+			}
+			graph->crossSuccessors[i] |= 1u << k;
+			graph->crossPredecessorCounts[k]++;
+		}
+	}
+
+	graph->reportMutex = Mutex_Create();
+	TaskGraph_Prepare(graph, 0);
+	return graph;
+}
+
+void TaskGraph_Destroy(TaskGraph* graph)
+{
+	TaskGraph_Flush(graph);
+	Mutex_Destroy(graph->reportMutex);
+	free(graph);
+}
+
+uint32 TaskGraph_Kick(TaskGraph* graph)
+{
+	ASSERT(JobSystem_GetThreadIndex(graph->jobs) == 0);
+
+	uint32 frameIndex = graph->frame++;
+	for (; graph->completed + 2 <= frameIndex; graph->completed++)
+	{
+		JobSystem_Wait(graph->jobs, TaskGraph_GetFrame(graph, graph->completed)->root);
+	}
+
+	// The next frame's counters must be in place before any stage of this
+	// one can finish and release into them.
+	TaskGraph_Prepare(graph, frameIndex + 1);
+
+	TaskGraph_Frame* frame = TaskGraph_GetFrame(graph, frameIndex);
+	frame->root = JobSystem_CreateJob(graph->jobs, TaskGraph_Nothing, NULL);
+	frame->kickTime = Timer_GetMilliseconds();
+	for (uint32 i = 0; i < graph->stageCount; i++)
+	{
+		TaskGraph_Release(graph, &frame->instances[i], TASK_GRAPH_KICK);
+	}
+	return frameIndex;
+}
+
+void TaskGraph_Flush(TaskGraph* graph)
+{
+	for (; graph->completed < graph->frame; graph->completed++)
+	{
+		JobSystem_Wait(graph->jobs, TaskGraph_GetFrame(graph, graph->completed)->root);
+	}
+}
+
+const char* TaskGraph_GetStageName(const TaskGraph* graph, uint32 stage)
+{
+	ASSERT(stage < graph->stageCount);
+	return graph->stages[stage].name != NULL ? graph->stages[stage].name : "unnamed";
+}
+
+int TaskGraph_GetReport(TaskGraph* graph, TaskGraph_Report* report)
+{
+	Mutex_Lock(graph->reportMutex);
+	int hasReport = graph->hasReport;
+	if (hasReport)
+		*report = graph->report;
+	Mutex_Unlock(graph->reportMutex);
+	return hasReport;
+}
+
+void TaskGraph_LogReport(const TaskGraph* graph, const TaskGraph_Report* report)
+{
+	LOG_I("Frame %u: %.2f ms, bound by %s\n", report->frame, report->frameTime, TaskGraph_GetStageName(graph, report->boundingStage));
+	for (uint32 i = 0; i < report->pathLength; i++)
+	{
+		const TaskGraph_PathEntry* entry = &report->path[i];
+		LOG_I("  %-16s %s %7.2f .. %7.2f ms\n", TaskGraph_GetStageName(graph, entry->stage), entry->frame == report->frame ? "     " : "(N-1)", entry->start, entry->end);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef __TASK_GRAPH_H__
+#define __TASK_GRAPH_H__
+
+#include "config.h"
+#include "job_system.h"
+
+#define TASK_GRAPH_MAX_STAGES 32
+
+// Per-frame stage graph on top of the job system. Every stage declares the
+// resources it reads and writes as bit masks (the caller numbers its own
+// resources: input, simulation state, poses, transforms, visibility, render
+// lists, ...) and the order of declaration is the logical order of a frame.
+// Two stages conflict when one writes what the other touches, and a stage
+// waits for every earlier conflicting stage of its frame; stages that do
+// not conflict run concurrently.
+//
+// The same rule applies across frames: a stage of frame N + 1 waits for
+// the conflicting stages of frame N (and for itself), nothing else. So the
+// simulation of the next frame starts as soon as the last stage reading
+// simulation state is done, while culling and submission of the current
+// frame are still running. At most two frames are in flight;
+// TaskGraph_Kick waits for frame N - 2 before it starts frame N, helping
+// with jobs meanwhile. Main-thread stages run on thread 0 while it waits.
+//
+// Every finished frame records when each stage ran and which stage
+// released which; walking that chain back from the stage that finished
+// last gives the critical path, which is what bounds the frame.
+typedef struct TaskGraph TaskGraph;
+
+typedef void (*TaskGraph_Function)(void* userData, uint32 frame);
+
+typedef struct TaskGraph_Stage
+{
+	const char* name;
+	TaskGraph_Function function;
+	void* userData;
+	uint32 reads;
+	uint32 writes;
+	int mainThread;
+} TaskGraph_Stage;
+
+typedef struct TaskGraph_PathEntry
+{
+	uint32 stage;
+	// Frame of the stage, the previous frame when it gated this one.
+	uint32 frame;
+	// Relative to the kick of the reported frame, in milliseconds.
+	double start;
+	double end;
+} TaskGraph_PathEntry;
+
+typedef struct TaskGraph_Report
+{
+	uint32 frame;
+	// From the kick to the end of the last stage.
+	double frameTime;
+	double stageTimes[TASK_GRAPH_MAX_STAGES];
+	uint32 pathLength;
+	// In execution order.
+	TaskGraph_PathEntry path[TASK_GRAPH_MAX_STAGES + 1];
+	// The stage on the path that ran longest.
+	uint32 boundingStage;
+} TaskGraph_Report;
+
+TaskGraph* TaskGraph_Create(JobSystem* jobs, const TaskGraph_Stage* stages, uint32 stageCount);
+// Finishes the frames in flight first.
+void TaskGraph_Destroy(TaskGraph* graph);
+
+// Thread 0 only. Starts the next frame and returns its number.
+uint32 TaskGraph_Kick(TaskGraph* graph);
+// Waits until every kicked frame finished.
+void TaskGraph_Flush(TaskGraph* graph);
+
+const char* TaskGraph_GetStageName(const TaskGraph* graph, uint32 stage);
+// Report of the latest finished frame; returns 0 before the first one.
+int TaskGraph_GetReport(TaskGraph* graph, TaskGraph_Report* report);
+void TaskGraph_LogReport(const TaskGraph* graph, const TaskGraph_Report* report);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,1143 @@
+#include "terrain.h"
+#include "frustum.h"
+#include "mesh.h"
+#include "simd.h"
+#include "thread.h"
+#include <opengl/glad.h>
+#include <math.h>
+#include <string.h>
+
+#define TERRAIN_MORPH_START 0.7f
+#define TERRAIN_MIN_RANGE 8.0f
+#define TERRAIN_MAX_LEVELS 16
+#define TERRAIN_NO_MORPH 1e30f
+#define TERRAIN_SIGHT_NUDGE 1e-3f
+#define TERRAIN_SIGHT_JOB_GRAIN 256
+
+typedef struct Terrain_Patch
+{
+	float x;
+	float z;
+	float size;
+	uint32 level;
+} Terrain_Patch;
+
+typedef struct Terrain_Level
+{
+	uint32 countX;
+	uint32 countZ;
+	float2* ranges;
+} Terrain_Level;
+
+struct Terrain
+{
+	uint32 width;
+	uint32 height;
+	float* heights;
+	float cellSize;
+	uint32 patchSize;
+	uint32 levelCount;
+	float lodRanges[TERRAIN_MAX_LEVELS];
+	Terrain_Level levels[TERRAIN_MAX_LEVELS];
+	// Height ranges of nodes smaller than a patch, 2^level cells wide, for
+	// line of sight. Coarser levels are shared with the patch quadtree.
+	uint32 patchShift;
+	Terrain_Level sightLevels[TERRAIN_MAX_LEVELS];
+	uint32 sightMaxSteps;
+	Texture* heightTexture;
+	Texture* groundLayers;
+	uint32 groundLayerCount;
+	float groundTiling;
+	Texture* splatMap;
+	uint8* splatWeights;
+	uint8* splatScratch;
+	uint32 splatChannels;
+	uint32 dirtyMin[2];
+	uint32 dirtyMax[2];
+	Mesh* grid;
+	Terrain_Patch* patches;
+	uint32 patchCount;
+	uint32 patchCapacity;
+	uint32 culledCount;
+	Frustum frustum;
+	float3 eye;
+	matrix4x4 viewProjection;
+};
+
+static Mesh* Terrain_CreateGrid(uint32 patchSize)
+{
+	uint32 side = patchSize + 1;
+	Mesh_Data data;
+	data.vertexCount = side * side;
+	data.indexCount = patchSize * patchSize * 6;
+	data.vertices = (Vertex*)malloc(sizeof(Vertex) * data.vertexCount);
+	data.indices = (uint32*)malloc(sizeof(uint32) * data.indexCount);
+	memset(data.vertices, 0, sizeof(Vertex) * data.vertexCount);
+
+	float step = 1.0f / (float)patchSize;
+	for (uint32 z = 0; z < side; z++)
+	{
+		for (uint32 x = 0; x < side; x++)
+		{
+			Vertex* vertex = &data.vertices[z * side + x];
+			vertex->position.x = x * step;
+			vertex->position.z = z * step;
+			vertex->normal.y = 1.0f;
+			vertex->uv1.x = vertex->position.x;
+			vertex->uv1.y = vertex->position.z;
+			vertex->color.r = vertex->color.g = vertex->color.b = vertex->color.a = 1.0f;
+		}
+	}
+
+	uint32* index = data.indices;
+	for (uint32 z = 0; z < patchSize; z++)
+	{
+		for (uint32 x = 0; x < patchSize; x++)
+		{
+			uint32 corner = z * side + x;
+			*index++ = corner;
+			*index++ = corner + side;
+			*index++ = corner + 1;
+			*index++ = corner + 1;
+			*index++ = corner + side;
+			*index++ = corner + side + 1;
+		}
+	}
+
+	Mesh* mesh = Mesh_Create(&data);
+	free(data.vertices);
+	free(data.indices);
+	return mesh;
+}
+
+static void Terrain_GetSampleRange(const Terrain* terrain, uint32 x0, uint32 z0, uint32 nodeCells, float2* range)
+{
+	uint32 cellsX = terrain->width - 1;
+	uint32 cellsZ = terrain->height - 1;
+	uint32 x1 = x0 + nodeCells < cellsX ? x0 + nodeCells : cellsX;
+	uint32 z1 = z0 + nodeCells < cellsZ ? z0 + nodeCells : cellsZ;
+	range->x = 1e30f;
+	range->y = -1e30f;
+	for (uint32 z = z0; z <= z1; z++)
+	{
+		const float* row = terrain->heights + z * terrain->width;
+		for (uint32 x = x0; x <= x1; x++)
+		{
+			if (row[x] < range->x)
+				range->x = row[x];
+			if (row[x] > range->y)
+				range->y = row[x];
+		}
+	}
+}
+
+static void Terrain_BuildLevels(Terrain* terrain)
+{
+	uint32 cellsX = terrain->width - 1;
+	uint32 cellsZ = terrain->height - 1;
+	uint32 level = 0;
+	for (;;)
+	{
+		uint32 nodeCells = terrain->patchSize << level;
+		Terrain_Level* current = &terrain->levels[level];
+		current->countX = (cellsX + nodeCells - 1) / nodeCells;
+		current->countZ = (cellsZ + nodeCells - 1) / nodeCells;
+		current->ranges = (float2*)malloc(sizeof(float2) * current->countX * current->countZ);
+
+		for (uint32 nz = 0; nz < current->countZ; nz++)
+		{
+			for (uint32 nx = 0; nx < current->countX; nx++)
+			{
+				float2* range = &current->ranges[nz * current->countX + nx];
+				range->x = 1e30f;
+				range->y = -1e30f;
+				if (level == 0)
+				{
+					Terrain_GetSampleRange(terrain, nx * nodeCells, nz * nodeCells, nodeCells, range);
+				}
+				else
+				{
+					const Terrain_Level* children = &terrain->levels[level - 1];
+					for (uint32 child = 0; child < 4; child++)
+					{
+						uint32 cx = nx * 2 + (child & 1);
+						uint32 cz = nz * 2 + (child >> 1);
+						if (cx >= children->countX || cz >= children->countZ)
+							continue;
+						const float2* childRange = &children->ranges[cz * children->countX + cx];
+						if (childRange->x < range->x)
+							range->x = childRange->x;
+						if (childRange->y > range->y)
+							range->y = childRange->y;
+					}
+				}
+			}
+		}
+
+		level++;
+		if ((current->countX == 1 && current->countZ == 1) || level == TERRAIN_MAX_LEVELS)
+			break;
+	}
+	terrain->levelCount = level;
+}
+
+static void Terrain_BuildSightLevels(Terrain* terrain)
+{
+	uint32 cellsX = terrain->width - 1;
+	uint32 cellsZ = terrain->height - 1;
+	terrain->patchShift = 0;
+	while ((1u << terrain->patchShift) < terrain->patchSize)
+	{
+		terrain->patchShift++;
+	}
+
+	for (uint32 level = 1; level < terrain->patchShift; level++)
+	{
+		uint32 nodeCells = 1u << level;
+		Terrain_Level* current = &terrain->sightLevels[level];
+		current->countX = (cellsX + nodeCells - 1) >> level;
+		current->countZ = (cellsZ + nodeCells - 1) >> level;
+		current->ranges = (float2*)malloc(sizeof(float2) * current->countX * current->countZ);
+
+		const Terrain_Level* children = &terrain->sightLevels[level - 1];
+		for (uint32 nz = 0; nz < current->countZ; nz++)
+		{
+			for (uint32 nx = 0; nx < current->countX; nx++)
+			{
+				float2* range = &current->ranges[nz * current->countX + nx];
+				if (level == 1)
+				{
+					Terrain_GetSampleRange(terrain, nx * nodeCells, nz * nodeCells, nodeCells, range);
+					continue;
+				}
+				range->x = 1e30f;
+				range->y = -1e30f;
+				for (uint32 child = 0; child < 4; child++)
+				{
+					uint32 cx = nx * 2 + (child & 1);
+					uint32 cz = nz * 2 + (child >> 1);
+					if (cx >= children->countX || cz >= children->countZ)
+						continue;
+					const float2* childRange = &children->ranges[cz * children->countX + cx];
+					if (childRange->x < range->x)
+						range->x = childRange->x;
+					if (childRange->y > range->y)
+						range->y = childRange->y;
+				}
+			}
+		}
+	}
+}
+
+Terrain* Terrain_Create(const Terrain_Desc* terrain_desc)
+{
+	ASSERT(terrain_desc->width >= 2 && terrain_desc->height >= 2);
+	ASSERT(terrain_desc->patchSize >= 2 && (terrain_desc->patchSize & (terrain_desc->patchSize - 1)) == 0);
+
+	Terrain* terrain = (Terrain*)malloc(sizeof(Terrain));
+	terrain->width = terrain_desc->width;
+	terrain->height = terrain_desc->height;
+	terrain->cellSize = terrain_desc->cellSize;
+	terrain->patchSize = terrain_desc->patchSize;
+	terrain->heights = (float*)malloc(sizeof(float) * terrain->width * terrain->height);
+	memcpy(terrain->heights, terrain_desc->heights, sizeof(float) * terrain->width * terrain->height);
+	Terrain_BuildLevels(terrain);
+	Terrain_BuildSightLevels(terrain);
+	// A walk advances past at most width + height cells and descends at
+	// most once per advance plus the start level, so a walk longer than
+	// this is stuck and counts as blocked.
+	terrain->sightMaxSteps = 4 * (terrain->width + terrain->height) + 4 * TERRAIN_MAX_LEVELS;
+
+	// A patch must finish morphing before its coarser neighbour starts to,
+	// which only holds when the LOD range is large against the patch size.
+	float lodDistance = terrain_desc->lodDistance;
+	float minimum = TERRAIN_MIN_RANGE * terrain->patchSize * terrain->cellSize;
+	if (lodDistance < minimum)
+	{
+		LOG_W("Terrain LOD distance %f is too small, using %f\n", lodDistance, minimum);
+		lodDistance = minimum;
+	}
+	for (uint32 i = 0; i < terrain->levelCount; i++)
+	{
+		terrain->lodRanges[i] = lodDistance * (float)(1 << i);
+	}
+
+	Texture_Desc desc =
+	{
+		TEXTURE_2D,
+		TEXTURE_R_32F,
+		terrain->width,
+		terrain->height,
+		1,
+		1,
+		FILTER_POINT,
+		FILTER_POINT,
+		WRAP_CLAMP,
+		WRAP_CLAMP
+	};
+	// R32F can't be filtered on GLES 3.0, terrain.glsl does the bilinear.
+	terrain->heightTexture = Texture_Create(&desc);
+	Texture_SetData(terrain->heightTexture, 0, terrain->heights);
+
+	terrain->groundLayers = NULL;
+	terrain->groundLayerCount = 0;
+	terrain->groundTiling = 1.0f;
+	terrain->splatMap = NULL;
+	terrain->splatWeights = NULL;
+	terrain->splatScratch = NULL;
+	terrain->splatChannels = 0;
+
+	terrain->grid = Terrain_CreateGrid(terrain->patchSize);
+	terrain->patchCapacity = 64;
+	terrain->patches = (Terrain_Patch*)malloc(sizeof(Terrain_Patch) * terrain->patchCapacity);
+	terrain->patchCount = 0;
+	terrain->culledCount = 0;
+	return terrain;
+}
+
+void Terrain_Destroy(Terrain* terrain)
+{
+	for (uint32 i = 0; i < terrain->levelCount; i++)
+	{
+		free(terrain->levels[i].ranges);
+	}
+	for (uint32 i = 1; i < terrain->patchShift; i++)
+	{
+		free(terrain->sightLevels[i].ranges);
+	}
+	Texture_Destroy(terrain->heightTexture);
+	if (terrain->splatMap != NULL)
+		Texture_Destroy(terrain->splatMap);
+	free(terrain->splatWeights);
+	free(terrain->splatScratch);
+	Mesh_Destroy(terrain->grid);
+	free(terrain->patches);
+	free(terrain->heights);
+	free(terrain);
+}
+
+static void Terrain_GetNodeBounds(const Terrain* terrain, uint32 level, uint32 nx, uint32 nz, Aabb* bounds)
+{
+	const Terrain_Level* current = &terrain->levels[level];
+	const float2* range = &current->ranges[nz * current->countX + nx];
+	float size = (terrain->patchSize << level) * terrain->cellSize;
+	bounds->min.x = nx * size;
+	bounds->min.y = range->x;
+	bounds->min.z = nz * size;
+	bounds->max.x = bounds->min.x + size;
+	bounds->max.y = range->y;
+	bounds->max.z = bounds->min.z + size;
+}
+
+static int Terrain_IntersectsSphere(const Aabb* bounds, const float3* center, float radius)
+{
+	float distanceSq = 0.0f;
+	for (uint32 axis = 0; axis < 3; axis++)
+	{
+		float value = center->data[axis];
+		if (value < bounds->min.data[axis])
+			distanceSq += (bounds->min.data[axis] - value) * (bounds->min.data[axis] - value);
+		else if (value > bounds->max.data[axis])
+			distanceSq += (value - bounds->max.data[axis]) * (value - bounds->max.data[axis]);
+	}
+	return distanceSq <= radius * radius;
+}
+
+static void Terrain_AddPatch(Terrain* terrain, const Aabb* bounds, uint32 level)
+{
+	if (terrain->patchCount == terrain->patchCapacity)
+	{
+		terrain->patchCapacity *= 2;
+		terrain->patches = (Terrain_Patch*)realloc(terrain->patches, sizeof(Terrain_Patch) * terrain->patchCapacity);
+	}
+	Terrain_Patch* patch = &terrain->patches[terrain->patchCount++];
+	patch->x = bounds->min.x;
+	patch->z = bounds->min.z;
+	patch->size = bounds->max.x - bounds->min.x;
+	patch->level = level;
+}
+
+static void Terrain_SelectNode(Terrain* terrain, uint32 level, uint32 nx, uint32 nz)
+{
+	Aabb bounds;
+	Terrain_GetNodeBounds(terrain, level, nx, nz, &bounds);
+	if (!Frustum_TestAabb(&terrain->frustum, &bounds))
+	{
+		terrain->culledCount++;
+		return;
+	}
+
+	// Children outside the finer range are still drawn with their own grid;
+	// they sit past that level's morph end, so they collapse to this level's
+	// resolution and match their neighbours.
+	if (level == 0 || !Terrain_IntersectsSphere(&bounds, &terrain->eye, terrain->lodRanges[level - 1]))
+	{
+		Terrain_AddPatch(terrain, &bounds, level);
+		return;
+	}
+
+	const Terrain_Level* children = &terrain->levels[level - 1];
+	for (uint32 child = 0; child < 4; child++)
+	{
+		uint32 cx = nx * 2 + (child & 1);
+		uint32 cz = nz * 2 + (child >> 1);
+		if (cx < children->countX && cz < children->countZ)
+			Terrain_SelectNode(terrain, level - 1, cx, cz);
+	}
+}
+
+uint32 Terrain_Select(Terrain* terrain, const matrix4x4* viewProjection, const float3* eye)
+{
+	terrain->viewProjection = *viewProjection;
+	terrain->eye = *eye;
+	Frustum_FromMatrix(&terrain->frustum, viewProjection);
+	terrain->patchCount = 0;
+	terrain->culledCount = 0;
+	Terrain_SelectNode(terrain, terrain->levelCount - 1, 0, 0);
+	return terrain->patchCount;
+}
+
+void Terrain_Draw(Terrain* terrain, Material* material)
+{
+	Terrain_FlushSplat(terrain);
+
+	Shader* shader = Material_Get_Shader(material);
+	Shader_Use(shader);
+	Material_Apply(material);
+
+	GLint location = Shader_GetLocation(shader, "uViewProjection");
+	if (location != -1)
+		glUniformMatrix4fv(location, 1, GL_FALSE, terrain->viewProjection.data);
+	location = Shader_GetLocation(shader, "uEye");
+	if (location != -1)
+		glUniform3f(location, terrain->eye.x, terrain->eye.y, terrain->eye.z);
+	location = Shader_GetLocation(shader, "uHeightMapSize");
+	if (location != -1)
+		glUniform4f(location, (float)terrain->width, (float)terrain->height, 1.0f / terrain->width, 1.0f / terrain->height);
+	location = Shader_GetLocation(shader, "uCellSize");
+	if (location != -1)
+		glUniform1f(location, terrain->cellSize);
+	location = Shader_GetLocation(shader, "uHeightMap");
+	if (location != -1)
+		glUniform1i(location, 0);
+	Texture_Bind(terrain->heightTexture, 0);
+
+	// Every sampler gets its own unit even when unused, since samplers of
+	// different types must never share one.
+	location = Shader_GetLocation(shader, "uSplatMap");
+	if (location != -1)
+		glUniform1i(location, 1);
+	location = Shader_GetLocation(shader, "uGroundLayers");
+	if (location != -1)
+		glUniform1i(location, 2);
+	location = Shader_GetLocation(shader, "uShadowMap");
+	if (location != -1)
+		glUniform1i(location, TERRAIN_SHADOW_UNIT);
+	location = Shader_GetLocation(shader, "uFogOfWar");
+	if (location != -1)
+		glUniform1i(location, TERRAIN_FOG_OF_WAR_UNIT);
+	location = Shader_GetLocation(shader, "uTracks");
+	if (location != -1)
+		glUniform1i(location, TERRAIN_TRACK_UNIT);
+	location = Shader_GetLocation(shader, "uLayerCount");
+	if (location != -1)
+		glUniform1i(location, terrain->groundLayers != NULL ? terrain->groundLayerCount : 0);
+	if (terrain->groundLayers != NULL)
+	{
+		location = Shader_GetLocation(shader, "uGroundTiling");
+		if (location != -1)
+			glUniform1f(location, terrain->groundTiling);
+		Texture_Bind(terrain->splatMap, 1);
+		Texture_Bind(terrain->groundLayers, 2);
+	}
+
+	GLint patchLocation = Shader_GetLocation(shader, "uPatch");
+	GLint morphLocation = Shader_GetLocation(shader, "uMorph");
+	Mesh_BindBuffer(terrain->grid);
+	for (uint32 i = 0; i < terrain->patchCount; i++)
+	{
+		const Terrain_Patch* patch = &terrain->patches[i];
+		float end = terrain->lodRanges[patch->level];
+		float start = end * TERRAIN_MORPH_START;
+		if (patch->level + 1 == terrain->levelCount)
+			start = TERRAIN_NO_MORPH;
+		glUniform4f(patchLocation, patch->x, patch->z, patch->size, (float)terrain->patchSize);
+		glUniform2f(morphLocation, start, 1.0f / (end - end * TERRAIN_MORPH_START));
+		Mesh_Draw(terrain->grid);
+	}
+	Mesh_UnbindBuffer(terrain->grid);
+}
+
+static void Terrain_MarkSplatDirty(Terrain* terrain, uint32 x0, uint32 z0, uint32 x1, uint32 z1)
+{
+	if (terrain->dirtyMin[0] > x0)
+		terrain->dirtyMin[0] = x0;
+	if (terrain->dirtyMin[1] > z0)
+		terrain->dirtyMin[1] = z0;
+	if (terrain->dirtyMax[0] < x1)
+		terrain->dirtyMax[0] = x1;
+	if (terrain->dirtyMax[1] < z1)
+		terrain->dirtyMax[1] = z1;
+}
+
+void Terrain_SetGroundLayers(Terrain* terrain, Texture* layers, float tiling)
+{
+	terrain->groundLayers = layers;
+	terrain->groundTiling = tiling;
+	if (layers == NULL)
+		return;
+
+	uint32 layerCount = Texture_GetDepth(layers);
+	uint32 channels = (layerCount + 3) & ~3u;
+	terrain->groundLayerCount = layerCount;
+	if (channels == terrain->splatChannels)
+		return;
+
+	// Every weight texel starts fully on the first layer.
+	uint32 texels = terrain->width * terrain->height;
+	terrain->splatChannels = channels;
+	free(terrain->splatWeights);
+	free(terrain->splatScratch);
+	terrain->splatWeights = (uint8*)malloc(texels * channels);
+	terrain->splatScratch = (uint8*)malloc(texels * 4);
+	memset(terrain->splatWeights, 0, texels * channels);
+	for (uint32 i = 0; i < texels; i++)
+	{
+		terrain->splatWeights[i * channels] = 255;
+	}
+
+	if (terrain->splatMap != NULL)
+		Texture_Destroy(terrain->splatMap);
+	Texture_Desc desc =
+	{
+		TEXTURE_2D_ARRAY,
+		TEXTURE_RGBA_8888,
+		terrain->width,
+		terrain->height,
+		channels / 4,
+		1,
+		FILTER_LINEAR,
+		FILTER_LINEAR,
+		WRAP_CLAMP,
+		WRAP_CLAMP
+	};
+	terrain->splatMap = Texture_Create(&desc);
+	Texture_SetData(terrain->splatMap, 0, NULL);
+	terrain->dirtyMin[0] = terrain->dirtyMin[1] = 0;
+	terrain->dirtyMax[0] = terrain->width;
+	terrain->dirtyMax[1] = terrain->height;
+}
+
+void Terrain_SetSplat(Terrain* terrain, uint32 x, uint32 z, uint32 width, uint32 height, const uint8* weights)
+{
+	ASSERT(terrain->splatWeights != NULL);
+	ASSERT(x + width <= terrain->width && z + height <= terrain->height);
+
+	uint32 rowSize = width * terrain->splatChannels;
+	for (uint32 row = 0; row < height; row++)
+	{
+		memcpy(terrain->splatWeights + ((z + row) * terrain->width + x) * terrain->splatChannels, weights + row * rowSize, rowSize);
+	}
+	Terrain_MarkSplatDirty(terrain, x, z, x + width, z + height);
+}
+
+void Terrain_PaintSplat(Terrain* terrain, float x, float z, float radius, uint32 layer, float strength)
+{
+	ASSERT(terrain->splatWeights != NULL && layer < terrain->groundLayerCount);
+
+	float cx = x / terrain->cellSize;
+	float cz = z / terrain->cellSize;
+	float r = radius / terrain->cellSize;
+	int32 x0 = (int32)floorf(cx - r), x1 = (int32)ceilf(cx + r) + 1;
+	int32 z0 = (int32)floorf(cz - r), z1 = (int32)ceilf(cz + r) + 1;
+	x0 = x0 > 0 ? x0 : 0;
+	z0 = z0 > 0 ? z0 : 0;
+	x1 = x1 < (int32)terrain->width ? x1 : (int32)terrain->width;
+	z1 = z1 < (int32)terrain->height ? z1 : (int32)terrain->height;
+	if (x0 >= x1 || z0 >= z1 || r <= 0.0f)
+		return;
+
+	// Other layers fade by the same factor the painted one grows, so the
+	// weights keep summing to one.
+	uint32 channels = terrain->splatChannels;
+	for (int32 tz = z0; tz < z1; tz++)
+	{
+		for (int32 tx = x0; tx < x1; tx++)
+		{
+			float dx = tx - cx;
+			float dz = tz - cz;
+			float distance = sqrtf(dx * dx + dz * dz);
+			if (distance >= r)
+				continue;
+			float amount = strength * (1.0f - distance / r);
+			amount = amount < 1.0f ? amount : 1.0f;
+
+			uint8* weights = terrain->splatWeights + (tz * terrain->width + tx) * channels;
+			for (uint32 c = 0; c < channels; c++)
+			{
+				float weight = weights[c] * (1.0f - amount);
+				if (c == layer)
+					weight += 255.0f * amount;
+				weights[c] = (uint8)(weight + 0.5f);
+			}
+		}
+	}
+	Terrain_MarkSplatDirty(terrain, x0, z0, x1, z1);
+}
+
+void Terrain_FlushSplat(Terrain* terrain)
+{
+	if (terrain->splatMap == NULL || terrain->dirtyMin[0] >= terrain->dirtyMax[0] || terrain->dirtyMin[1] >= terrain->dirtyMax[1])
+		return;
+
+	uint32 x = terrain->dirtyMin[0];
+	uint32 z = terrain->dirtyMin[1];
+	uint32 width = terrain->dirtyMax[0] - x;
+	uint32 height = terrain->dirtyMax[1] - z;
+	uint32 channels = terrain->splatChannels;
+	for (uint32 layer = 0; layer < channels / 4; layer++)
+	{
+		uint8* scratch = terrain->splatScratch;
+		for (uint32 row = 0; row < height; row++)
+		{
+			const uint8* source = terrain->splatWeights + ((z + row) * terrain->width + x) * channels + layer * 4;
+			for (uint32 column = 0; column < width; column++)
+			{
+				memcpy(scratch, source, 4);
+				scratch += 4;
+				source += channels;
+			}
+		}
+		Texture_SetSubData(terrain->splatMap, 0, x, z, layer, width, height, terrain->splatScratch);
+	}
+
+	terrain->dirtyMin[0] = terrain->width;
+	terrain->dirtyMin[1] = terrain->height;
+	terrain->dirtyMax[0] = 0;
+	terrain->dirtyMax[1] = 0;
+}
+
+uint32 Terrain_GetSplatChannelCount(const Terrain* terrain)
+{
+	return terrain->splatChannels;
+}
+
+static float Terrain_Bilinear(const float* row0, const float* row1, float fu, float fv)
+{
+	float h0 = row0[0] + (row0[1] - row0[0]) * fu;
+	float h1 = row1[0] + (row1[1] - row1[0]) * fu;
+	return h0 + (h1 - h0) * fv;
+}
+
+// Bilinear height at a point given in height samples.
+static float Terrain_SampleHeight(const Terrain* terrain, float u, float v)
+{
+	float maxU = (float)(terrain->width - 1);
+	float maxV = (float)(terrain->height - 1);
+	u = u < 0.0f ? 0.0f : (u > maxU ? maxU : u);
+	v = v < 0.0f ? 0.0f : (v > maxV ? maxV : v);
+
+	uint32 x0 = (uint32)u;
+	uint32 z0 = (uint32)v;
+	x0 = x0 < terrain->width - 2 ? x0 : terrain->width - 2;
+	z0 = z0 < terrain->height - 2 ? z0 : terrain->height - 2;
+	float fu = u - x0;
+	float fv = v - z0;
+
+	const float* row0 = terrain->heights + z0 * terrain->width + x0;
+	return Terrain_Bilinear(row0, row0 + terrain->width, fu, fv);
+}
+
+float Terrain_GetHeight(const Terrain* terrain, float x, float z)
+{
+	return Terrain_SampleHeight(terrain, x / terrain->cellSize, z / terrain->cellSize);
+}
+
+#ifdef SIMD_SSE
+// Bilinear heights at four points given in height samples.
+static __m128 Terrain_SampleHeights4(const Terrain* terrain, __m128 u, __m128 v)
+{
+	__m128 zero = _mm_setzero_ps();
+	u = _mm_min_ps(_mm_max_ps(u, zero), _mm_set1_ps((float)(terrain->width - 1)));
+	v = _mm_min_ps(_mm_max_ps(v, zero), _mm_set1_ps((float)(terrain->height - 1)));
+	__m128 x0 = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(u)), _mm_set1_ps((float)(terrain->width - 2)));
+	__m128 z0 = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(v)), _mm_set1_ps((float)(terrain->height - 2)));
+	__m128 fu = _mm_sub_ps(u, x0);
+	__m128 fv = _mm_sub_ps(v, z0);
+
+	int32 offsets[4];
+	float corners[4][4];
+	__m128i offset = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(z0, _mm_set1_ps((float)terrain->width)), x0));
+	_mm_storeu_si128((__m128i*)offsets, offset);
+	for (uint32 lane = 0; lane < 4; lane++)
+	{
+		const float* row0 = terrain->heights + offsets[lane];
+		const float* row1 = row0 + terrain->width;
+		corners[0][lane] = row0[0];
+		corners[1][lane] = row0[1];
+		corners[2][lane] = row1[0];
+		corners[3][lane] = row1[1];
+	}
+
+	__m128 h00 = _mm_loadu_ps(corners[0]);
+	__m128 h10 = _mm_loadu_ps(corners[1]);
+	__m128 h01 = _mm_loadu_ps(corners[2]);
+	__m128 h11 = _mm_loadu_ps(corners[3]);
+	__m128 h0 = _mm_add_ps(h00, _mm_mul_ps(_mm_sub_ps(h10, h00), fu));
+	__m128 h1 = _mm_add_ps(h01, _mm_mul_ps(_mm_sub_ps(h11, h01), fu));
+	return _mm_add_ps(h0, _mm_mul_ps(_mm_sub_ps(h1, h0), fv));
+}
+#endif
+
+void Terrain_GetHeights(const Terrain* terrain, const float* x, const float* z, float* heights, uint32 count)
+{
+	uint32 i = 0;
+#ifdef SIMD_SSE
+	__m128 inverseCell = _mm_set1_ps(1.0f / terrain->cellSize);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 u = _mm_mul_ps(_mm_loadu_ps(x + i), inverseCell);
+		__m128 v = _mm_mul_ps(_mm_loadu_ps(z + i), inverseCell);
+		_mm_storeu_ps(heights + i, Terrain_SampleHeights4(terrain, u, v));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		heights[i] = Terrain_GetHeight(terrain, x[i], z[i]);
+	}
+}
+
+typedef struct Terrain_SightRay
+{
+	float ox;
+	float oz;
+	float dx;
+	float dz;
+	float oy;
+	float dy;
+	float t0;
+	float t1;
+	float inverseDx;
+	float inverseDz;
+	uint32 level;
+} Terrain_SightRay;
+
+// Converts a segment to height samples and clips it to the map. Returns 0
+// when nothing of it lies over the terrain.
+static int Terrain_SetupSightRay(const Terrain* terrain, const float3* from, const float3* to, Terrain_SightRay* ray)
+{
+	float inverseCell = 1.0f / terrain->cellSize;
+	float extents[2] = { (float)(terrain->width - 1), (float)(terrain->height - 1) };
+	float origin[2] = { from->x * inverseCell, from->z * inverseCell };
+	float delta[2] = { (to->x - from->x) * inverseCell, (to->z - from->z) * inverseCell };
+	ray->ox = origin[0];
+	ray->oz = origin[1];
+	ray->dx = delta[0];
+	ray->dz = delta[1];
+	ray->oy = from->y;
+	ray->dy = to->y - from->y;
+	ray->t0 = 0.0f;
+	ray->t1 = 1.0f;
+	ray->inverseDx = delta[0] != 0.0f ? 1.0f / delta[0] : 0.0f;
+	ray->inverseDz = delta[1] != 0.0f ? 1.0f / delta[1] : 0.0f;
+	for (uint32 axis = 0; axis < 2; axis++)
+	{
+		if (delta[axis] == 0.0f)
+		{
+			if (origin[axis] < 0.0f || origin[axis] > extents[axis])
+				return 0;
+			continue;
+		}
+		float entry = -origin[axis] / delta[axis];
+		float departure = (extents[axis] - origin[axis]) / delta[axis];
+		if (entry > departure)
+		{
+			float swap = entry;
+			entry = departure;
+			departure = swap;
+		}
+		ray->t0 = entry > ray->t0 ? entry : ray->t0;
+		ray->t1 = departure < ray->t1 ? departure : ray->t1;
+	}
+	if (ray->t0 >= ray->t1)
+		return 0;
+
+	// Start on the finest level whose nodes are as long as the segment.
+	float span = (fabsf(ray->dx) > fabsf(ray->dz) ? fabsf(ray->dx) : fabsf(ray->dz)) * (ray->t1 - ray->t0);
+	uint32 top = terrain->patchShift + terrain->levelCount - 1;
+	ray->level = 0;
+	while (ray->level < top && (float)(1u << ray->level) < span)
+	{
+		ray->level++;
+	}
+	return 1;
+}
+
+// Finds the node of a level under a point and its height range. Single
+// cells take their range straight from the four corner samples.
+static void Terrain_GetSightNode(const Terrain* terrain, uint32 level, float u, float v, int32* node, float2* range)
+{
+	int32 countX = (int32)((terrain->width - 1 + (1u << level) - 1) >> level);
+	int32 countZ = (int32)((terrain->height - 1 + (1u << level) - 1) >> level);
+	int32 nx = (int32)(u > 0.0f ? u : 0.0f) >> level;
+	int32 nz = (int32)(v > 0.0f ? v : 0.0f) >> level;
+	nx = nx < countX ? nx : countX - 1;
+	nz = nz < countZ ? nz : countZ - 1;
+	node[0] = nx;
+	node[1] = nz;
+
+	if (level == 0)
+	{
+		const float* row0 = terrain->heights + nz * terrain->width + nx;
+		const float* row1 = row0 + terrain->width;
+		float low0 = row0[0] < row0[1] ? row0[0] : row0[1];
+		float low1 = row1[0] < row1[1] ? row1[0] : row1[1];
+		float high0 = row0[0] > row0[1] ? row0[0] : row0[1];
+		float high1 = row1[0] > row1[1] ? row1[0] : row1[1];
+		range->x = low0 < low1 ? low0 : low1;
+		range->y = high0 > high1 ? high0 : high1;
+		return;
+	}
+	const Terrain_Level* nodes = level < terrain->patchShift ? &terrain->sightLevels[level] : &terrain->levels[level - terrain->patchShift];
+	*range = nodes->ranges[nz * nodes->countX + nx];
+}
+
+// Walks the segment through the min/max pyramid: a node the segment passes
+// entirely above is skipped, a node entirely above the segment blocks it,
+// anything else descends. Single cells are tested against the bilinear
+// surface where the segment leaves them and halfway through; the entry
+// point was the previous cell's exit.
+static int Terrain_TraceSight(const Terrain* terrain, const Terrain_SightRay* ray)
+{
+	uint32 top = terrain->patchShift + terrain->levelCount - 1;
+	float nudgeX = ray->dx > 0.0f ? TERRAIN_SIGHT_NUDGE : (ray->dx < 0.0f ? -TERRAIN_SIGHT_NUDGE : 0.0f);
+	float nudgeZ = ray->dz > 0.0f ? TERRAIN_SIGHT_NUDGE : (ray->dz < 0.0f ? -TERRAIN_SIGHT_NUDGE : 0.0f);
+	float t = ray->t0;
+	uint32 level = ray->level;
+	for (uint32 step = 0; step < terrain->sightMaxSteps && t < ray->t1; step++)
+	{
+		int32 node[2];
+		float2 range;
+		Terrain_GetSightNode(terrain, level, ray->ox + ray->dx * t + nudgeX, ray->oz + ray->dz * t + nudgeZ, node, &range);
+
+		float size = (float)(1u << level);
+		float leave = ray->t1;
+		int32 crossed = -1;
+		if (ray->dx != 0.0f)
+		{
+			float tx = ((node[0] + (ray->dx > 0.0f)) * size - ray->ox) * ray->inverseDx;
+			if (tx < leave)
+			{
+				leave = tx;
+				crossed = 0;
+			}
+		}
+		if (ray->dz != 0.0f)
+		{
+			float tz = ((node[1] + (ray->dz > 0.0f)) * size - ray->oz) * ray->inverseDz;
+			if (tz < leave)
+			{
+				leave = tz;
+				crossed = 1;
+			}
+		}
+		leave = leave > t ? leave : t + 1e-6f;
+
+		float y0 = ray->oy + ray->dy * t;
+		float y1 = ray->oy + ray->dy * leave;
+		float low = y0 < y1 ? y0 : y1;
+		float high = y0 > y1 ? y0 : y1;
+		if (low > range.y)
+		{
+			// Climb only when the segment leaves the parent node as well,
+			// otherwise the parent would fail on the part already walked.
+			float direction = crossed == 0 ? ray->dx : ray->dz;
+			if (level < top && crossed >= 0 && (node[crossed] & 1) == (direction > 0.0f))
+				level++;
+			t = leave;
+			continue;
+		}
+		if (high < range.x)
+			return 0;
+		if (level > 0)
+		{
+			level--;
+			continue;
+		}
+
+		const float* row0 = terrain->heights + node[1] * terrain->width + node[0];
+		const float* row1 = row0 + terrain->width;
+		float middle = (t + leave) * 0.5f;
+		float exitHeight = Terrain_Bilinear(row0, row1, ray->ox + ray->dx * leave - node[0], ray->oz + ray->dz * leave - node[1]);
+		float middleHeight = Terrain_Bilinear(row0, row1, ray->ox + ray->dx * middle - node[0], ray->oz + ray->dz * middle - node[1]);
+		if (y1 < exitHeight || ray->oy + ray->dy * middle < middleHeight)
+			return 0;
+		t = leave;
+	}
+	return t >= ray->t1;
+}
+
+#ifdef SIMD_SSE
+static __m128 Terrain_Select4(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static __m128 Terrain_Bilinear4(const __m128* corners, __m128 fu, __m128 fv)
+{
+	__m128 h0 = _mm_add_ps(corners[0], _mm_mul_ps(_mm_sub_ps(corners[1], corners[0]), fu));
+	__m128 h1 = _mm_add_ps(corners[2], _mm_mul_ps(_mm_sub_ps(corners[3], corners[2]), fu));
+	return _mm_add_ps(h0, _mm_mul_ps(_mm_sub_ps(h1, h0), fv));
+}
+
+// Terrain_TraceSight on four rays in lockstep, lanes drop out as they
+// finish. Node lookups are gathered per lane, the rest runs in SSE. Returns
+// the mask of blocked lanes.
+static int Terrain_TraceSight4(const Terrain* terrain, const Terrain_SightRay* rays, int activeLanes)
+{
+	static const int32 LaneMasks[16][4] =
+	{
+		{ 0, 0, 0, 0 }, { -1, 0, 0, 0 }, { 0, -1, 0, 0 }, { -1, -1, 0, 0 },
+		{ 0, 0, -1, 0 }, { -1, 0, -1, 0 }, { 0, -1, -1, 0 }, { -1, -1, -1, 0 },
+		{ 0, 0, 0, -1 }, { -1, 0, 0, -1 }, { 0, -1, 0, -1 }, { -1, -1, 0, -1 },
+		{ 0, 0, -1, -1 }, { -1, 0, -1, -1 }, { 0, -1, -1, -1 }, { -1, -1, -1, -1 }
+	};
+
+	float values[10][4];
+	int32 levels[4];
+	for (uint32 lane = 0; lane < 4; lane++)
+	{
+		const Terrain_SightRay* ray = &rays[lane];
+		values[0][lane] = ray->ox;
+		values[1][lane] = ray->oz;
+		values[2][lane] = ray->dx;
+		values[3][lane] = ray->dz;
+		values[4][lane] = ray->oy;
+		values[5][lane] = ray->dy;
+		values[6][lane] = ray->t0;
+		values[7][lane] = ray->t1;
+		values[8][lane] = ray->inverseDx;
+		values[9][lane] = ray->inverseDz;
+		levels[lane] = (activeLanes >> lane) & 1 ? (int32)ray->level : 0;
+	}
+	__m128 ox = _mm_loadu_ps(values[0]);
+	__m128 oz = _mm_loadu_ps(values[1]);
+	__m128 dx = _mm_loadu_ps(values[2]);
+	__m128 dz = _mm_loadu_ps(values[3]);
+	__m128 oy = _mm_loadu_ps(values[4]);
+	__m128 dy = _mm_loadu_ps(values[5]);
+	__m128 t = _mm_loadu_ps(values[6]);
+	__m128 t1 = _mm_loadu_ps(values[7]);
+	__m128 inverseDx = _mm_loadu_ps(values[8]);
+	__m128 inverseDz = _mm_loadu_ps(values[9]);
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 nudge = _mm_set1_ps(TERRAIN_SIGHT_NUDGE);
+	__m128 forwardX = _mm_cmpgt_ps(dx, zero);
+	__m128 forwardZ = _mm_cmpgt_ps(dz, zero);
+	__m128 flatX = _mm_cmpeq_ps(dx, zero);
+	__m128 flatZ = _mm_cmpeq_ps(dz, zero);
+	__m128 nudgeX = _mm_andnot_ps(flatX, Terrain_Select4(forwardX, nudge, _mm_sub_ps(zero, nudge)));
+	__m128 nudgeZ = _mm_andnot_ps(flatZ, Terrain_Select4(forwardZ, nudge, _mm_sub_ps(zero, nudge)));
+	__m128i stepX = _mm_and_si128(_mm_castps_si128(forwardX), _mm_set1_epi32(1));
+	__m128i stepZ = _mm_and_si128(_mm_castps_si128(forwardZ), _mm_set1_epi32(1));
+	__m128 never = _mm_set1_ps(1e30f);
+	__m128i level = _mm_loadu_si128((const __m128i*)levels);
+	__m128i top = _mm_set1_epi32((int32)(terrain->patchShift + terrain->levelCount - 1));
+	__m128 active = _mm_loadu_ps((const float*)LaneMasks[activeLanes]);
+	__m128 blocked = zero;
+
+	float us[4];
+	float vs[4];
+	int32 nodes[2][4];
+	float ranges[2][4];
+	float corners[4][4];
+	for (uint32 step = 0; step < terrain->sightMaxSteps; step++)
+	{
+		int mask = _mm_movemask_ps(active);
+		if (mask == 0)
+			break;
+
+		_mm_storeu_ps(us, _mm_add_ps(_mm_add_ps(ox, _mm_mul_ps(dx, t)), nudgeX));
+		_mm_storeu_ps(vs, _mm_add_ps(_mm_add_ps(oz, _mm_mul_ps(dz, t)), nudgeZ));
+		_mm_storeu_si128((__m128i*)levels, level);
+		for (uint32 lane = 0; lane < 4; lane++)
+		{
+			int32 node[2] = { 0, 0 };
+			float2 range;
+			range.x = range.y = 0.0f;
+			if ((mask >> lane) & 1)
+			{
+				Terrain_GetSightNode(terrain, levels[lane], us[lane], vs[lane], node, &range);
+				if (levels[lane] == 0)
+				{
+					const float* row0 = terrain->heights + node[1] * terrain->width + node[0];
+					corners[0][lane] = row0[0];
+					corners[1][lane] = row0[1];
+					corners[2][lane] = row0[terrain->width];
+					corners[3][lane] = row0[terrain->width + 1];
+				}
+			}
+			nodes[0][lane] = node[0];
+			nodes[1][lane] = node[1];
+			ranges[0][lane] = range.x;
+			ranges[1][lane] = range.y;
+		}
+
+		// 2^level straight from the exponent bits.
+		__m128 size = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(level, _mm_set1_epi32(127)), 23));
+		__m128i nodeX = _mm_loadu_si128((const __m128i*)nodes[0]);
+		__m128i nodeZ = _mm_loadu_si128((const __m128i*)nodes[1]);
+		__m128 cellX = _mm_cvtepi32_ps(nodeX);
+		__m128 cellZ = _mm_cvtepi32_ps(nodeZ);
+		__m128 tx = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_add_ps(cellX, _mm_and_ps(forwardX, one)), size), ox), inverseDx);
+		__m128 tz = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_add_ps(cellZ, _mm_and_ps(forwardZ, one)), size), oz), inverseDz);
+		tx = Terrain_Select4(flatX, never, tx);
+		tz = Terrain_Select4(flatZ, never, tz);
+		__m128 crossedX = _mm_cmplt_ps(tx, t1);
+		__m128 leave = _mm_min_ps(tx, t1);
+		__m128 crossedZ = _mm_cmplt_ps(tz, leave);
+		crossedX = _mm_andnot_ps(crossedZ, crossedX);
+		leave = _mm_min_ps(tz, leave);
+		leave = _mm_max_ps(leave, _mm_add_ps(t, _mm_set1_ps(1e-6f)));
+
+		__m128 y0 = _mm_add_ps(oy, _mm_mul_ps(dy, t));
+		__m128 y1 = _mm_add_ps(oy, _mm_mul_ps(dy, leave));
+		__m128 clear = _mm_and_ps(_mm_cmpgt_ps(_mm_min_ps(y0, y1), _mm_loadu_ps(ranges[1])), active);
+		__m128 below = _mm_and_ps(_mm_cmplt_ps(_mm_max_ps(y0, y1), _mm_loadu_ps(ranges[0])), active);
+		__m128 undecided = _mm_andnot_ps(_mm_or_ps(clear, below), active);
+		__m128 finest = _mm_castsi128_ps(_mm_cmpeq_epi32(level, _mm_setzero_si128()));
+		__m128 leaf = _mm_and_ps(undecided, finest);
+		__m128 descend = _mm_andnot_ps(finest, undecided);
+
+		__m128 leafBlocked = zero;
+		if (_mm_movemask_ps(leaf) != 0)
+		{
+			__m128 cornerValues[4];
+			for (uint32 c = 0; c < 4; c++)
+			{
+				cornerValues[c] = _mm_loadu_ps(corners[c]);
+			}
+			__m128 middle = _mm_mul_ps(_mm_add_ps(t, leave), _mm_set1_ps(0.5f));
+			__m128 exitHeight = Terrain_Bilinear4(cornerValues, _mm_sub_ps(_mm_add_ps(ox, _mm_mul_ps(dx, leave)), cellX), _mm_sub_ps(_mm_add_ps(oz, _mm_mul_ps(dz, leave)), cellZ));
+			__m128 middleHeight = Terrain_Bilinear4(cornerValues, _mm_sub_ps(_mm_add_ps(ox, _mm_mul_ps(dx, middle)), cellX), _mm_sub_ps(_mm_add_ps(oz, _mm_mul_ps(dz, middle)), cellZ));
+			__m128 ym = _mm_add_ps(oy, _mm_mul_ps(dy, middle));
+			leafBlocked = _mm_and_ps(leaf, _mm_or_ps(_mm_cmplt_ps(y1, exitHeight), _mm_cmplt_ps(ym, middleHeight)));
+		}
+
+		__m128 stop = _mm_or_ps(below, leafBlocked);
+		blocked = _mm_or_ps(blocked, stop);
+		active = _mm_andnot_ps(stop, active);
+
+		__m128 advance = _mm_or_ps(clear, _mm_andnot_ps(leafBlocked, leaf));
+		t = Terrain_Select4(advance, leave, t);
+
+		// Same climbing rule as the scalar walk: the crossed side of the
+		// node must also be a side of its parent.
+		__m128i leavesParentX = _mm_and_si128(_mm_castps_si128(crossedX), _mm_cmpeq_epi32(_mm_and_si128(nodeX, _mm_set1_epi32(1)), stepX));
+		__m128i leavesParentZ = _mm_and_si128(_mm_castps_si128(crossedZ), _mm_cmpeq_epi32(_mm_and_si128(nodeZ, _mm_set1_epi32(1)), stepZ));
+		__m128i climb = _mm_and_si128(_mm_castps_si128(clear), _mm_or_si128(leavesParentX, leavesParentZ));
+		climb = _mm_and_si128(climb, _mm_cmplt_epi32(level, top));
+		level = _mm_add_epi32(_mm_sub_epi32(level, climb), _mm_castps_si128(descend));
+
+		active = _mm_andnot_ps(_mm_cmpge_ps(t, t1), active);
+	}
+	// Lanes still walking ran out of steps.
+	return _mm_movemask_ps(_mm_or_ps(blocked, active));
+}
+#endif
+
+uint32 Terrain_TestLineOfSight(const Terrain* terrain, const float3* from, const float3* to, uint8* visible, uint32 count)
+{
+	uint32 visibleCount = 0;
+	uint32 i = 0;
+#ifdef SIMD_SSE
+	Terrain_SightRay rays[4];
+	for (; i + 4 <= count; i += 4)
+	{
+		int activeLanes = 0;
+		for (uint32 lane = 0; lane < 4; lane++)
+		{
+			if (Terrain_SetupSightRay(terrain, &from[i + lane], &to[i + lane], &rays[lane]))
+				activeLanes |= 1 << lane;
+		}
+		int blocked = activeLanes != 0 ? Terrain_TraceSight4(terrain, rays, activeLanes) : 0;
+		for (uint32 lane = 0; lane < 4; lane++)
+		{
+			visible[i + lane] = (uint8)(((blocked >> lane) & 1) ^ 1);
+			visibleCount += visible[i + lane];
+		}
+	}
+#endif
+	for (; i < count; i++)
+	{
+		Terrain_SightRay ray;
+		visible[i] = (uint8)(!Terrain_SetupSightRay(terrain, &from[i], &to[i], &ray) || Terrain_TraceSight(terrain, &ray));
+		visibleCount += visible[i];
+	}
+	return visibleCount;
+}
+
+typedef struct Terrain_SightRange
+{
+	const Terrain* terrain;
+	const float3* from;
+	const float3* to;
+	uint8* visible;
+	volatile int32 visibleCount;
+} Terrain_SightRange;
+
+static void Terrain_TestSightRange(void* userData, uint32 begin, uint32 end)
+{
+	Terrain_SightRange* range = (Terrain_SightRange*)userData;
+	uint32 count = Terrain_TestLineOfSight(range->terrain, range->from + begin, range->to + begin, range->visible + begin, end - begin);
+	Atomic_Add(&range->visibleCount, (int32)count);
+}
+
+uint32 Terrain_TestLineOfSightJobs(const Terrain* terrain, JobSystem* jobs, const float3* from, const float3* to, uint8* visible, uint32 count)
+{
+	if (jobs == NULL)
+		return Terrain_TestLineOfSight(terrain, from, to, visible, count);
+
+	Terrain_SightRange range = { terrain, from, to, visible, 0 };
+	JobSystem_ParallelFor(jobs, count, TERRAIN_SIGHT_JOB_GRAIN, Terrain_TestSightRange, &range);
+	return (uint32)Atomic_Load(&range.visibleCount);
+}
+
+void Terrain_GetBounds(const Terrain* terrain, Aabb* bounds)
+{
+	// The root level is more than one node when the build stopped at
+	// TERRAIN_MAX_LEVELS.
+	const Terrain_Level* root = &terrain->levels[terrain->levelCount - 1];
+	bounds->min.x = 0.0f;
+	bounds->min.y = root->ranges[0].x;
+	bounds->min.z = 0.0f;
+	bounds->max.x = (terrain->width - 1) * terrain->cellSize;
+	bounds->max.y = root->ranges[0].y;
+	bounds->max.z = (terrain->height - 1) * terrain->cellSize;
+	for (uint32 i = 1; i < root->countX * root->countZ; i++)
+	{
+		if (root->ranges[i].x < bounds->min.y)
+			bounds->min.y = root->ranges[i].x;
+		if (root->ranges[i].y > bounds->max.y)
+			bounds->max.y = root->ranges[i].y;
+	}
+}
+
+uint32 Terrain_GetLevelCount(const Terrain* terrain)
+{
+	return terrain->levelCount;
+}
+
+Texture* Terrain_GetHeightTexture(const Terrain* terrain)
+{
+	return terrain->heightTexture;
+}
+
+void Terrain_GetStats(const Terrain* terrain, Terrain_Stats* stats)
+{
+	stats->patchCount = terrain->patchCount;
+	stats->culledCount = terrain->culledCount;
+	stats->triangleCount = terrain->patchCount * terrain->patchSize * terrain->patchSize * 2;
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#ifndef __TERRAIN_H__
+#define __TERRAIN_H__
+
+#include "config.h"
+#include "maths.h"
+#include "material.h"
+#include "texture.h"
+#include "job_system.h"
+
+// Heightmap terrain drawn with continuous distance-based LOD (CDLOD). Every
+// patch is the same grid mesh, displaced in the vertex shader from a R32F
+// height texture and morphed towards the next coarser grid before it hands
+// over to it. Visible patches are selected through a min/max height
+// quadtree. The heights stay on the CPU too, so gameplay queries read the
+// same data the renderer displays.
+//
+// Ground textures live in one TEXTURE_2D_ARRAY and are blended in a single
+// pass from a splat map holding one weight per layer and height sample.
+// Painting only touches a rectangle of the CPU copy; the dirty rectangle is
+// uploaded with Texture_SetSubData before the next draw.
+//
+// Shadows are received from a ShadowMap bound to TERRAIN_SHADOW_UNIT, fog of
+// war from a FogOfWar bound to TERRAIN_FOG_OF_WAR_UNIT and baked tracks from
+// a DecalSystem bound to TERRAIN_TRACK_UNIT.
+typedef struct Terrain Terrain;
+
+#define TERRAIN_SHADOW_UNIT 3
+#define TERRAIN_FOG_OF_WAR_UNIT 4
+#define TERRAIN_TRACK_UNIT 5
+
+typedef struct Terrain_Desc
+{
+	uint32 width;
+	uint32 height;
+	const float* heights;
+	float cellSize;
+	uint32 patchSize;
+	float lodDistance;
+} Terrain_Desc;
+
+typedef struct Terrain_Stats
+{
+	uint32 patchCount;
+	uint32 culledCount;
+	uint32 triangleCount;
+} Terrain_Stats;
+
+Terrain* Terrain_Create(const Terrain_Desc* terrain_desc);
+void Terrain_Destroy(Terrain* terrain);
+
+uint32 Terrain_Select(Terrain* terrain, const matrix4x4* viewProjection, const float3* eye);
+void Terrain_Draw(Terrain* terrain, Material* material);
+
+void Terrain_SetGroundLayers(Terrain* terrain, Texture* layers, float tiling);
+void Terrain_SetSplat(Terrain* terrain, uint32 x, uint32 z, uint32 width, uint32 height, const uint8* weights);
+void Terrain_PaintSplat(Terrain* terrain, float x, float z, float radius, uint32 layer, float strength);
+void Terrain_FlushSplat(Terrain* terrain);
+uint32 Terrain_GetSplatChannelCount(const Terrain* terrain);
+
+float Terrain_GetHeight(const Terrain* terrain, float x, float z);
+void Terrain_GetHeights(const Terrain* terrain, const float* x, const float* z, float* heights, uint32 count);
+// Writes 1 for every pair whose segment stays above the terrain, 0 when the
+// terrain blocks it, and returns the number of clear pairs. Lift the points
+// to eye and target height first. Only reads the terrain, so threads may
+// test disjoint ranges concurrently.
+uint32 Terrain_TestLineOfSight(const Terrain* terrain, const float3* from, const float3* to, uint8* visible, uint32 count);
+// Splits the pairs into ranges on the job system (NULL for the calling
+// thread); the calling thread must belong to it.
+uint32 Terrain_TestLineOfSightJobs(const Terrain* terrain, JobSystem* jobs, const float3* from, const float3* to, uint8* visible, uint32 count);
+void Terrain_GetBounds(const Terrain* terrain, Aabb* bounds);
+uint32 Terrain_GetLevelCount(const Terrain* terrain);
+Texture* Terrain_GetHeightTexture(const Terrain* terrain);
+void Terrain_GetStats(const Terrain* terrain, Terrain_Stats* stats);
+
+#endif
\ No newline at end of file
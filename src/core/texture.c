@@ -4,9 +4,12 @@
 struct Texture
 {
 	GLenum type;
+	GLenum internalFormat;
 	GLenum format;
+	GLenum dataType;
 	GLuint width;
 	GLuint height;
+	GLuint depth;
 	GLuint mipmapLevelCount;
 	GLenum minFilter;
 	GLenum magFilter;
@@ -20,18 +23,58 @@ GLenum Texture_ToGLenum(int value)
 	case TEXTURE_2D: return GL_TEXTURE_2D;
 	case TEXTURE_3D: return GL_TEXTURE_3D;
 	case TEXTURE_CUBE: return GL_TEXTURE_CUBE_MAP;
+	case TEXTURE_2D_ARRAY: return GL_TEXTURE_2D_ARRAY;
 	case TEXTURE_ALPHA_8: return GL_ALPHA;
 	case TEXTURE_LUMINANCE_ALPHA_88: return GL_LUMINANCE_ALPHA;
 	case TEXTURE_RGB_888: return GL_RGB;
 	case TEXTURE_RGBA_8888: return GL_RGBA;
+	case TEXTURE_R_32F: return GL_RED;
+	case TEXTURE_DEPTH_32F: return GL_DEPTH_COMPONENT;
+	case TEXTURE_R_32UI: return GL_RED_INTEGER;
+	case TEXTURE_R_16UI: return GL_RED_INTEGER;
+	case TEXTURE_RGBA_32F: return GL_RGBA;
+	case TEXTURE_R_8: return GL_RED;
 	case FILTER_POINT: return GL_NEAREST;
 	case FILTER_LINEAR: return GL_LINEAR;
 	case FILTER_BILINEAR: return GL_LINEAR_MIPMAP_NEAREST;
 	case FILTER_TRILLINEAR: return GL_LINEAR_MIPMAP_LINEAR;
+	case FILTER_POINT_MIPMAP: return GL_NEAREST_MIPMAP_NEAREST;
 	case WRAP_REPEAT: return GL_REPEAT;
 	case WRAP_CLAMP: return GL_CLAMP;
 	default: break;
 	}
+	return 0;
+}
+
+static GLenum Texture_ToInternalFormat(Texture_Format format)
+{
+	switch (format)
+	{
+	case TEXTURE_R_32F: return GL_R32F;
+	case TEXTURE_DEPTH_32F: return GL_DEPTH_COMPONENT32F;
+	case TEXTURE_R_32UI: return GL_R32UI;
+	case TEXTURE_R_16UI: return GL_R16UI;
+	case TEXTURE_RGBA_32F: return GL_RGBA32F;
+	case TEXTURE_R_8: return GL_R8;
+	default: return Texture_ToGLenum(format);
+	}
+}
+
+static GLenum Texture_ToDataType(Texture_Format format)
+{
+	switch (format)
+	{
+	case TEXTURE_R_32F:
+	case TEXTURE_DEPTH_32F:
+	case TEXTURE_RGBA_32F:
+		return GL_FLOAT;
+	case TEXTURE_R_32UI:
+		return GL_UNSIGNED_INT;
+	case TEXTURE_R_16UI:
+		return GL_UNSIGNED_SHORT;
+	default:
+		return GL_UNSIGNED_BYTE;
+	}
 }
 
 Texture* Texture_Create(const Texture_Desc* texture_desc)
@@ -53,12 +96,27 @@ void Texture_SetData(Texture* texture, uint32 mipmapLevel, const void* data)
 {
 	ASSERT(texture->mipmapLevelCount > mipmapLevel || mipmapLevel == 0);
 
+	GLuint width = texture->width >> mipmapLevel;
+	GLuint height = texture->height >> mipmapLevel;
+	GLuint depth = texture->type == GL_TEXTURE_3D ? texture->depth >> mipmapLevel : texture->depth;
+	width = width > 0 ? width : 1;
+	height = height > 0 ? height : 1;
+	depth = depth > 0 ? depth : 1;
+
 	glBindTexture(texture->type, texture->id);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	switch (texture->type)
 	{
 	case GL_TEXTURE_2D:
 	{
-		glTexImage2D(GL_TEXTURE_2D, mipmapLevel, texture->format, texture->width, texture->height, 0, texture->format, GL_UNSIGNED_BYTE, data);
+		glTexImage2D(GL_TEXTURE_2D, mipmapLevel, texture->internalFormat, width, height, 0, texture->format, texture->dataType, data);
+		break;
+	}
+	case GL_TEXTURE_3D:
+	case GL_TEXTURE_2D_ARRAY:
+	{
+		glTexImage3D(texture->type, mipmapLevel, texture->internalFormat, width, height, depth, 0, texture->format, texture->dataType, data);
+		break;
 	}
 	case GL_TEXTURE_CUBE_MAP:
 	{
@@ -67,6 +125,40 @@ void Texture_SetData(Texture* texture, uint32 mipmapLevel, const void* data)
 	default:
 		break;
 	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (mipmapLevel == 0 && texture->mipmapLevelCount == 0 && (texture->minFilter > GL_LINEAR || texture->magFilter > GL_LINEAR))
+	{
+		glGenerateMipmap(texture->type);
+	}
+	glBindTexture(texture->type, 0);
+}
+
+void Texture_SetSubData(Texture* texture, uint32 mipmapLevel, uint32 x, uint32 y, uint32 layer, uint32 width, uint32 height, const void* data)
+{
+	ASSERT(texture->mipmapLevelCount > mipmapLevel || mipmapLevel == 0);
+	ASSERT(x + width <= (texture->width >> mipmapLevel > 0 ? texture->width >> mipmapLevel : 1));
+	ASSERT(y + height <= (texture->height >> mipmapLevel > 0 ? texture->height >> mipmapLevel : 1));
+
+	glBindTexture(texture->type, texture->id);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	switch (texture->type)
+	{
+	case GL_TEXTURE_2D:
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, mipmapLevel, x, y, width, height, texture->format, texture->dataType, data);
+		break;
+	}
+	case GL_TEXTURE_3D:
+	case GL_TEXTURE_2D_ARRAY:
+	{
+		ASSERT(layer < texture->depth);
+		glTexSubImage3D(texture->type, mipmapLevel, x, y, layer, width, height, 1, texture->format, texture->dataType, data);
+		break;
+	}
+	default:
+		break;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 	if (mipmapLevel == 0 && texture->mipmapLevelCount == 0 && (texture->minFilter > GL_LINEAR || texture->magFilter > GL_LINEAR))
 	{
 		glGenerateMipmap(texture->type);
@@ -87,15 +179,49 @@ void Texture_Apply(Texture* texture, const Texture_Desc* texture_desc)
 		glTexParameteri(type, GL_TEXTURE_MAX_LEVEL, texture_desc->mipmapLevelCount - 1);
 	glTexParameteri(type, GL_TEXTURE_WRAP_S, Texture_ToGLenum(texture_desc->wrapS));
 	glTexParameteri(type, GL_TEXTURE_WRAP_T, Texture_ToGLenum(texture_desc->wrapT));
-	glTexParameteri(type, GL_TEXTURE_MIN_FILTER, Texture_ToGLenum(minFilter));
-	glTexParameteri(type, GL_TEXTURE_MAG_FILTER, Texture_ToGLenum(magFilter));
+	glTexParameteri(type, GL_TEXTURE_MIN_FILTER, minFilter);
+	glTexParameteri(type, GL_TEXTURE_MAG_FILTER, magFilter);
 	glBindTexture(type, 0);
 
 	texture->type = type;
+	texture->internalFormat = Texture_ToInternalFormat(texture_desc->format);
 	texture->format = Texture_ToGLenum(texture_desc->format);
+	texture->dataType = Texture_ToDataType(texture_desc->format);
 	texture->width = texture_desc->width;
 	texture->height = texture_desc->height;
+	texture->depth = texture_desc->depth > 0 ? texture_desc->depth : 1;
 	texture->mipmapLevelCount = texture_desc->mipmapLevelCount;
 	texture->minFilter = minFilter;
 	texture->magFilter = magFilter;
+}
+
+void Texture_Bind(const Texture* texture, uint32 unit)
+{
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(texture->type, texture->id);
+}
+
+uint32 Texture_GetHandle(const Texture* texture)
+{
+	return texture->id;
+}
+
+uint32 Texture_GetTarget(const Texture* texture)
+{
+	return texture->type;
+}
+
+uint32 Texture_GetWidth(const Texture* texture)
+{
+	return texture->width;
+}
+
+uint32 Texture_GetHeight(const Texture* texture)
+{
+	return texture->height;
+}
+
+uint32 Texture_GetDepth(const Texture* texture)
+{
+	return texture->depth;
 }
\ No newline at end of file
@@ -9,6 +9,7 @@ typedef struct Texture_Desc
 	Texture_Format format;
 	uint32 width;
 	uint32 height;
+	uint32 depth;
 	uint32 mipmapLevelCount;
 	Texture_Filter minFilter;
 	Texture_Filter magFilter;
@@ -21,6 +22,14 @@ typedef struct Texture Texture;
 Texture* Texture_Create(const Texture_Desc* texture_desc);
 void Texture_Destroy(Texture* texture);
 void Texture_SetData(Texture* texture, uint32 mipmapLevel, const void* data);
+void Texture_SetSubData(Texture* texture, uint32 mipmapLevel, uint32 x, uint32 y, uint32 layer, uint32 width, uint32 height, const void* data);
 void Texture_Apply(Texture* texture, const Texture_Desc* texture_desc);
+void Texture_Bind(const Texture* texture, uint32 unit);
+
+uint32 Texture_GetHandle(const Texture* texture);
+uint32 Texture_GetTarget(const Texture* texture);
+uint32 Texture_GetWidth(const Texture* texture);
+uint32 Texture_GetHeight(const Texture* texture);
+uint32 Texture_GetDepth(const Texture* texture);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,293 @@
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "thread.h"
+
+#ifdef _WIN32
+#include <windows.h>
+
+struct Thread
+{
+	HANDLE handle;
+	Thread_Function function;
+	void* userData;
+};
+
+struct Mutex
+{
+	CRITICAL_SECTION section;
+};
+
+struct Condition
+{
+	CONDITION_VARIABLE variable;
+};
+
+static DWORD WINAPI Thread_Entry(LPVOID parameter)
+{
+	Thread* thread = (Thread*)parameter;
+	thread->function(thread->userData);
+	return 0;
+}
+
+Thread* Thread_Create(Thread_Function function, void* userData)
+{
+	Thread* thread = (Thread*)malloc(sizeof(Thread));
+	thread->function = function;
+	thread->userData = userData;
+	thread->handle = CreateThread(NULL, 0, Thread_Entry, thread, 0, NULL);
+	if (thread->handle == NULL)
+	{
+		LOG_E("Cannot create thread\n");
+		free(thread);
+		return NULL;
+	}
+	return thread;
+}
+
+void Thread_Join(Thread* thread)
+{
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+	free(thread);
+}
+
+uint32 Thread_GetProcessorCount()
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (uint32)info.dwNumberOfProcessors : 1;
+}
+
+void Thread_Yield()
+{
+	SwitchToThread();
+}
+
+void Thread_Pause()
+{
+	YieldProcessor();
+}
+
+Mutex* Mutex_Create()
+{
+	Mutex* mutex = (Mutex*)malloc(sizeof(Mutex));
+	InitializeCriticalSection(&mutex->section);
+	return mutex;
+}
+
+void Mutex_Destroy(Mutex* mutex)
+{
+	DeleteCriticalSection(&mutex->section);
+	free(mutex);
+}
+
+void Mutex_Lock(Mutex* mutex)
+{
+	EnterCriticalSection(&mutex->section);
+}
+
+void Mutex_Unlock(Mutex* mutex)
+{
+	LeaveCriticalSection(&mutex->section);
+}
+
+Condition* Condition_Create()
+{
+	Condition* condition = (Condition*)malloc(sizeof(Condition));
+	InitializeConditionVariable(&condition->variable);
+	return condition;
+}
+
+void Condition_Destroy(Condition* condition)
+{
+	free(condition);
+}
+
+void Condition_Wait(Condition* condition, Mutex* mutex)
+{
+	SleepConditionVariableCS(&condition->variable, &mutex->section, INFINITE);
+}
+
+void Condition_Signal(Condition* condition)
+{
+	WakeConditionVariable(&condition->variable);
+}
+
+void Condition_Broadcast(Condition* condition)
+{
+	WakeAllConditionVariable(&condition->variable);
+}
+
+int32 Atomic_Load(const volatile int32* value)
+{
+	// Aligned loads are atomic on x86 and volatile reads are acquires under
+	// MSVC; stores go through interlocked instructions, which keeps the
+	// whole set sequentially consistent.
+	return *value;
+}
+
+void Atomic_Store(volatile int32* value, int32 desired)
+{
+	InterlockedExchange((volatile LONG*)value, desired);
+}
+
+int32 Atomic_Exchange(volatile int32* value, int32 desired)
+{
+	return InterlockedExchange((volatile LONG*)value, desired);
+}
+
+int32 Atomic_Add(volatile int32* value, int32 amount)
+{
+	return InterlockedExchangeAdd((volatile LONG*)value, amount) + amount;
+}
+
+int32 Atomic_CompareExchange(volatile int32* value, int32 expected, int32 desired)
+{
+	return InterlockedCompareExchange((volatile LONG*)value, desired, expected);
+}
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+struct Thread
+{
+	pthread_t handle;
+	Thread_Function function;
+	void* userData;
+};
+
+struct Mutex
+{
+	pthread_mutex_t mutex;
+};
+
+struct Condition
+{
+	pthread_cond_t condition;
+};
+
+static void* Thread_Entry(void* parameter)
+{
+	Thread* thread = (Thread*)parameter;
+	thread->function(thread->userData);
+	return NULL;
+}
+
+Thread* Thread_Create(Thread_Function function, void* userData)
+{
+	Thread* thread = (Thread*)malloc(sizeof(Thread));
+	thread->function = function;
+	thread->userData = userData;
+	if (pthread_create(&thread->handle, NULL, Thread_Entry, thread) != 0)
+	{
+		LOG_E("Cannot create thread\n");
+		free(thread);
+		return NULL;
+	}
+	return thread;
+}
+
+void Thread_Join(Thread* thread)
+{
+	pthread_join(thread->handle, NULL);
+	free(thread);
+}
+
+uint32 Thread_GetProcessorCount()
+{
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (uint32)count : 1;
+}
+
+void Thread_Yield()
+{
+	sched_yield();
+}
+
+void Thread_Pause()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#endif
+}
+
+Mutex* Mutex_Create()
+{
+	Mutex* mutex = (Mutex*)malloc(sizeof(Mutex));
+	pthread_mutex_init(&mutex->mutex, NULL);
+	return mutex;
+}
+
+void Mutex_Destroy(Mutex* mutex)
+{
+	pthread_mutex_destroy(&mutex->mutex);
+	free(mutex);
+}
+
+void Mutex_Lock(Mutex* mutex)
+{
+	pthread_mutex_lock(&mutex->mutex);
+}
+
+void Mutex_Unlock(Mutex* mutex)
+{
+	pthread_mutex_unlock(&mutex->mutex);
+}
+
+Condition* Condition_Create()
+{
+	Condition* condition = (Condition*)malloc(sizeof(Condition));
+	pthread_cond_init(&condition->condition, NULL);
+	return condition;
+}
+
+void Condition_Destroy(Condition* condition)
+{
+	pthread_cond_destroy(&condition->condition);
+	free(condition);
+}
+
+void Condition_Wait(Condition* condition, Mutex* mutex)
+{
+	pthread_cond_wait(&condition->condition, &mutex->mutex);
+}
+
+void Condition_Signal(Condition* condition)
+{
+	pthread_cond_signal(&condition->condition);
+}
+
+void Condition_Broadcast(Condition* condition)
+{
+	pthread_cond_broadcast(&condition->condition);
+}
+
+int32 Atomic_Load(const volatile int32* value)
+{
+	return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+}
+
+void Atomic_Store(volatile int32* value, int32 desired)
+{
+	__atomic_store_n(value, desired, __ATOMIC_SEQ_CST);
+}
+
+int32 Atomic_Exchange(volatile int32* value, int32 desired)
+{
+	return __atomic_exchange_n(value, desired, __ATOMIC_SEQ_CST);
+}
+
+int32 Atomic_Add(volatile int32* value, int32 amount)
+{
+	return __atomic_add_fetch(value, amount, __ATOMIC_SEQ_CST);
+}
+
+int32 Atomic_CompareExchange(volatile int32* value, int32 expected, int32 desired)
+{
+	__atomic_compare_exchange_n(value, &expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	return expected;
+}
+#endif
\ No newline at end of file
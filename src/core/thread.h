@@ -0,0 +1,49 @@
+#ifndef __THREAD_H__
+#define __THREAD_H__
+
+#include "config.h"
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+// Thin wrappers over Win32 and pthreads threads, mutexes, condition
+// variables and 32-bit atomics. Every atomic is sequentially consistent.
+typedef struct Thread Thread;
+typedef struct Mutex Mutex;
+typedef struct Condition Condition;
+
+typedef void (*Thread_Function)(void* userData);
+
+Thread* Thread_Create(Thread_Function function, void* userData);
+// Waits for the thread to return and frees it.
+void Thread_Join(Thread* thread);
+uint32 Thread_GetProcessorCount();
+void Thread_Yield();
+// Spin-wait hint for busy loops.
+void Thread_Pause();
+
+Mutex* Mutex_Create();
+void Mutex_Destroy(Mutex* mutex);
+void Mutex_Lock(Mutex* mutex);
+void Mutex_Unlock(Mutex* mutex);
+
+Condition* Condition_Create();
+void Condition_Destroy(Condition* condition);
+// The mutex must be locked; it is released while waiting. Wake-ups may be
+// spurious, so always wait in a loop over the actual predicate.
+void Condition_Wait(Condition* condition, Mutex* mutex);
+void Condition_Signal(Condition* condition);
+void Condition_Broadcast(Condition* condition);
+
+int32 Atomic_Load(const volatile int32* value);
+void Atomic_Store(volatile int32* value, int32 desired);
+int32 Atomic_Exchange(volatile int32* value, int32 desired);
+// Returns the new value.
+int32 Atomic_Add(volatile int32* value, int32 amount);
+// Returns the value found, the store happened when it equals expected.
+int32 Atomic_CompareExchange(volatile int32* value, int32 expected, int32 desired);
+
+#endif
\ No newline at end of file
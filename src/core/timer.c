@@ -0,0 +1,30 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include "timer.h"
+
+#ifdef _WIN32
+#include <windows.h>
+
+double Timer_GetMilliseconds()
+{
+	static LARGE_INTEGER frequency = { 0 };
+	LARGE_INTEGER counter;
+	if (frequency.QuadPart == 0)
+	{
+		QueryPerformanceFrequency(&frequency);
+	}
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart * 1000.0 / (double)frequency.QuadPart;
+}
+#else
+#include <time.h>
+
+double Timer_GetMilliseconds()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec * 1000.0 + (double)now.tv_nsec / 1000000.0;
+}
+#endif
\ No newline at end of file
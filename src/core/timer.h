@@ -0,0 +1,9 @@
+#ifndef __TIMER_H__
+#define __TIMER_H__
+
+#include "config.h"
+
+// Monotonic time in milliseconds, for profiling and frame pacing.
+double Timer_GetMilliseconds();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,405 @@
+#include "tlsf.h"
+#include <string.h>
+
+#define TLSF_SL_LOG2 4
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+#define TLSF_FL_COUNT 32
+
+typedef enum Tlsf_BlockState
+{
+	BLOCK_FREE = 0,
+	BLOCK_USED = 1,
+	BLOCK_UNUSED = 2
+} Tlsf_BlockState;
+
+typedef struct Tlsf_Block
+{
+	uint32 offset;
+	uint32 size;
+	uint32 prevPhysical;
+	uint32 nextPhysical;
+	uint32 prevFree;
+	uint32 nextFree;
+	uint32 state;
+} Tlsf_Block;
+
+struct Tlsf
+{
+	uint32 capacity;
+	uint32 usedSize;
+	uint32 flBitmap;
+	uint32 slBitmap[TLSF_FL_COUNT];
+	uint32 heads[TLSF_FL_COUNT][TLSF_SL_COUNT];
+	Tlsf_Block* blocks;
+	uint32 blockCount;
+	uint32 blockCapacity;
+	uint32 unusedBlocks;
+	uint32 firstPhysical;
+	uint32 lastPhysical;
+};
+
+static uint32 Tlsf_FindLastSet(uint32 value)
+{
+	uint32 bit = 0;
+	while (value >>= 1)
+		bit++;
+	return bit;
+}
+
+static uint32 Tlsf_FindFirstSet(uint32 value)
+{
+	uint32 bit = 0;
+	while ((value & 1) == 0)
+	{
+		value >>= 1;
+		bit++;
+	}
+	return bit;
+}
+
+static void Tlsf_MappingInsert(uint32 size, uint32* fl, uint32* sl)
+{
+	if (size < TLSF_SL_COUNT)
+	{
+		*fl = 0;
+		*sl = size;
+	}
+	else
+	{
+		uint32 f = Tlsf_FindLastSet(size);
+		*sl = (size >> (f - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+		*fl = f - TLSF_SL_LOG2 + 1;
+	}
+}
+
+static void Tlsf_MappingSearch(uint32 size, uint32* fl, uint32* sl)
+{
+	if (size >= TLSF_SL_COUNT)
+	{
+		uint32 round = (1 << (Tlsf_FindLastSet(size) - TLSF_SL_LOG2)) - 1;
+		if (size <= 0xffffffff - round)
+			size += round;
+	}
+	Tlsf_MappingInsert(size, fl, sl);
+}
+
+static uint32 Tlsf_NewBlock(Tlsf* tlsf)
+{
+	uint32 index;
+	if (tlsf->unusedBlocks != TLSF_INVALID)
+	{
+		index = tlsf->unusedBlocks;
+		tlsf->unusedBlocks = tlsf->blocks[index].nextFree;
+	}
+	else
+	{
+		if (tlsf->blockCount == tlsf->blockCapacity)
+		{
+			tlsf->blockCapacity = tlsf->blockCapacity * 2;
+			tlsf->blocks = (Tlsf_Block*)realloc(tlsf->blocks, sizeof(Tlsf_Block) * tlsf->blockCapacity);
+		}
+		index = tlsf->blockCount++;
+	}
+
+	Tlsf_Block* block = &tlsf->blocks[index];
+	block->offset = 0;
+	block->size = 0;
+	block->prevPhysical = TLSF_INVALID;
+	block->nextPhysical = TLSF_INVALID;
+	block->prevFree = TLSF_INVALID;
+	block->nextFree = TLSF_INVALID;
+	block->state = BLOCK_FREE;
+	return index;
+}
+
+static void Tlsf_ReleaseBlock(Tlsf* tlsf, uint32 index)
+{
+	tlsf->blocks[index].state = BLOCK_UNUSED;
+	tlsf->blocks[index].nextFree = tlsf->unusedBlocks;
+	tlsf->unusedBlocks = index;
+}
+
+static void Tlsf_InsertFree(Tlsf* tlsf, uint32 index)
+{
+	Tlsf_Block* block = &tlsf->blocks[index];
+	uint32 fl, sl;
+	Tlsf_MappingInsert(block->size, &fl, &sl);
+
+	block->state = BLOCK_FREE;
+	block->prevFree = TLSF_INVALID;
+	block->nextFree = tlsf->heads[fl][sl];
+	if (block->nextFree != TLSF_INVALID)
+		tlsf->blocks[block->nextFree].prevFree = index;
+	tlsf->heads[fl][sl] = index;
+	tlsf->flBitmap |= 1 << fl;
+	tlsf->slBitmap[fl] |= 1 << sl;
+}
+
+static void Tlsf_RemoveFree(Tlsf* tlsf, uint32 index)
+{
+	Tlsf_Block* block = &tlsf->blocks[index];
+	uint32 fl, sl;
+	Tlsf_MappingInsert(block->size, &fl, &sl);
+
+	if (block->prevFree != TLSF_INVALID)
+		tlsf->blocks[block->prevFree].nextFree = block->nextFree;
+	if (block->nextFree != TLSF_INVALID)
+		tlsf->blocks[block->nextFree].prevFree = block->prevFree;
+	if (tlsf->heads[fl][sl] == index)
+	{
+		tlsf->heads[fl][sl] = block->nextFree;
+		if (block->nextFree == TLSF_INVALID)
+		{
+			tlsf->slBitmap[fl] &= ~(1 << sl);
+			if (tlsf->slBitmap[fl] == 0)
+				tlsf->flBitmap &= ~(1 << fl);
+		}
+	}
+	block->prevFree = TLSF_INVALID;
+	block->nextFree = TLSF_INVALID;
+}
+
+static uint32 Tlsf_FindSuitable(const Tlsf* tlsf, uint32 fl, uint32 sl)
+{
+	if (fl >= TLSF_FL_COUNT)
+		return TLSF_INVALID;
+
+	uint32 slMap = tlsf->slBitmap[fl] & (0xffffffff << sl);
+	if (slMap == 0)
+	{
+		uint32 flMap = fl + 1 < TLSF_FL_COUNT ? tlsf->flBitmap & (0xffffffff << (fl + 1)) : 0;
+		if (flMap == 0)
+			return TLSF_INVALID;
+		fl = Tlsf_FindFirstSet(flMap);
+		slMap = tlsf->slBitmap[fl];
+	}
+	sl = Tlsf_FindFirstSet(slMap);
+	return tlsf->heads[fl][sl];
+}
+
+static void Tlsf_ResetLists(Tlsf* tlsf)
+{
+	tlsf->flBitmap = 0;
+	memset(tlsf->slBitmap, 0, sizeof(tlsf->slBitmap));
+	memset(tlsf->heads, 0xff, sizeof(tlsf->heads));
+}
+
+Tlsf* Tlsf_Create(uint32 capacity)
+{
+	ASSERT(capacity > 0);
+	Tlsf* tlsf = (Tlsf*)malloc(sizeof(Tlsf));
+	tlsf->capacity = capacity;
+	tlsf->usedSize = 0;
+	tlsf->blockCount = 0;
+	tlsf->blockCapacity = 64;
+	tlsf->blocks = (Tlsf_Block*)malloc(sizeof(Tlsf_Block) * tlsf->blockCapacity);
+	tlsf->unusedBlocks = TLSF_INVALID;
+	Tlsf_ResetLists(tlsf);
+
+	uint32 index = Tlsf_NewBlock(tlsf);
+	tlsf->blocks[index].size = capacity;
+	tlsf->firstPhysical = index;
+	tlsf->lastPhysical = index;
+	Tlsf_InsertFree(tlsf, index);
+	return tlsf;
+}
+
+void Tlsf_Destroy(Tlsf* tlsf)
+{
+	free(tlsf->blocks);
+	free(tlsf);
+}
+
+uint32 Tlsf_Allocate(Tlsf* tlsf, uint32 size)
+{
+	if (size == 0)
+		size = 1;
+
+	uint32 fl, sl;
+	Tlsf_MappingSearch(size, &fl, &sl);
+	uint32 index = Tlsf_FindSuitable(tlsf, fl, sl);
+	if (index == TLSF_INVALID)
+		return TLSF_INVALID;
+
+	Tlsf_RemoveFree(tlsf, index);
+
+	if (tlsf->blocks[index].size > size)
+	{
+		uint32 rest = Tlsf_NewBlock(tlsf);
+		Tlsf_Block* block = &tlsf->blocks[index];
+		Tlsf_Block* remainder = &tlsf->blocks[rest];
+		remainder->offset = block->offset + size;
+		remainder->size = block->size - size;
+		remainder->prevPhysical = index;
+		remainder->nextPhysical = block->nextPhysical;
+		if (block->nextPhysical != TLSF_INVALID)
+			tlsf->blocks[block->nextPhysical].prevPhysical = rest;
+		else
+			tlsf->lastPhysical = rest;
+		block->nextPhysical = rest;
+		block->size = size;
+		Tlsf_InsertFree(tlsf, rest);
+	}
+
+	tlsf->blocks[index].state = BLOCK_USED;
+	tlsf->usedSize += size;
+	return index;
+}
+
+void Tlsf_Free(Tlsf* tlsf, uint32 handle)
+{
+	if (handle == TLSF_INVALID)
+		return;
+	ASSERT(handle < tlsf->blockCount && tlsf->blocks[handle].state == BLOCK_USED);
+
+	Tlsf_Block* block = &tlsf->blocks[handle];
+	tlsf->usedSize -= block->size;
+
+	uint32 prev = block->prevPhysical;
+	if (prev != TLSF_INVALID && tlsf->blocks[prev].state == BLOCK_FREE)
+	{
+		Tlsf_RemoveFree(tlsf, prev);
+		tlsf->blocks[prev].size += block->size;
+		tlsf->blocks[prev].nextPhysical = block->nextPhysical;
+		if (block->nextPhysical != TLSF_INVALID)
+			tlsf->blocks[block->nextPhysical].prevPhysical = prev;
+		else
+			tlsf->lastPhysical = prev;
+		Tlsf_ReleaseBlock(tlsf, handle);
+		handle = prev;
+		block = &tlsf->blocks[handle];
+	}
+
+	uint32 next = block->nextPhysical;
+	if (next != TLSF_INVALID && tlsf->blocks[next].state == BLOCK_FREE)
+	{
+		Tlsf_RemoveFree(tlsf, next);
+		block->size += tlsf->blocks[next].size;
+		block->nextPhysical = tlsf->blocks[next].nextPhysical;
+		if (block->nextPhysical != TLSF_INVALID)
+			tlsf->blocks[block->nextPhysical].prevPhysical = handle;
+		else
+			tlsf->lastPhysical = handle;
+		Tlsf_ReleaseBlock(tlsf, next);
+	}
+
+	Tlsf_InsertFree(tlsf, handle);
+}
+
+uint32 Tlsf_GetOffset(const Tlsf* tlsf, uint32 handle)
+{
+	ASSERT(handle < tlsf->blockCount);
+	return tlsf->blocks[handle].offset;
+}
+
+uint32 Tlsf_GetSize(const Tlsf* tlsf, uint32 handle)
+{
+	ASSERT(handle < tlsf->blockCount);
+	return tlsf->blocks[handle].size;
+}
+
+uint32 Tlsf_GetCapacity(const Tlsf* tlsf)
+{
+	return tlsf->capacity;
+}
+
+uint32 Tlsf_GetUsedSize(const Tlsf* tlsf)
+{
+	return tlsf->usedSize;
+}
+
+uint32 Tlsf_GetLargestFreeBlock(const Tlsf* tlsf)
+{
+	if (tlsf->flBitmap == 0)
+		return 0;
+
+	uint32 fl = Tlsf_FindLastSet(tlsf->flBitmap);
+	uint32 sl = Tlsf_FindLastSet(tlsf->slBitmap[fl]);
+	uint32 largest = 0;
+	for (uint32 index = tlsf->heads[fl][sl]; index != TLSF_INVALID; index = tlsf->blocks[index].nextFree)
+	{
+		if (tlsf->blocks[index].size > largest)
+			largest = tlsf->blocks[index].size;
+	}
+	return largest;
+}
+
+void Tlsf_Defragment(Tlsf* tlsf, Tlsf_MoveCallback callback, void* userData)
+{
+	uint32 cursor = 0;
+	uint32 lastUsed = TLSF_INVALID;
+	uint32 index = tlsf->firstPhysical;
+	tlsf->firstPhysical = TLSF_INVALID;
+
+	while (index != TLSF_INVALID)
+	{
+		Tlsf_Block* block = &tlsf->blocks[index];
+		uint32 next = block->nextPhysical;
+		if (block->state == BLOCK_USED)
+		{
+			if (callback != NULL)
+				callback(userData, block->offset, cursor, block->size);
+			block->offset = cursor;
+			cursor += block->size;
+
+			block->prevPhysical = lastUsed;
+			block->nextPhysical = TLSF_INVALID;
+			if (lastUsed != TLSF_INVALID)
+				tlsf->blocks[lastUsed].nextPhysical = index;
+			else
+				tlsf->firstPhysical = index;
+			lastUsed = index;
+		}
+		else
+		{
+			Tlsf_ReleaseBlock(tlsf, index);
+		}
+		index = next;
+	}
+
+	Tlsf_ResetLists(tlsf);
+	tlsf->lastPhysical = lastUsed;
+
+	if (cursor < tlsf->capacity)
+	{
+		uint32 rest = Tlsf_NewBlock(tlsf);
+		tlsf->blocks[rest].offset = cursor;
+		tlsf->blocks[rest].size = tlsf->capacity - cursor;
+		tlsf->blocks[rest].prevPhysical = lastUsed;
+		if (lastUsed != TLSF_INVALID)
+			tlsf->blocks[lastUsed].nextPhysical = rest;
+		else
+			tlsf->firstPhysical = rest;
+		tlsf->lastPhysical = rest;
+		Tlsf_InsertFree(tlsf, rest);
+	}
+}
+
+void Tlsf_Grow(Tlsf* tlsf, uint32 capacity)
+{
+	if (capacity <= tlsf->capacity)
+		return;
+
+	uint32 extra = capacity - tlsf->capacity;
+	uint32 last = tlsf->lastPhysical;
+	if (last != TLSF_INVALID && tlsf->blocks[last].state == BLOCK_FREE)
+	{
+		Tlsf_RemoveFree(tlsf, last);
+		tlsf->blocks[last].size += extra;
+		Tlsf_InsertFree(tlsf, last);
+	}
+	else
+	{
+		uint32 rest = Tlsf_NewBlock(tlsf);
+		tlsf->blocks[rest].offset = tlsf->capacity;
+		tlsf->blocks[rest].size = extra;
+		tlsf->blocks[rest].prevPhysical = last;
+		if (last != TLSF_INVALID)
+			tlsf->blocks[last].nextPhysical = rest;
+		else
+			tlsf->firstPhysical = rest;
+		tlsf->lastPhysical = rest;
+		Tlsf_InsertFree(tlsf, rest);
+	}
+	tlsf->capacity = capacity;
+}
\ No newline at end of file
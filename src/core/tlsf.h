@@ -0,0 +1,34 @@
+#ifndef __TLSF_H__
+#define __TLSF_H__
+
+#include "config.h"
+
+#define TLSF_INVALID 0xffffffff
+
+// Two-level segregated fit allocator over an abstract range of units.
+// It never touches the memory it manages, so it can be used to sub-allocate
+// GPU buffers. Handles stay valid across Tlsf_Defragment and Tlsf_Grow;
+// only their offsets change.
+typedef struct Tlsf Tlsf;
+
+typedef void (*Tlsf_MoveCallback)(void* userData, uint32 from, uint32 to, uint32 size);
+
+Tlsf* Tlsf_Create(uint32 capacity);
+void Tlsf_Destroy(Tlsf* tlsf);
+
+uint32 Tlsf_Allocate(Tlsf* tlsf, uint32 size);
+void Tlsf_Free(Tlsf* tlsf, uint32 handle);
+
+uint32 Tlsf_GetOffset(const Tlsf* tlsf, uint32 handle);
+uint32 Tlsf_GetSize(const Tlsf* tlsf, uint32 handle);
+uint32 Tlsf_GetCapacity(const Tlsf* tlsf);
+uint32 Tlsf_GetUsedSize(const Tlsf* tlsf);
+uint32 Tlsf_GetLargestFreeBlock(const Tlsf* tlsf);
+
+// Packs the used blocks to the front in order. The callback gets every used
+// block, also those that stay put (from == to), so it can copy into a new
+// buffer as well as move within the old one.
+void Tlsf_Defragment(Tlsf* tlsf, Tlsf_MoveCallback callback, void* userData);
+void Tlsf_Grow(Tlsf* tlsf, uint32 capacity);
+
+#endif
\ No newline at end of file
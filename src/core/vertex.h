@@ -16,4 +16,15 @@ typedef struct Vertex
 
 #define VERTEX_ATTRIBUTE_COUNTS 7
 
+#define INSTANCE_ATTRIBUTE_DRAW_ID VERTEX_ATTRIBUTE_COUNTS
+#define INSTANCE_ATTRIBUTE_MODEL (VERTEX_ATTRIBUTE_COUNTS + 1)
+#define INSTANCE_ATTRIBUTE_PARTICLE INSTANCE_ATTRIBUTE_MODEL
+#define INSTANCE_ATTRIBUTE_PARTICLE_COLOR (INSTANCE_ATTRIBUTE_MODEL + 1)
+#define INSTANCE_ATTRIBUTE_PARTICLE_VELOCITY (INSTANCE_ATTRIBUTE_MODEL + 2)
+#define INSTANCE_ATTRIBUTE_PARTICLE_LIFE (INSTANCE_ATTRIBUTE_MODEL + 3)
+#define INSTANCE_ATTRIBUTE_DECAL INSTANCE_ATTRIBUTE_MODEL
+#define INSTANCE_ATTRIBUTE_DECAL_AXIS (INSTANCE_ATTRIBUTE_MODEL + 1)
+#define INSTANCE_ATTRIBUTE_DECAL_ATLAS (INSTANCE_ATTRIBUTE_MODEL + 2)
+#define INSTANCE_ATTRIBUTE_DECAL_COLOR (INSTANCE_ATTRIBUTE_MODEL + 3)
+
 #endif
\ No newline at end of file
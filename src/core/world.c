@@ -0,0 +1,537 @@
+#include "world.h"
+#include <string.h>
+#include <math.h>
+
+#define WORLD_INDEX_BITS 20
+#define WORLD_INDEX_MASK ((1u << WORLD_INDEX_BITS) - 1)
+#define WORLD_GENERATION_MASK ((1u << (32 - WORLD_INDEX_BITS)) - 1)
+#define WORLD_ALIGNMENT 16
+#define WORLD_DEAD 0xFFFFFFFFu
+
+typedef struct World_Block
+{
+	uint8* data;
+	uint32 count;
+} World_Block;
+
+typedef struct World_Archetype
+{
+	ComponentMask components;
+	Chunk* renderChunk;
+	uint32 capacity;
+	uint32 blockBytes;
+	// Entity handles sit at offset 0, each component array after them.
+	uint32 offsets[WORLD_MAX_COMPONENTS];
+	World_Block* blocks;
+	uint32 blockCount;
+	uint32 maxBlocks;
+} World_Archetype;
+
+// While an entity is dead, row links the free list.
+typedef struct World_Record
+{
+	uint32 generation;
+	uint32 archetype;
+	uint32 block;
+	uint32 row;
+} World_Record;
+
+typedef struct World_QueryItem
+{
+	uint32 archetype;
+	uint32 block;
+} World_QueryItem;
+
+struct World
+{
+	World_Desc desc;
+	uint32 componentSizes[WORLD_MAX_COMPONENTS];
+	uint32 componentCount;
+	World_Record* records;
+	uint32 recordCount;
+	uint32 freeList;
+	uint32 entityCount;
+	World_Archetype* archetypes;
+	uint32 archetypeCount;
+	uint32 maxArchetypes;
+	World_QueryItem* queryItems;
+	uint32 maxQueryItems;
+};
+
+static uint32 World_Align(uint32 value)
+{
+	return (value + WORLD_ALIGNMENT - 1) & ~(WORLD_ALIGNMENT - 1);
+}
+
+static uint32 World_Layout(const World* world, ComponentMask components, uint32 capacity, uint32* offsets)
+{
+	uint32 size = World_Align(sizeof(Entity) * capacity);
+	for (uint32 i = 0; i < world->componentCount; i++)
+	{
+		if ((components & COMPONENT_BIT(i)) == 0)
+			continue;
+		if (offsets != NULL)
+			offsets[i] = size;
+		size = World_Align(size + world->componentSizes[i] * capacity);
+	}
+	return size;
+}
+
+static uint32 World_FindArchetype(World* world, ComponentMask components, Chunk* renderChunk)
+{
+	for (uint32 i = 0; i < world->archetypeCount; i++)
+	{
+		if (world->archetypes[i].components == components && world->archetypes[i].renderChunk == renderChunk)
+			return i;
+	}
+
+	if (world->archetypeCount == world->maxArchetypes)
+	{
+		world->maxArchetypes = world->maxArchetypes > 0 ? world->maxArchetypes * 2 : 16;
+		world->archetypes = (World_Archetype*)realloc(world->archetypes, sizeof(World_Archetype) * world->maxArchetypes);
+	}
+	World_Archetype* archetype = &world->archetypes[world->archetypeCount];
+	memset(archetype, 0, sizeof(World_Archetype));
+	archetype->components = components;
+	archetype->renderChunk = renderChunk;
+
+	uint32 entityBytes = sizeof(Entity);
+	for (uint32 i = 0; i < world->componentCount; i++)
+	{
+		if (components & COMPONENT_BIT(i))
+			entityBytes += world->componentSizes[i];
+	}
+	uint32 capacity = world->desc.blockSize / entityBytes;
+	while (capacity > 1 && World_Layout(world, components, capacity, NULL) > world->desc.blockSize)
+	{
+		capacity--;
+	}
+	if (capacity == 0)
+		capacity = 1;
+	archetype->capacity = capacity;
+	archetype->blockBytes = World_Layout(world, components, capacity, archetype->offsets);
+	return world->archetypeCount++;
+}
+
+static void World_Place(World* world, uint32 archetypeIndex, Entity entity)
+{
+	World_Archetype* archetype = &world->archetypes[archetypeIndex];
+	if (archetype->blockCount == 0 || archetype->blocks[archetype->blockCount - 1].count == archetype->capacity)
+	{
+		if (archetype->blockCount == archetype->maxBlocks)
+		{
+			archetype->maxBlocks = archetype->maxBlocks > 0 ? archetype->maxBlocks * 2 : 4;
+			archetype->blocks = (World_Block*)realloc(archetype->blocks, sizeof(World_Block) * archetype->maxBlocks);
+		}
+		World_Block* fresh = &archetype->blocks[archetype->blockCount++];
+		fresh->data = (uint8*)malloc(archetype->blockBytes);
+		fresh->count = 0;
+	}
+
+	uint32 blockIndex = archetype->blockCount - 1;
+	World_Block* block = &archetype->blocks[blockIndex];
+	uint32 row = block->count++;
+	((Entity*)block->data)[row] = entity;
+	for (uint32 i = 0; i < world->componentCount; i++)
+	{
+		if (archetype->components & COMPONENT_BIT(i))
+			memset(block->data + archetype->offsets[i] + world->componentSizes[i] * row, 0, world->componentSizes[i]);
+	}
+
+	World_Record* record = &world->records[entity & WORLD_INDEX_MASK];
+	record->archetype = archetypeIndex;
+	record->block = blockIndex;
+	record->row = row;
+}
+
+// Fills the hole with the archetype's last entity.
+static void World_Remove(World* world, const World_Record* record)
+{
+	World_Archetype* archetype = &world->archetypes[record->archetype];
+	World_Block* block = &archetype->blocks[record->block];
+	World_Block* last = &archetype->blocks[archetype->blockCount - 1];
+	uint32 lastRow = last->count - 1;
+	if (block != last || record->row != lastRow)
+	{
+		Entity moved = ((Entity*)last->data)[lastRow];
+		((Entity*)block->data)[record->row] = moved;
+		for (uint32 i = 0; i < world->componentCount; i++)
+		{
+			if ((archetype->components & COMPONENT_BIT(i)) == 0)
+				continue;
+			uint32 size = world->componentSizes[i];
+			memcpy(block->data + archetype->offsets[i] + size * record->row, last->data + archetype->offsets[i] + size * lastRow, size);
+		}
+		World_Record* movedRecord = &world->records[moved & WORLD_INDEX_MASK];
+		movedRecord->block = record->block;
+		movedRecord->row = record->row;
+	}
+
+	last->count--;
+	if (last->count == 0)
+	{
+		free(last->data);
+		archetype->blockCount--;
+	}
+}
+
+static void World_Move(World* world, Entity entity, ComponentMask components, Chunk* renderChunk)
+{
+	World_Record* record = &world->records[entity & WORLD_INDEX_MASK];
+	World_Archetype* source = &world->archetypes[record->archetype];
+	if (source->components == components && source->renderChunk == renderChunk)
+		return;
+
+	World_Record previous = *record;
+	uint32 target = World_FindArchetype(world, components, renderChunk);
+	World_Place(world, target, entity);
+
+	// Both may have moved: FindArchetype can grow the archetype array.
+	source = &world->archetypes[previous.archetype];
+	World_Archetype* destination = &world->archetypes[target];
+	const uint8* from = source->blocks[previous.block].data;
+	uint8* to = destination->blocks[record->block].data;
+	ComponentMask shared = source->components & components;
+	for (uint32 i = 0; i < world->componentCount; i++)
+	{
+		if ((shared & COMPONENT_BIT(i)) == 0)
+			continue;
+		uint32 size = world->componentSizes[i];
+		memcpy(to + destination->offsets[i] + size * record->row, from + source->offsets[i] + size * previous.row, size);
+	}
+	World_Remove(world, &previous);
+}
+
+static World_Record* World_GetRecord(const World* world, Entity entity)
+{
+	uint32 index = entity & WORLD_INDEX_MASK;
+	if (entity == ENTITY_NULL || index >= world->recordCount)
+		return NULL;
+	World_Record* record = &world->records[index];
+	if (record->archetype == WORLD_DEAD || record->generation != entity >> WORLD_INDEX_BITS)
+		return NULL;
+	return record;
+}
+
+World* World_Create(const World_Desc* world_desc)
+{
+	ASSERT(world_desc != NULL && world_desc->maxEntities > 0 && world_desc->maxEntities <= WORLD_INDEX_MASK);
+
+	World* world = (World*)malloc(sizeof(World));
+	memset(world, 0, sizeof(World));
+	world->desc = *world_desc;
+	if (world->desc.blockSize == 0)
+		world->desc.blockSize = 16 * 1024;
+	world->records = (World_Record*)malloc(sizeof(World_Record) * world_desc->maxEntities);
+	world->freeList = WORLD_DEAD;
+
+	world->componentSizes[COMPONENT_POSITION] = sizeof(float3);
+	world->componentSizes[COMPONENT_VELOCITY] = sizeof(float3);
+	world->componentSizes[COMPONENT_HEALTH] = sizeof(float);
+	world->componentSizes[COMPONENT_TEAM] = sizeof(uint32);
+	world->componentSizes[COMPONENT_TRANSFORM] = sizeof(matrix4x4);
+	world->componentCount = COMPONENT_BUILTIN_COUNT;
+	return world;
+}
+
+void World_Destroy(World* world)
+{
+	for (uint32 i = 0; i < world->archetypeCount; i++)
+	{
+		World_Archetype* archetype = &world->archetypes[i];
+		for (uint32 b = 0; b < archetype->blockCount; b++)
+		{
+			free(archetype->blocks[b].data);
+		}
+		free(archetype->blocks);
+	}
+	free(world->archetypes);
+	free(world->queryItems);
+	free(world->records);
+	free(world);
+}
+
+uint32 World_RegisterComponent(World* world, uint32 size)
+{
+	// Existing archetypes were laid out without it.
+	ASSERT(world->archetypeCount == 0 && world->componentCount < WORLD_MAX_COMPONENTS && size > 0);
+	world->componentSizes[world->componentCount] = size;
+	return world->componentCount++;
+}
+
+Entity World_CreateEntity(World* world, ComponentMask components, Chunk* renderChunk)
+{
+	uint32 index;
+	if (world->freeList != WORLD_DEAD)
+	{
+		index = world->freeList;
+		world->freeList = world->records[index].row;
+	}
+	else
+	{
+		if (world->recordCount == world->desc.maxEntities)
+		{
+			LOG_W("World is full, cannot create more than %u entities\n", world->desc.maxEntities);
+			return ENTITY_NULL;
+		}
+		index = world->recordCount++;
+		world->records[index].generation = 1;
+	}
+
+	// Index 0 with generation 0 would be ENTITY_NULL; generations start at 1.
+	Entity entity = (world->records[index].generation << WORLD_INDEX_BITS) | index;
+	World_Place(world, World_FindArchetype(world, components, renderChunk), entity);
+	world->entityCount++;
+	return entity;
+}
+
+void World_DestroyEntity(World* world, Entity entity)
+{
+	World_Record* record = World_GetRecord(world, entity);
+	if (record == NULL)
+		return;
+
+	World_Remove(world, record);
+	uint32 index = entity & WORLD_INDEX_MASK;
+	record->archetype = WORLD_DEAD;
+	record->generation = (record->generation + 1) & WORLD_GENERATION_MASK;
+	if (record->generation == 0)
+		record->generation = 1;
+	record->row = world->freeList;
+	world->freeList = index;
+	world->entityCount--;
+}
+
+int World_IsAlive(const World* world, Entity entity)
+{
+	return World_GetRecord(world, entity) != NULL;
+}
+
+void* World_GetComponent(World* world, Entity entity, uint32 component)
+{
+	World_Record* record = World_GetRecord(world, entity);
+	if (record == NULL)
+		return NULL;
+	World_Archetype* archetype = &world->archetypes[record->archetype];
+	if ((archetype->components & COMPONENT_BIT(component)) == 0)
+		return NULL;
+	return archetype->blocks[record->block].data + archetype->offsets[component] + world->componentSizes[component] * record->row;
+}
+
+ComponentMask World_GetComponents(const World* world, Entity entity)
+{
+	World_Record* record = World_GetRecord(world, entity);
+	return record != NULL ? world->archetypes[record->archetype].components : 0;
+}
+
+void World_AddComponents(World* world, Entity entity, ComponentMask components)
+{
+	World_Record* record = World_GetRecord(world, entity);
+	if (record == NULL)
+		return;
+	World_Archetype* archetype = &world->archetypes[record->archetype];
+	World_Move(world, entity, archetype->components | components, archetype->renderChunk);
+}
+
+void World_RemoveComponents(World* world, Entity entity, ComponentMask components)
+{
+	World_Record* record = World_GetRecord(world, entity);
+	if (record == NULL)
+		return;
+	World_Archetype* archetype = &world->archetypes[record->archetype];
+	World_Move(world, entity, archetype->components & ~components, archetype->renderChunk);
+}
+
+Chunk* World_GetRenderChunk(const World* world, Entity entity)
+{
+	World_Record* record = World_GetRecord(world, entity);
+	return record != NULL ? world->archetypes[record->archetype].renderChunk : NULL;
+}
+
+void World_SetRenderChunk(World* world, Entity entity, Chunk* renderChunk)
+{
+	World_Record* record = World_GetRecord(world, entity);
+	if (record == NULL)
+		return;
+	World_Move(world, entity, world->archetypes[record->archetype].components, renderChunk);
+}
+
+static void World_MakeView(const World* world, const World_Archetype* archetype, const World_Block* block, World_View* view)
+{
+	view->count = block->count;
+	view->entities = (const Entity*)block->data;
+	view->renderChunk = archetype->renderChunk;
+	for (uint32 i = 0; i < WORLD_MAX_COMPONENTS; i++)
+	{
+		view->components[i] = i < world->componentCount && (archetype->components & COMPONENT_BIT(i)) ? block->data + archetype->offsets[i] : NULL;
+	}
+}
+
+void World_Query(World* world, ComponentMask components, World_QueryFunction function, void* userData)
+{
+	World_View view;
+	for (uint32 a = 0; a < world->archetypeCount; a++)
+	{
+		const World_Archetype* archetype = &world->archetypes[a];
+		if ((archetype->components & components) != components)
+			continue;
+		for (uint32 b = 0; b < archetype->blockCount; b++)
+		{
+			World_MakeView(world, archetype, &archetype->blocks[b], &view);
+			function(&view, userData);
+		}
+	}
+}
+
+typedef struct World_QueryContext
+{
+	World* world;
+	World_QueryFunction function;
+	void* userData;
+} World_QueryContext;
+
+static void World_QueryRange(void* userData, uint32 begin, uint32 end)
+{
+	World_QueryContext* context = (World_QueryContext*)userData;
+	World_View view;
+	for (uint32 i = begin; i < end; i++)
+	{
+		const World_QueryItem* item = &context->world->queryItems[i];
+		const World_Archetype* archetype = &context->world->archetypes[item->archetype];
+		World_MakeView(context->world, archetype, &archetype->blocks[item->block], &view);
+		context->function(&view, context->userData);
+	}
+}
+
+void World_QueryJobs(World* world, JobSystem* jobs, ComponentMask components, World_QueryFunction function, void* userData)
+{
+	if (jobs == NULL)
+	{
+		World_Query(world, components, function, userData);
+		return;
+	}
+
+	uint32 count = 0;
+	for (uint32 a = 0; a < world->archetypeCount; a++)
+	{
+		const World_Archetype* archetype = &world->archetypes[a];
+		if ((archetype->components & components) != components)
+			continue;
+		if (count + archetype->blockCount > world->maxQueryItems)
+		{
+			while (count + archetype->blockCount > world->maxQueryItems)
+			{
+				world->maxQueryItems = world->maxQueryItems > 0 ? world->maxQueryItems * 2 : 64;
+			}
+			world->queryItems = (World_QueryItem*)realloc(world->queryItems, sizeof(World_QueryItem) * world->maxQueryItems);
+		}
+		for (uint32 b = 0; b < archetype->blockCount; b++)
+		{
+			world->queryItems[count].archetype = a;
+			world->queryItems[count].block = b;
+			count++;
+		}
+	}
+
+	World_QueryContext context = { world, function, userData };
+	JobSystem_ParallelFor(jobs, count, 1, World_QueryRange, &context);
+}
+
+static void World_IntegrateBlock(const World_View* view, void* userData)
+{
+	float deltaTime = *(const float*)userData;
+	float3* positions = (float3*)view->components[COMPONENT_POSITION];
+	const float3* velocities = (const float3*)view->components[COMPONENT_VELOCITY];
+	for (uint32 i = 0; i < view->count; i++)
+	{
+		positions[i].x += velocities[i].x * deltaTime;
+		positions[i].y += velocities[i].y * deltaTime;
+		positions[i].z += velocities[i].z * deltaTime;
+	}
+}
+
+void World_Integrate(World* world, JobSystem* jobs, float deltaTime)
+{
+	World_QueryJobs(world, jobs, COMPONENT_BIT(COMPONENT_POSITION) | COMPONENT_BIT(COMPONENT_VELOCITY), World_IntegrateBlock, &deltaTime);
+}
+
+static void World_TransformBlock(const World_View* view, void* userData)
+{
+	// Moving back (1 - alpha) of a tick along the velocity.
+	float back = *(const float*)userData;
+	const float3* positions = (const float3*)view->components[COMPONENT_POSITION];
+	const float3* velocities = (const float3*)view->components[COMPONENT_VELOCITY];
+	matrix4x4* transforms = (matrix4x4*)view->components[COMPONENT_TRANSFORM];
+	for (uint32 i = 0; i < view->count; i++)
+	{
+		matrix4x4* m = &transforms[i];
+		Matrix4x4_Identity(m);
+		m->d1 = positions[i].x;
+		m->d2 = positions[i].y;
+		m->d3 = positions[i].z;
+		if (velocities == NULL)
+			continue;
+
+		float3 v = velocities[i];
+		m->d1 -= v.x * back;
+		m->d2 -= v.y * back;
+		m->d3 -= v.z * back;
+		float length = sqrtf(v.x * v.x + v.z * v.z);
+		if (length > 1e-4f)
+		{
+			float fx = v.x / length;
+			float fz = v.z / length;
+			m->a1 = fz;
+			m->a3 = -fx;
+			m->c1 = fx;
+			m->c3 = fz;
+		}
+	}
+}
+
+void World_UpdateTransforms(World* world, JobSystem* jobs, float alpha, float tickTime)
+{
+	float back = (1.0f - alpha) * tickTime;
+	World_QueryJobs(world, jobs, COMPONENT_BIT(COMPONENT_POSITION) | COMPONENT_BIT(COMPONENT_TRANSFORM), World_TransformBlock, &back);
+}
+
+void World_Submit(World* world, RenderQueue* queue)
+{
+	for (uint32 a = 0; a < world->archetypeCount; a++)
+	{
+		const World_Archetype* archetype = &world->archetypes[a];
+		if (archetype->renderChunk == NULL || (archetype->components & COMPONENT_BIT(COMPONENT_TRANSFORM)) == 0)
+			continue;
+		for (uint32 b = 0; b < archetype->blockCount; b++)
+		{
+			const World_Block* block = &archetype->blocks[b];
+			RenderQueue_Add(queue, archetype->renderChunk, (const matrix4x4*)(block->data + archetype->offsets[COMPONENT_TRANSFORM]), block->count);
+		}
+	}
+}
+
+void World_Snapshot(World* world, RenderSnapshot* snapshot)
+{
+	for (uint32 a = 0; a < world->archetypeCount; a++)
+	{
+		const World_Archetype* archetype = &world->archetypes[a];
+		if (archetype->renderChunk == NULL || (archetype->components & COMPONENT_BIT(COMPONENT_TRANSFORM)) == 0)
+			continue;
+		for (uint32 b = 0; b < archetype->blockCount; b++)
+		{
+			const World_Block* block = &archetype->blocks[b];
+			RenderSnapshot_AddChunk(snapshot, archetype->renderChunk, (const matrix4x4*)(block->data + archetype->offsets[COMPONENT_TRANSFORM]), block->count);
+		}
+	}
+}
+
+void World_GetStats(const World* world, World_Stats* stats)
+{
+	stats->entityCount = world->entityCount;
+	stats->archetypeCount = world->archetypeCount;
+	stats->blockCount = 0;
+	for (uint32 i = 0; i < world->archetypeCount; i++)
+	{
+		stats->blockCount += world->archetypes[i].blockCount;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+#ifndef __WORLD_H__
+#define __WORLD_H__
+
+#include "config.h"
+#include "maths.h"
+#include "chunk.h"
+#include "job_system.h"
+#include "render_queue.h"
+#include "render_thread.h"
+
+#define WORLD_MAX_COMPONENTS 32
+
+// Archetype entity-component store. Entities with the same set of
+// components and the same render chunk share an archetype, which keeps
+// them in fixed-size blocks; inside a block every component is one
+// contiguous array (structure of arrays), so a query walks memory
+// linearly and hands whole arrays to its callback. Removing an entity
+// moves the archetype's last one into the hole, blocks never have gaps.
+//
+// The render chunk is shared by a whole archetype instead of stored per
+// entity, so the transforms of a block are already the instance array of
+// one draw: World_Submit hands them to the render queue as they are.
+//
+// Entity handles carry a 12-bit generation; a handle to a destroyed entity
+// is not mistaken for one reusing its slot until the slot was recycled
+// 4095 times. Component pointers and
+// views stay valid until the next structural change (create, destroy,
+// add, remove, render chunk), which must not happen during a query.
+// The update functions take a NULL job system to run on the calling
+// thread; a world runs one parallel query at a time.
+typedef struct World World;
+typedef uint32 Entity;
+typedef uint32 ComponentMask;
+
+#define ENTITY_NULL 0
+
+typedef enum Component
+{
+	COMPONENT_POSITION,		// float3
+	COMPONENT_VELOCITY,		// float3
+	COMPONENT_HEALTH,		// float
+	COMPONENT_TEAM,			// uint32
+	COMPONENT_TRANSFORM,	// matrix4x4
+	COMPONENT_BUILTIN_COUNT
+} Component;
+
+#define COMPONENT_BIT(component) (1u << (component))
+
+typedef struct World_Desc
+{
+	uint32 maxEntities;
+	// Bytes per block, entity handles included.
+	uint32 blockSize;
+} World_Desc;
+
+typedef struct World_View
+{
+	uint32 count;
+	const Entity* entities;
+	// Indexed by component, NULL for components outside the archetype.
+	void* components[WORLD_MAX_COMPONENTS];
+	Chunk* renderChunk;
+} World_View;
+
+typedef void (*World_QueryFunction)(const World_View* view, void* userData);
+
+typedef struct World_Stats
+{
+	uint32 entityCount;
+	uint32 archetypeCount;
+	uint32 blockCount;
+} World_Stats;
+
+World* World_Create(const World_Desc* world_desc);
+void World_Destroy(World* world);
+// Further components after the built-in ones; returns the id.
+uint32 World_RegisterComponent(World* world, uint32 size);
+
+Entity World_CreateEntity(World* world, ComponentMask components, Chunk* renderChunk);
+void World_DestroyEntity(World* world, Entity entity);
+int World_IsAlive(const World* world, Entity entity);
+void* World_GetComponent(World* world, Entity entity, uint32 component);
+ComponentMask World_GetComponents(const World* world, Entity entity);
+void World_AddComponents(World* world, Entity entity, ComponentMask components);
+void World_RemoveComponents(World* world, Entity entity, ComponentMask components);
+Chunk* World_GetRenderChunk(const World* world, Entity entity);
+void World_SetRenderChunk(World* world, Entity entity, Chunk* renderChunk);
+
+// Calls the function once per block holding all of the given components.
+void World_Query(World* world, ComponentMask components, World_QueryFunction function, void* userData);
+// Same, with the blocks spread over the job system.
+void World_QueryJobs(World* world, JobSystem* jobs, ComponentMask components, World_QueryFunction function, void* userData);
+
+// position += velocity * deltaTime.
+void World_Integrate(World* world, JobSystem* jobs, float deltaTime);
+// Builds transforms facing along the velocity, from the position moved
+// back by velocity * (1 - alpha) * tickTime: for constant velocity that is
+// exactly the interpolation between the last two ticks.
+void World_UpdateTransforms(World* world, JobSystem* jobs, float alpha, float tickTime);
+// One instanced batch per block with transforms and a render chunk.
+void World_Submit(World* world, RenderQueue* queue);
+void World_Snapshot(World* world, RenderSnapshot* snapshot);
+
+void World_GetStats(const World* world, World_Stats* stats);
+
+#endif
\ No newline at end of file
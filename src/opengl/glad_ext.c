@@ -0,0 +1,35 @@
+#include "glad_ext.h"
+
+int GLAD_GL_VERSION_3_3;
+PFNGLVERTEXATTRIBDIVISORPROC glad_glVertexAttribDivisor;
+
+int GLAD_GL_VERSION_4_3;
+PFNGLMULTIDRAWELEMENTSINDIRECTPROC glad_glMultiDrawElementsIndirect;
+PFNGLDISPATCHCOMPUTEPROC glad_glDispatchCompute;
+PFNGLMEMORYBARRIERPROC glad_glMemoryBarrier;
+PFNGLBINDIMAGETEXTUREPROC glad_glBindImageTexture;
+
+static void load_GL_VERSION_3_3(GLADloadproc load) {
+	if(!GLAD_GL_VERSION_3_3) return;
+	glad_glVertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISORPROC)load("glVertexAttribDivisor");
+	if(glad_glVertexAttribDivisor == NULL) GLAD_GL_VERSION_3_3 = 0;
+}
+
+static void load_GL_VERSION_4_3(GLADloadproc load) {
+	if(!GLAD_GL_VERSION_4_3) return;
+	glad_glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+	glad_glDispatchCompute = (PFNGLDISPATCHCOMPUTEPROC)load("glDispatchCompute");
+	glad_glMemoryBarrier = (PFNGLMEMORYBARRIERPROC)load("glMemoryBarrier");
+	glad_glBindImageTexture = (PFNGLBINDIMAGETEXTUREPROC)load("glBindImageTexture");
+	if(glad_glMultiDrawElementsIndirect == NULL || glad_glDispatchCompute == NULL || glad_glMemoryBarrier == NULL || glad_glBindImageTexture == NULL) GLAD_GL_VERSION_4_3 = 0;
+}
+
+int gladLoadGLExt(GLADloadproc load) {
+	int major = GLVersion.major;
+	int minor = GLVersion.minor;
+	GLAD_GL_VERSION_3_3 = (major == 3 && minor >= 3) || major > 3;
+	GLAD_GL_VERSION_4_3 = (major == 4 && minor >= 3) || major > 4;
+	load_GL_VERSION_3_3(load);
+	load_GL_VERSION_4_3(load);
+	return GLAD_GL_VERSION_3_3;
+}
\ No newline at end of file
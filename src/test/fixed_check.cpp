@@ -0,0 +1,363 @@
+#include "fixed_check.h"
+#include <core/maths/fixed.h>
+#include <math.h>
+#include <stdio.h>
+
+extern "C" {
+#include <core/timer.h>
+}
+
+using namespace lwge;
+using namespace lwge::core;
+
+#define FIXED_CHECK_COUNT 100000
+#define FIXED_BENCH_COUNT 4096
+#define FIXED_BENCH_ROUNDS 256
+
+// 128 bit two's complement, only for the references below: they work a bit
+// at a time so they share nothing with the code they check.
+struct FixedCheck_U128
+{
+	u64 high;
+	u64 low;
+};
+
+static FixedCheck_U128 FixedCheck_Add(FixedCheck_U128 a, FixedCheck_U128 b)
+{
+	FixedCheck_U128 sum;
+	sum.low = a.low + b.low;
+	sum.high = a.high + b.high + (sum.low < a.low ? 1 : 0);
+	return sum;
+}
+
+static FixedCheck_U128 FixedCheck_Negate(FixedCheck_U128 a)
+{
+	FixedCheck_U128 one = { 0, 1 };
+	a.high = ~a.high;
+	a.low = ~a.low;
+	return FixedCheck_Add(a, one);
+}
+
+static FixedCheck_U128 FixedCheck_ShiftLeft(FixedCheck_U128 a, u32 shift)
+{
+	for (u32 i = 0; i < shift; i++)
+	{
+		a.high = (a.high << 1) | (a.low >> 63);
+		a.low <<= 1;
+	}
+	return a;
+}
+
+static int FixedCheck_Less(FixedCheck_U128 a, FixedCheck_U128 b)
+{
+	return a.high != b.high ? a.high < b.high : a.low < b.low;
+}
+
+static FixedCheck_U128 FixedCheck_Multiply(u64 a, u64 b)
+{
+	FixedCheck_U128 product = { 0, 0 };
+	FixedCheck_U128 term = { 0, a };
+	for (u32 i = 0; i < 64; i++)
+	{
+		if ((b >> i) & 1)
+			product = FixedCheck_Add(product, term);
+		term = FixedCheck_ShiftLeft(term, 1);
+	}
+	return product;
+}
+
+static u64 FixedCheck_Magnitude(s64 a)
+{
+	return a < 0 ? 0u - (u64)a : (u64)a;
+}
+
+//! a * b / 2^fractionBits rounded half up, as the fixed types promise.
+static s64 FixedCheck_ReferenceMultiply(s64 a, s64 b, u32 fractionBits)
+{
+	FixedCheck_U128 product = FixedCheck_Multiply(FixedCheck_Magnitude(a), FixedCheck_Magnitude(b));
+	if ((a < 0) != (b < 0))
+		product = FixedCheck_Negate(product);
+	FixedCheck_U128 half = { 0, (u64)1 << (fractionBits - 1) };
+	product = FixedCheck_Add(product, half);
+	return (s64)((product.high << (64 - fractionBits)) | (product.low >> fractionBits));
+}
+
+//! a * 2^fractionBits / b truncated towards zero; false when it needs more than 63 bits.
+static bool FixedCheck_ReferenceDivide(s64 a, s64 b, u32 fractionBits, s64* quotient)
+{
+	FixedCheck_U128 dividend = { 0, FixedCheck_Magnitude(a) };
+	dividend = FixedCheck_ShiftLeft(dividend, fractionBits);
+	FixedCheck_U128 divisor = { 0, FixedCheck_Magnitude(b) };
+	FixedCheck_U128 remainder = { 0, 0 };
+	u64 result = 0;
+	for (int i = 127; i >= 0; i--)
+	{
+		u64 bit = i >= 64 ? (dividend.high >> (i - 64)) & 1 : (dividend.low >> i) & 1;
+		remainder = FixedCheck_ShiftLeft(remainder, 1);
+		remainder.low |= bit;
+		if (!FixedCheck_Less(remainder, divisor))
+		{
+			remainder = FixedCheck_Add(remainder, FixedCheck_Negate(divisor));
+			if (i >= 63)
+				return false;
+			result |= (u64)1 << i;
+		}
+	}
+	*quotient = (a < 0) != (b < 0) ? -(s64)result : (s64)result;
+	return true;
+}
+
+//! Whether root is sqrt(raw * 2^fractionBits) rounded to nearest: (2 root - 1)^2 <= 4 raw 2^f < (2 root + 1)^2.
+static bool FixedCheck_IsRoundedRoot(u64 raw, u32 fractionBits, u64 root)
+{
+	FixedCheck_U128 value = { 0, raw };
+	value = FixedCheck_ShiftLeft(value, fractionBits + 2);
+	FixedCheck_U128 above = FixedCheck_Multiply(2 * root + 1, 2 * root + 1);
+	if (!FixedCheck_Less(value, above))
+		return false;
+	if (root == 0)
+		return true;
+	FixedCheck_U128 below = FixedCheck_Multiply(2 * root - 1, 2 * root - 1);
+	return !FixedCheck_Less(value, below);
+}
+
+static u64 FixedCheck_Random(u64* state)
+{
+	*state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+	return *state;
+}
+
+//! Signed value of up to bits magnitude bits from the top of the generator.
+static s64 FixedCheck_RandomSigned(u64* state, u32 bits)
+{
+	u64 r = FixedCheck_Random(state);
+	s64 magnitude = (s64)(r >> (64 - bits));
+	return (r >> 20) & 1 ? -magnitude : magnitude;
+}
+
+// FNV-1a over the raw bits of every result.
+static u64 FixedCheck_Hash(u64 hash, u64 value)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		hash ^= (value >> (i * 8)) & 0xFF;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+struct FixedCheck_Result
+{
+	const char* name;
+	u64 hash;
+	u64 expectedHash;
+	u32 wrong;
+	//! Against libm, negative for the exact functions
+	f64 maxError;
+};
+
+static int FixedCheck_Report(const FixedCheck_Result* result)
+{
+	bool passed = result->wrong == 0 && result->hash == result->expectedHash;
+	printf("%-8s %s  hash %016llx%s  off %u", result->name, passed ? "ok    " : "FAILED",
+		result->hash, result->hash == result->expectedHash ? "" : " (expected different)", result->wrong);
+	if (result->maxError >= 0.0)
+		printf("  max error %.2f ulp", result->maxError);
+	printf("\n");
+	return passed ? 0 : 1;
+}
+
+static int FixedCheck_Exact()
+{
+	int failures = 0;
+	u64 state;
+	FixedCheck_Result result;
+
+	result.name = "mul16"; result.hash = 14695981039346656037ULL; result.expectedHash = 0x923ba679eeabcf54ULL; result.wrong = 0; result.maxError = -1.0;
+	state = 1;
+	for (u32 i = 0; i < FIXED_CHECK_COUNT; i++)
+	{
+		fix16 a = fix16::fromRaw((s32)FixedCheck_RandomSigned(&state, 24));
+		fix16 b = fix16::fromRaw((s32)FixedCheck_RandomSigned(&state, 22));
+		fix16 c = a * b;
+		result.wrong += c.raw != (s32)FixedCheck_ReferenceMultiply(a.raw, b.raw, 16);
+		result.hash = FixedCheck_Hash(result.hash, (u64)(s64)c.raw);
+	}
+	failures += FixedCheck_Report(&result);
+
+	result.name = "div16"; result.hash = 14695981039346656037ULL; result.expectedHash = 0x694847748aaa3a33ULL; result.wrong = 0;
+	state = 2;
+	for (u32 i = 0; i < FIXED_CHECK_COUNT; i++)
+	{
+		fix16 a = fix16::fromRaw((s32)FixedCheck_RandomSigned(&state, 26));
+		fix16 b = fix16::fromRaw((s32)FixedCheck_RandomSigned(&state, 22) | 1);
+		s64 expected;
+		if (!FixedCheck_ReferenceDivide(a.raw, b.raw, 16, &expected) || expected != (s32)expected)
+			continue;
+		fix16 c = a / b;
+		result.wrong += c.raw != expected;
+		result.hash = FixedCheck_Hash(result.hash, (u64)(s64)c.raw);
+	}
+	failures += FixedCheck_Report(&result);
+
+	result.name = "sqrt16"; result.hash = 14695981039346656037ULL; result.expectedHash = 0x07e187af9a8226bcULL; result.wrong = 0;
+	state = 3;
+	for (u32 i = 0; i < FIXED_CHECK_COUNT; i++)
+	{
+		fix16 a = fix16::fromRaw((s32)(FixedCheck_Random(&state) >> (33 + i % 24)));
+		fix16 c = fixedSqrt(a);
+		result.wrong += !FixedCheck_IsRoundedRoot((u64)a.raw, 16, (u64)c.raw);
+		result.hash = FixedCheck_Hash(result.hash, (u64)(s64)c.raw);
+	}
+	failures += FixedCheck_Report(&result);
+
+	result.name = "mul32"; result.hash = 14695981039346656037ULL; result.expectedHash = 0x9baa588452b44c3eULL; result.wrong = 0;
+	state = 4;
+	for (u32 i = 0; i < FIXED_CHECK_COUNT; i++)
+	{
+		fix32 a = fix32::fromRaw(FixedCheck_RandomSigned(&state, 48));
+		fix32 b = fix32::fromRaw(FixedCheck_RandomSigned(&state, 46));
+		fix32 c = a * b;
+		result.wrong += c.raw != FixedCheck_ReferenceMultiply(a.raw, b.raw, 32);
+		result.hash = FixedCheck_Hash(result.hash, (u64)c.raw);
+	}
+	failures += FixedCheck_Report(&result);
+
+	result.name = "div32"; result.hash = 14695981039346656037ULL; result.expectedHash = 0x22cea549fbfc6993ULL; result.wrong = 0;
+	state = 5;
+	for (u32 i = 0; i < FIXED_CHECK_COUNT; i++)
+	{
+		fix32 a = fix32::fromRaw(FixedCheck_RandomSigned(&state, 56));
+		fix32 b = fix32::fromRaw(FixedCheck_RandomSigned(&state, 24 + i % 32) | 1);
+		s64 expected;
+		if (!FixedCheck_ReferenceDivide(a.raw, b.raw, 32, &expected))
+			continue;
+		fix32 c = a / b;
+		result.wrong += c.raw != expected;
+		result.hash = FixedCheck_Hash(result.hash, (u64)c.raw);
+	}
+	failures += FixedCheck_Report(&result);
+
+	result.name = "sqrt32"; result.hash = 14695981039346656037ULL; result.expectedHash = 0x29713fab7781c5faULL; result.wrong = 0;
+	state = 6;
+	for (u32 i = 0; i < FIXED_CHECK_COUNT; i++)
+	{
+		fix32 a = fix32::fromRaw((s64)(FixedCheck_Random(&state) >> (1 + i % 48)));
+		fix32 c = fixedSqrt(a);
+		result.wrong += !FixedCheck_IsRoundedRoot((u64)a.raw, 32, (u64)c.raw);
+		result.hash = FixedCheck_Hash(result.hash, (u64)c.raw);
+	}
+	failures += FixedCheck_Report(&result);
+	return failures;
+}
+
+// The table and polynomial functions are not exact; libm in double only
+// bounds their error, the hashes pin their bits.
+static int FixedCheck_Approximate()
+{
+	int failures = 0;
+	u64 state;
+	FixedCheck_Result result;
+
+	result.name = "sin"; result.hash = 14695981039346656037ULL; result.expectedHash = 0x8e6a9e658fbf6e18ULL; result.wrong = 0; result.maxError = 0.0;
+	state = 7;
+	for (u32 i = 0; i < FIXED_CHECK_COUNT; i++)
+	{
+		fix16 a = fix16::fromRaw((s32)FixedCheck_RandomSigned(&state, 22));
+		fix16 c = fixedSin(a);
+		f64 error = fabs(c.raw - sin(a.raw / 65536.0) * 65536.0);
+		result.maxError = error > result.maxError ? error : result.maxError;
+		result.wrong += error > 1.0;
+		result.hash = FixedCheck_Hash(result.hash, (u64)(s64)c.raw);
+	}
+	failures += FixedCheck_Report(&result);
+
+	result.name = "cos"; result.hash = 14695981039346656037ULL; result.expectedHash = 0x20f269ce040c52c6ULL; result.wrong = 0; result.maxError = 0.0;
+	state = 8;
+	for (u32 i = 0; i < FIXED_CHECK_COUNT; i++)
+	{
+		fix16 a = fix16::fromRaw((s32)FixedCheck_RandomSigned(&state, 22));
+		fix16 c = fixedCos(a);
+		f64 error = fabs(c.raw - cos(a.raw / 65536.0) * 65536.0);
+		result.maxError = error > result.maxError ? error : result.maxError;
+		result.wrong += error > 1.0;
+		result.hash = FixedCheck_Hash(result.hash, (u64)(s64)c.raw);
+	}
+	failures += FixedCheck_Report(&result);
+
+	result.name = "atan2"; result.hash = 14695981039346656037ULL; result.expectedHash = 0xfd6fada2863a79e8ULL; result.wrong = 0; result.maxError = 0.0;
+	state = 9;
+	for (u32 i = 0; i < FIXED_CHECK_COUNT; i++)
+	{
+		fix16 y = fix16::fromRaw((s32)FixedCheck_RandomSigned(&state, 8 + i % 23));
+		fix16 x = fix16::fromRaw((s32)FixedCheck_RandomSigned(&state, 8 + i % 17));
+		fix16 c = fixedAtan2(y, x);
+		f64 error = fabs(c.raw - atan2((f64)y.raw, (f64)x.raw) * 65536.0);
+		result.maxError = error > result.maxError ? error : result.maxError;
+		result.wrong += error > 1.5;
+		result.hash = FixedCheck_Hash(result.hash, (u64)(s64)c.raw);
+	}
+	failures += FixedCheck_Report(&result);
+	return failures;
+}
+
+static fix16 fixedInputs[FIXED_BENCH_COUNT];
+static f32 floatInputs[FIXED_BENCH_COUNT];
+static volatile s32 fixedSink;
+static volatile f32 floatSink;
+
+static void FixedCheck_PrintTime(const char* name, f64 fixedTime, f64 floatTime)
+{
+	f64 scale = 1e6 / ((f64)FIXED_BENCH_COUNT * FIXED_BENCH_ROUNDS);
+	printf("%-8s fixed %6.2f ns  float %6.2f ns\n", name, fixedTime * scale, floatTime * scale);
+}
+
+// Each loop carries a dependency through the sum, so the timings are of
+// latency bound chains like the simulation's rather than of ideal throughput.
+static void FixedCheck_Benchmark()
+{
+	u64 state = 10;
+	for (u32 i = 0; i < FIXED_BENCH_COUNT; i++)
+	{
+		fixedInputs[i] = fix16::fromRaw((s32)(FixedCheck_Random(&state) >> 44) + 65536);
+		floatInputs[i] = fixedInputs[i].toFloat();
+	}
+
+	f64 start, fixedTime, floatTime;
+	fix16 fixedSum;
+	f32 floatSum;
+
+#define FIXED_CHECK_TIME(name, fixedStep, floatStep) \
+	fixedSum = fix16(); \
+	start = Timer_GetMilliseconds(); \
+	for (u32 round = 0; round < FIXED_BENCH_ROUNDS; round++) \
+		for (u32 i = 0; i < FIXED_BENCH_COUNT; i++) \
+			fixedSum = fixedStep; \
+	fixedTime = Timer_GetMilliseconds() - start; \
+	fixedSink = fixedSum.raw; \
+	floatSum = 0.0f; \
+	start = Timer_GetMilliseconds(); \
+	for (u32 round = 0; round < FIXED_BENCH_ROUNDS; round++) \
+		for (u32 i = 0; i < FIXED_BENCH_COUNT; i++) \
+			floatSum = floatStep; \
+	floatTime = Timer_GetMilliseconds() - start; \
+	floatSink = floatSum; \
+	FixedCheck_PrintTime(name, fixedTime, floatTime);
+
+	FIXED_CHECK_TIME("mul-add", fixedSum * fix16::fromRaw(65535) + fixedInputs[i], floatSum * 0.99998f + floatInputs[i]);
+	FIXED_CHECK_TIME("div", fixedSum + fix16(1) / fixedInputs[i], floatSum + 1.0f / floatInputs[i]);
+	FIXED_CHECK_TIME("sqrt", fixedSum + fixedSqrt(fixedInputs[i]), floatSum + sqrtf(floatInputs[i]));
+	FIXED_CHECK_TIME("sin", fixedSum + fixedSin(fixedInputs[i] + fixedSum), floatSum + sinf(floatInputs[i] + floatSum));
+	FIXED_CHECK_TIME("atan2", fixedSum + fixedAtan2(fixedInputs[i], fixedSum + fix16(1)), floatSum + atan2f(floatInputs[i], floatSum + 1.0f));
+
+#undef FIXED_CHECK_TIME
+}
+
+int FixedCheck_Run()
+{
+	int failures = FixedCheck_Exact();
+	failures += FixedCheck_Approximate();
+	FixedCheck_Benchmark();
+	printf(failures == 0 ? "fixed-point check passed\n" : "fixed-point check: %d failed\n", failures);
+	return failures;
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#ifndef __FIXED_CHECK_H__
+#define __FIXED_CHECK_H__
+
+// Checks the fixed-point maths against exact references and hashes of
+// known results, then times it against floats. Run with --fixed-check; the
+// hashes must come out the same with every compiler and build setting the
+// lockstep simulation is shipped with. Returns the number of failures.
+int FixedCheck_Run();
+
+#endif
\ No newline at end of file
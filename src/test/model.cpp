@@ -1,7 +1,9 @@
 #include "model.h"
 #include "gason.h"
 #include <string.h>
+#include <math.h>
 #include "TGA.h"
+#include <opengl/glad_ext.h>
 
 extern "C" {
 #include <core/mesh.h>
@@ -30,6 +32,8 @@ char* ReadFile(const char* fileName)
 Material* LoadMaterial(JsonValue value)
 {
 	Material* material = Material_Create();
+	const char* shaderFile = NULL;
+	const char* multiDrawShaderFile = NULL;
 	for (auto prop : value)
 	{
 		if (strcmp(prop->key, "textures") == 0)
@@ -44,6 +48,7 @@ Material* LoadMaterial(JsonValue value)
 						TEXTURE_RGBA_8888,
 						0,
 						0,
+						1,
 						0,
 						FILTER_BILINEAR,
 						FILTER_LINEAR,
@@ -66,41 +71,56 @@ Material* LoadMaterial(JsonValue value)
 		}
 		else if (strcmp(prop->key, "shader") == 0)
 		{
-			char* shaderSrc = ReadFile(prop->value.toString());
-			Shader* shader = Shader_Compile(shaderSrc);
-			free(shaderSrc);
-			Material_Set_Shader(material, shader);
+			shaderFile = prop->value.toString();
 		}
+		else if (strcmp(prop->key, "multiDrawShader") == 0)
+		{
+			multiDrawShaderFile = prop->value.toString();
+		}
+	}
+
+	// GL 4.3 has the transform storage buffer, which the multi-draw shader
+	// indexes with aDrawID instead of reading aModel.
+	if (multiDrawShaderFile != NULL && GLAD_GL_VERSION_4_3)
+		shaderFile = multiDrawShaderFile;
+	if (shaderFile != NULL)
+	{
+		char* shaderSrc = ReadFile(shaderFile);
+		Shader* shader = Shader_Compile(shaderSrc);
+		free(shaderSrc);
+		Material_Set_Shader(material, shader);
 	}
 	return material;
 }
 
-Mesh* LoadMesh(JsonValue value)
+bool LoadMeshData(const char* fileName, Mesh_Data* mesh_data)
 {
-	FILE* f = fopen(value.toString(), "r");
+	FILE* f = fopen(fileName, "r");
 	if (f == NULL)
-		return NULL;
+		return false;
 
-	Mesh_Data mesh_data;
-	fscanf(f, "NrVertices: %d\n", &mesh_data.vertexCount);
-	mesh_data.vertices = new Vertex[mesh_data.vertexCount];
-	for (int i = 0; i < mesh_data.vertexCount; i++)
+	fscanf(f, "NrVertices: %d\n", &mesh_data->vertexCount);
+	mesh_data->vertices = new Vertex[mesh_data->vertexCount];
+	for (int i = 0; i < mesh_data->vertexCount; i++)
 	{
-		fscanf(f, "%*s pos:[%f, %f, %f]; norm:[%*f, %*f, %*f]; binorm:[%*f, %*f, %*f]; tgt:[%*f, %*f, %*f]; uv:[%*f, %*f];\n", &(mesh_data.vertices[i].position.x), &(mesh_data.vertices[i].position.y), &(mesh_data.vertices[i].position.z));
+		fscanf(f, "%*s pos:[%f, %f, %f]; norm:[%*f, %*f, %*f]; binorm:[%*f, %*f, %*f]; tgt:[%*f, %*f, %*f]; uv:[%*f, %*f];\n", &(mesh_data->vertices[i].position.x), &(mesh_data->vertices[i].position.y), &(mesh_data->vertices[i].position.z));
 	}
 
-	fscanf(f, "NrIndices: %d\n", &mesh_data.indexCount);
-	mesh_data.indices = new uint32[mesh_data.indexCount];
-	for (int i = 0; i < mesh_data.indexCount / 3; i++)
+	fscanf(f, "NrIndices: %d\n", &mesh_data->indexCount);
+	mesh_data->indices = new uint32[mesh_data->indexCount];
+	for (int i = 0; i < mesh_data->indexCount / 3; i++)
 	{
-		fscanf(f, "%*d. %u, %u, %u", &(mesh_data.indices[i * 3]), &(mesh_data.indices[i * 3 + 1]), &(mesh_data.indices[i * 3 + 2]));
+		fscanf(f, "%*d. %u, %u, %u", &(mesh_data->indices[i * 3]), &(mesh_data->indices[i * 3 + 1]), &(mesh_data->indices[i * 3 + 2]));
 	}
+	fclose(f);
 
-	Mesh* mesh = Mesh_Create(&mesh_data);
-	delete[] mesh_data.vertices;
-	delete[] mesh_data.indices;
+	return true;
+}
 
-	return mesh;
+void FreeMeshData(Mesh_Data* mesh_data)
+{
+	delete[] mesh_data->vertices;
+	delete[] mesh_data->indices;
 }
 
 Model::Model(const char* fileName)
@@ -117,6 +137,9 @@ Model::Model(const char* fileName)
 
 	Mesh* mesh = NULL;
 	Material* material = NULL;
+	Mesh_Data mesh_data;
+	bool hasMeshData = false;
+	const char* occluderFile = NULL;
 	for (auto i : value)
 	{
 		if (strcmp(i->key, "Material") == 0)
@@ -125,19 +148,88 @@ Model::Model(const char* fileName)
 		}
 		else if (strcmp(i->key, "Mesh") == 0)
 		{
-			mesh = LoadMesh(i->value);
+			hasMeshData = LoadMeshData(i->value.toString(), &mesh_data);
+			if (hasMeshData)
+				mesh = Mesh_Create(&mesh_data);
+		}
+		else if (strcmp(i->key, "Occluder") == 0)
+		{
+			occluderFile = i->value.toString();
 		}
 	}
+
+	// "Occluder": "auto" builds boxes inside the (closed) render mesh, any
+	// other value names an authored low-poly occluder mesh.
+	m_occluder = NULL;
+	if (occluderFile != NULL)
+	{
+		if (strcmp(occluderFile, "auto") == 0)
+		{
+			if (hasMeshData)
+				m_occluder = Occluder_Generate(&mesh_data, 16);
+		}
+		else
+		{
+			Mesh_Data occluder_data;
+			if (LoadMeshData(occluderFile, &occluder_data))
+			{
+				m_occluder = Occluder_Create(&occluder_data);
+				FreeMeshData(&occluder_data);
+			}
+		}
+	}
+	if (hasMeshData)
+		FreeMeshData(&mesh_data);
 	
 	m_chunk = Chunk_Create(mesh, material);
+
+	memset(&m_transform, 0, sizeof(m_transform));
+	m_transform.a1 = m_transform.b2 = m_transform.c3 = m_transform.d4 = 1.0f;
+	m_previousTransform = m_transform;
+	m_angle = 0.0f;
 }
 
 Model::~Model()
 {
+	if (m_occluder != NULL)
+		Occluder_Destroy(m_occluder);
 	Chunk_Destroy(m_chunk);
 }
 
-void Model::Draw()
+const Occluder* Model::GetOccluder() const
+{
+	return m_occluder;
+}
+
+Chunk* Model::GetChunk() const
+{
+	return m_chunk;
+}
+
+void Model::Draw(RenderQueue* queue)
+{
+	RenderQueue_Add(queue, m_chunk, &m_transform, 1);
+}
+
+void Model::Tick(float tickTime)
+{
+	m_previousTransform = m_transform;
+	m_angle = fmodf(m_angle + tickTime * 1.5f, 6.2831853f);
+
+	// Spin around the vertical axis.
+	float c = cosf(m_angle);
+	float s = sinf(m_angle);
+	m_transform.a1 = c;
+	m_transform.a3 = -s;
+	m_transform.c1 = s;
+	m_transform.c3 = c;
+}
+
+void Model::Draw(RenderSnapshot* snapshot, float alpha)
 {
-	Chunk_Draw(m_chunk);
+	matrix4x4 transform;
+	Matrix4x4_Interpolate(&m_previousTransform, &m_transform, alpha, &transform);
+	RenderSnapshot_AddChunk(snapshot, m_chunk, &transform, 1);
+	if (m_occluder != NULL)
+		RenderSnapshot_AddOccluder(snapshot, m_occluder, &transform);
 }
@@ -7,6 +7,9 @@ extern "C" {
 
 #include <core/config.h>
 #include <core/chunk.h>
+#include <core/render_queue.h>
+#include <core/occlusion.h>
+#include <core/render_thread.h>
 
 #ifdef __cplusplus
 }
@@ -19,10 +22,20 @@ public:
 	Model(const char* fileName);
 	~Model();
 
-	void Draw();
+	void Draw(RenderQueue* queue);
+	// Advances the simulation by one fixed tick of the given length.
+	void Tick(float tickTime);
+	// Draws the model between the last two ticks, alpha in [0, 1].
+	void Draw(RenderSnapshot* snapshot, float alpha);
+	const Occluder* GetOccluder() const;
+	Chunk* GetChunk() const;
 
 private:
 	Chunk* m_chunk;
+	matrix4x4 m_transform;
+	matrix4x4 m_previousTransform;
+	float m_angle;
+	Occluder* m_occluder;
 };
 
 #endif
\ No newline at end of file
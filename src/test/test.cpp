@@ -1,26 +1,208 @@
 #include <core/config.h>
 #include <opengl/glad.h>
+#include <opengl/glad_ext.h>
 #include <GLFW/glfw3.h>
+#include <string.h>
+#include <stdlib.h>
 #include "model.h"
+#include "fixed_check.h"
+
+extern "C" {
+#include <core/frame_clock.h>
+#include <core/framebuffer.h>
+#include <core/task_graph.h>
+#include <core/timer.h>
+#include <core/world.h>
+}
+
+enum
+{
+	RESOURCE_INPUT = 1 << 0,
+	RESOURCE_SIMULATION = 1 << 1,
+	RESOURCE_SNAPSHOT = 1 << 2
+};
 
 Model* model;
+RenderQueue* renderQueue;
+OcclusionBuffer* occlusionBuffer;
+GpuCull* gpuCull;
+Framebuffer* sceneTarget;
+Texture* sceneColor;
+Texture* sceneDepth;
+int sceneWidth;
+int sceneHeight;
+RenderThread* renderThread;
+FrameClock* frameClock;
+float frameAlpha;
+JobSystem* jobs;
+World* world;
 
-void Init()
+#define UNIT_GRID 32
+#define UNIT_SPACING 4.0f
+#define UNIT_SPEED 2.0f
+
+// Runs on the render thread, which owns the GL context from here on.
+void Init(void* userData)
 {
+	glfwMakeContextCurrent((GLFWwindow*)userData);
+	gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+	if (!gladLoadGLExt((GLADloadproc)glfwGetProcAddress))
+	{
+		LOG_E("OpenGL 3.3 is required, the context has %d.%d\n", GLVersion.major, GLVersion.minor);
+		exit(EXIT_FAILURE);
+	}
+
 	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 	model = new Model("test.model");
+	renderQueue = RenderQueue_Create(4096);
+	occlusionBuffer = OcclusionBuffer_Create(256, 128);
+	RenderQueue_SetOcclusionBuffer(renderQueue, occlusionBuffer);
+	LOG_I("Multi-draw indirect: %s\n", RenderQueue_GetMultiDraw(renderQueue) ? "enabled" : "disabled");
+
+	// GPU culling tests against the Hi-Z pyramid of the previous frame, so
+	// the scene goes to a target whose depth is a texture.
+	gpuCull = GpuCull_IsSupported() ? GpuCull_Create(4096) : NULL;
+	if (gpuCull != NULL)
+	{
+		glfwGetFramebufferSize((GLFWwindow*)userData, &sceneWidth, &sceneHeight);
+		Texture_Desc colorDesc = { TEXTURE_2D, TEXTURE_RGBA_8888, (uint32)sceneWidth, (uint32)sceneHeight, 1, 1, FILTER_POINT, FILTER_POINT, WRAP_CLAMP, WRAP_CLAMP };
+		Texture_Desc depthDesc = colorDesc;
+		depthDesc.format = TEXTURE_DEPTH_32F;
+		sceneColor = Texture_Create(&colorDesc);
+		Texture_SetData(sceneColor, 0, NULL);
+		sceneDepth = Texture_Create(&depthDesc);
+		Texture_SetData(sceneDepth, 0, NULL);
+		sceneTarget = Framebuffer_Create();
+		Framebuffer_AttachColor(sceneTarget, 0, sceneColor, 0);
+		Framebuffer_AttachDepth(sceneTarget, sceneDepth, 0);
+		if (Framebuffer_IsComplete(sceneTarget))
+		{
+			RenderQueue_SetGpuCull(renderQueue, gpuCull);
+		}
+	}
+	LOG_I("GPU culling: %s\n", gpuCull != NULL ? "enabled" : "disabled");
+}
+
+void Draw(const RenderSnapshot* snapshot, void* userData)
+{
+	if (gpuCull != NULL)
+	{
+		Framebuffer_Bind(sceneTarget);
+		glEnable(GL_DEPTH_TEST);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		RenderSnapshot_Submit(snapshot, renderQueue);
+		Framebuffer_BlitColor(sceneTarget, NULL, sceneWidth, sceneHeight);
+		GpuCull_BuildHiZ(gpuCull, sceneDepth);
+	}
+	else
+	{
+		glClear(GL_COLOR_BUFFER_BIT);
+		RenderSnapshot_Submit(snapshot, renderQueue);
+	}
+
+	/* Swap front and back buffers */
+	glfwSwapBuffers((GLFWwindow*)userData);
+}
+
+void Shutdown(void* userData)
+{
+	RenderQueue_Destroy(renderQueue);
+	OcclusionBuffer_Destroy(occlusionBuffer);
+	if (gpuCull != NULL)
+	{
+		Framebuffer_Destroy(sceneTarget);
+		Texture_Destroy(sceneColor);
+		Texture_Destroy(sceneDepth);
+		GpuCull_Destroy(gpuCull);
+	}
+	delete model;
+	glfwMakeContextCurrent(NULL);
+}
+
+void SpawnUnits()
+{
+	ComponentMask components = COMPONENT_BIT(COMPONENT_POSITION) | COMPONENT_BIT(COMPONENT_VELOCITY) |
+		COMPONENT_BIT(COMPONENT_HEALTH) | COMPONENT_BIT(COMPONENT_TEAM) | COMPONENT_BIT(COMPONENT_TRANSFORM);
+	for (uint32 i = 0; i < UNIT_GRID * UNIT_GRID; i++)
+	{
+		Entity unit = World_CreateEntity(world, components, model->GetChunk());
+		float3* position = (float3*)World_GetComponent(world, unit, COMPONENT_POSITION);
+		float3* velocity = (float3*)World_GetComponent(world, unit, COMPONENT_VELOCITY);
+		position->x = (i % UNIT_GRID) * UNIT_SPACING;
+		position->z = (i / UNIT_GRID) * UNIT_SPACING;
+		velocity->x = (i % 3 == 0 ? -1.0f : 1.0f) * UNIT_SPEED;
+		velocity->z = (i % 2 == 0 ? -1.0f : 1.0f) * UNIT_SPEED;
+		*(float*)World_GetComponent(world, unit, COMPONENT_HEALTH) = 100.0f;
+		*(uint32*)World_GetComponent(world, unit, COMPONENT_TEAM) = i % 2;
+	}
 }
 
-void Draw()
+/* Keeps the units inside the grid by bouncing them off its edges */
+void BounceUnits(const World_View* view, void* userData)
 {
-	glClear(GL_COLOR_BUFFER_BIT);
-	model->Draw();
+	const float size = (UNIT_GRID - 1) * UNIT_SPACING;
+	float3* positions = (float3*)view->components[COMPONENT_POSITION];
+	float3* velocities = (float3*)view->components[COMPONENT_VELOCITY];
+	for (uint32 i = 0; i < view->count; i++)
+	{
+		if ((positions[i].x < 0.0f && velocities[i].x < 0.0f) || (positions[i].x > size && velocities[i].x > 0.0f))
+			velocities[i].x = -velocities[i].x;
+		if ((positions[i].z < 0.0f && velocities[i].z < 0.0f) || (positions[i].z > size && velocities[i].z > 0.0f))
+			velocities[i].z = -velocities[i].z;
+	}
+}
+
+void Tick(float tickTime)
+{
+	model->Tick(tickTime);
+	World_Integrate(world, jobs, tickTime);
+	World_QueryJobs(world, jobs, COMPONENT_BIT(COMPONENT_POSITION) | COMPONENT_BIT(COMPONENT_VELOCITY), BounceUnits, NULL);
+}
+
+void Update(RenderSnapshot* snapshot, float alpha)
+{
+	model->Draw(snapshot, alpha);
+	World_UpdateTransforms(world, jobs, alpha, FrameClock_GetTickTime(frameClock));
+	World_Snapshot(world, snapshot);
+}
+
+void InputStage(void* userData, uint32 frame)
+{
+	/* Stay at most one frame ahead of the render thread */
+	RenderThread_Wait(renderThread);
+
+	/* Poll for and process events */
+	glfwPollEvents();
+}
+
+void SimulateStage(void* userData, uint32 frame)
+{
+	uint32 ticks = FrameClock_Advance(frameClock, Timer_GetMilliseconds());
+	for (uint32 i = 0; i < ticks; i++)
+	{
+		Tick(FrameClock_GetTickTime(frameClock));
+	}
+	frameAlpha = FrameClock_GetAlpha(frameClock);
+}
+
+void BuildStage(void* userData, uint32 frame)
+{
+	Update(RenderThread_BeginFrame(renderThread), frameAlpha);
+}
+
+void SubmitStage(void* userData, uint32 frame)
+{
+	RenderThread_Publish(renderThread);
 }
 
-int main(void)
+int main(int argc, char** argv)
 {
 	GLFWwindow* window;
 
+	/* --fixed-check checks and times the fixed-point maths, no window needed */
+	if (argc > 1 && strcmp(argv[1], "--fixed-check") == 0)
+		return FixedCheck_Run() == 0 ? 0 : 1;
+
 	/* Initialize the library */
 	if (!glfwInit())
 		return -1;
@@ -33,23 +215,65 @@ int main(void)
 		return -1;
 	}
 
-	/* Make the window's context current */
-	glfwMakeContextCurrent(window);
-	gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
-	Init();
+	/* Hand the context over to the render thread; --single-thread keeps
+	   everything on this one for debugging */
+	RenderThread_Desc desc;
+	memset(&desc, 0, sizeof(desc));
+	desc.threaded = !(argc > 1 && strcmp(argv[1], "--single-thread") == 0);
+	desc.maxItems = 4096;
+	desc.maxInstances = 4096;
+	desc.maxParameters = 256;
+	desc.maxOccluders = 64;
+	desc.start = Init;
+	desc.render = Draw;
+	desc.stop = Shutdown;
+	desc.userData = window;
+	renderThread = RenderThread_Create(&desc);
+
+	/* Simulate at a fixed 20 Hz, draw at whatever the display does */
+	FrameClock_Desc clockDesc;
+	clockDesc.tickRate = 20.0;
+	clockDesc.maxTicksPerFrame = 5;
+	clockDesc.maxFrameTime = 250.0;
+	frameClock = FrameClock_Create(&clockDesc);
+
+	/* Events and submission stay on this thread, which GLFW requires and
+	   which renders itself with --single-thread */
+	JobSystem_Desc jobsDesc;
+	jobsDesc.workerCount = 0;
+	jobsDesc.jobsPerThread = 4096;
+	jobs = JobSystem_Create(&jobsDesc);
+
+	/* The model was loaded by the render thread before it returned */
+	World_Desc worldDesc;
+	worldDesc.maxEntities = 65536;
+	worldDesc.blockSize = 16 * 1024;
+	world = World_Create(&worldDesc);
+	SpawnUnits();
+	TaskGraph_Stage stages[] =
+	{
+		{ "input", InputStage, NULL, 0, RESOURCE_INPUT, 1 },
+		{ "simulate", SimulateStage, NULL, RESOURCE_INPUT, RESOURCE_SIMULATION, 0 },
+		{ "build", BuildStage, NULL, RESOURCE_SIMULATION, RESOURCE_SNAPSHOT, 0 },
+		{ "submit", SubmitStage, NULL, 0, RESOURCE_SNAPSHOT, 1 }
+	};
+	TaskGraph* graph = TaskGraph_Create(jobs, stages, sizeof(stages) / sizeof(stages[0]));
 
 	/* Loop until the user closes the window */
 	while (!glfwWindowShouldClose(window))
 	{
-		Draw();
-
-		/* Swap front and back buffers */
-		glfwSwapBuffers(window);
+		uint32 frame = TaskGraph_Kick(graph);
 
-		/* Poll for and process events */
-		glfwPollEvents();
+		TaskGraph_Report report;
+		if (frame % 600 == 0 && TaskGraph_GetReport(graph, &report))
+			TaskGraph_LogReport(graph, &report);
 	}
 
+	TaskGraph_Destroy(graph);
+	World_Destroy(world);
+	JobSystem_Destroy(jobs);
+	FrameClock_Destroy(frameClock);
+	RenderThread_Destroy(renderThread);
 	glfwTerminate();
 	return 0;
 }
\ No newline at end of file